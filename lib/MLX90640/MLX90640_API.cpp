@@ -34,7 +34,13 @@ void ExtractCILCParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
 int ExtractDeviatingPixels(uint16_t *eeData, paramsMLX90640 *mlx90640);
 int CheckAdjacentPixels(uint16_t pix1, uint16_t pix2);
 int CheckEEPROMValid(uint16_t *eeData);  
+int ReadStatusRegister(uint8_t slaveAddr, uint16_t *statusRegister);
+int ReadFrameData(uint8_t slaveAddr, uint16_t *frameData, uint16_t statusRegister);
 
+static acquisitionStatsMLX90640 acquisitionStats;
+static uint16_t framePolls = 0;
+static uint32_t lastSubPageReady = 0;
+static uint8_t scheduleValid = 0;
   
 int MLX90640_DumpEE(uint8_t slaveAddr, uint16_t *eeData)
 {
@@ -44,15 +50,14 @@ int MLX90640_DumpEE(uint8_t slaveAddr, uint16_t *eeData)
 int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData)
 {
     uint16_t dataReady = 1;
-    uint16_t controlRegister1;
     uint16_t statusRegister;
     int error = 1;
-    uint8_t cnt = 0;
     
+    framePolls = 0;
     dataReady = 0;
     while(dataReady == 0)
     {
-        error = MLX90640_I2CRead(slaveAddr, 0x8000, 1, &statusRegister);
+        error = ReadStatusRegister(slaveAddr, &statusRegister);
         if(error != 0)
         {
             return error;
@@ -60,6 +65,110 @@ int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData)
         dataReady = statusRegister & 0x0008;
     }       
         
+    return ReadFrameData(slaveAddr, frameData, statusRegister);
+}
+
+//------------------------------------------------------------------------------
+
+int MLX90640_GetFrameDataScheduled(uint8_t slaveAddr, uint16_t *frameData)
+{
+    uint16_t statusRegister;
+    uint32_t period;
+    uint32_t wakeUp;
+    uint32_t elapsed;
+    uint32_t start;
+    unsigned int backoff;
+    unsigned int maxBackoff;
+    int refreshRate;
+    int error;
+    
+    framePolls = 0;
+    if(acquisitionStats.subPagePeriod == 0)
+    {
+        refreshRate = MLX90640_GetRefreshRate(slaveAddr);
+        if(refreshRate < 0)
+        {
+            return refreshRate;
+        }
+        acquisitionStats.subPagePeriod = 2000000 >> refreshRate;
+        scheduleValid = 0;
+    }
+    period = acquisitionStats.subPagePeriod;
+    
+    //Sleep until shortly before next subpage is expected, sensor clock is not exact so wake up 1/8 period earlier
+    if(scheduleValid)
+    {
+        wakeUp = period - period / 8;
+        elapsed = MLX90640_Micros() - lastSubPageReady;
+        if(elapsed < wakeUp)
+        {
+            MLX90640_Delay((wakeUp - elapsed) / 1000);
+        }
+    }
+    
+    //Then poll status register with increasing intervals, but never longer than 1/16 of period
+    backoff = 1;
+    maxBackoff = period / 16000;
+    if(maxBackoff < 1)
+    {
+        maxBackoff = 1;
+    }
+    start = MLX90640_Micros();
+    while(1)
+    {
+        error = ReadStatusRegister(slaveAddr, &statusRegister);
+        if(error != 0)
+        {
+            return error;
+        }
+        if((statusRegister & 0x0008) != 0)
+        {
+            break;
+        }
+        if(MLX90640_Micros() - start > 2 * period)
+        {
+            scheduleValid = 0;
+            return -9;
+        }
+        MLX90640_Delay(backoff);
+        backoff = backoff * 2;
+        if(backoff > maxBackoff)
+        {
+            backoff = maxBackoff;
+        }
+    }
+    lastSubPageReady = MLX90640_Micros();
+    scheduleValid = 1;
+    
+    return ReadFrameData(slaveAddr, frameData, statusRegister);
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_GetAcquisitionStats(acquisitionStatsMLX90640 *stats)
+{
+    *stats = acquisitionStats;
+}
+
+//------------------------------------------------------------------------------
+
+int ReadStatusRegister(uint8_t slaveAddr, uint16_t *statusRegister)
+{
+    framePolls = framePolls + 1;
+    acquisitionStats.statusPolls = acquisitionStats.statusPolls + 1;
+    return MLX90640_I2CRead(slaveAddr, 0x8000, 1, statusRegister);
+}
+
+//------------------------------------------------------------------------------
+
+int ReadFrameData(uint8_t slaveAddr, uint16_t *frameData, uint16_t statusRegister)
+{
+    uint16_t dataReady = statusRegister & 0x0008;
+    uint16_t controlRegister1;
+    int error = 1;
+    uint8_t cnt = 0;
+    uint32_t start = MLX90640_Micros();
+    
     while(dataReady != 0 && cnt < 5)
     { 
         error = MLX90640_I2CWrite(slaveAddr, 0x8000, 0x0030);
@@ -74,7 +183,7 @@ int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData)
             return error;
         }
                    
-        error = MLX90640_I2CRead(slaveAddr, 0x8000, 1, &statusRegister);
+        error = ReadStatusRegister(slaveAddr, &statusRegister);
         if(error != 0)
         {
             return error;
@@ -83,6 +192,14 @@ int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData)
         cnt = cnt + 1;
     }
     
+    acquisitionStats.frames = acquisitionStats.frames + 1;
+    acquisitionStats.lastReadTime = MLX90640_Micros() - start;
+    acquisitionStats.lastFramePolls = framePolls;
+    if(framePolls > acquisitionStats.maxFramePolls)
+    {
+        acquisitionStats.maxFramePolls = framePolls;
+    }
+    
     if(cnt > 4)
     {
         return -8;
@@ -100,6 +217,8 @@ int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData)
     return frameData[833];    
 }
 
+//------------------------------------------------------------------------------
+
 int MLX90640_ExtractParameters(uint16_t *eeData, paramsMLX90640 *mlx90640)
 {
     int error = CheckEEPROMValid(eeData);
@@ -182,6 +301,10 @@ int MLX90640_SetRefreshRate(uint8_t slaveAddr, uint8_t refreshRate)
         error = MLX90640_I2CWrite(slaveAddr, 0x800D, value);
     }    
     
+    //Scheduled reads have to pick up new subpage period
+    acquisitionStats.subPagePeriod = 0;
+    scheduleValid = 0;
+    
     return error;
 }
 
@@ -45,8 +45,20 @@
         uint16_t outlierPixels[5];  
     } paramsMLX90640;
     
+  typedef struct
+    {
+        uint32_t frames;
+        uint32_t statusPolls;
+        uint16_t lastFramePolls;
+        uint16_t maxFramePolls;
+        uint32_t subPagePeriod;
+        uint32_t lastReadTime;
+    } acquisitionStatsMLX90640;
+    
     int MLX90640_DumpEE(uint8_t slaveAddr, uint16_t *eeData);
     int MLX90640_GetFrameData(uint8_t slaveAddr, uint16_t *frameData);
+    int MLX90640_GetFrameDataScheduled(uint8_t slaveAddr, uint16_t *frameData);
+    void MLX90640_GetAcquisitionStats(acquisitionStatsMLX90640 *stats);
     int MLX90640_ExtractParameters(uint16_t *eeData, paramsMLX90640 *mlx90640);
     float MLX90640_GetVdd(uint16_t *frameData, const paramsMLX90640 *params);
     float MLX90640_GetTa(uint16_t *frameData, const paramsMLX90640 *params);
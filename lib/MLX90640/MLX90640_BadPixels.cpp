@@ -0,0 +1,146 @@
+#include "MLX90640_BadPixels.h"
+#include "MLX90640_Fixed.h"
+
+int IsBadPixel(const badPixelsMLX90640 *plan, int pixel);
+void AddNeighbours(const badPixelsMLX90640 *plan, badPixelMLX90640 *bad, int pattern, const int offsets[][2], int offsetCount);
+
+static const int interleavedNear[2][2] = {{0, -1}, {0, 1}};
+static const int interleavedFar[2][2] = {{-2, 0}, {2, 0}};
+static const int chessNear[4][2] = {{-1, -1}, {-1, 1}, {1, -1}, {1, 1}};
+static const int chessFar[4][2] = {{0, -2}, {0, 2}, {-2, 0}, {2, 0}};
+
+void MLX90640_PrepareBadPixels(const paramsMLX90640 *params, badPixelsMLX90640 *plan)
+{
+    int i;
+    int row;
+    int column;
+    badPixelMLX90640 *bad;
+
+    plan->count = 0;
+    for(i = 0; i < 5 && params->brokenPixels[i] < 768; i++)
+    {
+        plan->pixels[plan->count++].pixel = params->brokenPixels[i];
+    }
+    plan->broken = plan->count;
+    for(i = 0; i < 5 && params->outlierPixels[i] < 768; i++)
+    {
+        plan->pixels[plan->count++].pixel = params->outlierPixels[i];
+    }
+
+    for(i = 0; i < plan->count; i++)
+    {
+        bad = &plan->pixels[i];
+        row = bad->pixel / 32;
+        column = bad->pixel % 32;
+        bad->subPage[0] = row & 1;
+        bad->subPage[1] = (row ^ column) & 1;
+
+        bad->count[0] = 0;
+        AddNeighbours(plan, bad, 0, interleavedNear, 2);
+        if(bad->count[0] == 0)
+        {
+            AddNeighbours(plan, bad, 0, interleavedFar, 2);
+        }
+
+        bad->count[1] = 0;
+        AddNeighbours(plan, bad, 1, chessNear, 4);
+        if(bad->count[1] == 0)
+        {
+            AddNeighbours(plan, bad, 1, chessFar, 4);
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_CorrectBadPixels(const badPixelsMLX90640 *plan, int subPage, int pattern, float *result)
+{
+    const badPixelMLX90640 *bad;
+    float sum;
+
+    pattern = pattern != 0;
+    for(int i = 0; i < plan->count; i++)
+    {
+        bad = &plan->pixels[i];
+        if(bad->subPage[pattern] != subPage || bad->count[pattern] == 0)
+        {
+            continue;
+        }
+        sum = 0.0f;
+        for(int n = 0; n < bad->count[pattern]; n++)
+        {
+            sum = sum + result[bad->neighbours[pattern][n]];
+        }
+        result[bad->pixel] = sum / bad->count[pattern];
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_CorrectBadPixelsFixed(const badPixelsMLX90640 *plan, int subPage, int pattern, int16_t *result)
+{
+    const badPixelMLX90640 *bad;
+    int32_t sum;
+    int32_t count;
+    int16_t value;
+    int invalid;
+
+    pattern = pattern != 0;
+    for(int i = 0; i < plan->count; i++)
+    {
+        bad = &plan->pixels[i];
+        count = bad->count[pattern];
+        if(bad->subPage[pattern] != subPage || count == 0)
+        {
+            continue;
+        }
+        sum = 0;
+        invalid = 0;
+        for(int n = 0; n < count; n++)
+        {
+            value = result[bad->neighbours[pattern][n]];
+            invalid = invalid || value == MLX90640_FIXED_INVALID;
+            sum = sum + value;
+        }
+        //Rounded to nearest like float correction, invalid neighbour makes pixel invalid as NaN does there
+        result[bad->pixel] = invalid ? MLX90640_FIXED_INVALID : (int16_t)((sum + (sum < 0 ? -count : count) / 2) / count);
+    }
+}
+
+//------------------------------------------------------------------------------
+
+int IsBadPixel(const badPixelsMLX90640 *plan, int pixel)
+{
+    for(int i = 0; i < plan->count; i++)
+    {
+        if(plan->pixels[i].pixel == pixel)
+        {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+//------------------------------------------------------------------------------
+
+void AddNeighbours(const badPixelsMLX90640 *plan, badPixelMLX90640 *bad, int pattern, const int offsets[][2], int offsetCount)
+{
+    int row;
+    int column;
+    int neighbour;
+
+    for(int i = 0; i < offsetCount; i++)
+    {
+        row = bad->pixel / 32 + offsets[i][0];
+        column = bad->pixel % 32 + offsets[i][1];
+        if(row < 0 || row >= 24 || column < 0 || column >= 32)
+        {
+            continue;
+        }
+        neighbour = row * 32 + column;
+        if(!IsBadPixel(plan, neighbour))
+        {
+            bad->neighbours[pattern][bad->count[pattern]++] = neighbour;
+        }
+    }
+}
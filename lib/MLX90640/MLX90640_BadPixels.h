@@ -0,0 +1,45 @@
+/**
+ * Correction of broken and outlier pixels listed in EEPROM (paramsMLX90640
+ * brokenPixels / outlierPixels, filled by MLX90640_ExtractParameters()).
+ *
+ * MLX90640_PrepareBadPixels() builds correction plan once: for every flagged pixel
+ * and both subpage patterns it picks neighbours measured in the same subpage, so
+ * replacement comes from the same conversion as the pixel itself:
+ *
+ *   interleaved  left and right pixel, pixels two rows up and down if both are unusable
+ *   chess        four diagonal pixels, pixels two columns / rows away if all are unusable
+ *
+ * Neighbours outside the array or flagged themselves are skipped. Per subpage
+ * MLX90640_CorrectBadPixels() only averages neighbours of at most 10 pixels.
+ */
+#ifndef _MLX640_BAD_PIXELS_H_
+#define _MLX640_BAD_PIXELS_H_
+
+#include <stdint.h>
+#include "MLX90640_API.h"
+
+#define MLX90640_MAX_BAD_PIXELS 10
+#define MLX90640_MAX_BAD_PIXEL_NEIGHBOURS 4
+
+  typedef struct
+    {
+        uint16_t pixel;
+        uint8_t subPage[2];                                        //subpage measuring pixel, [interleaved, chess]
+        uint8_t count[2];                                          //usable neighbours, 0 leaves pixel as measured
+        uint16_t neighbours[2][MLX90640_MAX_BAD_PIXEL_NEIGHBOURS];
+    } badPixelMLX90640;
+
+  typedef struct
+    {
+        uint8_t count;
+        uint8_t broken;                                            //first broken pixels are listed, outliers follow
+        badPixelMLX90640 pixels[MLX90640_MAX_BAD_PIXELS];
+    } badPixelsMLX90640;
+
+    void MLX90640_PrepareBadPixels(const paramsMLX90640 *params, badPixelsMLX90640 *plan);
+    //pattern is 0 for interleaved and 1 for chess mode, as bit 12 of control register
+    void MLX90640_CorrectBadPixels(const badPixelsMLX90640 *plan, int subPage, int pattern, float *result);
+    //Same for fixed-point output of MLX90640_CalculateToFixed()
+    void MLX90640_CorrectBadPixelsFixed(const badPixelsMLX90640 *plan, int subPage, int pattern, int16_t *result);
+
+#endif
@@ -0,0 +1,96 @@
+#include "MLX90640_Counting.h"
+
+static int CountingRead(void *context, uint8_t slaveAddr, unsigned int startAddress, unsigned int nWordsRead, uint16_t *data);
+static int CountingWrite(void *context, uint8_t slaveAddr, unsigned int writeAddress, uint16_t data);
+static void CountingSleep(void *context, uint32_t us);
+static uint32_t CountingMicros(void *context);
+
+void MLX90640_CountingInit(countingMLX90640 *counting, const i2cTransportMLX90640 *inner, uint32_t readLatency, uint32_t writeLatency)
+{
+    counting->inner = inner;
+    counting->readLatency = readLatency;
+    counting->writeLatency = writeLatency;
+    MLX90640_CountingReset(counting);
+}
+
+void MLX90640_CountingReset(countingMLX90640 *counting)
+{
+    counting->reads = 0;
+    counting->writes = 0;
+    counting->wordsRead = 0;
+    counting->errors = 0;
+    counting->busTime = 0;
+    counting->sleepTime = 0;
+}
+
+void MLX90640_CountingTransport(countingMLX90640 *counting, i2cTransportMLX90640 *transport)
+{
+    transport->read = CountingRead;
+    transport->write = CountingWrite;
+    transport->sleep = CountingSleep;
+    transport->micros = CountingMicros;
+    transport->context = counting;
+}
+
+//------------------------------------------------------------------------------
+
+static int CountingRead(void *context, uint8_t slaveAddr, unsigned int startAddress, unsigned int nWordsRead, uint16_t *data)
+{
+    countingMLX90640 *counting = (countingMLX90640 *)context;
+    const i2cTransportMLX90640 *inner = counting->inner;
+    uint32_t start = inner->micros(inner->context);
+    int error;
+
+    if(counting->readLatency > 0)
+    {
+        inner->sleep(inner->context, counting->readLatency);
+    }
+    error = inner->read(inner->context, slaveAddr, startAddress, nWordsRead, data);
+    counting->reads++;
+    if(error != 0)
+    {
+        counting->errors++;
+    }
+    else
+    {
+        counting->wordsRead += nWordsRead;
+    }
+    counting->busTime += inner->micros(inner->context) - start;
+
+    return error;
+}
+
+static int CountingWrite(void *context, uint8_t slaveAddr, unsigned int writeAddress, uint16_t data)
+{
+    countingMLX90640 *counting = (countingMLX90640 *)context;
+    const i2cTransportMLX90640 *inner = counting->inner;
+    uint32_t start = inner->micros(inner->context);
+    int error;
+
+    if(counting->writeLatency > 0)
+    {
+        inner->sleep(inner->context, counting->writeLatency);
+    }
+    error = inner->write(inner->context, slaveAddr, writeAddress, data);
+    counting->writes++;
+    if(error != 0)
+    {
+        counting->errors++;
+    }
+    counting->busTime += inner->micros(inner->context) - start;
+
+    return error;
+}
+
+static void CountingSleep(void *context, uint32_t us)
+{
+    countingMLX90640 *counting = (countingMLX90640 *)context;
+    counting->sleepTime += us;
+    counting->inner->sleep(counting->inner->context, us);
+}
+
+static uint32_t CountingMicros(void *context)
+{
+    countingMLX90640 *counting = (countingMLX90640 *)context;
+    return counting->inner->micros(counting->inner->context);
+}
@@ -0,0 +1,29 @@
+/**
+ * Transport wrapper counting bus operations of another transport and optionally
+ * injecting extra latency into every read and write (through inner transport sleep,
+ * so simulated bus time and real bus time are affected the same way).
+ */
+#ifndef _MLX640_COUNTING_H_
+#define _MLX640_COUNTING_H_
+
+#include <stdint.h>
+#include "MLX90640_I2C_Driver.h"
+
+  typedef struct
+    {
+        const i2cTransportMLX90640 *inner;
+        uint32_t readLatency;               //us added to every read
+        uint32_t writeLatency;              //us added to every write
+        uint32_t reads;
+        uint32_t writes;
+        uint32_t wordsRead;
+        uint32_t errors;
+        uint32_t busTime;                   //us spent in reads and writes, including injected latency
+        uint32_t sleepTime;                 //us requested by sleeps
+    } countingMLX90640;
+
+    void MLX90640_CountingInit(countingMLX90640 *counting, const i2cTransportMLX90640 *inner, uint32_t readLatency, uint32_t writeLatency);
+    void MLX90640_CountingReset(countingMLX90640 *counting);
+    void MLX90640_CountingTransport(countingMLX90640 *counting, i2cTransportMLX90640 *transport);
+
+#endif
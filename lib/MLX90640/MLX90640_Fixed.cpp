@@ -0,0 +1,292 @@
+#include "MLX90640_Fixed.h"
+#include <math.h>
+
+#define ROOT4_TABLE_SIZE 1025                   //indexed by top 10 bits of normalized value
+#define RECIPROCAL_TABLE_SIZE 1026              //Q14 denominators 0.5 .. 1.5 in steps of 16
+#define RECIPROCAL_MIN 8192
+#define RECIPROCAL_MAX 24576
+#define KELVIN_CENTI 27315
+
+static uint32_t root4Table[ROOT4_TABLE_SIZE];             //(i * 2^22)^(1/4), Q16
+static uint32_t reciprocalTable[RECIPROCAL_TABLE_SIZE];   //1 / ((8192 + 16 * i) / 2^14), Q24
+
+void RefreshFixedCalibration(const paramsMLX90640 *params, fixedMLX90640 *fixed, float ta, float vdd);
+
+//Rounds to nearest integer in single precision, lroundf is a library call on ESP32
+static inline int32_t RoundQ(float x)
+{
+    return (int32_t)(x < 0 ? x - 0.5f : x + 0.5f);
+}
+
+void MLX90640_PrepareFixed(const paramsMLX90640 *params, const preparedMLX90640 *prepared, fixedMLX90640 *fixed)
+{
+    float minAlpha = prepared->alphaCP[0][0];
+    float scale;
+    int shift;
+
+    for(int i = 0; i < ROOT4_TABLE_SIZE; i++)
+    {
+        root4Table[i] = (uint32_t)lround(pow((double)i * 4194304.0, 0.25) * 65536.0);
+    }
+    for(int i = 0; i < RECIPROCAL_TABLE_SIZE; i++)
+    {
+        reciprocalTable[i] = (uint32_t)lround(16777216.0 * 16384.0 / (RECIPROCAL_MIN + 16 * i));
+    }
+
+    for(int pixelNumber = 0; pixelNumber < MLX90640_PIXEL_COUNT; pixelNumber++)
+    {
+        fixed->ilChessCorrection[pixelNumber] = RoundQ(prepared->ilChessCorrection[pixelNumber] * 256.0f);
+        minAlpha = fminf(minAlpha, fminf(prepared->alphaCP[0][pixelNumber], prepared->alphaCP[1][pixelNumber]));
+    }
+
+    //Largest shift keeping all scaled reciprocals below 2^30
+    frexpf(1.0f / (minAlpha * 65536.0f), &shift);
+    shift = 30 - shift;
+    if(shift < 0)
+    {
+        shift = 0;
+    }
+    if(shift > 30)
+    {
+        shift = 30;
+    }
+    fixed->invAlphaShift = shift;
+    scale = (float)(1UL << shift) / 65536.0f;
+    for(int subPage = 0; subPage < 2; subPage++)
+    {
+        for(int pixelNumber = 0; pixelNumber < MLX90640_PIXEL_COUNT; pixelNumber++)
+        {
+            fixed->invAlpha[subPage][pixelNumber] = RoundQ(scale / prepared->alphaCP[subPage][pixelNumber]);
+        }
+    }
+
+    fixed->ksTo1Factor = RoundQ(prepared->ksTo1Factor * 16384.0f);
+    fixed->ksTo1 = RoundQ(params->ksTo[1] * 16384.0f / 100.0f * 65536.0f);
+    for(int range = 0; range < 4; range++)
+    {
+        fixed->rangeA[range] = RoundQ(prepared->alphaCorrR[range] * (1.0f - params->ksTo[range] * params->ct[range]) * 16384.0f);
+        fixed->rangeB[range] = RoundQ(prepared->alphaCorrR[range] * params->ksTo[range] * 16384.0f / 100.0f * 65536.0f);
+        fixed->ct[range] = params->ct[range] * 100;
+    }
+
+    fixed->valid = 0;
+}
+
+//------------------------------------------------------------------------------
+
+//Only offsets depend on Ta and Vdd per pixel, Ta dependence of alpha is common factor applied per frame
+void RefreshFixedCalibration(const paramsMLX90640 *params, fixedMLX90640 *fixed, float ta, float vdd)
+{
+    float dTa = ta - 25.0f;
+    float dVdd = vdd - 3.3f;
+
+    for(int pixelNumber = 0; pixelNumber < MLX90640_PIXEL_COUNT; pixelNumber++)
+    {
+        fixed->offset[pixelNumber] = RoundQ(params->offset[pixelNumber] * (1.0f + params->kta[pixelNumber] * dTa) * (1.0f + params->kv[pixelNumber] * dVdd) * 256.0f);
+    }
+
+    fixed->ta = ta;
+    fixed->vdd = vdd;
+    fixed->valid = 1;
+}
+
+//------------------------------------------------------------------------------
+
+//Fourth root of x (in units of 2^8 K^4), returns temperature in centi-kelvin or -1 if x
+//is not positive: there is no such temperature, float kernels give NaN there
+static inline int32_t Root4CentiKelvin(int64_t x)
+{
+    uint32_t value;
+    uint32_t index;
+    uint32_t fraction;
+    uint32_t root;
+    int shift;
+
+    if(x <= 0)
+    {
+        return -1;
+    }
+    if(x > 0xFFFFFFFF)
+    {
+        x = 0xFFFFFFFF;
+    }
+    value = (uint32_t)x;
+
+    //Normalize by multiple of 4 bits, so root of the scale is whole number of bits
+    shift = __builtin_clz(value) & ~3;
+    value = value << shift;
+    index = value >> 22;
+    fraction = (value >> 6) & 0xFFFF;
+    root = root4Table[index] + (((root4Table[index + 1] - root4Table[index]) * fraction) >> 16);
+
+    return (int32_t)(((uint64_t)root * 400) >> (16 + shift / 4));
+}
+
+//------------------------------------------------------------------------------
+
+//Reciprocal of Q14 value from 0.5 to 1.5, Q24
+static inline int32_t Reciprocal(int32_t value)
+{
+    uint32_t index;
+    uint32_t fraction;
+
+    if(value < RECIPROCAL_MIN)
+    {
+        value = RECIPROCAL_MIN;
+    }
+    if(value > RECIPROCAL_MAX)
+    {
+        value = RECIPROCAL_MAX;
+    }
+    index = (value - RECIPROCAL_MIN) >> 4;
+    fraction = value & 0x0F;
+
+    return reciprocalTable[index] - (((reciprocalTable[index] - reciprocalTable[index + 1]) * fraction) >> 4);
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_CalculateToFixed(uint16_t *frameData, const paramsMLX90640 *params, fixedMLX90640 *fixed, float emissivity, float tr, int16_t *result)
+{
+    float vdd;
+    float ta;
+    float ta4;
+    float tr4;
+    float irDataCP[2];
+    float gain;
+    int32_t gainQ14;
+    float alphaTaFactor;
+    int32_t irScaleQ20;
+    int32_t cpCompensation;
+    int32_t taTr;
+    int32_t irData;
+    int64_t irAlpha;
+    int32_t To;
+    int32_t denominator;
+    int range;
+    uint8_t mode;
+    uint8_t ilChessCorrection;
+    uint16_t subPage;
+    int step;
+    int count;
+
+    subPage = frameData[833];
+    vdd = MLX90640_GetVdd(frameData, params);
+    ta = MLX90640_GetTa(frameData, params);
+
+    if(!fixed->valid || fabsf(ta - fixed->ta) > MLX90640_FIXED_TA_THRESHOLD || fabsf(vdd - fixed->vdd) > MLX90640_FIXED_VDD_THRESHOLD)
+    {
+        RefreshFixedCalibration(params, fixed, ta, vdd);
+    }
+
+//------------------------- Per frame constants --------------------------------
+    ta4 = ta + 273.15f;
+    ta4 = ta4 * ta4;
+    ta4 = ta4 * ta4;
+    tr4 = tr + 273.15f;
+    tr4 = tr4 * tr4;
+    tr4 = tr4 * tr4;
+    taTr = (int32_t)lroundf((tr4 - (tr4-ta4)/emissivity) / 256.0f);
+
+    mode = (frameData[832] & 0x1000) >> 5;
+    ilChessCorrection = mode != params->calibrationModeEE;
+
+    gain = params->gainEE / (float)(int16_t)frameData[778];
+    gainQ14 = (int32_t)lroundf(gain * 16384.0f);
+    //Ta dependence of alpha is same for all pixels, it scales IR data instead of per pixel reciprocals
+    alphaTaFactor = 1.0f + params->KsTa * (ta - 25.0f);
+    irScaleQ20 = (int32_t)lroundf(1048576.0f / (emissivity * alphaTaFactor));
+
+    irDataCP[0] = (int16_t)frameData[776] * gain - params->cpOffset[0] * (1.0f + params->cpKta * (ta - 25.0f)) * (1.0f + params->cpKv * (vdd - 3.3f));
+    irDataCP[1] = (int16_t)frameData[808] * gain - params->cpOffset[1] * (1.0f + params->cpKta * (ta - 25.0f)) * (1.0f + params->cpKv * (vdd - 3.3f));
+    if(ilChessCorrection)
+    {
+        irDataCP[1] = irDataCP[1] - params->ilChessC[0] * (1.0f + params->cpKta * (ta - 25.0f)) * (1.0f + params->cpKv * (vdd - 3.3f));
+    }
+    cpCompensation = (int32_t)lroundf(params->tgc * irDataCP[subPage] * 256.0f / alphaTaFactor);
+
+//------------------------- To calculation -------------------------------------
+    const int32_t *invAlpha = fixed->invAlpha[subPage];
+    const int shift = fixed->invAlphaShift;
+
+    for(int row = 0; row < MLX90640_ROWS; row++)
+    {
+        int pixelNumber = row * 32;
+        if(mode == 0)
+        {
+            //Interleaved: subpage is made of whole rows
+            if((row & 1) != subPage)
+            {
+                continue;
+            }
+            step = 1;
+            count = 32;
+        }
+        else
+        {
+            //Chess: every second pixel, starting column alternates with row
+            pixelNumber = pixelNumber + ((row & 1) ^ subPage);
+            step = 2;
+            count = 16;
+        }
+
+        for(int i = 0; i < count; i++, pixelNumber += step)
+        {
+            irData = ((int32_t)(int16_t)frameData[pixelNumber] * gainQ14) >> 6;
+            irData = irData - fixed->offset[pixelNumber];
+            if(ilChessCorrection)
+            {
+                irData = irData + fixed->ilChessCorrection[pixelNumber];
+            }
+            irData = (int32_t)(((int64_t)irData * irScaleQ20) >> 20) - cpCompensation;
+
+            //irData / alpha, in units of 2^8 K^4
+            irAlpha = ((int64_t)irData * invAlpha[pixelNumber]) >> shift;
+
+            //First estimate without ksTo, then with Sx term: alpha * (1 - ksTo1 * 273.15) + Sx = alpha * (ksTo1Factor + ksTo1 * To)
+            To = Root4CentiKelvin(irAlpha + taTr);
+            if(To < 0)
+            {
+                result[pixelNumber] = MLX90640_FIXED_INVALID;
+                continue;
+            }
+            denominator = fixed->ksTo1Factor + (int32_t)(((int64_t)fixed->ksTo1 * To) >> 16);
+            To = Root4CentiKelvin(((irAlpha * Reciprocal(denominator)) >> 24) + taTr);
+            if(To < 0)
+            {
+                result[pixelNumber] = MLX90640_FIXED_INVALID;
+                continue;
+            }
+            To = To - KELVIN_CENTI;
+
+            range = 0;
+            if(To >= fixed->ct[1])
+            {
+                range = 1;
+            }
+            if(To >= fixed->ct[2])
+            {
+                range = 2;
+            }
+            if(To >= fixed->ct[3])
+            {
+                range = 3;
+            }
+
+            denominator = fixed->rangeA[range] + (int32_t)(((int64_t)fixed->rangeB[range] * To) >> 16);
+            To = Root4CentiKelvin(((irAlpha * Reciprocal(denominator)) >> 24) + taTr);
+            if(To < 0)
+            {
+                result[pixelNumber] = MLX90640_FIXED_INVALID;
+                continue;
+            }
+            To = To - KELVIN_CENTI;
+
+            if(To > 32767)
+            {
+                To = 32767;
+            }
+            result[pixelNumber] = (int16_t)To;
+        }
+    }
+}
@@ -0,0 +1,51 @@
+/**
+ * Fixed-point (integer only per pixel) variant of MLX90640_CalculateTo.
+ *
+ * Intended for low-power builds on classic ESP32 where float sqrt chains dominate
+ * frame time. Calibration terms are converted to integers once by
+ * MLX90640_PrepareFixed(), except offsets: they depend on Ta and Vdd per pixel and
+ * are refreshed in single precision when those drift by more than
+ * MLX90640_FIXED_TA_THRESHOLD / MLX90640_FIXED_VDD_THRESHOLD (above ADC noise, so
+ * not every subpage). Ta dependence of alpha is one factor applied per frame.
+ * Per pixel work uses only int32/int64 multiplications, shifts and two lookup
+ * tables (fourth root and reciprocal).
+ * Output is int16 in centi-degrees C, which can be sent without further conversion.
+ * Pixels the float kernels give NaN for are set to MLX90640_FIXED_INVALID.
+ *
+ * Error against MLX90640_CalculateTo() is below 0.03 degC over the -40..300 degC
+ * object range (host sweep with synthetic calibration data). Exception are pixels
+ * whose intermediate To lands within ~0.01 degC of ct[2] / ct[3]: reference is not
+ * continuous there when ksTo differs between ranges, so rounding may pick the other
+ * range (about 1 in 40000 pixels, up to 1.5 degC).
+ */
+#ifndef _MLX640_FIXED_H_
+#define _MLX640_FIXED_H_
+
+#include <stdint.h>
+#include "MLX90640_API.h"
+#include "MLX90640_Prepared.h"
+
+#define MLX90640_FIXED_TA_THRESHOLD 0.05f
+#define MLX90640_FIXED_VDD_THRESHOLD 0.005f
+#define MLX90640_FIXED_INVALID (-32768)          //no temperature, lowest int16 as NaN is quantized for clients
+
+  typedef struct
+    {
+        float ta;
+        float vdd;
+        uint8_t valid;
+        uint8_t invAlphaShift;
+        int32_t offset[MLX90640_PIXEL_COUNT];                   //offsetCompensated, Q8, only part depending on Ta and Vdd
+        int32_t ilChessCorrection[MLX90640_PIXEL_COUNT];        //Q8
+        int32_t invAlpha[2][MLX90640_PIXEL_COUNT];              //1 / (alphaCP * 2^16), scaled by 2^invAlphaShift
+        int32_t ksTo1Factor;                                    //Q14
+        int32_t ksTo1;                                          //Q14 per centi-degree, scaled by 2^16
+        int32_t rangeA[4];                                      //alphaCorrR * (1 - ksTo * ct), Q14
+        int32_t rangeB[4];                                      //alphaCorrR * ksTo, Q14 per centi-degree, scaled by 2^16
+        int32_t ct[4];                                          //centi-degrees
+    } fixedMLX90640;
+
+    void MLX90640_PrepareFixed(const paramsMLX90640 *params, const preparedMLX90640 *prepared, fixedMLX90640 *fixed);
+    void MLX90640_CalculateToFixed(uint16_t *frameData, const paramsMLX90640 *params, fixedMLX90640 *fixed, float emissivity, float tr, int16_t *result);
+
+#endif
@@ -11,76 +11,170 @@
    limitations under the License.
 */
 
-#include<Arduino.h>
+#include "MLX90640_I2C_Driver.h"
 
+#ifdef ARDUINO
+#include <Arduino.h>
 #include <Wire.h>
+#endif
 
-#include "MLX90640_I2C_Driver.h"
+static i2cStatsMLX90640 i2cStats = {0, 0, 0, I2C_BUFFER_LENGTH};   //Wire transport only
 
-void MLX90640_I2CInit()
+#ifdef ARDUINO
+static int WireRead(void *context, uint8_t _deviceAddress, unsigned int startAddress, unsigned int nWordsRead, uint16_t *data);
+static int WireWrite(void *context, uint8_t _deviceAddress, unsigned int writeAddress, uint16_t data);
+static void WireSleep(void *context, uint32_t us);
+static uint32_t WireMicros(void *context);
+
+const i2cTransportMLX90640 MLX90640_WireTransport = {WireRead, WireWrite, WireSleep, WireMicros, NULL};
+static const i2cTransportMLX90640 *transport = &MLX90640_WireTransport;
+#else
+static const i2cTransportMLX90640 *transport = NULL;
+#endif
+
+void MLX90640_SetTransport(const i2cTransportMLX90640 *newTransport)
 {
+  transport = newTransport;
+}
 
+const i2cTransportMLX90640 *MLX90640_GetTransport(void)
+{
+  return transport;
+}
+
+void MLX90640_I2CInit()
+{
+#if defined(ARDUINO_ARCH_ESP32)
+  if (Wire.setBufferSize(I2C_BUFFER_LENGTH_MLX90640) == I2C_BUFFER_LENGTH_MLX90640)
+  {
+    i2cStats.readLength = I2C_BUFFER_LENGTH_MLX90640;
+  }
+#else
+  i2cStats.readLength = I2C_BUFFER_LENGTH_MLX90640;
+#endif
 }
 
 //Read a number of words from startAddress. Store into Data array.
 //Returns 0 if successful, -1 if error
-int MLX90640_I2CRead(uint8_t _deviceAddress, unsigned int startAddress, unsigned int nWordsRead, uint16_t *data)
+int MLX90640_I2CRead(uint8_t slaveAddr, unsigned int startAddress, unsigned int nWordsRead, uint16_t *data)
 {
+  if (transport == NULL)
+  {
+    return (-1);
+  }
+  return transport->read(transport->context, slaveAddr, startAddress, nWordsRead, data);
+}
 
-  //Caller passes number of 'unsigned ints to read', increase this to 'bytes to read'
-  uint16_t bytesRemaining = nWordsRead * 2;
+//Write two bytes to a two byte address
+int MLX90640_I2CWrite(uint8_t slaveAddr, unsigned int writeAddress, uint16_t data)
+{
+  if (transport == NULL || transport->write(transport->context, slaveAddr, writeAddress, data) != 0)
+  {
+    return (-1);
+  }
+
+  uint16_t dataCheck;
+  if (MLX90640_I2CRead(slaveAddr, writeAddress, 1, &dataCheck) != 0)
+  {
+    return (-1);
+  }
+  if (dataCheck != data)
+  {
+    //Serial.println("The write request didn't stick");
+    return -2;
+  }
+
+  return (0); //Success
+}
+
+//Set I2C Freq, in kHz
+//MLX90640_I2CFreqSet(1000) sets frequency to 1MHz
+void MLX90640_I2CFreqSet(int freq)
+{
+#ifdef ARDUINO
+  //i2c.frequency(1000 * freq);
+  Wire.setClock((long)1000 * freq);
+#else
+  (void)freq;
+#endif
+}
+
+//Sleep for given number of milliseconds, lets other tasks run meanwhile
+void MLX90640_Delay(unsigned int ms)
+{
+  if (transport != NULL)
+  {
+    transport->sleep(transport->context, ms * 1000);
+  }
+}
+
+//Monotonic time in microseconds, used for scheduling frame reads
+uint32_t MLX90640_Micros(void)
+{
+  if (transport == NULL)
+  {
+    return 0;
+  }
+  return transport->micros(transport->context);
+}
 
-  //It doesn't look like sequential read works. Do we need to re-issue the address command each time?
+void MLX90640_I2CGetStats(i2cStatsMLX90640 *stats)
+{
+  *stats = i2cStats;
+}
+
+//------------------------------------------------------------------------------
 
-  uint16_t dataSpot = 0; //Start at beginning of array
+#ifdef ARDUINO
+static int WireRead(void *context, uint8_t _deviceAddress, unsigned int startAddress, unsigned int nWordsRead, uint16_t *data)
+{
+  (void)context;
+  //Caller passes number of 'unsigned ints to read', increase this to 'bytes to read'
+  size_t bytesRemaining = nWordsRead * 2;
+  uint16_t *dataSpot = data;
 
-  //Setup a series of chunked I2C_BUFFER_LENGTH byte reads
+  //Device auto-increments address, so chunks are only needed when read doesn't fit into Wire buffer
   while (bytesRemaining > 0)
   {
+    size_t numberOfBytesToRead = bytesRemaining;
+    if (numberOfBytesToRead > i2cStats.readLength) numberOfBytesToRead = i2cStats.readLength & ~1;
+
+    i2cStats.transactions++;
     Wire.beginTransmission(_deviceAddress);
     Wire.write(startAddress >> 8); //MSB
     Wire.write(startAddress & 0xFF); //LSB
     if (Wire.endTransmission(false) != 0) //Do not release bus
     {
-      Serial.println("No ack read");
-      return (0); //Sensor did not ACK
+      i2cStats.errors++;
+      return (-1); //Sensor did not ACK
     }
 
-    uint16_t numberOfBytesToRead = bytesRemaining;
-    if (numberOfBytesToRead > I2C_BUFFER_LENGTH) numberOfBytesToRead = I2C_BUFFER_LENGTH;
+    if (Wire.requestFrom(_deviceAddress, numberOfBytesToRead, true) != numberOfBytesToRead
+        || Wire.readBytes((uint8_t *)dataSpot, numberOfBytesToRead) != numberOfBytesToRead)
+    {
+      i2cStats.errors++;
+      return (-1); //Short read
+    }
+    i2cStats.bytesRead += numberOfBytesToRead;
 
-    Wire.requestFrom((uint8_t)_deviceAddress, (uint8_t)numberOfBytesToRead);
-    if (Wire.available())
+    //Device sends MSB first, convert words in place
+    uint8_t *bytes = (uint8_t *)dataSpot;
+    for (size_t x = 0 ; x < numberOfBytesToRead / 2; x++)
     {
-      for (uint16_t x = 0 ; x < numberOfBytesToRead / 2; x++)
-      {
-        //Store data into array
-        data[dataSpot] = Wire.read() << 8; //MSB
-        data[dataSpot] |= Wire.read(); //LSB
-
-        dataSpot++;
-      }
+      dataSpot[x] = (bytes[x * 2] << 8) | bytes[x * 2 + 1];
     }
 
+    dataSpot += numberOfBytesToRead / 2;
     bytesRemaining -= numberOfBytesToRead;
-
     startAddress += numberOfBytesToRead / 2;
   }
 
   return (0); //Success
 }
 
-//Set I2C Freq, in kHz
-//MLX90640_I2CFreqSet(1000) sets frequency to 1MHz
-void MLX90640_I2CFreqSet(int freq)
-{
-  //i2c.frequency(1000 * freq);
-  Wire.setClock((long)1000 * freq);
-}
-
-//Write two bytes to a two byte address
-int MLX90640_I2CWrite(uint8_t _deviceAddress, unsigned int writeAddress, uint16_t data)
+static int WireWrite(void *context, uint8_t _deviceAddress, unsigned int writeAddress, uint16_t data)
 {
+  (void)context;
   Wire.beginTransmission((uint8_t)_deviceAddress);
   Wire.write(writeAddress >> 8); //MSB
   Wire.write(writeAddress & 0xFF); //LSB
@@ -93,13 +187,26 @@ int MLX90640_I2CWrite(uint8_t _deviceAddress, unsigned int writeAddress, uint16_
     return (-1);
   }
 
-  uint16_t dataCheck;
-  MLX90640_I2CRead(_deviceAddress, writeAddress, 1, &dataCheck);
-  if (dataCheck != data)
+  return (0); //Success
+}
+
+//Whole milliseconds are slept with delay(), so other tasks can run meanwhile
+static void WireSleep(void *context, uint32_t us)
+{
+  (void)context;
+  if (us >= 1000)
   {
-    //Serial.println("The write request didn't stick");
-    return -2;
+    delay(us / 1000);
+  }
+  if (us % 1000 != 0)
+  {
+    delayMicroseconds(us % 1000);
   }
+}
 
-  return (0); //Success
-}
\ No newline at end of file
+static uint32_t WireMicros(void *context)
+{
+  (void)context;
+  return micros();
+}
+#endif
@@ -18,6 +18,7 @@
 #define _MLX90640_I2C_Driver_H_
 
 #include <stdint.h>
+#include <stddef.h>
 
 //Define the size of the I2C buffer based on the platform the user has
 //-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
@@ -36,6 +37,9 @@
 
 #elif ARDUINO_ARCH_ESP32
 //ESP32 based platforms
+//Wire buffer is enlarged by MLX90640_I2CInit() so whole frame or EEPROM (832 words) is read
+//in a single transaction. If that fails, reads fall back to default Wire buffer length
+#define I2C_BUFFER_LENGTH_MLX90640 1664
 
 #else
 
@@ -43,11 +47,44 @@
 #define I2C_BUFFER_LENGTH 32
 
 #endif
-//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
+#ifndef I2C_BUFFER_LENGTH_MLX90640
+#define I2C_BUFFER_LENGTH_MLX90640 I2C_BUFFER_LENGTH
+#endif
+//-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=-=
 
+  typedef struct
+    {
+        uint32_t transactions;      //address write + read pairs
+        uint32_t bytesRead;
+        uint32_t errors;            //missing ACK or short reads
+        uint16_t readLength;        //longest single read, bytes
+    } i2cStatsMLX90640;
+
+  //Bus backend used by MLX90640_I2CRead/Write. Time functions belong to it as well,
+  //so simulated sensor can run on virtual clock and acquisition timing stays consistent
+  typedef struct
+    {
+        int (*read)(void *context, uint8_t slaveAddr, unsigned int startAddress, unsigned int nWordsRead, uint16_t *data);
+        int (*write)(void *context, uint8_t slaveAddr, unsigned int writeAddress, uint16_t data);
+        void (*sleep)(void *context, uint32_t us);
+        uint32_t (*micros)(void *context);
+        void *context;
+    } i2cTransportMLX90640;
+
+//Call before Wire.begin(), Wire buffer can't be resized once bus is running
 void MLX90640_I2CInit(void);
 int MLX90640_I2CRead(uint8_t slaveAddr, unsigned int startAddress, unsigned int nWordsRead, uint16_t *data);
 int MLX90640_I2CWrite(uint8_t slaveAddr, unsigned int writeAddress, uint16_t data);
 void MLX90640_I2CFreqSet(int freq);
+void MLX90640_Delay(unsigned int ms);
+uint32_t MLX90640_Micros(void);
+void MLX90640_I2CGetStats(i2cStatsMLX90640 *stats);
+
+//Replaces bus backend, Wire transport is the default on Arduino. Transport must outlive its use
+void MLX90640_SetTransport(const i2cTransportMLX90640 *transport);
+const i2cTransportMLX90640 *MLX90640_GetTransport(void);
+#ifdef ARDUINO
+extern const i2cTransportMLX90640 MLX90640_WireTransport;
+#endif
 #endif
\ No newline at end of file
@@ -0,0 +1,340 @@
+#include "MLX90640_Prepared.h"
+#include <math.h>
+#include <string.h>
+
+void RefreshPreparedCalibration(const paramsMLX90640 *params, preparedMLX90640 *prepared, float ta, float vdd);
+
+  typedef struct
+    {
+        float gain;
+        float emissivityInv;
+        float cpCompensation;
+        float ilChessScale;
+        float taTr;
+        float ksTo1;
+        float ksTo1Factor;
+        float ksTo[4];
+        float ct[4];
+        float alphaCorrR[4];
+    } kernelConstants;
+
+void MLX90640_PrepareCalibration(const paramsMLX90640 *params, preparedMLX90640 *prepared)
+{
+    int ilPattern;
+    int chessPattern;
+    int conversionPattern;
+    int row;
+    int column;
+
+    for(row = 0; row < MLX90640_ROWS; row++)
+    {
+        prepared->patternMask[0][row] = 0;
+        prepared->patternMask[1][row] = 0;
+    }
+
+    for(int pixelNumber = 0; pixelNumber < MLX90640_PIXEL_COUNT; pixelNumber++)
+    {
+        row = pixelNumber / 32;
+        column = pixelNumber % 32;
+        ilPattern = pixelNumber / 32 - (pixelNumber / 64) * 2;
+        chessPattern = ilPattern ^ (pixelNumber - (pixelNumber/2)*2);
+        conversionPattern = ((pixelNumber + 2) / 4 - (pixelNumber + 3) / 4 + (pixelNumber + 1) / 4 - pixelNumber / 4) * (1 - 2 * ilPattern);
+
+        prepared->patternMask[0][row] |= (uint32_t)ilPattern << column;
+        prepared->patternMask[1][row] |= (uint32_t)chessPattern << column;
+        prepared->ilChessCorrection[pixelNumber] = params->ilChessC[2] * (2 * ilPattern - 1) - params->ilChessC[1] * conversionPattern;
+        prepared->alphaCP[0][pixelNumber] = params->alpha[pixelNumber] - params->tgc * params->cpAlpha[0];
+        prepared->alphaCP[1][pixelNumber] = params->alpha[pixelNumber] - params->tgc * params->cpAlpha[1];
+    }
+
+    prepared->alphaCorrR[0] = 1.0f / (1.0f + params->ksTo[0] * 40.0f);
+    prepared->alphaCorrR[1] = 1.0f;
+    prepared->alphaCorrR[2] = (1.0f + params->ksTo[2] * params->ct[2]);
+    prepared->alphaCorrR[3] = prepared->alphaCorrR[2] * (1.0f + params->ksTo[3] * (params->ct[3] - params->ct[2]));
+    prepared->ksTo1Factor = 1.0f - params->ksTo[1] * 273.15f;
+
+    prepared->valid = 0;
+}
+
+//------------------------------------------------------------------------------
+
+void RefreshPreparedCalibration(const paramsMLX90640 *params, preparedMLX90640 *prepared, float ta, float vdd)
+{
+    float dTa = ta - 25.0f;
+    float dVdd = vdd - 3.3f;
+    float alphaTaFactor = 1.0f + params->KsTa * dTa;
+
+    for(int pixelNumber = 0; pixelNumber < MLX90640_PIXEL_COUNT; pixelNumber++)
+    {
+        prepared->offsetCompensated[pixelNumber] = params->offset[pixelNumber] * (1.0f + params->kta[pixelNumber] * dTa) * (1.0f + params->kv[pixelNumber] * dVdd);
+        prepared->alphaCompensated[0][pixelNumber] = prepared->alphaCP[0][pixelNumber] * alphaTaFactor;
+        prepared->alphaCompensated[1][pixelNumber] = prepared->alphaCP[1][pixelNumber] * alphaTaFactor;
+    }
+
+    prepared->cpOffsetCompensated[0] = params->cpOffset[0] * (1.0f + params->cpKta * dTa) * (1.0f + params->cpKv * dVdd);
+    prepared->cpOffsetCompensated[1] = params->cpOffset[1] * (1.0f + params->cpKta * dTa) * (1.0f + params->cpKv * dVdd);
+    prepared->ta = ta;
+    prepared->vdd = vdd;
+    prepared->valid = 1;
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_CalculateToPrepared(uint16_t *frameData, const paramsMLX90640 *params, preparedMLX90640 *prepared, float emissivity, float tr, float *result)
+{
+    float vdd;
+    float ta;
+    float ta4;
+    float tr4;
+    float taTr;
+    float gain;
+    float irDataCP[2];
+    float irData;
+    float alphaCompensated;
+    float cpCompensation;
+    float emissivityInv;
+    float Sx;
+    float To;
+    int8_t range;
+    uint8_t mode;
+    uint8_t ilChessCorrection;
+    uint16_t subPage;
+    uint32_t rowMask;
+    uint32_t subPageBits;
+    const uint32_t *patternMask;
+
+    subPage = frameData[833];
+    vdd = MLX90640_GetVdd(frameData, params);
+    ta = MLX90640_GetTa(frameData, params);
+
+    if(!prepared->valid || fabsf(ta - prepared->ta) > MLX90640_PREPARED_TA_THRESHOLD || fabsf(vdd - prepared->vdd) > MLX90640_PREPARED_VDD_THRESHOLD)
+    {
+        RefreshPreparedCalibration(params, prepared, ta, vdd);
+    }
+
+    ta4 = ta + 273.15f;
+    ta4 = ta4 * ta4;
+    ta4 = ta4 * ta4;
+    tr4 = tr + 273.15f;
+    tr4 = tr4 * tr4;
+    tr4 = tr4 * tr4;
+    taTr = tr4 - (tr4-ta4)/emissivity;
+    emissivityInv = 1.0f / emissivity;
+
+//------------------------- Gain calculation -----------------------------------
+    gain = (int16_t)frameData[778];
+    gain = params->gainEE / gain;
+
+//------------------------- To calculation -------------------------------------
+    mode = (frameData[832] & 0x1000) >> 5;
+    ilChessCorrection = mode != params->calibrationModeEE;
+    patternMask = prepared->patternMask[mode == 0 ? 0 : 1];
+
+    irDataCP[0] = (int16_t)frameData[776] * gain - prepared->cpOffsetCompensated[0];
+    irDataCP[1] = (int16_t)frameData[808] * gain - prepared->cpOffsetCompensated[1];
+    if(ilChessCorrection)
+    {
+        irDataCP[1] = irDataCP[1] - params->ilChessC[0] * (1 + params->cpKta * (ta - 25)) * (1 + params->cpKv * (vdd - 3.3f));
+    }
+    cpCompensation = params->tgc * irDataCP[subPage];
+
+    //Pixels of current subpage have their bit in row mask equal to subpage number
+    subPageBits = subPage ? 0xFFFFFFFF : 0;
+
+    for(int row = 0; row < MLX90640_ROWS; row++)
+    {
+        rowMask = ~(patternMask[row] ^ subPageBits);
+
+        for(int column = 0; column < 32; column++)
+        {
+            if(((rowMask >> column) & 1) == 0)
+            {
+                continue;
+            }
+            int pixelNumber = row * 32 + column;
+
+            irData = (int16_t)frameData[pixelNumber] * gain - prepared->offsetCompensated[pixelNumber];
+            if(ilChessCorrection)
+            {
+                irData = irData + prepared->ilChessCorrection[pixelNumber];
+            }
+            irData = irData * emissivityInv - cpCompensation;
+
+            alphaCompensated = prepared->alphaCompensated[subPage][pixelNumber];
+
+            Sx = alphaCompensated * alphaCompensated * alphaCompensated * (irData + alphaCompensated * taTr);
+            Sx = sqrtf(sqrtf(Sx)) * params->ksTo[1];
+
+            To = sqrtf(sqrtf(irData/(alphaCompensated * prepared->ksTo1Factor + Sx) + taTr)) - 273.15f;
+
+            if(To < params->ct[1])
+            {
+                range = 0;
+            }
+            else if(To < params->ct[2])
+            {
+                range = 1;
+            }
+            else if(To < params->ct[3])
+            {
+                range = 2;
+            }
+            else
+            {
+                range = 3;
+            }
+
+            To = sqrtf(sqrtf(irData / (alphaCompensated * prepared->alphaCorrR[range] * (1 + params->ksTo[range] * (To - params->ct[range]))) + taTr)) - 273.15f;
+
+            result[pixelNumber] = To;
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+
+//Fourth root, single precision only. Initial estimate of x^(-1/4) from exponent bits,
+//refined with Newton iterations r = r * (1.25 - 0.25 * x * r^4), then x^(1/4) = x * r^3.
+//Negative x gives NaN like sqrtf(sqrtf(x)), set with bit mask so the loop stays branch-free
+static inline float FastRoot4(float x)
+{
+    uint32_t bits;
+    uint32_t negative;
+    float r;
+    float r2;
+
+    memcpy(&bits, &x, sizeof(bits));
+    negative = 0 - (bits >> 31);
+    bits = 0x4F580000 - (bits >> 2);
+    memcpy(&r, &bits, sizeof(r));
+
+    r2 = r * r;
+    r = r * (1.25f - 0.25f * x * r2 * r2);
+    r2 = r * r;
+    r = r * (1.25f - 0.25f * x * r2 * r2);
+    r2 = r * r;
+    r = r * (1.25f - 0.25f * x * r2 * r2);
+
+    r = x * r * r * r;
+    memcpy(&bits, &r, sizeof(bits));
+    bits = bits | (negative & 0x7FC00000);
+    memcpy(&r, &bits, sizeof(r));
+    return r;
+}
+
+//------------------------------------------------------------------------------
+
+//Computes To for count pixels starting at first, STRIDE apart. Loop body has no branches
+//or table lookups, so it can be vectorized
+template <int STRIDE>
+static void CalculateToRun(const uint16_t *__restrict frameData, const float *__restrict offset, const float *__restrict ilChess, const float *__restrict alpha, float *__restrict result, int count, const kernelConstants *k)
+{
+    const float gain = k->gain;
+    const float emissivityInv = k->emissivityInv;
+    const float cpCompensation = k->cpCompensation;
+    const float ilChessScale = k->ilChessScale;
+    const float taTr = k->taTr;
+    const float ksTo1 = k->ksTo1;
+    const float ksTo1Factor = k->ksTo1Factor;
+
+    for(int i = 0; i < count; i++)
+    {
+        int p = i * STRIDE;
+        float irData = (float)(int16_t)frameData[p] * gain - offset[p] + ilChessScale * ilChess[p];
+        irData = irData * emissivityInv - cpCompensation;
+
+        float alphaCompensated = alpha[p];
+        float Sx = alphaCompensated * alphaCompensated * alphaCompensated * (irData + alphaCompensated * taTr);
+        Sx = FastRoot4(Sx) * ksTo1;
+
+        float To = FastRoot4(irData / (alphaCompensated * ksTo1Factor + Sx) + taTr) - 273.15f;
+
+        float alphaCorrR = k->alphaCorrR[0];
+        float ksTo = k->ksTo[0];
+        float ct = k->ct[0];
+        alphaCorrR = To >= k->ct[1] ? k->alphaCorrR[1] : alphaCorrR;
+        ksTo = To >= k->ct[1] ? k->ksTo[1] : ksTo;
+        ct = To >= k->ct[1] ? k->ct[1] : ct;
+        alphaCorrR = To >= k->ct[2] ? k->alphaCorrR[2] : alphaCorrR;
+        ksTo = To >= k->ct[2] ? k->ksTo[2] : ksTo;
+        ct = To >= k->ct[2] ? k->ct[2] : ct;
+        alphaCorrR = To >= k->ct[3] ? k->alphaCorrR[3] : alphaCorrR;
+        ksTo = To >= k->ct[3] ? k->ksTo[3] : ksTo;
+        ct = To >= k->ct[3] ? k->ct[3] : ct;
+
+        result[p] = FastRoot4(irData / (alphaCompensated * alphaCorrR * (1.0f + ksTo * (To - ct))) + taTr) - 273.15f;
+    }
+}
+
+//------------------------------------------------------------------------------
+
+void MLX90640_CalculateToFast(uint16_t *frameData, const paramsMLX90640 *params, preparedMLX90640 *prepared, float emissivity, float tr, float *result)
+{
+    kernelConstants k;
+    float vdd;
+    float ta;
+    float ta4;
+    float tr4;
+    float irDataCP[2];
+    uint8_t mode;
+    uint16_t subPage;
+
+    subPage = frameData[833];
+    vdd = MLX90640_GetVdd(frameData, params);
+    ta = MLX90640_GetTa(frameData, params);
+
+    if(!prepared->valid || fabsf(ta - prepared->ta) > MLX90640_PREPARED_TA_THRESHOLD || fabsf(vdd - prepared->vdd) > MLX90640_PREPARED_VDD_THRESHOLD)
+    {
+        RefreshPreparedCalibration(params, prepared, ta, vdd);
+    }
+
+    ta4 = ta + 273.15f;
+    ta4 = ta4 * ta4;
+    ta4 = ta4 * ta4;
+    tr4 = tr + 273.15f;
+    tr4 = tr4 * tr4;
+    tr4 = tr4 * tr4;
+
+    mode = (frameData[832] & 0x1000) >> 5;
+
+    k.gain = params->gainEE / (float)(int16_t)frameData[778];
+    k.emissivityInv = 1.0f / emissivity;
+    k.ilChessScale = mode != params->calibrationModeEE ? 1.0f : 0.0f;
+    k.taTr = tr4 - (tr4-ta4)/emissivity;
+    k.ksTo1 = params->ksTo[1];
+    k.ksTo1Factor = prepared->ksTo1Factor;
+    for(int i = 0; i < 4; i++)
+    {
+        k.ksTo[i] = params->ksTo[i];
+        k.ct[i] = params->ct[i];
+        k.alphaCorrR[i] = prepared->alphaCorrR[i];
+    }
+
+    irDataCP[0] = (int16_t)frameData[776] * k.gain - prepared->cpOffsetCompensated[0];
+    irDataCP[1] = (int16_t)frameData[808] * k.gain - prepared->cpOffsetCompensated[1];
+    if(k.ilChessScale != 0.0f)
+    {
+        irDataCP[1] = irDataCP[1] - params->ilChessC[0] * (1.0f + params->cpKta * (ta - 25.0f)) * (1.0f + params->cpKv * (vdd - 3.3f));
+    }
+    k.cpCompensation = params->tgc * irDataCP[subPage];
+
+    const float *alpha = prepared->alphaCompensated[subPage];
+    for(int row = 0; row < MLX90640_ROWS; row++)
+    {
+        int first = row * 32;
+        if(mode == 0)
+        {
+            //Interleaved: subpage is made of whole rows
+            if((row & 1) == subPage)
+            {
+                CalculateToRun<1>(frameData + first, prepared->offsetCompensated + first, prepared->ilChessCorrection + first, alpha + first, result + first, 32, &k);
+            }
+        }
+        else
+        {
+            //Chess: every second pixel, starting column alternates with row
+            first = first + ((row & 1) ^ subPage);
+            CalculateToRun<2>(frameData + first, prepared->offsetCompensated + first, prepared->ilChessCorrection + first, alpha + first, result + first, 16, &k);
+        }
+    }
+}
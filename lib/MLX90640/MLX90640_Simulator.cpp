@@ -0,0 +1,354 @@
+#include "MLX90640_Simulator.h"
+#include "MLX90640_API.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define RAM_ADDRESS 0x0400
+#define EEPROM_ADDRESS 0x2400
+#define STATUS_ADDRESS 0x8000
+#define CONTROL_ADDRESS 0x800D
+#define DEFAULT_I2C_CLOCK 400000
+#define SYNTHETIC_CONTROL 0x1901            //2Hz, 18 bit, chess mode
+#define SYNTHETIC_TA 30.0f
+#define SYNTHETIC_VBE 19442
+
+static int SimulatorRead(void *context, uint8_t slaveAddr, unsigned int startAddress, unsigned int nWordsRead, uint16_t *data);
+static int SimulatorWrite(void *context, uint8_t slaveAddr, unsigned int writeAddress, uint16_t data);
+static void SimulatorSleep(void *context, uint32_t us);
+static uint32_t SimulatorMicros(void *context);
+
+//Subpage period for refresh rate in control register, 0.5Hz doubled with every step
+static uint32_t SubPagePeriod(const simulatorMLX90640 *simulator)
+{
+    return 2000000 >> ((simulator->controlRegister1 >> 7) & 0x07);
+}
+
+//Latches every subpage which became ready until current time
+static void Advance(simulatorMLX90640 *simulator)
+{
+    const uint16_t *frame;
+
+    while((int32_t)(simulator->clock - simulator->nextSubPage) >= 0)
+    {
+        if(simulator->frameCount > 0)
+        {
+            frame = simulator->frames + simulator->nextFrame * MLX90640_FRAME_WORDS;
+            memcpy(simulator->ram, frame, sizeof(simulator->ram));
+            simulator->statusRegister = (simulator->statusRegister & ~0x0007) | 0x0008 | (frame[833] & 0x0001);
+            simulator->nextFrame = (simulator->nextFrame + 1) % simulator->frameCount;
+        }
+        simulator->nextSubPage += SubPagePeriod(simulator);
+    }
+}
+
+//Time of transfer with address and given number of data bytes, 9 clocks per byte
+static void Transfer(simulatorMLX90640 *simulator, unsigned int bytes)
+{
+    simulator->clock += (uint32_t)((uint64_t)(bytes + 3) * 9 * 1000000 / simulator->i2cClock);
+}
+
+void MLX90640_SimulatorInit(simulatorMLX90640 *simulator, const uint16_t *eeData, const uint16_t *frames, size_t frameCount)
+{
+    memset(simulator, 0, sizeof(simulatorMLX90640));
+    simulator->eeData = eeData;
+    simulator->frames = frames;
+    simulator->frameCount = frameCount;
+    simulator->i2cClock = DEFAULT_I2C_CLOCK;
+    simulator->controlRegister1 = eeData[12];   //control register is loaded from EEPROM at power-up
+    simulator->nextSubPage = SubPagePeriod(simulator);
+}
+
+//Reads whole file into newly allocated buffer, returns number of words or 0 on error
+static size_t LoadWords(const char *path, uint16_t **words)
+{
+    FILE *file = fopen(path, "rb");
+    long size;
+    size_t count = 0;
+    uint8_t *bytes;
+
+    *words = NULL;
+    if(file == NULL)
+    {
+        return 0;
+    }
+    if(fseek(file, 0, SEEK_END) == 0 && (size = ftell(file)) > 0 && fseek(file, 0, SEEK_SET) == 0)
+    {
+        *words = (uint16_t *)malloc(size);
+        if(*words != NULL && fread(*words, 1, size, file) == (size_t)size)
+        {
+            count = size / 2;
+            bytes = (uint8_t *)*words;
+            for(size_t i = 0; i < count; i++)
+            {
+                (*words)[i] = bytes[i * 2] | (bytes[i * 2 + 1] << 8);
+            }
+        }
+    }
+    fclose(file);
+    if(count == 0)
+    {
+        free(*words);
+        *words = NULL;
+    }
+    return count;
+}
+
+int MLX90640_SimulatorLoad(simulatorMLX90640 *simulator, const char *eePath, const char *framesPath)
+{
+    uint16_t *eeData;
+    uint16_t *frames;
+    size_t frameWords;
+
+    if(LoadWords(eePath, &eeData) < MLX90640_EEPROM_WORDS)
+    {
+        free(eeData);
+        return -1;
+    }
+    frameWords = LoadWords(framesPath, &frames);
+    if(frameWords < MLX90640_FRAME_WORDS)
+    {
+        free(eeData);
+        free(frames);
+        return -2;
+    }
+
+    //Both dumps are kept in one allocation, so there is a single pointer to free
+    eeData = (uint16_t *)realloc(eeData, (MLX90640_EEPROM_WORDS + frameWords) * sizeof(uint16_t));
+    if(eeData == NULL)
+    {
+        free(frames);
+        return -3;
+    }
+    memcpy(eeData + MLX90640_EEPROM_WORDS, frames, frameWords * sizeof(uint16_t));
+    free(frames);
+
+    MLX90640_SimulatorInit(simulator, eeData, eeData + MLX90640_EEPROM_WORDS, frameWords / MLX90640_FRAME_WORDS);
+    simulator->ownedData = eeData;
+    return 0;
+}
+
+//Deterministic noise, same sequence on every run
+static int SyntheticNoise(uint32_t *seed)
+{
+    *seed = *seed * 1103515245 + 12345;
+    return (int)((*seed >> 16) % 3) - 1;
+}
+
+//Typical calibration, encoded as described in datasheet chapter 11.1
+static void SyntheticEEPROM(uint16_t *eeData)
+{
+    uint32_t seed = 1;
+    int offset;
+    int alpha;
+
+    memset(eeData, 0, MLX90640_EEPROM_WORDS * sizeof(uint16_t));
+    eeData[7] = 0x5A3C;                     //device ID
+    eeData[8] = 0x0F12;
+    eeData[9] = 0x2B61;
+    eeData[12] = SYNTHETIC_CONTROL;
+    eeData[16] = 0x4000;                    //alphaPTAT 9, offset scales 0
+    eeData[17] = (uint16_t)-60;             //offset reference
+    eeData[32] = 0x6000;                    //alpha scale 2^36
+    eeData[33] = 0x2000;                    //alpha reference, 1.19e-7
+    eeData[48] = 6383;                      //gain
+    eeData[49] = 12273;                     //vPTAT25
+    eeData[50] = (11 << 10) | 336;          //KvPTAT 0.0027, KtPTAT 42
+    eeData[51] = 0x9D66;                    //kVdd -3168, vdd25 -13120
+    eeData[52] = 0x6666;                    //Kv 0.375
+    eeData[53] = 0x0000;                    //no interleaved/chess correction
+    eeData[54] = 0x5050;                    //Kta 0.0049
+    eeData[55] = 0x5050;
+    eeData[56] = (2 << 12) | (4 << 8) | (6 << 4);  //18 bit, Kv scale 2^4, Kta scale 2^14
+    eeData[57] = 36;                        //CP alpha 4.2e-9
+    eeData[58] = (uint16_t)-70 & 0x03FF;    //CP offset
+    eeData[59] = 0x0642;                    //CP Kv, CP Kta
+    eeData[60] = 0xF000;                    //KsTa -0.002, TGC 0
+    eeData[61] = 0x9797;                    //KsTo -0.0008
+    eeData[62] = 0x9797;
+    eeData[63] = 0x2889;                    //corner temperatures 160 and 320 C, KsTo scale 2^17
+    for(int p = 0; p < 768; p++)
+    {
+        //Small spread of offset and alpha, Kta bit keeps word non-zero (zero marks broken pixel)
+        offset = SyntheticNoise(&seed) * 3 + SyntheticNoise(&seed);
+        alpha = SyntheticNoise(&seed) * 6 + SyntheticNoise(&seed) * 2;
+        eeData[64 + p] = (uint16_t)(((offset & 0x3F) << 10) | ((alpha & 0x3F) << 4) | 0x0002);
+    }
+}
+
+//Scene temperature, warm blob moves one column per frame and back
+static float SyntheticScene(int pixelNumber, size_t frame)
+{
+    int row = pixelNumber / 32;
+    int column = pixelNumber % 32;
+    int position = (int)(frame % 56);
+    float x = (float)(position < 28 ? position + 2 : 57 - position);
+    float dx = column - x;
+    float dy = row - 12.0f;
+
+    if(dx * dx + dy * dy < 16.0f)
+    {
+        return 34.0f;
+    }
+    return 20.0f + row * 4.0f / 23;
+}
+
+//Raw pixel value giving To through MLX90640_CalculateTo() at emissivity 1, gain 1 and Vdd 3.3 V
+static int16_t SyntheticPixel(const paramsMLX90640 *params, int pixelNumber, float to)
+{
+    float ta4 = powf(SYNTHETIC_TA + 273.15f, 4);
+    float alphaCorrR[4];
+    float alpha = params->alpha[pixelNumber] * (1 + params->KsTa * (SYNTHETIC_TA - 25));
+    float irData;
+    int range;
+
+    alphaCorrR[0] = 1 / (1 + params->ksTo[0] * 40);
+    alphaCorrR[1] = 1;
+    alphaCorrR[2] = (1 + params->ksTo[2] * params->ct[2]);
+    alphaCorrR[3] = alphaCorrR[2] * (1 + params->ksTo[3] * (params->ct[3] - params->ct[2]));
+    for(range = 3; range > 0 && to < params->ct[range]; range--)
+    {
+    }
+    irData = (powf(to + 273.15f, 4) - ta4) * alpha * alphaCorrR[range] * (1 + params->ksTo[range] * (to - params->ct[range]));
+    return (int16_t)lroundf(irData + params->offset[pixelNumber] * (1 + params->kta[pixelNumber] * (SYNTHETIC_TA - 25)));
+}
+
+int MLX90640_SimulatorSynthetic(simulatorMLX90640 *simulator, size_t frameCount)
+{
+    paramsMLX90640 *params = (paramsMLX90640 *)malloc(sizeof(paramsMLX90640));
+    uint16_t *eeData = (uint16_t *)malloc((MLX90640_EEPROM_WORDS + frameCount * MLX90640_FRAME_WORDS) * sizeof(uint16_t));
+    uint16_t *frame;
+    uint32_t seed = 7;
+    float vPTAT;
+
+    if(params == NULL || eeData == NULL || frameCount == 0)
+    {
+        free(params);
+        free(eeData);
+        return -3;
+    }
+    SyntheticEEPROM(eeData);
+    if(MLX90640_ExtractParameters(eeData, params) != 0)
+    {
+        free(params);
+        free(eeData);
+        return -4;
+    }
+
+    vPTAT = params->vPTAT25 + params->KtPTAT * (SYNTHETIC_TA - 25);
+    for(size_t n = 0; n < frameCount; n++)
+    {
+        frame = eeData + MLX90640_EEPROM_WORDS + n * MLX90640_FRAME_WORDS;
+        memset(frame, 0, MLX90640_FRAME_WORDS * sizeof(uint16_t));
+        for(int p = 0; p < 768; p++)
+        {
+            frame[p] = (uint16_t)(SyntheticPixel(params, p, SyntheticScene(p, n / 2)) + SyntheticNoise(&seed));
+        }
+        frame[768] = SYNTHETIC_VBE;
+        frame[776] = (uint16_t)params->cpOffset[0];
+        frame[778] = (uint16_t)params->gainEE;
+        frame[800] = (uint16_t)lroundf(vPTAT * SYNTHETIC_VBE / (262144 - params->alphaPTAT * vPTAT));
+        frame[808] = (uint16_t)params->cpOffset[1];
+        frame[810] = (uint16_t)params->vdd25;
+        frame[832] = SYNTHETIC_CONTROL;
+        frame[833] = n & 1;
+    }
+    free(params);
+
+    MLX90640_SimulatorInit(simulator, eeData, eeData + MLX90640_EEPROM_WORDS, frameCount);
+    simulator->ownedData = eeData;
+    return 0;
+}
+
+void MLX90640_SimulatorFree(simulatorMLX90640 *simulator)
+{
+    free(simulator->ownedData);
+    simulator->ownedData = NULL;
+    simulator->eeData = NULL;
+    simulator->frames = NULL;
+    simulator->frameCount = 0;
+}
+
+void MLX90640_SimulatorTransport(simulatorMLX90640 *simulator, i2cTransportMLX90640 *transport)
+{
+    transport->read = SimulatorRead;
+    transport->write = SimulatorWrite;
+    transport->sleep = SimulatorSleep;
+    transport->micros = SimulatorMicros;
+    transport->context = simulator;
+}
+
+//------------------------------------------------------------------------------
+
+static int SimulatorRead(void *context, uint8_t slaveAddr, unsigned int startAddress, unsigned int nWordsRead, uint16_t *data)
+{
+    simulatorMLX90640 *simulator = (simulatorMLX90640 *)context;
+    unsigned int address;
+
+    (void)slaveAddr;
+    Advance(simulator);
+    for(unsigned int i = 0; i < nWordsRead; i++)
+    {
+        address = startAddress + i;
+        if(address >= RAM_ADDRESS && address < RAM_ADDRESS + MLX90640_EEPROM_WORDS)
+        {
+            data[i] = simulator->ram[address - RAM_ADDRESS];
+        }
+        else if(address >= EEPROM_ADDRESS && address < EEPROM_ADDRESS + MLX90640_EEPROM_WORDS)
+        {
+            data[i] = simulator->eeData[address - EEPROM_ADDRESS];
+        }
+        else if(address == STATUS_ADDRESS)
+        {
+            data[i] = simulator->statusRegister;
+        }
+        else if(address == CONTROL_ADDRESS)
+        {
+            data[i] = simulator->controlRegister1;
+        }
+        else
+        {
+            data[i] = 0;
+        }
+    }
+    Transfer(simulator, nWordsRead * 2);
+
+    return 0;
+}
+
+static int SimulatorWrite(void *context, uint8_t slaveAddr, unsigned int writeAddress, uint16_t data)
+{
+    simulatorMLX90640 *simulator = (simulatorMLX90640 *)context;
+
+    (void)slaveAddr;
+    Advance(simulator);
+    if(writeAddress == STATUS_ADDRESS)
+    {
+        //Subpage number is read only, new data flag can only be cleared
+        simulator->statusRegister = (data & ~0x000F) | (simulator->statusRegister & 0x0007) | (data & simulator->statusRegister & 0x0008);
+    }
+    else if(writeAddress == CONTROL_ADDRESS)
+    {
+        simulator->controlRegister1 = data;
+        simulator->nextSubPage = simulator->clock + SubPagePeriod(simulator);
+    }
+    else
+    {
+        return -1;
+    }
+    Transfer(simulator, 2);
+
+    return 0;
+}
+
+static void SimulatorSleep(void *context, uint32_t us)
+{
+    simulatorMLX90640 *simulator = (simulatorMLX90640 *)context;
+    simulator->clock += us;
+}
+
+static uint32_t SimulatorMicros(void *context)
+{
+    return ((simulatorMLX90640 *)context)->clock;
+}
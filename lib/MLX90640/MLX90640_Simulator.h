@@ -0,0 +1,50 @@
+/**
+ * Simulated MLX90640 transport, serving EEPROM and frame data from recorded dumps.
+ *
+ * Sensor runs on virtual clock in microseconds. Every subpage period (derived from refresh
+ * rate in control register 0x800D) next recorded subpage is latched into RAM and status
+ * register 0x8000 gets new data flag and subpage number, same as on device. Writing status
+ * register clears the flag. Bus transfers advance the clock by their duration at i2cClock,
+ * sleep advances it right away, so host runs are fast and deterministic.
+ *
+ * Dump files are raw little-endian uint16 words: EEPROM is 832 words read from 0x2400,
+ * frames file is sequence of 834 word records as returned by MLX90640_GetFrameData()
+ * (words 0..831 from RAM, 832 control register, 833 subpage number).
+ *
+ * Without dumps MLX90640_SimulatorSynthetic() makes up a sensor: EEPROM encoded from typical
+ * calibration values and frames of a room at ~22 C with a 34 C blob crossing it, at Ta 30 C and
+ * Vdd 3.3 V, with +-1 count noise. Pixel words are inverse of MLX90640_CalculateTo() for
+ * emissivity 1, so they decode to the scene through the same path as a real sensor.
+ */
+#ifndef _MLX640_SIMULATOR_H_
+#define _MLX640_SIMULATOR_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "MLX90640_I2C_Driver.h"
+
+#define MLX90640_EEPROM_WORDS 832
+#define MLX90640_FRAME_WORDS 834
+
+  typedef struct
+    {
+        const uint16_t *eeData;             //MLX90640_EEPROM_WORDS
+        const uint16_t *frames;             //frameCount records of MLX90640_FRAME_WORDS
+        size_t frameCount;
+        size_t nextFrame;
+        uint32_t i2cClock;                  //Hz, used for transfer time
+        uint32_t clock;                     //virtual time, us
+        uint32_t nextSubPage;               //time next subpage is ready at
+        uint16_t ram[MLX90640_EEPROM_WORDS];
+        uint16_t statusRegister;
+        uint16_t controlRegister1;
+        uint16_t *ownedData;                //loaded from files or generated, freed by MLX90640_SimulatorFree
+    } simulatorMLX90640;
+
+    void MLX90640_SimulatorInit(simulatorMLX90640 *simulator, const uint16_t *eeData, const uint16_t *frames, size_t frameCount);
+    int MLX90640_SimulatorLoad(simulatorMLX90640 *simulator, const char *eePath, const char *framesPath);
+    int MLX90640_SimulatorSynthetic(simulatorMLX90640 *simulator, size_t frameCount);
+    void MLX90640_SimulatorFree(simulatorMLX90640 *simulator);
+    void MLX90640_SimulatorTransport(simulatorMLX90640 *simulator, i2cTransportMLX90640 *transport);
+
+#endif
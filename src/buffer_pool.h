@@ -0,0 +1,55 @@
+#ifndef _BUFFER_POOL_H_
+#define _BUFFER_POOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <memory>
+#include <vector>
+
+// Fixed pool of shared byte buffers, all allocated up front.
+//
+// Buffer is free again once the pool holds its only reference, i.e. every websocket message
+// sharing it was sent and dropped its copy. Acquiring is done by single task, references
+// are released from any task (shared_ptr count is atomic), so free buffer can't be taken
+// meanwhile. When all buffers are in use new one is allocated and counted as miss.
+template <size_t Count, size_t Size>
+class BufferPool {
+public:
+    typedef std::shared_ptr<std::vector<uint8_t>> Buffer;
+
+    BufferPool() : misses(0) {
+        for (Buffer &buffer : buffers) {
+            buffer = std::make_shared<std::vector<uint8_t>>(Size);
+        }
+    }
+
+    // Returns buffer of Size bytes, resizing within capacity doesn't allocate
+    Buffer acquire() {
+        for (Buffer &buffer : buffers) {
+            if (buffer.use_count() == 1) {
+                buffer->resize(Size);
+                return buffer;
+            }
+        }
+        misses++;
+        return std::make_shared<std::vector<uint8_t>>(Size);
+    }
+
+    // Buffers referenced outside of pool
+    size_t inUse() const {
+        size_t count = 0;
+        for (const Buffer &buffer : buffers) {
+            if (buffer.use_count() > 1) {
+                count++;
+            }
+        }
+        return count;
+    }
+
+    uint32_t misses; // buffers allocated because pool was exhausted
+
+private:
+    Buffer buffers[Count];
+};
+
+#endif
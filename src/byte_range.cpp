@@ -0,0 +1,84 @@
+#include "byte_range.h"
+#include <stdio.h>
+#include <string.h>
+
+// Reads decimal number, returns false if there is none or it overflows
+static bool parseNumber(const char **text, size_t *value) {
+    const char *p = *text;
+    if (*p < '0' || *p > '9') {
+        return false;
+    }
+    *value = 0;
+    for (; *p >= '0' && *p <= '9'; p++) {
+        size_t digit = *p - '0';
+        if (*value > (SIZE_MAX - digit) / 10) {
+            return false;
+        }
+        *value = *value * 10 + digit;
+    }
+    *text = p;
+    return true;
+}
+
+static const char *skipSpaces(const char *p) {
+    while (*p == ' ' || *p == '\t') {
+        p++;
+    }
+    return p;
+}
+
+int parseByteRange(const char *header, size_t size, ByteRange *range) {
+    range->start = 0;
+    range->length = size;
+    if (header == NULL) {
+        return RANGE_NONE;
+    }
+    const char *p = skipSpaces(header);
+    if (strncmp(p, "bytes=", 6) != 0) {
+        return RANGE_NONE;
+    }
+    p = skipSpaces(p + 6);
+
+    size_t first = 0;
+    size_t last = 0;
+    bool hasFirst = parseNumber(&p, &first);
+    if (*p++ != '-') {
+        return RANGE_NONE;
+    }
+    bool hasLast = parseNumber(&p, &last);
+    if (*skipSpaces(p) != '\0' || (!hasFirst && !hasLast) || (hasFirst && hasLast && last < first)) {
+        return RANGE_NONE; // several ranges or bad syntax
+    }
+
+    if (!hasFirst) {
+        // Suffix range, last bytes of resource
+        if (last == 0 || size == 0) {
+            return RANGE_UNSATISFIABLE;
+        }
+        range->start = last < size ? size - last : 0;
+        range->length = size - range->start;
+        return RANGE_PARTIAL;
+    }
+    if (first >= size) {
+        return RANGE_UNSATISFIABLE;
+    }
+    range->start = first;
+    range->length = (hasLast && last < size ? last + 1 : size) - first;
+    return RANGE_PARTIAL;
+}
+
+void formatContentRange(int result, const ByteRange *range, size_t size, char *out, size_t outSize) {
+    if (result == RANGE_UNSATISFIABLE) {
+        snprintf(out, outSize, "bytes */%u", (unsigned)size);
+    } else {
+        snprintf(out, outSize, "bytes %u-%u/%u", (unsigned)range->start, (unsigned)(range->start + range->length - 1), (unsigned)size);
+    }
+}
+
+size_t readRangeBlock(RecordingReadFunction read, void *context, const ByteRange *range, size_t index, uint8_t *out, size_t maxLength) {
+    if (index >= range->length) {
+        return 0;
+    }
+    size_t length = range->length - index < maxLength ? range->length - index : maxLength;
+    return read(context, range->start + index, out, length) ? length : 0;
+}
@@ -0,0 +1,32 @@
+#ifndef _BYTE_RANGE_H_
+#define _BYTE_RANGE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "recording.h"
+
+// HTTP byte ranges (RFC 7233) of downloads streamed straight from flash or capture ring.
+// Single range only: "bytes=first-last", "bytes=first-" and suffix "bytes=-length". Header with
+// several ranges, other unit or bad syntax is ignored and whole resource is sent, as RFC allows.
+
+#define RANGE_NONE 0 // no usable Range header, 200 with whole resource
+#define RANGE_PARTIAL 1 // 206 with Content-Range
+#define RANGE_UNSATISFIABLE 2 // 416 with Content-Range "bytes */size"
+
+struct ByteRange {
+    size_t start;
+    size_t length;
+};
+
+// Parses Range header value (NULL when missing) against resource of given size.
+// Range is set to the whole resource unless RANGE_PARTIAL is returned
+int parseByteRange(const char *header, size_t size, ByteRange *range);
+
+// Writes Content-Range header value for result of parseByteRange()
+void formatContentRange(int result, const ByteRange *range, size_t size, char *out, size_t outSize);
+
+// Reads next block of range into out for response filler, index is offset within range.
+// Returns number of bytes read (at most maxLength), 0 past the end of range or when read fails
+size_t readRangeBlock(RecordingReadFunction read, void *context, const ByteRange *range, size_t index, uint8_t *out, size_t maxLength);
+
+#endif
@@ -0,0 +1,34 @@
+#include "calibration_cache.h"
+
+// Half-byte table keeps CRC small in flash and still fast enough for 11 kB of params
+static const uint32_t crcTable[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC, 0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C, 0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+};
+
+uint32_t crc32Update(uint32_t crc, const void *data, size_t size) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = crcTable[(crc ^ bytes[i]) & 0x0F] ^ (crc >> 4);
+        crc = crcTable[(crc ^ (bytes[i] >> 4)) & 0x0F] ^ (crc >> 4);
+    }
+    return ~crc;
+}
+
+uint32_t calibrationKey(const uint16_t *eeHeader) {
+    return crc32Update(0, eeHeader, CALIBRATION_KEY_WORDS * sizeof(uint16_t));
+}
+
+void makeCalibrationMeta(uint32_t key, const paramsMLX90640 *params, int status, CalibrationMeta *meta) {
+    meta->version = CALIBRATION_CACHE_VERSION;
+    meta->key = key;
+    meta->size = sizeof(paramsMLX90640);
+    meta->crc = crc32Update(0, params, sizeof(paramsMLX90640));
+    meta->status = status;
+}
+
+bool isCalibrationValid(const CalibrationMeta *meta, uint32_t key, const paramsMLX90640 *params) {
+    return meta->version == CALIBRATION_CACHE_VERSION && meta->key == key && meta->size == sizeof(paramsMLX90640)
+        && meta->crc == crc32Update(0, params, sizeof(paramsMLX90640));
+}
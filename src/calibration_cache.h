@@ -0,0 +1,40 @@
+#ifndef _CALIBRATION_CACHE_H_
+#define _CALIBRATION_CACHE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "MLX90640_API.h"
+
+// Parameters extracted from sensor EEPROM are persisted between boots, so warm boot reads only
+// EEPROM header instead of whole EEPROM and skips MLX90640_ExtractParameters().
+//
+// Cached parameters are keyed by CRC32 of EEPROM header (device ID and global calibration words),
+// which identifies the sensor. Meta record holds the key, layout version and size of params and
+// CRC32 of params blob, so blob of another sensor, firmware or interrupted write isn't used.
+// Storage itself is up to the caller (NVS on device).
+
+#define CALIBRATION_CACHE_VERSION 1 // bump when paramsMLX90640 or extraction changes
+#define CALIBRATION_KEY_ADDRESS 0x2400
+#define CALIBRATION_KEY_WORDS 64 // EEPROM 0x2400 - 0x243F
+
+struct CalibrationMeta {
+    uint32_t version; // CALIBRATION_CACHE_VERSION
+    uint32_t key; // calibrationKey() of sensor params were extracted from
+    uint32_t size; // sizeof(paramsMLX90640)
+    uint32_t crc; // CRC32 of params
+    int32_t status; // MLX90640_ExtractParameters() result, deviating pixel warnings are kept
+};
+
+// CRC32 (IEEE 802.3) of data, continuing from crc (0 to start)
+uint32_t crc32Update(uint32_t crc, const void *data, size_t size);
+
+// Key of sensor from its first CALIBRATION_KEY_WORDS EEPROM words
+uint32_t calibrationKey(const uint16_t *eeHeader);
+
+// Fills meta record for params extracted from sensor with given key
+void makeCalibrationMeta(uint32_t key, const paramsMLX90640 *params, int status, CalibrationMeta *meta);
+
+// Whether params loaded along with meta are intact and belong to sensor with given key
+bool isCalibrationValid(const CalibrationMeta *meta, uint32_t key, const paramsMLX90640 *params);
+
+#endif
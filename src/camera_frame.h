@@ -0,0 +1,26 @@
+#ifndef _CAMERA_FRAME_H_
+#define _CAMERA_FRAME_H_
+
+#include <stdint.h>
+#include "frame_stats.h"
+
+const int GRID_WIDTH = 32;
+const int GRID_HEIGHT = 24;
+const int DATA_SIZE = GRID_WIDTH * GRID_HEIGHT;
+
+// Single full frame of temperatures read from the sensor
+struct CameraFrame {
+    uint32_t frameCounter;
+    uint32_t timestamp; // ms since boot when frame was completed
+    float ta; // sensor ambient temperature
+    uint8_t subPage; // subpage read last
+    uint8_t pattern; // subpage pattern sensor works in, FRAME_PATTERN_*
+    bool partial; // only subPage pixels changed since previously published frame
+    FrameStats stats; // of temperatures
+    float temperatures[DATA_SIZE];
+#ifdef MLX90640_FIXED_POINT
+    int16_t centi[DATA_SIZE]; // temperatures quantized as sent in frames (FRAME_DEFAULT_SCALE), kept by fixed-point build
+#endif
+};
+
+#endif
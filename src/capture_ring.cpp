@@ -0,0 +1,109 @@
+#include "capture_ring.h"
+#include <math.h>
+#include <string.h>
+
+void initCaptureRing(CaptureRing *ring, uint8_t *memory, size_t size) {
+    size_t capacity = memory ? size / CAPTURE_SLOT_SIZE : 0;
+    ring->slots = memory;
+    ring->capacity = capacity > UINT16_MAX ? UINT16_MAX : capacity;
+    ring->state = CAPTURE_OFF;
+    ring->preFrames = 0;
+    ring->postFrames = 0;
+    ring->threshold = NAN;
+    ring->aboveThreshold = true;
+    ring->triggerRequested = false;
+    ring->head = 0;
+    ring->stored = 0;
+    ring->count = 0;
+}
+
+void armCapture(CaptureRing *ring, uint32_t preFrames, uint32_t postFrames) {
+    if (ring->capacity == 0) {
+        return;
+    }
+    // Window too long for ring is shortened keeping its proportions. Trigger frame always belongs
+    // to pre-trigger frames, so at least one of them is kept
+    uint32_t pre = preFrames > 0 ? preFrames : 1;
+    uint32_t post = postFrames;
+    if (pre + post > ring->capacity) {
+        post = (uint64_t)post * ring->capacity / (pre + post);
+        pre = ring->capacity - post;
+    }
+    ring->preFrames = pre;
+    ring->postFrames = post;
+    ring->head = 0;
+    ring->stored = 0;
+    ring->count = 0;
+    ring->aboveThreshold = true; // threshold has to be crossed after arming, hot scene doesn't trigger right away
+    ring->triggerRequested = false;
+    ring->state = CAPTURE_ARMED;
+}
+
+void triggerCapture(CaptureRing *ring) {
+    if (ring->state == CAPTURE_ARMED) {
+        ring->triggerRequested = true;
+    }
+}
+
+bool captureFrame(CaptureRing *ring, FrameHeader *header, const float *pixels) {
+    if (ring->state != CAPTURE_ARMED && ring->state != CAPTURE_TRIGGERED) {
+        return false;
+    }
+    header->type = FRAME_TYPE_FULL;
+    encodeFrame(header, pixels, ring->slots + (size_t)ring->head * CAPTURE_SLOT_SIZE, CAPTURE_SLOT_SIZE);
+    if (++ring->head == ring->capacity) {
+        ring->head = 0;
+    }
+    if (ring->stored < ring->capacity) {
+        ring->stored++;
+    }
+
+    bool above = header->maxTemp >= ring->threshold; // false while threshold is NAN
+    bool crossed = above && !ring->aboveThreshold;
+    ring->aboveThreshold = above;
+
+    if (ring->state == CAPTURE_ARMED) {
+        if (!crossed && !ring->triggerRequested) {
+            return false;
+        }
+        ring->triggerRequested = false;
+        ring->triggerFrame = header->frameCounter;
+        ring->triggerIndex = (ring->stored < ring->preFrames ? ring->stored : ring->preFrames) - 1;
+        ring->remaining = ring->postFrames;
+        ring->state = CAPTURE_TRIGGERED;
+    } else {
+        ring->remaining--;
+    }
+    if (ring->remaining > 0) {
+        return false;
+    }
+    // Pre-trigger frames can't be overwritten yet, window fits into capacity
+    ring->count = ring->triggerIndex + 1 + ring->postFrames;
+    ring->first = (ring->head + ring->capacity - ring->count) % ring->capacity;
+    ring->state = CAPTURE_FROZEN;
+    return true;
+}
+
+size_t captureSize(const CaptureRing *ring) {
+    return ring->state == CAPTURE_FROZEN ? (size_t)ring->count * CAPTURE_SLOT_SIZE : 0;
+}
+
+size_t readCapture(const CaptureRing *ring, size_t offset, uint8_t *out, size_t outSize) {
+    size_t size = captureSize(ring);
+    if (offset >= size) {
+        return 0;
+    }
+    if (outSize > size - offset) {
+        outSize = size - offset;
+    }
+    size_t copied = 0;
+    while (copied < outSize) {
+        size_t position = offset + copied;
+        size_t slot = (ring->first + position / CAPTURE_SLOT_SIZE) % ring->capacity;
+        size_t within = position % CAPTURE_SLOT_SIZE;
+        size_t length = CAPTURE_SLOT_SIZE - within < outSize - copied ? CAPTURE_SLOT_SIZE - within : outSize - copied;
+        memcpy(out + copied, ring->slots + slot * CAPTURE_SLOT_SIZE + within, length);
+        copied += length;
+    }
+    return copied;
+}
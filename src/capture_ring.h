@@ -0,0 +1,63 @@
+#ifndef _CAPTURE_RING_H_
+#define _CAPTURE_RING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "frame_protocol.h"
+#include "camera_frame.h"
+
+// Pre-trigger capture: ring buffer continuously holding last frames, so the moment before a trigger
+// isn't missed. On trigger (captureTrigger() or frame max temperature crossing threshold) ring keeps
+// preFrames up to the trigger frame and postFrames following it, then it's frozen until armed again.
+//
+// Slots hold frames already encoded as FRAME_TYPE_FULL frames of frame_protocol.h (int16 pixels),
+// so storing a frame is one encode into a fixed slot and frozen capture reads as a file of
+// CAPTURE_SLOT_SIZE byte frames, oldest first. Memory is given by caller, nothing is allocated.
+
+#define CAPTURE_SLOT_SIZE (FRAME_HEADER_SIZE + DATA_SIZE * 2)
+
+#define CAPTURE_OFF 0 // not armed, frames are ignored
+#define CAPTURE_ARMED 1 // storing frames, waiting for trigger
+#define CAPTURE_TRIGGERED 2 // storing frames following the trigger
+#define CAPTURE_FROZEN 3 // capture complete, readable
+
+struct CaptureRing {
+    uint8_t *slots; // capacity * CAPTURE_SLOT_SIZE bytes
+    uint16_t capacity;
+    uint8_t state; // CAPTURE_*
+    uint16_t preFrames; // kept up to and including trigger frame
+    uint16_t postFrames; // kept after trigger frame
+    float threshold; // max temp triggering capture when crossed upwards, NAN disables
+    bool aboveThreshold; // previous frame max was at or above threshold
+    bool triggerRequested;
+    uint16_t head; // slot of next frame
+    uint16_t stored; // frames in ring, up to capacity
+    uint16_t remaining; // frames still to be stored after trigger
+    uint16_t first; // slot of oldest captured frame, once frozen
+    uint16_t count; // captured frames, once frozen
+    uint16_t triggerIndex; // of trigger frame within capture
+    uint32_t triggerFrame; // frame counter of trigger frame
+};
+
+// Sets up ring in memory of given size, capacity is size / CAPTURE_SLOT_SIZE frames
+void initCaptureRing(CaptureRing *ring, uint8_t *memory, size_t size);
+
+// Drops stored frames and starts waiting for trigger. Window longer than ring capacity is
+// shortened proportionally, frame counts are 32-bit so that hour long windows at full rate fit
+void armCapture(CaptureRing *ring, uint32_t preFrames, uint32_t postFrames);
+
+// Triggers capture with next stored frame, if armed
+void triggerCapture(CaptureRing *ring);
+
+// Stores complete frame, header statistics have to be filled (see encodeFrame()).
+// Takes constant time. Returns true when frame completed the capture
+bool captureFrame(CaptureRing *ring, FrameHeader *header, const float *pixels);
+
+// Size of frozen capture in bytes, 0 if capture isn't frozen
+size_t captureSize(const CaptureRing *ring);
+
+// Copies bytes of frozen capture starting at offset into out.
+// Returns number of bytes copied, 0 past the end
+size_t readCapture(const CaptureRing *ring, size_t offset, uint8_t *out, size_t outSize);
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef _CLIENT_FANOUT_H_
+#define _CLIENT_FANOUT_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <ESPAsyncWebServer.h>
+
+// Websocket fan-out: one encoded frame goes to every connected client as shared buffer, clients are
+// paced by how fast they drain their queue. Header only, it builds against AsyncWebSocket of the
+// device and against stub of native tests (test/test_client_fanout), client slots and their locking
+// stay with the caller. Clients are reached through pointers kept in their slots, never through
+// AsyncWebSocket's client list: AsyncTCP task changes that list without a lock callers could take.
+
+#define MAX_CLIENT_QUEUE 2 // Messages queued per client, slow client skips frames until its queue drains
+#define MIN_CLIENT_BACKOFF 50 // First pacing interval of client whose queue got full, ms
+#define MAX_CLIENT_INTERVAL 1000 // Pacing of slowest clients, 1 fps
+
+// Websocket client as seen by fan-out, slots are taken on connect and freed on disconnect
+struct ClientState {
+    uint32_t id; // 0 when slot is free
+    AsyncWebSocketClient *client; // set on connect, valid while caller holds lock the disconnect event takes too
+    bool needsKeyframe; // just joined or skipped a frame, stream messages can't be applied until full frame
+    bool pending; // message sent into empty queue waits for acknowledgement
+    uint32_t sent;
+    uint32_t dropped; // frames skipped because client queue was full
+    uint32_t paced; // frames skipped to keep client pace
+    uint32_t interval; // ms between frames sent to client, 0 sends every frame
+    uint32_t lastSent; // ms
+    uint32_t pendingSince; // ms
+    uint32_t ackLatency; // ms, smoothed time until client queue drains
+    uint32_t windowSent; // frames sent since effective frame rate was updated
+    float fps; // effective frame rate of client
+};
+
+// Frames skipped by fan-out, summed over clients
+struct FanOutStats {
+    uint32_t dropped; // client queue was full
+    uint32_t paced; // client wasn't due yet
+};
+
+// Paces client by how fast it drains its queue. Full queue doubles interval between frames up to
+// MAX_CLIENT_INTERVAL, every drained queue shrinks it towards half of acknowledgement latency
+// (client holds MAX_CLIENT_QUEUE messages in flight), so fast clients get every frame.
+// Returns whether frame should be sent to client now.
+inline bool paceClient(ClientState &state, size_t queued, uint32_t now, FanOutStats &stats) {
+    if (state.pending && queued == 0) {
+        uint32_t latency = now - state.pendingSince;
+        state.ackLatency = state.sent > 1 ? (state.ackLatency * 3 + latency) / 4 : latency;
+        state.pending = false;
+        state.interval = std::max(state.interval * 7 / 8, state.ackLatency / MAX_CLIENT_QUEUE);
+    }
+    if (queued >= MAX_CLIENT_QUEUE) {
+        state.interval = std::min(std::max(state.interval * 2, (uint32_t)MIN_CLIENT_BACKOFF), (uint32_t)MAX_CLIENT_INTERVAL);
+        state.dropped++;
+        stats.dropped++;
+        return false;
+    }
+    if (now - state.lastSent < state.interval) {
+        state.paced++;
+        stats.paced++;
+        return false;
+    }
+    return true;
+}
+
+// Fans frame out to count client states, stream is sent to clients in sync and keyframe to clients that
+// joined or skipped a frame. Keyframe is null unless stream is a full frame itself, then it's made by
+// makeKeyframe() at most once, for first client needing it. Empty stream (encoder ran out of buffer
+// space) is skipped by all clients. Clients with MAX_CLIENT_QUEUE messages still queued skip the frame
+// instead of queueing it, so memory stays bounded by clients * MAX_CLIENT_QUEUE shared buffers.
+template <typename MakeKeyframe>
+void fanOutFrame(ClientState *states, size_t count, AsyncWebSocketSharedBuffer stream, AsyncWebSocketSharedBuffer keyframe,
+                 uint32_t now, MakeKeyframe makeKeyframe, FanOutStats &stats) {
+    for (size_t i = 0; i < count; i++) {
+        ClientState &state = states[i];
+        if (state.id == 0) {
+            continue;
+        }
+        AsyncWebSocketClient *client = state.client;
+        if (client == NULL || client->status() != WS_CONNECTED) {
+            continue;
+        }
+        // Skipped frame breaks chain of stream messages, so paced clients get keyframes
+        if (stream->empty() || !paceClient(state, client->queueLen(), now, stats)) {
+            state.needsKeyframe = true;
+            continue;
+        }
+        if (state.needsKeyframe && keyframe == nullptr) {
+            keyframe = makeKeyframe();
+        }
+        if (client->binary(state.needsKeyframe ? keyframe : stream)) {
+            state.sent++;
+            state.windowSent++;
+            state.lastSent = now;
+            state.needsKeyframe = false;
+            if (!state.pending) {
+                state.pending = true;
+                state.pendingSince = now;
+            }
+        } else {
+            state.dropped++;
+            state.needsKeyframe = true;
+            stats.dropped++;
+        }
+    }
+}
+
+#endif
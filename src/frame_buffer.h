@@ -0,0 +1,66 @@
+#ifndef _FRAME_BUFFER_H_
+#define _FRAME_BUFFER_H_
+
+#include <stdint.h>
+#include <string.h>
+#include <atomic>
+
+// Lock-free single producer / multiple consumers double buffer.
+//
+// Producer always writes into the slot which is not published, so readers of the latest
+// frame are never blocked. Every slot is guarded with its own sequence number (seqlock):
+// it's odd while slot is being written, readers copy the slot and retry if sequence
+// changed meanwhile. This way consumers always get complete, consistent frame.
+template <typename T>
+class FrameBuffer {
+public:
+    FrameBuffer() : published(0) {
+        slotSequence[0].store(0);
+        slotSequence[1].store(0);
+    }
+
+    // Publishes new frame, can only be called from single producer task
+    void write(const T &frame) {
+        uint32_t current = published.load(std::memory_order_relaxed);
+        uint32_t slot = (current & 1) ^ 1;
+        uint32_t sequence = (current >> 1) + 1;
+
+        slotSequence[slot].store(sequence * 2 - 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        memcpy(&slots[slot], &frame, sizeof(T));
+        slotSequence[slot].store(sequence * 2, std::memory_order_release);
+        published.store((sequence << 1) | slot, std::memory_order_release);
+    }
+
+    // Copies latest published frame into out. Returns its sequence number, 0 if nothing was published yet
+    uint32_t read(T *out) const {
+        while (true) {
+            uint32_t current = published.load(std::memory_order_acquire);
+            if (current == 0) {
+                return 0;
+            }
+            uint32_t slot = current & 1;
+            uint32_t before = slotSequence[slot].load(std::memory_order_acquire);
+            if (before & 1) {
+                continue; // producer lapped us and is overwriting this slot
+            }
+            memcpy(out, &slots[slot], sizeof(T));
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (slotSequence[slot].load(std::memory_order_relaxed) == before) {
+                return before / 2;
+            }
+        }
+    }
+
+    // Sequence number of latest published frame, 0 if nothing was published yet
+    uint32_t sequence() const {
+        return published.load(std::memory_order_acquire) >> 1;
+    }
+
+private:
+    T slots[2];
+    std::atomic<uint32_t> slotSequence[2];
+    std::atomic<uint32_t> published; // sequence << 1 | slot
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include "frame_protocol.h"
+#include <math.h>
+
+static void putU16(uint8_t *out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void putU32(uint8_t *out, uint32_t value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    out[2] = (value >> 16) & 0xFF;
+    out[3] = value >> 24;
+}
+
+static uint16_t getU16(const uint8_t *in) {
+    return in[0] | (in[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t *in) {
+    return in[0] | (in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+// Converts temperature to scaled int16, clamping values outside of int16 range. NaN (pixel
+// without temperature) becomes -32768, as fixed-point kernel marks such pixels
+static int16_t quantize(float value, uint16_t scale) {
+    float scaled = roundf(value * scale);
+    if (scaled > 32767.0f) return 32767;
+    if (!(scaled >= -32768.0f)) return -32768;
+    return (int16_t)scaled;
+}
+
+// Writes header fields
+static void putHeader(const FrameHeader *header, uint8_t *out) {
+    out[0] = header->version;
+    out[1] = header->type;
+    out[2] = header->width;
+    out[3] = header->height;
+    putU32(out + 4, header->frameCounter);
+    putU32(out + 8, header->timestamp);
+    putU16(out + 12, (uint16_t)quantize(header->ta, header->scale));
+    putU16(out + 14, (uint16_t)quantize(header->minTemp, header->scale));
+    putU16(out + 16, (uint16_t)quantize(header->maxTemp, header->scale));
+    putU16(out + 18, header->scale);
+    putU16(out + 20, header->minIndex);
+    putU16(out + 22, header->maxIndex);
+    putU16(out + 24, (uint16_t)quantize(header->mean, header->scale));
+    putU16(out + 26, (uint16_t)quantize(header->stddev, header->scale));
+    for (int i = 0; i < FRAME_PERCENTILE_COUNT; i++) {
+        putU16(out + 28 + i * 2, (uint16_t)quantize(header->percentiles[i], header->scale));
+    }
+}
+
+size_t encodeFrame(FrameHeader *header, const float *pixels, uint8_t *out, size_t outSize) {
+    size_t pixelCount = header->width * header->height;
+    size_t size = frameEncodedSize(pixelCount);
+    if (outSize < size || pixelCount == 0) {
+        return 0;
+    }
+    if (header->scale == 0) {
+        header->scale = FRAME_DEFAULT_SCALE;
+    }
+
+    uint8_t *pixelsOut = out + FRAME_HEADER_SIZE;
+    for (size_t i = 0; i < pixelCount; i++) {
+        putU16(pixelsOut + i * 2, (uint16_t)quantize(pixels[i], header->scale));
+    }
+    putHeader(header, out);
+
+    return size;
+}
+
+size_t encodeQuantizedFrame(FrameHeader *header, const int16_t *values, uint8_t *out, size_t outSize) {
+    size_t pixelCount = header->width * header->height;
+    size_t size = frameEncodedSize(pixelCount);
+    if (outSize < size || pixelCount == 0) {
+        return 0;
+    }
+    if (header->scale == 0) {
+        header->scale = FRAME_DEFAULT_SCALE;
+    }
+
+    uint8_t *pixelsOut = out + FRAME_HEADER_SIZE;
+    for (size_t i = 0; i < pixelCount; i++) {
+        putU16(pixelsOut + i * 2, (uint16_t)values[i]);
+    }
+    putHeader(header, out);
+
+    return size;
+}
+
+size_t encodeSubpage(FrameHeader *header, const float *pixels, uint8_t subPage, uint8_t pattern, uint8_t *out, size_t outSize) {
+    size_t pixelCount = header->width * header->height;
+    size_t size = subpageEncodedSize(pixelCount);
+    if (outSize < size || pixelCount == 0 || subPage > 1) {
+        return 0;
+    }
+    if (header->scale == 0) {
+        header->scale = FRAME_DEFAULT_SCALE;
+    }
+    header->type = FRAME_TYPE_SUBPAGE;
+
+    uint8_t *pixelsOut = out + FRAME_HEADER_SIZE + FRAME_SUBPAGE_HEADER_SIZE;
+    for (size_t i = 0; i < pixelCount; i++) {
+        if (isSubpagePixel(i, header->width, pattern, subPage)) {
+            putU16(pixelsOut, (uint16_t)quantize(pixels[i], header->scale));
+            pixelsOut += 2;
+        }
+    }
+    putHeader(header, out);
+    out[FRAME_HEADER_SIZE] = subPage;
+    out[FRAME_HEADER_SIZE + 1] = pattern;
+
+    return size;
+}
+
+void quantizeFrame(const float *pixels, size_t pixelCount, uint16_t scale, int16_t *out) {
+    for (size_t i = 0; i < pixelCount; i++) {
+        out[i] = quantize(pixels[i], scale);
+    }
+}
+
+// Writes unsigned LEB128 varint, returns number of bytes written or 0 if it doesn't fit
+static size_t putVarint(uint8_t *out, size_t outSize, uint32_t value) {
+    size_t size = 0;
+    do {
+        if (size >= outSize) {
+            return 0;
+        }
+        uint8_t byte = value & 0x7F;
+        value >>= 7;
+        out[size++] = value ? (byte | 0x80) : byte;
+    } while (value);
+    return size;
+}
+
+// Reads unsigned LEB128 varint, returns number of bytes read or 0 if it's truncated or too long
+static size_t getVarint(const uint8_t *in, size_t size, uint32_t *value) {
+    *value = 0;
+    for (size_t i = 0; i < size && i < 5; i++) {
+        *value |= (uint32_t)(in[i] & 0x7F) << (i * 7);
+        if ((in[i] & 0x80) == 0) {
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+size_t encodeDeltaFrame(FrameHeader *header, const float *pixels, int16_t *reference, uint16_t deadband, uint8_t *out, size_t outSize) {
+    size_t pixelCount = header->width * header->height;
+    if (outSize < FRAME_HEADER_SIZE || pixelCount == 0) {
+        return 0;
+    }
+    if (header->scale == 0) {
+        header->scale = FRAME_DEFAULT_SCALE;
+    }
+    header->type = FRAME_TYPE_DELTA;
+
+    size_t size = FRAME_HEADER_SIZE;
+    uint32_t run = 0;
+    for (size_t i = 0; i <= pixelCount; i++) {
+        int32_t delta = 0;
+        if (i < pixelCount) {
+            delta = quantize(pixels[i], header->scale) - reference[i];
+            if (delta >= -(int32_t)deadband && delta <= (int32_t)deadband) {
+                delta = 0;
+                run++;
+                continue;
+            }
+        }
+        if (run > 0) {
+            size_t marker = putVarint(out + size, outSize - size, 0);
+            size_t length = marker ? putVarint(out + size + marker, outSize - size - marker, run - 1) : 0;
+            if (length == 0) {
+                return 0;
+            }
+            size += marker + length;
+            run = 0;
+        }
+        if (delta != 0) {
+            size_t written = putVarint(out + size, outSize - size, ((uint32_t)delta << 1) ^ (uint32_t)(delta >> 31));
+            if (written == 0) {
+                return 0;
+            }
+            size += written;
+        }
+    }
+
+    putHeader(header, out);
+    for (size_t i = 0; i < pixelCount; i++) {
+        int16_t value = quantize(pixels[i], header->scale);
+        int32_t delta = value - reference[i];
+        if (delta < -(int32_t)deadband || delta > (int32_t)deadband) {
+            reference[i] = value;
+        }
+    }
+
+    return size;
+}
+
+// Merges subpage pixels into pixels, header is already decoded
+static int decodeSubpage(const uint8_t *data, size_t size, const FrameHeader *header, float *pixels, size_t maxPixels) {
+    size_t pixelCount = header->width * header->height;
+    if (size < subpageEncodedSize(pixelCount)) {
+        return -1;
+    }
+    uint8_t subPage = data[FRAME_HEADER_SIZE];
+    uint8_t pattern = data[FRAME_HEADER_SIZE + 1];
+    if (subPage > 1 || pattern > FRAME_PATTERN_CHESS) {
+        return -1;
+    }
+    if (pixels == NULL) {
+        return pixelCount / 2;
+    }
+    if (pixelCount > maxPixels) {
+        return -1;
+    }
+    const uint8_t *pixelsIn = data + FRAME_HEADER_SIZE + FRAME_SUBPAGE_HEADER_SIZE;
+    for (size_t i = 0; i < pixelCount; i++) {
+        if (isSubpagePixel(i, header->width, pattern, subPage)) {
+            pixels[i] = (float)(int16_t)getU16(pixelsIn) / header->scale;
+            pixelsIn += 2;
+        }
+    }
+    return pixelCount / 2;
+}
+
+// Applies delta tokens on top of pixels, header is already decoded
+static int decodeDelta(const uint8_t *data, size_t size, const FrameHeader *header, float *pixels, size_t maxPixels) {
+    size_t pixelCount = header->width * header->height;
+    if (pixels == NULL) {
+        return pixelCount;
+    }
+    if (pixelCount > maxPixels) {
+        return -1;
+    }
+    size_t offset = FRAME_HEADER_SIZE;
+    size_t i = 0;
+    while (i < pixelCount) {
+        uint32_t value;
+        size_t read = getVarint(data + offset, size - offset, &value);
+        if (read == 0) {
+            return -1;
+        }
+        offset += read;
+        if (value == 0) {
+            read = getVarint(data + offset, size - offset, &value);
+            if (read == 0 || value >= pixelCount - i) {
+                return -1;
+            }
+            offset += read;
+            i += value + 1;
+            continue;
+        }
+        int32_t delta = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+        int32_t scaled = (int32_t)roundf(pixels[i] * header->scale) + delta;
+        pixels[i] = (float)scaled / header->scale;
+        i++;
+    }
+    return pixelCount;
+}
+
+int decodeFrame(const uint8_t *data, size_t size, FrameHeader *header, float *pixels, size_t maxPixels) {
+    if (size < FRAME_HEADER_SIZE || data[0] != FRAME_PROTOCOL_VERSION || data[1] > FRAME_TYPE_DELTA) {
+        return -1;
+    }
+    header->version = data[0];
+    header->type = data[1];
+    header->width = data[2];
+    header->height = data[3];
+    header->frameCounter = getU32(data + 4);
+    header->timestamp = getU32(data + 8);
+    header->scale = getU16(data + 18);
+    if (header->scale == 0) {
+        return -1;
+    }
+    header->ta = (float)(int16_t)getU16(data + 12) / header->scale;
+    header->minTemp = (float)(int16_t)getU16(data + 14) / header->scale;
+    header->maxTemp = (float)(int16_t)getU16(data + 16) / header->scale;
+    header->minIndex = getU16(data + 20);
+    header->maxIndex = getU16(data + 22);
+    header->mean = (float)(int16_t)getU16(data + 24) / header->scale;
+    header->stddev = (float)(int16_t)getU16(data + 26) / header->scale;
+    for (int i = 0; i < FRAME_PERCENTILE_COUNT; i++) {
+        header->percentiles[i] = (float)(int16_t)getU16(data + 28 + i * 2) / header->scale;
+    }
+
+    size_t pixelCount = header->width * header->height;
+    if (header->type == FRAME_TYPE_SUBPAGE) {
+        return decodeSubpage(data, size, header, pixels, maxPixels);
+    }
+    if (header->type == FRAME_TYPE_DELTA) {
+        return decodeDelta(data, size, header, pixels, maxPixels);
+    }
+    if (size < frameEncodedSize(pixelCount)) {
+        return -1;
+    }
+    if (pixels == NULL) {
+        return pixelCount;
+    }
+    if (pixelCount > maxPixels) {
+        return -1;
+    }
+    const uint8_t *pixelsIn = data + FRAME_HEADER_SIZE;
+    for (size_t i = 0; i < pixelCount; i++) {
+        pixels[i] = (float)(int16_t)getU16(pixelsIn + i * 2) / header->scale;
+    }
+    return pixelCount;
+}
@@ -0,0 +1,127 @@
+#ifndef _FRAME_PROTOCOL_H_
+#define _FRAME_PROTOCOL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary frame format sent over websocket. All fields are little-endian.
+//
+//  offset  size  field
+//       0     1  version (FRAME_PROTOCOL_VERSION)
+//       1     1  frame type (FRAME_TYPE_*)
+//       2     1  width
+//       3     1  height
+//       4     4  frame counter
+//       8     4  timestamp (ms since boot)
+//      12     2  Ta        (int16, scaled)
+//      14     2  min temp  (int16, scaled)
+//      16     2  max temp  (int16, scaled)
+//      18     2  scale     (uint16, units per degree C, 100 = centi-degrees)
+//      20     2  min index (uint16, row major pixel index of min temp)
+//      22     2  max index
+//      24     2  mean      (int16, scaled)
+//      26     2  stddev    (int16, scaled)
+//      28   2*P  percentiles FRAME_PERCENTILES (int16, scaled), P = FRAME_PERCENTILE_COUNT
+//      38   2*N  pixels    (int16, scaled, row major)
+//
+// Statistics (min to percentiles) describe the frame as measured (see frame_stats.h), they are
+// filled by caller and always cover the full frame, also in subpage and delta frames.
+//
+// FRAME_TYPE_SUBPAGE carries only pixels of one subpage, width and height still describe
+// the full frame and statistics are taken over the full frame after merging the subpage:
+//
+//      38     1  subpage (0 or 1)
+//      39     1  pattern (FRAME_PATTERN_*)
+//      40   2*N  pixels of the subpage (int16, scaled, ascending pixel index), N = width * height / 2
+//
+// FRAME_TYPE_DELTA carries difference of every scaled pixel against previously sent frame
+// (full, subpage or delta), as stream of unsigned LEB128 varints:
+//
+//      38     -  tokens, value v > 0 is zigzag encoded difference of next pixel,
+//                v = 0 is followed by varint r and stands for r + 1 unchanged pixels
+
+#define FRAME_PROTOCOL_VERSION 2
+#define FRAME_HEADER_SIZE 38
+#define FRAME_DEFAULT_SCALE 100
+
+#define FRAME_TYPE_FULL 0
+#define FRAME_TYPE_SUBPAGE 1
+#define FRAME_TYPE_DELTA 2
+
+#define FRAME_PERCENTILE_COUNT 5
+const uint8_t FRAME_PERCENTILES[FRAME_PERCENTILE_COUNT] = {5, 25, 50, 75, 95};
+
+#define FRAME_SUBPAGE_HEADER_SIZE 2
+#define FRAME_PATTERN_INTERLEAVED 0 // subpage is made of every second row
+#define FRAME_PATTERN_CHESS 1 // subpage is made of every second pixel, like black squares of chessboard
+
+struct FrameHeader {
+    uint8_t version;
+    uint8_t type;
+    uint8_t width;
+    uint8_t height;
+    uint32_t frameCounter;
+    uint32_t timestamp;
+    float ta;
+    float minTemp;
+    float maxTemp;
+    uint16_t scale;
+    uint16_t minIndex;
+    uint16_t maxIndex;
+    float mean;
+    float stddev;
+    float percentiles[FRAME_PERCENTILE_COUNT];
+};
+
+// Size of encoded frame for given pixels count
+inline size_t frameEncodedSize(size_t pixelCount) {
+    return FRAME_HEADER_SIZE + pixelCount * 2;
+}
+
+// Size of encoded subpage frame for given full frame pixels count
+inline size_t subpageEncodedSize(size_t pixelCount) {
+    return FRAME_HEADER_SIZE + FRAME_SUBPAGE_HEADER_SIZE + pixelCount / 2 * 2;
+}
+
+// Whether pixel at given index is measured in given subpage
+inline bool isSubpagePixel(size_t index, size_t width, uint8_t pattern, uint8_t subPage) {
+    size_t row = index / width;
+    size_t column = index % width;
+    if (pattern == FRAME_PATTERN_INTERLEAVED) {
+        return (row & 1) == subPage;
+    }
+    return ((row ^ column) & 1) == subPage;
+}
+
+// Encodes header and pixels into out buffer, header statistics have to be filled.
+// Returns number of bytes written, or 0 if out buffer is too small
+size_t encodeFrame(FrameHeader *header, const float *pixels, uint8_t *out, size_t outSize);
+
+// Encodes header and already quantized pixels (in header scale) into out buffer, as full frame.
+// Returns number of bytes written, or 0 if out buffer is too small
+size_t encodeQuantizedFrame(FrameHeader *header, const int16_t *values, uint8_t *out, size_t outSize);
+
+// Encodes header and pixels of one subpage. Pixels is the full frame with the subpage already merged,
+// header type is set to FRAME_TYPE_SUBPAGE.
+// Returns number of bytes written, or 0 if out buffer is too small
+size_t encodeSubpage(FrameHeader *header, const float *pixels, uint8_t subPage, uint8_t pattern, uint8_t *out, size_t outSize);
+
+// Scales and rounds pixels to int16 the same way they are encoded in frames
+void quantizeFrame(const float *pixels, size_t pixelCount, uint16_t scale, int16_t *out);
+
+// Encodes header and differences of pixels against reference (quantized previously sent frame).
+// Differences within deadband (scaled units) are sent as unchanged, 0 makes encoding lossless.
+// Header type is set to FRAME_TYPE_DELTA and reference is updated
+// to what receiver has after decoding.
+// Returns number of bytes written, or 0 if encoded frame doesn't fit into out buffer
+// (reference is left untouched then, full frame should be sent instead)
+size_t encodeDeltaFrame(FrameHeader *header, const float *pixels, int16_t *reference, uint16_t deadband, uint8_t *out, size_t outSize);
+
+// Decodes frame from buffer into header and pixels (pixels can be NULL to decode header only).
+// Subpage frame only overwrites pixels of its subpage and delta frame is applied on top of pixels,
+// so pixels should hold the previous frame for those.
+// Returns number of pixels decoded, or -1 if buffer is malformed, frame type is unknown
+// or pixels buffer is too small
+int decodeFrame(const uint8_t *data, size_t size, FrameHeader *header, float *pixels, size_t maxPixels);
+
+#endif
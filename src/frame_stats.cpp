@@ -0,0 +1,94 @@
+#include "frame_stats.h"
+#include <math.h>
+#include <string.h>
+
+static int fineBin(float value) {
+    float position = (value - STATS_RANGE_MIN) * (1.0f / STATS_BIN_WIDTH);
+    if (position < 0.0f) return 0;
+    if (position >= STATS_FINE_BINS - 1) return STATS_FINE_BINS - 1;
+    return (int)position;
+}
+
+void computeFrameStats(StatsWork *work, const float *pixels, size_t count, FrameStats *stats) {
+    uint16_t *bins = work->bins;
+    // Kernels give NaN for pixels they can't calculate, those are left out of all statistics
+    size_t firstValid = 0;
+    while (firstValid < count && !isfinite(pixels[firstValid])) {
+        firstValid++;
+    }
+    if (firstValid == count) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    float minTemp = pixels[firstValid];
+    float maxTemp = pixels[firstValid];
+    size_t minIndex = firstValid;
+    size_t maxIndex = firstValid;
+    // Sums are taken relative to first pixel, so single precision doesn't lose variance of warm scenes
+    float origin = pixels[firstValid];
+    float sum = 0.0f;
+    float squares = 0.0f;
+    size_t valid = 0;
+    for (size_t i = firstValid; i < count; i++) {
+        float value = pixels[i];
+        if (!isfinite(value)) {
+            continue;
+        }
+        if (value < minTemp) {
+            minTemp = value;
+            minIndex = i;
+        }
+        if (value > maxTemp) {
+            maxTemp = value;
+            maxIndex = i;
+        }
+        float difference = value - origin;
+        sum += difference;
+        squares += difference * difference;
+        bins[fineBin(value)]++;
+        valid++;
+    }
+
+    float mean = sum / valid;
+    stats->minTemp = minTemp;
+    stats->maxTemp = maxTemp;
+    stats->minIndex = minIndex;
+    stats->maxIndex = maxIndex;
+    stats->mean = origin + mean;
+    stats->stddev = sqrtf(fmaxf(0.0f, squares / valid - mean * mean));
+
+    // Percentile p is value of pixel at rank p / 100 * (count - 1) in sorted frame, pixels
+    // within fine bin are assumed to be spread evenly over it
+    float ranks[FRAME_PERCENTILE_COUNT];
+    for (int p = 0; p < FRAME_PERCENTILE_COUNT; p++) {
+        ranks[p] = FRAME_PERCENTILES[p] / 100.0f * (valid - 1);
+    }
+    memset(stats->histogram, 0, sizeof(stats->histogram));
+    float histogramFactor = maxTemp > minTemp ? STATS_HISTOGRAM_BINS / (maxTemp - minTemp) : 0.0f;
+    int first = fineBin(minTemp);
+    int last = fineBin(maxTemp);
+    int percentile = 0;
+    size_t below = 0;
+    for (int bin = first; bin <= last; bin++) {
+        uint16_t pixelsInBin = bins[bin];
+        if (pixelsInBin == 0) {
+            continue;
+        }
+        bins[bin] = 0;
+        // Edge bins span only up to min / max, they also hold everything outside of the fine range
+        float start = bin == first ? minTemp : STATS_RANGE_MIN + bin * STATS_BIN_WIDTH;
+        float end = bin == last ? maxTemp : STATS_RANGE_MIN + (bin + 1) * STATS_BIN_WIDTH;
+        while (percentile < FRAME_PERCENTILE_COUNT && ranks[percentile] < below + pixelsInBin) {
+            float value = start + (ranks[percentile] - below + 0.5f) / pixelsInBin * (end - start);
+            stats->percentiles[percentile++] = fminf(end, value); // rank past last pixel of bin would overshoot it
+        }
+        below += pixelsInBin;
+
+        int coarse = (int)(((start + end) / 2 - minTemp) * histogramFactor);
+        coarse = coarse < 0 ? 0 : coarse >= STATS_HISTOGRAM_BINS ? STATS_HISTOGRAM_BINS - 1 : coarse;
+        stats->histogram[coarse] += pixelsInBin;
+    }
+    while (percentile < FRAME_PERCENTILE_COUNT) {
+        stats->percentiles[percentile++] = maxTemp;
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef _FRAME_STATS_H_
+#define _FRAME_STATS_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "frame_protocol.h"
+
+// Frame statistics computed in single pass over pixels: min and max with their pixel index,
+// mean, standard deviation, histogram and percentile estimates.
+//
+// While pixels are scanned they are counted into fine histogram of STATS_BIN_WIDTH bins over
+// sensor range, percentiles are interpolated within fine bins (error below STATS_BIN_WIDTH / 2 for
+// smooth scenes) and fine bins between min and max are merged into STATS_HISTOGRAM_BINS equal bins.
+// Only fine bins between min and max are visited afterwards and they are cleared on the way,
+// so no per frame memset of the whole fine histogram is needed.
+
+#define STATS_RANGE_MIN -40.0f // MLX90640 object temperature range, values outside go to edge bins
+#define STATS_RANGE_MAX 300.0f
+#define STATS_BIN_WIDTH 0.25f
+#define STATS_FINE_BINS 1360 // (STATS_RANGE_MAX - STATS_RANGE_MIN) / STATS_BIN_WIDTH
+#define STATS_HISTOGRAM_BINS 16
+
+struct FrameStats {
+    float minTemp;
+    float maxTemp;
+    uint16_t minIndex; // row major pixel index
+    uint16_t maxIndex;
+    float mean;
+    float stddev;
+    float percentiles[FRAME_PERCENTILE_COUNT]; // at FRAME_PERCENTILES
+    uint16_t histogram[STATS_HISTOGRAM_BINS]; // pixel counts of equal bins from minTemp to maxTemp
+};
+
+// Scratch fine histogram, has to be zero initialized (it's left zeroed after every use)
+struct StatsWork {
+    uint16_t bins[STATS_FINE_BINS];
+};
+
+// Computes statistics of count pixels (at least 1). Non-finite pixels are skipped,
+// all statistics are zero when no pixel is finite
+void computeFrameStats(StatsWork *work, const float *pixels, size_t count, FrameStats *stats);
+
+#endif
@@ -0,0 +1,566 @@
+#include "image_encoder.h"
+#include "calibration_cache.h"
+#include <string.h>
+
+static void putBE16(uint8_t *data, uint16_t value) {
+    data[0] = value >> 8;
+    data[1] = value & 0xFF;
+}
+
+static void putBE32(uint8_t *data, uint32_t value) {
+    data[0] = value >> 24;
+    data[1] = (value >> 16) & 0xFF;
+    data[2] = (value >> 8) & 0xFF;
+    data[3] = value & 0xFF;
+}
+
+// PNG
+
+static const uint8_t pngSignature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const uint8_t lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const uint16_t distanceBase[18] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385}; // up to IMAGE_MAX_WIDTH + 1
+static const uint8_t distanceExtra[18] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7};
+
+// Reserves chunk length and type, data follows
+static void beginPngChunk(PngEncoder *encoder, const char *type) {
+    memcpy(encoder->buffer + encoder->length + 4, type, 4);
+    encoder->length += 8;
+}
+
+// Fills in length of chunk starting at start and appends its CRC
+static void endPngChunk(PngEncoder *encoder, size_t start) {
+    putBE32(encoder->buffer + start, encoder->length - start - 8);
+    putBE32(encoder->buffer + encoder->length, crc32Update(0, encoder->buffer + start + 4, encoder->length - start - 4));
+    encoder->length += 4;
+}
+
+static void putDeflateBits(PngEncoder *encoder, uint32_t value, int count) {
+    encoder->bits |= value << encoder->bitCount;
+    encoder->bitCount += count;
+    while (encoder->bitCount >= 8) {
+        encoder->buffer[encoder->length++] = encoder->bits & 0xFF;
+        encoder->bits >>= 8;
+        encoder->bitCount -= 8;
+    }
+}
+
+// Reversed bits of code, Huffman codes are sent most significant bit first
+static uint32_t reverseBits(uint32_t code, int count) {
+    uint32_t reversed = 0;
+    for (int i = 0; i < count; i++) {
+        reversed = (reversed << 1) | ((code >> i) & 1);
+    }
+    return reversed;
+}
+
+// Fixed Huffman code of literal/length symbol
+static void putDeflateSymbol(PngEncoder *encoder, int symbol) {
+    uint32_t code;
+    int count;
+    if (symbol < 144) {
+        code = 0x30 + symbol;
+        count = 8;
+    } else if (symbol < 256) {
+        code = 0x190 + symbol - 144;
+        count = 9;
+    } else if (symbol < 280) {
+        code = symbol - 256;
+        count = 7;
+    } else {
+        code = 0xC0 + symbol - 280;
+        count = 8;
+    }
+    putDeflateBits(encoder, reverseBits(code, count), count);
+}
+
+// Copy of length (3 - 258) bytes from distance back
+static void putDeflateMatch(PngEncoder *encoder, int length, int distance) {
+    int code = 28;
+    while (lengthBase[code] > length) {
+        code--;
+    }
+    putDeflateSymbol(encoder, 257 + code);
+    putDeflateBits(encoder, length - lengthBase[code], lengthExtra[code]);
+    code = 17;
+    while (distanceBase[code] > distance) {
+        code--;
+    }
+    putDeflateBits(encoder, reverseBits(code, 5), 5);
+    putDeflateBits(encoder, distance - distanceBase[code], distanceExtra[code]);
+}
+
+static void putPngHeader(PngEncoder *encoder) {
+    memcpy(encoder->buffer, pngSignature, sizeof(pngSignature));
+    encoder->length = sizeof(pngSignature);
+
+    size_t start = encoder->length;
+    beginPngChunk(encoder, "IHDR");
+    uint8_t *data = encoder->buffer + encoder->length;
+    putBE32(data, imageWidth(encoder->render));
+    putBE32(data + 4, imageHeight(encoder->render));
+    data[8] = 8; // bit depth
+    data[9] = 3; // indexed color
+    data[10] = 0; // deflate
+    data[11] = 0; // adaptive filtering
+    data[12] = 0; // no interlace
+    encoder->length += 13;
+    endPngChunk(encoder, start);
+
+    start = encoder->length;
+    beginPngChunk(encoder, "PLTE");
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        uint16_t color = encoder->render->palette[i];
+        uint8_t *rgb = encoder->buffer + encoder->length;
+        rgb[0] = ((color >> 11) << 3) | (color >> 13);
+        rgb[1] = (((color >> 5) & 0x3F) << 2) | ((color >> 9) & 0x03);
+        rgb[2] = ((color & 0x1F) << 3) | ((color >> 2) & 0x07);
+        encoder->length += 3;
+    }
+    endPngChunk(encoder, start);
+}
+
+// Filters row with the filter giving the smallest sum of absolute differences
+static void filterPngRow(PngEncoder *encoder, const uint8_t *row, const uint8_t *previous, size_t width) {
+    uint32_t sums[3] = {0, 0, 0};
+    for (size_t x = 0; x < width; x++) {
+        int8_t none = row[x];
+        int8_t sub = row[x] - (x > 0 ? row[x - 1] : 0);
+        int8_t up = row[x] - previous[x];
+        sums[0] += none < 0 ? -none : none;
+        sums[1] += sub < 0 ? -sub : sub;
+        sums[2] += up < 0 ? -up : up;
+    }
+    uint8_t filter = sums[1] < sums[0] ? 1 : 0;
+    filter = sums[2] < sums[filter] ? 2 : filter;
+
+    uint8_t *out = encoder->filtered[encoder->row & 1];
+    out[0] = filter;
+    for (size_t x = 0; x < width; x++) {
+        out[x + 1] = row[x] - (filter == 1 ? (x > 0 ? row[x - 1] : 0) : filter == 2 ? previous[x] : 0);
+    }
+}
+
+// Encodes next row as IDAT chunk, the last one also ends zlib stream and image
+static void putPngRow(PngEncoder *encoder) {
+    size_t width = imageWidth(encoder->render);
+    size_t height = imageHeight(encoder->render);
+    uint8_t *row = encoder->rows[encoder->row & 1];
+    const uint8_t *previous = encoder->rows[(encoder->row & 1) ^ 1];
+    renderImage(encoder->render, (size_t)encoder->row * width, row, width);
+    filterPngRow(encoder, row, previous, width);
+
+    encoder->length = 0;
+    beginPngChunk(encoder, "IDAT");
+    if (encoder->row == 0) {
+        encoder->buffer[encoder->length++] = 0x78; // zlib header, deflate with 32 kB window
+        encoder->buffer[encoder->length++] = 0x01;
+        putDeflateBits(encoder, 1, 1); // single final block
+        putDeflateBits(encoder, 1, 2); // of fixed Huffman codes
+    }
+
+    const uint8_t *data = encoder->filtered[encoder->row & 1];
+    const uint8_t *above = encoder->filtered[(encoder->row & 1) ^ 1];
+    size_t size = width + 1;
+    uint32_t a = encoder->adler & 0xFFFF;
+    uint32_t b = encoder->adler >> 16;
+    for (size_t i = 0; i < size; i++) {
+        a += data[i];
+        b += a;
+    }
+    encoder->adler = ((b % 65521) << 16) | (a % 65521);
+
+    // Matches are runs of previous byte and bytes of previous row, which repeat in upscaled image
+    // once filtered: rows within source cell differ by the same step
+    for (size_t i = 0; i < size;) {
+        size_t run = 0;
+        size_t copy = 0;
+        if (i > 0) {
+            while (run < 258 && i + run < size && data[i + run] == data[i - 1]) {
+                run++;
+            }
+        }
+        if (encoder->row > 0) {
+            while (copy < 258 && i + copy < size && data[i + copy] == above[i + copy]) {
+                copy++;
+            }
+        }
+        if (run >= 3 && run >= copy) {
+            putDeflateMatch(encoder, run, 1);
+            i += run;
+        } else if (copy >= 3) {
+            putDeflateMatch(encoder, copy, size);
+            i += copy;
+        } else {
+            putDeflateSymbol(encoder, data[i++]);
+        }
+    }
+
+    bool last = ++encoder->row == height;
+    if (last) {
+        putDeflateSymbol(encoder, 256); // end of block
+        if (encoder->bitCount > 0) {
+            putDeflateBits(encoder, 0, 8 - encoder->bitCount);
+        }
+        putBE32(encoder->buffer + encoder->length, encoder->adler);
+        encoder->length += 4;
+    }
+    endPngChunk(encoder, 0);
+
+    if (last) {
+        size_t start = encoder->length;
+        beginPngChunk(encoder, "IEND");
+        endPngChunk(encoder, start);
+    }
+}
+
+bool initPngEncoder(PngEncoder *encoder, ImageRender *render) {
+    if (render->format != IMAGE_FORMAT_INDEXED) {
+        return false;
+    }
+    encoder->render = render;
+    encoder->row = 0;
+    encoder->started = false;
+    encoder->adler = 1;
+    encoder->bits = 0;
+    encoder->bitCount = 0;
+    encoder->length = 0;
+    encoder->position = 0;
+    memset(encoder->rows, 0, sizeof(encoder->rows));
+    return true;
+}
+
+size_t encodePng(PngEncoder *encoder, uint8_t *out, size_t outSize) {
+    size_t written = 0;
+    while (written < outSize) {
+        if (encoder->position == encoder->length) {
+            encoder->position = 0;
+            if (!encoder->started) {
+                putPngHeader(encoder);
+                encoder->started = true;
+            } else if (encoder->row < imageHeight(encoder->render)) {
+                putPngRow(encoder);
+            } else {
+                encoder->length = 0;
+                break;
+            }
+        }
+        size_t length = encoder->length - encoder->position < outSize - written ? encoder->length - encoder->position : outSize - written;
+        memcpy(out + written, encoder->buffer + encoder->position, length);
+        encoder->position += length;
+        written += length;
+    }
+    return written;
+}
+
+// JPEG
+
+// Natural order index of n-th coefficient in zigzag order
+static const uint8_t zigzag[64] = {
+    0, 1, 8, 16, 9, 2, 3, 10, 17, 24, 32, 25, 18, 11, 4, 5, 12, 19, 26, 33, 40, 48, 41, 34, 27, 20, 13, 6, 7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36, 29, 22, 15, 23, 30, 37, 44, 51, 58, 59, 52, 45, 38, 31, 39, 46, 53, 60, 61, 54, 47, 55, 62, 63};
+
+// Standard tables of JPEG specification annex K, natural order
+static const uint8_t luminanceQuant[64] = {
+    16, 11, 10, 16, 24, 40, 51, 61, 12, 12, 14, 19, 26, 58, 60, 55, 14, 13, 16, 24, 40, 57, 69, 56, 14, 17, 22, 29, 51, 87, 80, 62,
+    18, 22, 37, 56, 68, 109, 103, 77, 24, 35, 55, 64, 81, 104, 113, 92, 49, 64, 78, 87, 103, 121, 120, 101, 72, 92, 95, 98, 112, 100, 103, 99};
+static const uint8_t chrominanceQuant[64] = {
+    17, 18, 24, 47, 99, 99, 99, 99, 18, 21, 26, 66, 99, 99, 99, 99, 24, 26, 56, 99, 99, 99, 99, 99, 47, 66, 99, 99, 99, 99, 99, 99,
+    99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99, 99};
+
+// Huffman tables as in DHT: code counts per length 1 - 16, then symbols
+static const uint8_t dcLuminanceCounts[16] = {0, 1, 5, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0};
+static const uint8_t dcChrominanceCounts[16] = {0, 3, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0};
+static const uint8_t dcSymbols[12] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11};
+static const uint8_t acLuminanceCounts[16] = {0, 2, 1, 3, 3, 2, 4, 3, 5, 5, 4, 4, 0, 0, 1, 0x7D};
+static const uint8_t acLuminanceSymbols[162] = {
+    0x01, 0x02, 0x03, 0x00, 0x04, 0x11, 0x05, 0x12, 0x21, 0x31, 0x41, 0x06, 0x13, 0x51, 0x61, 0x07, 0x22, 0x71, 0x14, 0x32, 0x81, 0x91, 0xA1, 0x08,
+    0x23, 0x42, 0xB1, 0xC1, 0x15, 0x52, 0xD1, 0xF0, 0x24, 0x33, 0x62, 0x72, 0x82, 0x09, 0x0A, 0x16, 0x17, 0x18, 0x19, 0x1A, 0x25, 0x26, 0x27, 0x28,
+    0x29, 0x2A, 0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58, 0x59,
+    0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x83, 0x84, 0x85, 0x86, 0x87, 0x88, 0x89,
+    0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4, 0xB5, 0xB6,
+    0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA, 0xE1, 0xE2,
+    0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF1, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA};
+static const uint8_t acChrominanceCounts[16] = {0, 2, 1, 2, 4, 4, 3, 4, 7, 5, 4, 4, 0, 1, 2, 0x77};
+static const uint8_t acChrominanceSymbols[162] = {
+    0x00, 0x01, 0x02, 0x03, 0x11, 0x04, 0x05, 0x21, 0x31, 0x06, 0x12, 0x41, 0x51, 0x07, 0x61, 0x71, 0x13, 0x22, 0x32, 0x81, 0x08, 0x14, 0x42, 0x91,
+    0xA1, 0xB1, 0xC1, 0x09, 0x23, 0x33, 0x52, 0xF0, 0x15, 0x62, 0x72, 0xD1, 0x0A, 0x16, 0x24, 0x34, 0xE1, 0x25, 0xF1, 0x17, 0x18, 0x19, 0x1A, 0x26,
+    0x27, 0x28, 0x29, 0x2A, 0x35, 0x36, 0x37, 0x38, 0x39, 0x3A, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49, 0x4A, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+    0x59, 0x5A, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68, 0x69, 0x6A, 0x73, 0x74, 0x75, 0x76, 0x77, 0x78, 0x79, 0x7A, 0x82, 0x83, 0x84, 0x85, 0x86, 0x87,
+    0x88, 0x89, 0x8A, 0x92, 0x93, 0x94, 0x95, 0x96, 0x97, 0x98, 0x99, 0x9A, 0xA2, 0xA3, 0xA4, 0xA5, 0xA6, 0xA7, 0xA8, 0xA9, 0xAA, 0xB2, 0xB3, 0xB4,
+    0xB5, 0xB6, 0xB7, 0xB8, 0xB9, 0xBA, 0xC2, 0xC3, 0xC4, 0xC5, 0xC6, 0xC7, 0xC8, 0xC9, 0xCA, 0xD2, 0xD3, 0xD4, 0xD5, 0xD6, 0xD7, 0xD8, 0xD9, 0xDA,
+    0xE2, 0xE3, 0xE4, 0xE5, 0xE6, 0xE7, 0xE8, 0xE9, 0xEA, 0xF2, 0xF3, 0xF4, 0xF5, 0xF6, 0xF7, 0xF8, 0xF9, 0xFA};
+
+// Scale factors of AAN DCT outputs
+static const float dctScale[8] = {1.0f, 1.387039845f, 1.306562965f, 1.175875602f, 1.0f, 0.785694958f, 0.541196100f, 0.275899379f};
+
+struct HuffmanCode {
+    uint16_t code;
+    uint8_t length;
+};
+
+// Codes by symbol: DC luminance, AC luminance, DC chrominance, AC chrominance
+static HuffmanCode huffmanCodes[4][256];
+
+static void buildHuffmanCodes(HuffmanCode *codes, const uint8_t *counts, const uint8_t *symbols) {
+    uint16_t code = 0;
+    for (int length = 1, k = 0; length <= 16; length++) {
+        for (int i = 0; i < counts[length - 1]; i++, k++) {
+            codes[symbols[k]].code = code++;
+            codes[symbols[k]].length = length;
+        }
+        code <<= 1;
+    }
+}
+
+void initJpegEncoder(JpegEncoder *encoder, uint8_t quality) {
+    buildHuffmanCodes(huffmanCodes[0], dcLuminanceCounts, dcSymbols);
+    buildHuffmanCodes(huffmanCodes[1], acLuminanceCounts, acLuminanceSymbols);
+    buildHuffmanCodes(huffmanCodes[2], dcChrominanceCounts, dcSymbols);
+    buildHuffmanCodes(huffmanCodes[3], acChrominanceCounts, acChrominanceSymbols);
+
+    quality = quality < 1 ? 1 : quality > 100 ? 100 : quality;
+    encoder->quality = quality;
+    int scale = quality < 50 ? 5000 / quality : 200 - quality * 2;
+    for (int i = 0; i < 64; i++) {
+        int natural = zigzag[i];
+        for (int table = 0; table < 2; table++) {
+            int value = ((table == 0 ? luminanceQuant : chrominanceQuant)[natural] * scale + 50) / 100;
+            value = value < 1 ? 1 : value > 255 ? 255 : value;
+            encoder->quantTables[table][i] = value;
+            encoder->divisors[table][natural] = 1.0f / (value * dctScale[natural / 8] * dctScale[natural % 8] * 8.0f);
+        }
+    }
+}
+
+static void putJpegByte(JpegEncoder *encoder, uint8_t value) {
+    if (encoder->position < encoder->size) {
+        encoder->out[encoder->position] = value;
+    }
+    encoder->position++; // past size once out is too small
+}
+
+static void putJpegBytes(JpegEncoder *encoder, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        putJpegByte(encoder, data[i]);
+    }
+}
+
+static void putJpegMarker(JpegEncoder *encoder, uint8_t marker, uint16_t length) {
+    uint8_t data[4] = {0xFF, marker};
+    putBE16(data + 2, length);
+    putJpegBytes(encoder, data, length ? 4 : 2);
+}
+
+// Huffman coded bits, most significant first, 0xFF bytes are stuffed
+static void putJpegBits(JpegEncoder *encoder, uint32_t value, int count) {
+    encoder->bits = (encoder->bits << count) | (value & ((1u << count) - 1));
+    encoder->bitCount += count;
+    while (encoder->bitCount >= 8) {
+        uint8_t byte = encoder->bits >> (encoder->bitCount - 8);
+        putJpegByte(encoder, byte);
+        if (byte == 0xFF) {
+            putJpegByte(encoder, 0);
+        }
+        encoder->bitCount -= 8;
+    }
+}
+
+// Symbol of run and size category of value followed by value bits
+static void putJpegValue(JpegEncoder *encoder, const HuffmanCode *codes, int run, int value) {
+    int magnitude = value < 0 ? -value : value;
+    int category = 0;
+    while (magnitude > 0) {
+        category++;
+        magnitude >>= 1;
+    }
+    const HuffmanCode &code = codes[(run << 4) | category];
+    putJpegBits(encoder, code.code, code.length);
+    if (category > 0) {
+        putJpegBits(encoder, value < 0 ? value - 1 : value, category);
+    }
+}
+
+static void putJpegHeader(JpegEncoder *encoder, size_t width, size_t height, int sampling) {
+    static const uint8_t jfif[14] = {'J', 'F', 'I', 'F', 0, 1, 1, 0, 0, 1, 0, 1, 0, 0};
+    putJpegMarker(encoder, 0xD8, 0); // SOI
+    putJpegMarker(encoder, 0xE0, 2 + sizeof(jfif));
+    putJpegBytes(encoder, jfif, sizeof(jfif));
+
+    putJpegMarker(encoder, 0xDB, 2 + 2 * 65); // DQT
+    for (int table = 0; table < 2; table++) {
+        putJpegByte(encoder, table);
+        putJpegBytes(encoder, encoder->quantTables[table], 64);
+    }
+
+    uint8_t frame[15] = {8, 0, 0, 0, 0, 3, 1, 0x11, 0, 2, 0x11, 1, 3, 0x11, 1}; // Y, Cb and Cr sampling factors
+    frame[7] = sampling * 0x11;
+    putBE16(frame + 1, height);
+    putBE16(frame + 3, width);
+    putJpegMarker(encoder, 0xC0, 2 + sizeof(frame)); // SOF0
+    putJpegBytes(encoder, frame, sizeof(frame));
+
+    const uint8_t *counts[4] = {dcLuminanceCounts, acLuminanceCounts, dcChrominanceCounts, acChrominanceCounts};
+    const uint8_t *symbols[4] = {dcSymbols, acLuminanceSymbols, dcSymbols, acChrominanceSymbols};
+    const uint8_t classes[4] = {0x00, 0x10, 0x01, 0x11};
+    putJpegMarker(encoder, 0xC4, 2 + 2 * (17 + 12) + 2 * (17 + 162)); // DHT
+    for (int table = 0; table < 4; table++) {
+        putJpegByte(encoder, classes[table]);
+        putJpegBytes(encoder, counts[table], 16);
+        putJpegBytes(encoder, symbols[table], table & 1 ? 162 : 12);
+    }
+
+    static const uint8_t scan[10] = {3, 1, 0x00, 2, 0x11, 3, 0x11, 0, 63, 0};
+    putJpegMarker(encoder, 0xDA, 2 + sizeof(scan)); // SOS
+    putJpegBytes(encoder, scan, sizeof(scan));
+}
+
+// AAN forward DCT of 8 values at stride, outputs are scaled by dctScale
+static void dct8(float *d, int stride) {
+    float tmp0 = d[0] + d[7 * stride];
+    float tmp7 = d[0] - d[7 * stride];
+    float tmp1 = d[stride] + d[6 * stride];
+    float tmp6 = d[stride] - d[6 * stride];
+    float tmp2 = d[2 * stride] + d[5 * stride];
+    float tmp5 = d[2 * stride] - d[5 * stride];
+    float tmp3 = d[3 * stride] + d[4 * stride];
+    float tmp4 = d[3 * stride] - d[4 * stride];
+
+    // Even part
+    float tmp10 = tmp0 + tmp3;
+    float tmp13 = tmp0 - tmp3;
+    float tmp11 = tmp1 + tmp2;
+    float tmp12 = tmp1 - tmp2;
+    d[0] = tmp10 + tmp11;
+    d[4 * stride] = tmp10 - tmp11;
+    float z1 = (tmp12 + tmp13) * 0.707106781f;
+    d[2 * stride] = tmp13 + z1;
+    d[6 * stride] = tmp13 - z1;
+
+    // Odd part
+    tmp10 = tmp4 + tmp5;
+    tmp11 = tmp5 + tmp6;
+    tmp12 = tmp6 + tmp7;
+    float z5 = (tmp10 - tmp12) * 0.382683433f;
+    float z2 = tmp10 * 0.541196100f + z5;
+    float z4 = tmp12 * 1.306562965f + z5;
+    float z3 = tmp11 * 0.707106781f;
+    float z11 = tmp7 + z3;
+    float z13 = tmp7 - z3;
+    d[5 * stride] = z13 + z2;
+    d[3 * stride] = z13 - z2;
+    d[stride] = z11 + z4;
+    d[7 * stride] = z11 - z4;
+}
+
+static void putJpegBlock(JpegEncoder *encoder, float *block, int component) {
+    int table = component == 0 ? 0 : 1;
+    const HuffmanCode *dcCodes = huffmanCodes[table * 2];
+    const HuffmanCode *acCodes = huffmanCodes[table * 2 + 1];
+    for (int i = 0; i < 64; i += 8) {
+        dct8(block + i, 1);
+    }
+    for (int i = 0; i < 8; i++) {
+        dct8(block + i, 8);
+    }
+
+    int values[64];
+    for (int i = 0; i < 64; i++) {
+        int natural = zigzag[i];
+        float value = block[natural] * encoder->divisors[table][natural];
+        int quantized = (int)(value < 0.0f ? value - 0.5f : value + 0.5f);
+        values[i] = quantized < -1023 ? -1023 : quantized > 1023 ? 1023 : quantized;
+    }
+
+    putJpegValue(encoder, dcCodes, 0, values[0] - encoder->dc[component]);
+    encoder->dc[component] = values[0];
+    int run = 0;
+    for (int i = 1; i < 64; i++) {
+        if (values[i] == 0) {
+            run++;
+            continue;
+        }
+        while (run >= 16) {
+            putJpegBits(encoder, acCodes[0xF0].code, acCodes[0xF0].length); // 16 zeros
+            run -= 16;
+        }
+        putJpegValue(encoder, acCodes, run, values[i]);
+        run = 0;
+    }
+    if (run > 0) {
+        putJpegBits(encoder, acCodes[0x00].code, acCodes[0x00].length); // end of block
+    }
+}
+
+size_t encodeJpeg(JpegEncoder *encoder, ImageRender *render, uint8_t *out, size_t outSize) {
+    if (render->format != IMAGE_FORMAT_INDEXED) {
+        return 0;
+    }
+    size_t width = imageWidth(render);
+    size_t height = imageHeight(render);
+    encoder->out = out;
+    encoder->size = outSize;
+    encoder->position = 0;
+    encoder->bits = 0;
+    encoder->bitCount = 0;
+    memset(encoder->dc, 0, sizeof(encoder->dc));
+
+    // Palette to level shifted YCbCr, pixels are then converted by lookup
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        uint16_t color = render->palette[i];
+        float r = ((color >> 11) << 3) | (color >> 13);
+        float g = (((color >> 5) & 0x3F) << 2) | ((color >> 9) & 0x03);
+        float b = ((color & 0x1F) << 3) | ((color >> 2) & 0x07);
+        encoder->colors[0][i] = 0.299f * r + 0.587f * g + 0.114f * b - 128.0f;
+        encoder->colors[1][i] = -0.168736f * r - 0.331264f * g + 0.5f * b;
+        encoder->colors[2][i] = 0.5f * r - 0.418688f * g - 0.081312f * b;
+    }
+    // Upscaled image has no color detail within 2x2 pixels, chroma is subsampled then (4:2:0).
+    // Native resolution keeps full chroma (4:4:4), every pixel is a sensor pixel
+    int sampling = render->scale > 1 ? 2 : 1;
+    int mcuSize = 8 * sampling;
+    putJpegHeader(encoder, width, height, sampling);
+
+    // Image not divisible into whole MCUs is padded by repeating its last row and column
+    float block[64];
+    for (size_t top = 0; top < height; top += mcuSize) {
+        size_t rows = height - top < (size_t)mcuSize ? height - top : mcuSize;
+        renderImage(render, top * width, encoder->strip, rows * width);
+        for (size_t left = 0; left < width; left += mcuSize) {
+            for (int y0 = 0; y0 < mcuSize; y0 += 8) {
+                for (int x0 = 0; x0 < mcuSize; x0 += 8) {
+                    for (int y = 0; y < 8; y++) {
+                        size_t row = y0 + y < (int)rows ? y0 + y : rows - 1;
+                        for (int x = 0; x < 8; x++) {
+                            size_t column = left + x0 + x < width ? left + x0 + x : width - 1;
+                            block[y * 8 + x] = encoder->colors[0][encoder->strip[row * width + column]];
+                        }
+                    }
+                    putJpegBlock(encoder, block, 0);
+                }
+            }
+            for (int component = 1; component < 3; component++) {
+                const float *colors = encoder->colors[component];
+                for (int y = 0; y < 8; y++) {
+                    for (int x = 0; x < 8; x++) {
+                        float sum = 0.0f;
+                        for (int dy = 0; dy < sampling; dy++) {
+                            size_t row = y * sampling + dy < (int)rows ? y * sampling + dy : rows - 1;
+                            for (int dx = 0; dx < sampling; dx++) {
+                                size_t column = left + x * sampling + dx < width ? left + x * sampling + dx : width - 1;
+                                sum += colors[encoder->strip[row * width + column]];
+                            }
+                        }
+                        block[y * 8 + x] = sum / (sampling * sampling);
+                    }
+                }
+                putJpegBlock(encoder, block, component);
+            }
+        }
+    }
+    if (encoder->bitCount > 0) {
+        putJpegBits(encoder, 0x7F, 8 - encoder->bitCount); // padded with ones
+    }
+    putJpegMarker(encoder, 0xD9, 0); // EOI
+    return encoder->position <= outSize ? encoder->position : 0;
+}
@@ -0,0 +1,65 @@
+#ifndef _IMAGE_ENCODER_H_
+#define _IMAGE_ENCODER_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "thermal_image.h"
+
+// Standard image formats of frames rendered by thermal_image.h, for /snapshot.png and /stream.mjpg.
+// Both encoders take IMAGE_FORMAT_INDEXED render and pull it row by row through renderImage(),
+// palette lookup table of render gives colors. Nothing is allocated, working buffers are fixed:
+//
+//  PNG   8 bit indexed with PLTE of render palette. Encoded on demand as output is read, one row at
+//        a time: row is filtered (none, sub or up, whichever is smallest), deflated with fixed Huffman
+//        codes, runs and matches of previous row, and sent as its own IDAT chunk. Lossless.
+//  JPEG  baseline YCbCr with standard Huffman tables, encoded whole into caller's buffer one MCU row
+//        at a time. Chroma is 4:2:0 for upscaled image, 4:4:4 at native resolution. YCbCr of palette
+//        colors is computed once per image, pixels are converted by lookup.
+
+#define IMAGE_MAX_WIDTH (GRID_WIDTH * MAX_IMAGE_SCALE)
+#define PNG_BUFFER_SIZE 1024 // largest piece is header with PLTE, 813 bytes, row is at most ~400
+#define JPEG_STRIP_ROWS 16 // MCU row of 4:2:0
+
+struct PngEncoder {
+    ImageRender *render;
+    uint16_t row; // next row to encode
+    bool started; // header was produced
+    uint32_t adler; // of uncompressed zlib data
+    uint32_t bits; // deflate bits not yet output
+    uint8_t bitCount;
+    uint8_t rows[2][IMAGE_MAX_WIDTH]; // current and previous row, for up filter
+    uint8_t filtered[2][IMAGE_MAX_WIDTH + 1]; // filter type and filtered row, current and previous
+    uint8_t buffer[PNG_BUFFER_SIZE]; // piece being output
+    size_t length;
+    size_t position;
+};
+
+struct JpegEncoder {
+    uint8_t quality;
+    uint8_t quantTables[2][64]; // luminance and chrominance, zigzag order as written to DQT
+    float divisors[2][64]; // reciprocal quantizers with DCT scaling, natural order
+    float colors[3][PALETTE_SIZE]; // Y, Cb, Cr of palette, level shifted
+    uint8_t strip[JPEG_STRIP_ROWS * IMAGE_MAX_WIDTH]; // palette indexes of MCU row
+    int dc[3]; // previous DC of components
+    uint8_t *out;
+    size_t size;
+    size_t position;
+    uint32_t bits; // Huffman bits not yet output
+    int bitCount;
+};
+
+// Starts PNG encoding of render, it has to stay valid until encoding is done.
+// Returns false if render isn't IMAGE_FORMAT_INDEXED
+bool initPngEncoder(PngEncoder *encoder, ImageRender *render);
+
+// Writes next PNG bytes into out. Returns number of bytes written, 0 once whole image was output
+size_t encodePng(PngEncoder *encoder, uint8_t *out, size_t outSize);
+
+// Sets quality (1 - 100, same scaling of standard tables as libjpeg) for following images
+void initJpegEncoder(JpegEncoder *encoder, uint8_t quality);
+
+// Encodes IMAGE_FORMAT_INDEXED render as JPEG into out. Returns JPEG size, 0 if out is too small
+// or render isn't indexed
+size_t encodeJpeg(JpegEncoder *encoder, ImageRender *render, uint8_t *out, size_t outSize);
+
+#endif
@@ -2,19 +2,231 @@
 #include <AsyncTCP.h>
 #include <ESPAsyncWebServer.h>
 #include <Wire.h>
+#include <Preferences.h>
+#include <LittleFS.h>
 #include "MLX90640_API.h"
 #include "MLX90640_I2C_Driver.h"
+#include "MLX90640_Prepared.h"
+#include "MLX90640_BadPixels.h"
+#ifdef MLX90640_FIXED_POINT
+#include "MLX90640_Fixed.h"
+#endif
 #include <ArduinoJson.h>
+#include "frame_protocol.h"
+#include "camera_frame.h"
+#include "frame_buffer.h"
+#include "buffer_pool.h"
+#include "thermal_image.h"
+#include "temporal_filter.h"
+#include "frame_stats.h"
+#include "calibration_cache.h"
+#include "recording.h"
+#include "capture_ring.h"
+#include "byte_range.h"
+#include "image_encoder.h"
+#include "client_fanout.h"
 #include <secrets.h> // Here store WiFi credentials and other secrets
 
 const byte MLX90640_address = 0x33; //Default MLX90640 I2C address
 paramsMLX90640 mlx90640;
+preparedMLX90640 mlx90640Prepared; // per-pixel calibration precomputed from mlx90640 params
+badPixelsMLX90640 mlx90640BadPixels; // neighbours replacing broken and outlier pixels listed in EEPROM
+Preferences calibrationStore; // params extracted at previous boot, see calibration_cache.h
+bool calibrationCached = false; // params were loaded from calibrationStore at this boot
+uint32_t calibrationTime = 0; // us spent getting params at boot, EEPROM reads included
+uint32_t sensorKey = 0; // calibrationKey() of sensor, recordings are tagged with it
+uint32_t firstFrameTime = 0; // ms since boot when first frame was published
+#ifdef MLX90640_FIXED_POINT
+fixedMLX90640 mlx90640Fixed; // integer calibration for fixed-point temperature calculation
+#endif
+#define CALIBRATION_NAMESPACE "mlx90640"
 #define TA_SHIFT 8 //Default shift for MLX90640 in open air
 #define EMISSIVITY 0.92 // Value for body heat calibration. 0.95 is industry standard for gery bodies, but it can be tweaked as I found MLX90640 as not the most accurate in that matter, lower values gave me better results
-const int GRID_WIDTH = 32;
-const int GRID_HEIGHT = 24;
-const int DATA_SIZE = GRID_WIDTH * GRID_HEIGHT;
-float frameData[DATA_SIZE]; // buffer for full frame of temperatures
+#define ACQUISITION_TASK_CORE 1 // Same core as Arduino loop, WiFi and TCP stack runs on core 0
+#define ACQUISITION_TASK_PRIORITY 2 // Above loop, task sleeps while sensor integrates next subpage
+#define ACQUISITION_TASK_STACK 8192
+#define DEFAULT_FRAME_RATE 4 // Full frames per second, sensor refresh rate is twice that as frame has 2 subpages
+#define MAX_FRAME_RATE 32
+#define I2C_CLOCK 400000
+#define I2C_CLOCK_HIGH_RATE 1000000 // Used above default frame rate, EEPROM dump is always done at I2C_CLOCK
+#define FRAME_BUDGET_LIMIT 5 // Consecutive frames over time budget before falling back to lower frame rate
+#define FRAME_RECOVERY_LIMIT 32 // Consecutive frames fitting into 3/4 of double rate budget before trying that rate again
+#define KEYFRAME_INTERVAL 32 // Delta frames between full frames in compressed stream
+#define DEFAULT_DEADBAND 5 // Changes up to 0.05 degC (under sensor noise) are not sent in compressed stream
+#define MAX_DEADBAND 100
+#define MAX_WS_CLIENTS 8
+#define FRAME_BUFFER_SIZE (FRAME_HEADER_SIZE + DATA_SIZE * 2) // Largest encoded frame
+#define DEFAULT_FILTER_THRESHOLD 2.0f // Changes above ~4x sensor noise at 32 fps restart adaptive filter
+#define MAX_FILTER_THRESHOLD 20.0f
+#define DEFAULT_IMAGE_SCALE 10 // Device rendered image is 320x240, same as web client canvas
+#define FRAME_POOL_SIZE (MAX_WS_CLIENTS * MAX_CLIENT_QUEUE + 2) // Every queued message holds different frame, plus stream and keyframe being encoded
+#define RECORDING_DIR "/rec"
+#define RECORDING_CHUNKS 2 // acquisition task fills one chunk while the other one is written, allocated per recording
+#define RECORDING_TASK_CORE 0 // flash writes wait for erase, away from acquisition core
+#define RECORDING_TASK_PRIORITY 1
+#define RECORDING_TASK_STACK 4096
+#define CAPTURE_PSRAM_SIZE (2 * 1024 * 1024) // 1330 frames, 41 s at 32 fps
+#define CAPTURE_HEAP_FRAMES 16 // without PSRAM, 4 s at default frame rate
+#define DEFAULT_CAPTURE_PRE 10 // s kept before trigger
+#define DEFAULT_CAPTURE_POST 5 // s kept after trigger
+#define DOWNLOAD_BLOCK_SIZE 4096 // Largest read per response fill, one flash block
+#define STREAM_BUFFERS 3 // latest MJPEG frame, previous one still sent to slow consumer and next one being encoded, allocated while stream has consumers
+#define STREAM_BUFFER_SIZE 16384 // JPEG of 320x240 thermal scene is ~5 kB, larger frame (noise) is skipped
+#define STREAM_INTERVAL 125 // ms, MJPEG is encoded at most 8 fps
+#define DEFAULT_STREAM_QUALITY 75
+#define MAX_STREAM_CONSUMERS 4
+#define STREAM_BOUNDARY "thermalframe"
+
+FrameBuffer<CameraFrame> frames; // latest complete frames, published by acquisition task
+
+// Counters of MLX90640 driver are updated by acquisition task, loop logs the copy published after every subpage
+struct AcquisitionReport {
+    acquisitionStatsMLX90640 acquisition;
+    i2cStatsMLX90640 i2c;
+};
+FrameBuffer<AcquisitionReport> acquisitionReports;
+BufferPool<FRAME_POOL_SIZE, FRAME_BUFFER_SIZE> framePool; // encoded frames shared by websocket clients, no allocation per frame
+CameraFrame frameData; // working frame of acquisition task
+CameraFrame wsFrame; // frame copy used by loop to send to websocket clients
+CameraFrame httpFrame; // frame copy used by async HTTP handlers
+TaskHandle_t acquisitionTaskHandle = NULL;
+TaskHandle_t loopTaskHandle = NULL;
+volatile uint32_t calculationCycles = 0; // CPU cycles spent in temperature calculation of last frame
+volatile uint8_t frameRate = DEFAULT_FRAME_RATE; // currently applied frame rate
+volatile uint8_t requestedFrameRate = DEFAULT_FRAME_RATE; // frame rate asked for by user, kept over budget fallbacks
+volatile uint8_t budgetFrameRate = MAX_FRAME_RATE; // highest rate fitting into frame budget, acquisition task runs min of both
+volatile bool subpageStreaming = false; // publish after every subpage, so clients get each half-frame right away
+volatile bool compression = false; // send delta frames against previously sent frame, with periodic keyframes
+volatile uint16_t deadband = DEFAULT_DEADBAND; // in FRAME_DEFAULT_SCALE units
+volatile uint8_t filterMode = FILTER_MODE_OFF; // temporal noise filter, FILTER_MODE_*
+volatile float filterAlpha = 0; // EMA weight, 0 picks weight giving noise of DEFAULT_FRAME_RATE at any frame rate
+volatile float filterThreshold = DEFAULT_FILTER_THRESHOLD;
+TemporalFilter temporalFilter; // used by acquisition task only
+volatile uint32_t imageRenderTime = 0; // us spent rendering last complete /image response
+int16_t sentFrame[DATA_SIZE]; // quantized frame as websocket clients in sync have it, reference of delta frames
+uint8_t framesSinceKeyframe = 0;
+
+// Recording of complete frames to flash, see recording.h. Acquisition task encodes frames into chunk
+// buffers and hands full ones over to recordingTask, so flash writes never stall acquisition.
+// Buffer numbers travel between the two tasks through queues. Chunk buffers exist only while recording:
+// acquisition task allocates them when recording starts, recordingTask frees them after the last chunk
+struct RecordingMessage {
+    int8_t chunk; // buffer to write, -1 for none
+    bool last; // recording stopped, file is closed after chunk
+};
+RecordingWriter recordingWriter; // used by acquisition task only
+uint8_t *volatile recordingChunks = NULL; // RECORDING_CHUNKS * RECORDING_CHUNK_SIZE, PSRAM if present
+QueueHandle_t recordingFree = NULL; // buffers ready to be filled
+QueueHandle_t recordingFull = NULL; // RecordingMessage to be written
+volatile bool recordingRequested = false; // set by /recording, latched by acquisition task per frame
+bool recordingActive = false; // acquisition task side of recordingRequested
+bool filesystemMounted = false;
+
+// Progress of current or last recording
+struct RecordingStats {
+    char file[24]; // path
+    uint32_t frames;
+    uint32_t dropped; // frames lost because all chunks were waiting for write
+    uint32_t chunks; // written
+    uint32_t writeTime; // us, last chunk
+    uint32_t maxWriteTime;
+    const char *error; // why recording stopped, NULL
+};
+RecordingStats recordingStats = {};
+
+// Pre-trigger capture, see capture_ring.h. Ring is armed and triggered by acquisition task on requests
+// of /capture, frozen capture is downloaded from /capture.bin
+CaptureRing captureRing;
+bool capturePsram = false; // ring is in PSRAM
+volatile bool captureArmRequested = false;
+volatile bool captureTriggerRequested = false;
+volatile uint16_t capturePre = DEFAULT_CAPTURE_PRE; // s, converted to frames at current frame rate when armed
+volatile uint16_t capturePost = DEFAULT_CAPTURE_POST;
+volatile float captureThreshold = NAN; // max temp triggering capture, NAN disables
+std::atomic<uint8_t> captureReaders(0); // downloads in progress, ring isn't armed again meanwhile
+
+// Held by capture download, so ring isn't armed while it's being read
+struct CaptureReader {
+    CaptureReader() { captureReaders++; }
+    ~CaptureReader() { captureReaders--; }
+};
+
+// MJPEG stream of /stream.mjpg, see image_encoder.h. Loop encodes frame once for all consumers,
+// every consumer sends the newest encoded frame once it's done with the previous one
+typedef BufferPool<STREAM_BUFFERS, STREAM_BUFFER_SIZE> StreamPool;
+StreamPool *streamPool = NULL; // encoded JPEG frames, reused across frames, owned by loop
+StreamPool::Buffer streamFrame; // latest JPEG, sized to its length
+uint32_t streamSequence = 0; // of streamFrame
+portMUX_TYPE streamMux = portMUX_INITIALIZER_UNLOCKED; // streamFrame is taken by consumers from AsyncTCP task
+std::atomic<uint8_t> streamConsumers(0);
+JpegEncoder jpegEncoder; // used by loop only
+ImageRender streamRender;
+volatile uint8_t streamScale = DEFAULT_IMAGE_SCALE; // shared by all consumers, set by /stream.mjpg
+volatile uint8_t streamPalette = PALETTE_RAINBOW;
+volatile uint8_t streamQuality = DEFAULT_STREAM_QUALITY;
+volatile uint32_t mjpegEncodeTime = 0; // us spent encoding last MJPEG frame
+volatile uint32_t pngEncodeTime = 0; // us spent encoding last complete /snapshot.png
+uint32_t lastStreamEncode = 0; // ms
+
+// MJPEG stream statistics since last report
+struct MjpegStats {
+    uint32_t frames;
+    uint32_t bytes;
+    uint32_t encodeTime; // us
+    uint32_t busy; // frames skipped because all buffers were still being sent
+    uint32_t oversized; // frames skipped because JPEG didn't fit into buffer
+    uint32_t noMemory; // frames skipped because there was no heap for buffers
+};
+MjpegStats mjpegStats = {};
+
+// Consumer of /stream.mjpg, sends multipart part per frame
+struct StreamConsumer {
+    StreamConsumer() { streamConsumers++; }
+    ~StreamConsumer() { streamConsumers--; }
+    StreamPool::Buffer frame; // JPEG being sent
+    uint32_t sequence = 0; // of frame
+    char header[96]; // part header
+    size_t headerLength = 0;
+    size_t sent = 0; // bytes of part
+};
+
+// /snapshot.png encoded row by row as TCP window allows
+struct PngSnapshot {
+    ImageRender render;
+    PngEncoder encoder;
+};
+
+ClientState clients[MAX_WS_CLIENTS] = {};
+portMUX_TYPE clientsMux = portMUX_INITIALIZER_UNLOCKED; // clients are registered from AsyncTCP task
+// Held during fan-out and by disconnect event, so client isn't freed while frame is sent to it. Recursive,
+// as library may close client and fire the event from inside a send
+SemaphoreHandle_t clientsLock = NULL;
+
+// Websocket stream statistics since last report
+struct StreamStats {
+    uint32_t frames;
+    uint32_t keyframes;
+    uint32_t rawBytes; // size the frames would have as full frames
+    uint32_t encodedBytes;
+    uint32_t encodeTime; // us
+    uint32_t dropped; // frames skipped for clients with full queue
+    uint32_t paced; // frames skipped to keep pace of slow clients
+};
+StreamStats streamStats = {};
+
+// Time spent in each stage of last frame, in us
+struct StageTimings {
+    uint32_t read; // I2C transfer of both subpages
+    uint32_t calculation;
+    uint32_t filter;
+    uint32_t stats;
+    uint32_t record; // encoding frame into recording chunk
+    uint32_t capture; // storing frame into pre-trigger ring
+    uint32_t encode;
+    uint32_t send;
+    uint32_t interval; // time between last two frames
+};
+StageTimings stageTimings = {};
 
 AsyncWebServer server(80);
 AsyncWebSocket ws("/ws");
@@ -23,19 +235,154 @@ IPAddress gateway(192, 168, 4, 1);
 IPAddress subnet(255, 255, 255, 0);
 
 const char* HTML_CONTENT = R"rawliteral(
-<!doctype html><html><head><title>ESP32 Thermal Camera</title><style>body { font-family: Arial, sans-serif; text-align: center; color: white; background: rgb(21, 21, 21) }
+<!doctype html><html><head><title>ESP32 Thermal Camera</title><style>
+        body { font-family: Arial, sans-serif; text-align: center; color: white; background: rgb(21, 21, 21) }
         #canvas-container { margin: 10px auto; border: 2px solid #333; width: 480px; height: 360px; }
         .temp-info { margin-right: 10px; display: inline }
-        canvas { display: block; width: 100%}</style></head><body><div id="canvas-container"><canvas id="thermalCanvas" width="320" height="240"></canvas></div><div><p class="temp-info">min: <span id="minTemp">N/A</span> / max: <span id="maxTemp">N/A</span></p><p class="temp-info">|</p><label for="palette">Colors:</label> <select name="colors" id="palette"><option value="rainbow">Rainbow</option><option value="whitehot">White Hot</option><option value="nightvision">Nightvision</option><option value="iron">Iron</option></select></div><script>const wsAddr=`ws://${window.location.host}/ws`;let webSocket;const canvas=document.getElementById("thermalCanvas"),ctx=canvas.getContext("2d"),gridWidth=32,gridHeight=24,interpolationScale=10,pixelSize=1;function initWebsocket(){const t=new WebSocket(wsAddr);return t.onopen=function(){console.log("WebSocket connected")},t.onmessage=function(t){try{const e=JSON.parse(t.data);e.temperatures&&drawThermalMap(e.temperatures)}catch(t){console.error("Error parsing WebSocket message:",t)}},t.onclose=function(){console.log("WebSocket closed")},t.onerror=function(t){console.log("WebSocket error: "+t)},t}function temperatureToRainbow(t,e,o){let r=(t-e)/(o-e);return r=Math.max(0,Math.min(1,r)),`hsl(${240*(1-r)}, 100%, 50%)`}function temperatureToWhitehot(t,e,o){let r=(t-e)/(o-e);r=Math.max(0,Math.min(1,r));let a=100*Math.pow(r,1.5);return`hsl(${Math.round(0)}, ${Math.round(0)}%, ${Math.round(a)}%)`}function temperatureToNightvision(t,e,o){let r=(t-e)/(o-e);r=Math.max(0,Math.min(1,r));let a=270-250*r,n=60*Math.pow(r,1.5);if(n=Math.max(5,n),r>.9){n=60+50*(10*(r-.9)),n=Math.min(100,n)}return`hsl(${Math.round(a)}, 100%, ${Math.round(n)}%)`}function temperatureToIron(t,e,o){let r,a=(t-e)/(o-e);a=Math.max(0,Math.min(1,a));let n,i=100;if(a<=.5){r=270+90*(a/.5)}else if(a<.9){r=60*((a-.5)/.4)}else r=60;if(r%=360,n=65*Math.pow(a,1.5),n=Math.max(0,n),a>=.9){let t=10*(a-.9);n=65+35*t,i=100-100*t}return`hsl(${Math.round(r)}, ${Math.round(Math.max(0,i))}%, ${Math.round(Math.min(100,n))}%)`}const temperatureToPalette={rainbow:temperatureToRainbow,whitehot:temperatureToWhitehot,nightvision:temperatureToNightvision,iron:temperatureToIron};async function fetchSensorData(){try{const t=await fetch("/data"),e=await t.json();e&&e.temperatures&&drawThermalMap(e.temperatures)}catch(t){console.error("Error fetching data:",t)}}function interpolateTemperatures(t,e,o,r,a){if(t.length!==e*o)return console.error("Input data size does not match low resolution dimensions."),[];const n=e/r,i=o/a,c=new Array(r*a),l=(r,a)=>(r=Math.max(0,Math.min(e-1,Math.floor(r))),a=Math.max(0,Math.min(o-1,Math.floor(a))),t[a*e+r]);for(let t=0;t<a;t++)for(let a=0;a<r;a++){const h=a*n,s=t*i,m=Math.floor(h),u=Math.floor(s),d=Math.min(e-1,m+1),p=Math.min(o-1,u+1),M=h-m,f=s-u,w=(1-f)*((1-M)*l(m,u)+M*l(d,u))+f*((1-M)*l(m,p)+M*l(d,p));c[t*r+a]=w}return c}function drawThermalMap(t){if(768!==t.length)return void console.error("Data size mismatch.");const e=interpolateTemperatures(t,32,24,320,240),o=Math.min(...t),r=Math.max(...t);let a=temperatureToPalette.rainbow;try{document.getElementById("minTemp").textContent=o.toFixed(1),document.getElementById("maxTemp").textContent=r.toFixed(1)}catch{console.error("Error updating temperature display.")}try{const t=document.getElementById("palette").value||"rainbow";a=temperatureToPalette[t]||temperatureToPalette.rainbow}catch{console.error("Error getting color palette. Fallback to rainbow")}for(let t=0;t<240;t++)for(let n=0;n<320;n++){const i=a(e[32*t*10+n],o,r),c=320-n-1;ctx.fillStyle=i,ctx.fillRect(1*c,1*t,1,1)}}webSocket=initWebsocket(),webSocket||(fetchSensorData(),setInterval(fetchSensorData,1e3))</script></body></html>
+        canvas { display: block; width: 100%}
+    </style></head><body><div id="canvas-container"><canvas id="thermalCanvas" width="320" height="240"></canvas></div><div><p class="temp-info">min: <span id="minTemp">N/A</span> / max: <span id="maxTemp">N/A</span></p><p class="temp-info">|</p><label for="palette">Colors:</label><select name="colors" id="palette"><option value="rainbow">Rainbow</option><option value="whitehot">White Hot</option><option value="nightvision">Nightvision</option><option value="iron">Iron</option></select><p class="temp-info">|</p><label for="frameRate">Rate:</label><select name="rate" id="frameRate"><option value="1">1 fps</option><option value="2">2 fps</option><option value="4" selected>4 fps</option><option value="8">8 fps</option><option value="16">16 fps</option><option value="32">32 fps</option></select><p class="temp-info">|</p><label for="subpages">Subpages:</label><input type="checkbox" id="subpages"><label for="compression">Compress:</label><input type="checkbox" id="compression"><label for="filter">Filter:</label><select name="filter" id="filter"><option value="off">Off</option><option value="ema">Average</option><option value="adaptive">Adaptive</option></select><label for="record">Record:</label><input type="checkbox" id="record"><p class="temp-info">|</p><label for="render">Render:</label><select name="render" id="render"><option value="browser">Browser</option><option value="indexed">Device (indexed)</option><option value="rgb565">Device (RGB565)</option></select><label for="upscaler">Upscale:</label><select name="upscaler" id="upscaler"><option value="nearest">Nearest</option><option value="bilinear" selected>Bilinear</option><option value="bicubic">Bicubic</option><option value="lanczos">Lanczos</option></select><select name="size" id="size"><option value="10">320x240</option><option value="20">640x480</option></select><label for="worker">Worker:</label><input type="checkbox" id="worker"><p class="temp-info"><span id="renderTime">N/A</span> ms</p></div><script id="renderer">const paletteSize = 256;function temperatureToRainbow(value, minTemp, maxTemp) {let normalized = (value - minTemp) / (maxTemp - minTemp);normalized = Math.max(0, Math.min(1, normalized));let hue = (1 - normalized) * 240;return `hsl(${hue}, 100%, 50%)`;}
+function temperatureToWhitehot(temperature, minTemp, maxTemp) {let tNorm = (temperature - minTemp) / (maxTemp - minTemp);tNorm = Math.max(0.0, Math.min(1.0, tNorm));const hue = 0;const saturation = 0;let lightness = Math.pow(tNorm, 1.5) * 100;const H = Math.round(hue);const S = Math.round(saturation);const L = Math.round(lightness);return `hsl(${H}, ${S}%, ${L}%)`;}
+function temperatureToNightvision(temperature, minTemp, maxTemp) {let tNorm = (temperature - minTemp) / (maxTemp - minTemp);tNorm = Math.max(0.0, Math.min(1.0, tNorm));let hue = 270 - (250 * tNorm);let lightness = Math.pow(tNorm, 1.5) * 60;lightness = Math.max(5, lightness);if (tNorm > 0.9) {const whiteHotProgress = (tNorm - 0.9) * 10;lightness = 60 + (50 * whiteHotProgress);lightness = Math.min(100, lightness);}
+const H = Math.round(hue);const L = Math.round(lightness);return `hsl(${H}, 100%, ${L}%)`;}
+function temperatureToIron(temperature, minTemp, maxTemp) {let tNorm = (temperature - minTemp) / (maxTemp - minTemp);tNorm = Math.max(0.0, Math.min(1.0, tNorm));let hue;let saturation = 100;let lightness;if (tNorm <= 0.5) {let segmentNorm = tNorm / 0.5;hue = 270 + (90 * segmentNorm);} else if (tNorm < 0.9) {let segmentNorm = (tNorm - 0.5) / 0.4;hue = 60 * segmentNorm;} else {hue = 60;}
+hue = hue % 360;lightness = Math.pow(tNorm, 1.5) * 65;lightness = Math.max(0, lightness);if (tNorm >= 0.9) {let whiteHotProgress = (tNorm - 0.9) * 10;lightness = 65 + (35 * whiteHotProgress);saturation = 100 - (100 * whiteHotProgress);}
+const H = Math.round(hue);const S = Math.round(Math.max(0, saturation));const L = Math.round(Math.min(100, lightness));return `hsl(${H}, ${S}%, ${L}%)`;}
+const temperatureToPalette = {"rainbow": temperatureToRainbow,"whitehot": temperatureToWhitehot,"nightvision": temperatureToNightvision,"iron": temperatureToIron
+};function hslToRgba(color) {const [h, s, l] = color.match(/[\d.]+/g).map(Number);const a = s / 100 * Math.min(l / 100, 1 - l / 100);const channel = (n) => {const k = (n + h / 30) % 12;return Math.round((l / 100 - a * Math.max(-1, Math.min(k - 3, 9 - k, 1))) * 255);};return ((255 << 24) | (channel(4) << 16) | (channel(8) << 8) | channel(0)) >>> 0;}
+const paletteTables = {};function paletteTable(name) {if (!paletteTables[name]) {const handler = temperatureToPalette[name] || temperatureToPalette['rainbow'];const table = new Uint32Array(paletteSize);for (let i = 0; i < paletteSize; i++) {table[i] = hslToRgba(handler(i / (paletteSize - 1), 0, 1));}
+paletteTables[name] = table;}
+return paletteTables[name];}
+const sinc = (x) => x === 0 ? 1 : Math.sin(Math.PI * x) / (Math.PI * x);const upscalers = {nearest: {taps: 1, weight: () => 1},bilinear: {taps: 2, weight: (d) => 1 - Math.abs(d)},bicubic: {taps: 4, weight: (d) => {d = Math.abs(d);return d < 1 ? 1.5 * d * d * d - 2.5 * d * d + 1 : d < 2 ? -0.5 * d * d * d + 2.5 * d * d - 4 * d + 2 : 0;}},lanczos: {taps: 6, weight: (d) => Math.abs(d) < 3 ? sinc(d) * sinc(d / 3) : 0}
+};const axisWeights = {};function getAxisWeights(upscaler, size, scale) {const key = `${upscaler}:${size}:${scale}`;if (!axisWeights[key]) {const kernel = upscalers[upscaler] || upscalers['bilinear'];const taps = kernel.taps;const indexes = new Int32Array(size * scale * taps);const weights = new Float32Array(size * scale * taps);for (let o = 0; o < size * scale; o++) {const position = o / scale;const base = Math.floor(position) - ((taps - 1) >> 1);let sum = 0;for (let j = 0; j < taps; j++) {const weight = kernel.weight(position - (base + j));indexes[o * taps + j] = Math.max(0, Math.min(size - 1, base + j));weights[o * taps + j] = weight;sum += weight;}
+for (let j = 0; j < taps; j++) {weights[o * taps + j] /= sum;}
+}
+axisWeights[key] = {taps: taps, indexes: indexes, weights: weights};}
+return axisWeights[key];}
+let intermediate = new Float32Array(0);const rowOffsets = new Int32Array(8);const rowWeights = new Float32Array(8);function renderTemperatures(pixels, temperatures, width, height, scale, table, upscaler, range) {let minTemp = temperatures[0];let maxTemp = temperatures[0];if (range) {minTemp = range.minTemp;maxTemp = range.maxTemp;} else {for (let i = 1; i < width * height; i++) {const value = temperatures[i];if (value < minTemp) minTemp = value;if (value > maxTemp) maxTemp = value;}
+}
+const factor = maxTemp > minTemp ? (paletteSize - 1) / (maxTemp - minTemp) : 0;const outWidth = width * scale;const horizontal = getAxisWeights(upscaler, width, scale);const vertical = getAxisWeights(upscaler, height, scale);if (intermediate.length < outWidth * height) {intermediate = new Float32Array(outWidth * height);}
+for (let y = 0; y < height; y++) {const row = y * width;const out = y * outWidth;for (let x = 0, tap = 0; x < outWidth; x++) {let value = 0;for (let j = 0; j < horizontal.taps; j++, tap++) {value += temperatures[row + horizontal.indexes[tap]] * horizontal.weights[tap];}
+intermediate[out + x] = (value - minTemp) * factor;}
+}
+const last = paletteSize - 1;for (let y = 0, tap = 0; y < height * scale; y++, tap += vertical.taps) {let out = (y + 1) * outWidth - 1;if (vertical.taps === 1) {const source = vertical.indexes[tap] * outWidth;for (let x = 0; x < outWidth; x++) {const value = intermediate[source + x] + 0.5;pixels[out--] = table[value <= 0 ? 0 : value >= last ? last : value | 0];}
+continue;}
+for (let j = 0; j < vertical.taps; j++) {rowOffsets[j] = vertical.indexes[tap + j] * outWidth;rowWeights[j] = vertical.weights[tap + j];}
+for (let x = 0; x < outWidth; x++) {let value = 0.5;for (let j = 0; j < vertical.taps; j++) {value += intermediate[rowOffsets[j] + x] * rowWeights[j];}
+pixels[out--] = table[value <= 0 ? 0 : value >= last ? last : value | 0];}
+}
+return {minTemp: minTemp, maxTemp: maxTemp};}
+function expandImage(pixels, bytes, format, table) {if (format === 'rgb565') {for (let i = 0; i < pixels.length; i++) {const color = bytes[i * 2] | (bytes[i * 2 + 1] << 8);const r = ((color >> 11) * 527 + 23) >> 6;const g = (((color >> 5) & 0x3F) * 259 + 33) >> 6;const b = ((color & 0x1F) * 527 + 23) >> 6;pixels[i] = ((255 << 24) | (b << 16) | (g << 8) | r) >>> 0;}
+} else {for (let i = 0; i < pixels.length; i++) {pixels[i] = table[bytes[i]];}
+}
+}
+function createRenderer(context) {let imageData = null;const target = (width, height) => {if (!imageData || imageData.width !== width || imageData.height !== height) {imageData = context.createImageData(width, height);context.canvas.width = width;context.canvas.height = height;}
+return new Uint32Array(imageData.data.buffer);};return {drawTemperatures(temperatures, width, height, scale, palette, upscaler, range) {const result = renderTemperatures(target(width * scale, height * scale), temperatures, width, height, scale, paletteTable(palette), upscaler, range);context.putImageData(imageData, 0, 0);return result;},drawImage(bytes, format, width, height, palette) {expandImage(target(width, height), bytes, format, paletteTable(palette));context.putImageData(imageData, 0, 0);return {};}
+};}
+if (typeof WorkerGlobalScope !== 'undefined' && self instanceof WorkerGlobalScope) {let workerRenderer = null;self.onmessage = (event) => {const message = event.data;if (message.canvas) {workerRenderer = createRenderer(message.canvas.getContext('2d'));return;}
+const start = performance.now();const result = message.bytes
+? workerRenderer.drawImage(message.bytes, message.format, message.width, message.height, message.palette)
+: workerRenderer.drawTemperatures(message.temperatures, message.width, message.height, message.scale, message.palette, message.upscaler, message.range);result.renderTime = performance.now() - start;self.postMessage(result);};}</script><script>const wsAddr = `ws://${window.location.host}/ws`;let webSocket;let canvas = document.getElementById('thermalCanvas');const gridWidth = 32;const gridHeight = 24;const maxDeviceScale = 10;function initWebsocket() {const ws = new WebSocket(wsAddr);ws.binaryType = 'arraybuffer';ws.onopen = function() {console.log("WebSocket connected");};ws.onmessage = function(event) {try {if (event.data instanceof ArrayBuffer) {const frame = decodeFrame(event.data);if (frame && frame.complete) {drawFrame(frame.temperatures, frame);}
+return;}
+const parsedData = JSON.parse(event.data);if (parsedData.temperatures) {drawFrame(parsedData.temperatures);}
+} catch (error) {console.error("Error parsing WebSocket message:", error);}
+};ws.onclose = function() {console.log("WebSocket closed");};ws.onerror = function(error) {console.log("WebSocket error: " + error);};return ws;}
+const frameProtocolVersion = 2;const frameHeaderSize = 38;const framePercentiles = [5, 25, 50, 75, 95];const frameTypeFull = 0;const frameTypeSubpage = 1;const frameTypeDelta = 2;const framePatternInterleaved = 0;let frameValues = new Int16Array(gridWidth * gridHeight);let frameTemperatures = new Float32Array(gridWidth * gridHeight);let receivedSubpages = 0;function isSubpagePixel(index, width, pattern, subPage) {const row = Math.floor(index / width);const column = index % width;if (pattern === framePatternInterleaved) {return (row & 1) === subPage;}
+return ((row ^ column) & 1) === subPage;}
+function applyDelta(bytes, pixelCount) {let offset = frameHeaderSize;const readVarint = () => {let value = 0;for (let shift = 0; shift < 35 && offset < bytes.length; shift += 7) {const byte = bytes[offset++];value += (byte & 0x7F) * Math.pow(2, shift);if ((byte & 0x80) === 0) {return value;}
+}
+return -1;};let i = 0;while (i < pixelCount) {const value = readVarint();if (value < 0) {return false;}
+if (value === 0) {const run = readVarint();if (run < 0 || run >= pixelCount - i) {return false;}
+i += run + 1;continue;}
+frameValues[i] += value % 2 ? -(value + 1) / 2 : value / 2;i++;}
+return true;}
+function decodeFrame(buffer) {if (buffer.byteLength < frameHeaderSize) {console.error("Frame too short.");return null;}
+const view = new DataView(buffer);const version = view.getUint8(0);if (version !== frameProtocolVersion) {console.error("Unsupported frame version: " + version);return null;}
+const type = view.getUint8(1);const width = view.getUint8(2);const height = view.getUint8(3);const scale = view.getUint16(18, true);const pixelCount = width * height;const payloadSize = type === frameTypeSubpage ? 2 + pixelCount : type === frameTypeDelta ? 0 : pixelCount * 2;if (scale === 0 || buffer.byteLength < frameHeaderSize + payloadSize || type > frameTypeDelta) {console.error("Malformed frame.");return null;}
+if (frameValues.length !== pixelCount) {frameValues = new Int16Array(pixelCount);frameTemperatures = new Float32Array(pixelCount);receivedSubpages = 0;}
+if (type === frameTypeSubpage) {const subPage = view.getUint8(frameHeaderSize) & 1;const pattern = view.getUint8(frameHeaderSize + 1);let offset = frameHeaderSize + 2;for (let i = 0; i < pixelCount; i++) {if (isSubpagePixel(i, width, pattern, subPage)) {frameValues[i] = view.getInt16(offset, true);offset += 2;}
+}
+receivedSubpages |= 1 << subPage;} else if (type === frameTypeDelta) {if (receivedSubpages !== 3) {return null;}
+if (!applyDelta(new Uint8Array(buffer), pixelCount)) {console.error("Malformed delta frame.");receivedSubpages = 0;return null;}
+} else {for (let i = 0; i < pixelCount; i++) {frameValues[i] = view.getInt16(frameHeaderSize + i * 2, true);}
+receivedSubpages = 3;}
+for (let i = 0; i < pixelCount; i++) {frameTemperatures[i] = frameValues[i] / scale;}
+return {type: type,width: width,height: height,frameCounter: view.getUint32(4, true),timestamp: view.getUint32(8, true),ta: view.getInt16(12, true) / scale,minTemp: view.getInt16(14, true) / scale,maxTemp: view.getInt16(16, true) / scale,minIndex: view.getUint16(20, true),maxIndex: view.getUint16(22, true),mean: view.getInt16(24, true) / scale,stddev: view.getInt16(26, true) / scale,percentiles: framePercentiles.map((p, i) => view.getInt16(28 + i * 2, true) / scale),complete: receivedSubpages === 3,temperatures: frameTemperatures
+};}
+let renderer = null;let renderWorker = null;let workerBusy = false;let workerPending = null;let imagePending = false;function showRenderResult(result) {if (result.minTemp !== undefined) {document.getElementById('minTemp').textContent = result.minTemp.toFixed(1);document.getElementById('maxTemp').textContent = result.maxTemp.toFixed(1);}
+document.getElementById('renderTime').textContent = result.renderTime.toFixed(1);}
+function postToWorker(message, transfer) {if (workerBusy) {workerPending = {message: message, transfer: transfer};return;}
+workerBusy = true;renderWorker.postMessage(message, transfer);}
+function setupRenderer(useWorker) {if (renderWorker) {renderWorker.terminate();renderWorker = null;}
+const fresh = canvas.cloneNode(false);canvas.replaceWith(fresh);canvas = fresh;workerBusy = false;workerPending = null;if (useWorker && canvas.transferControlToOffscreen) {const source = new Blob([document.getElementById('renderer').textContent], {type: 'text/javascript'});renderWorker = new Worker(URL.createObjectURL(source));renderWorker.onmessage = (event) => {showRenderResult(event.data);workerBusy = false;if (workerPending) {const pending = workerPending;workerPending = null;postToWorker(pending.message, pending.transfer);}
+};const offscreen = canvas.transferControlToOffscreen();renderWorker.postMessage({canvas: offscreen}, [offscreen]);renderer = {drawTemperatures(temperatures, width, height, scale, palette, upscaler, range) {const copy = Float32Array.from(temperatures);postToWorker({temperatures: copy, width: width, height: height, scale: scale, palette: palette, upscaler: upscaler, range: range}, [copy.buffer]);},drawImage(bytes, format, width, height, palette) {postToWorker({bytes: bytes, format: format, width: width, height: height, palette: palette}, [bytes.buffer]);}
+};return true;}
+const local = createRenderer(canvas.getContext('2d'));const timed = (draw) => function() {const start = performance.now();const result = draw.apply(null, arguments);result.renderTime = performance.now() - start;showRenderResult(result);};renderer = {drawTemperatures: timed(local.drawTemperatures), drawImage: timed(local.drawImage)};return false;}
+async function drawDeviceImage(format, palette, scale) {if (imagePending) {return;}
+imagePending = true;try {const response = await fetch(`/image?format=${format}&palette=${palette}&scale=${Math.min(scale, maxDeviceScale)}`);if (!response.ok) {throw new Error(await response.text());}
+const width = parseInt(response.headers.get('X-Image-Width'));const height = parseInt(response.headers.get('X-Image-Height'));const bytes = new Uint8Array(await response.arrayBuffer());document.getElementById('minTemp').textContent = parseFloat(response.headers.get('X-Min-Temp')).toFixed(1);document.getElementById('maxTemp').textContent = parseFloat(response.headers.get('X-Max-Temp')).toFixed(1);renderer.drawImage(bytes, format, width, height, palette);} catch (error) {console.error("Error fetching image:", error);} finally {imagePending = false;}
+}
+function drawFrame(temperatures, range) {if (temperatures.length !== gridWidth * gridHeight) {console.error("Data size mismatch.");return;}
+const render = document.getElementById('render').value;const palette = document.getElementById('palette').value || 'rainbow';const scale = parseInt(document.getElementById('size').value) || 10;if (render === 'indexed' || render === 'rgb565') {drawDeviceImage(render, palette, scale);return;}
+renderer.drawTemperatures(temperatures, gridWidth, gridHeight, scale, palette, document.getElementById('upscaler').value, range && {minTemp: range.minTemp, maxTemp: range.maxTemp});}
+async function fetchMode(query) {try {const response = await fetch(query ? `/mode?${query}` : '/mode', {method: query ? 'POST' : 'GET'});const mode = await response.json();if (mode && mode.requestedRate) {document.getElementById('frameRate').value = mode.requestedRate;}
+if (mode && mode.subpages !== undefined) {document.getElementById('subpages').checked = mode.subpages;}
+if (mode && mode.compression !== undefined) {document.getElementById('compression').checked = mode.compression;}
+if (mode && mode.filter !== undefined) {document.getElementById('filter').value = mode.filter;}
+} catch (error) {console.error("Error fetching mode:", error);}
+}
+async function fetchRecording(query) {try {const response = await fetch(query ? `/recording?${query}` : '/recording', {method: query ? 'POST' : 'GET'});const recording = await response.json();if (recording && recording.recording !== undefined) {document.getElementById('record').checked = recording.recording;}
+if (recording && recording.error) {console.error("Recording stopped: " + recording.error);}
+} catch (error) {console.error("Error fetching recording:", error);}
+}
+async function fetchSensorData() {try {const response = await fetch('/data');const data = await response.json();if (data && data.temperatures) {drawFrame(data.temperatures);}
+} catch (error) {console.error("Error fetching data:", error);}
+}
+document.getElementById('frameRate').addEventListener('change', (event) => fetchMode(`rate=${event.target.value}`));document.getElementById('subpages').addEventListener('change', (event) => fetchMode(`subpages=${event.target.checked ? 1 : 0}`));document.getElementById('compression').addEventListener('change', (event) => fetchMode(`compression=${event.target.checked ? 1 : 0}`));document.getElementById('filter').addEventListener('change', (event) => fetchMode(`filter=${event.target.value}`));document.getElementById('record').addEventListener('change', (event) => fetchRecording(`record=${event.target.checked ? 1 : 0}`));document.getElementById('worker').addEventListener('change', (event) => {event.target.checked = setupRenderer(event.target.checked);});setupRenderer(false);fetchMode();fetchRecording();webSocket = initWebsocket();if (!webSocket) {fetchSensorData();setInterval(fetchSensorData, 1000);}</script></body></html>
 )rawliteral";
 
+// Takes free client slot, returns false when all are taken
+bool registerClient(AsyncWebSocketClient *client) {
+    bool registered = false;
+    portENTER_CRITICAL(&clientsMux);
+    for (ClientState &state : clients) {
+        if (state.id == 0) {
+            state = {};
+            state.id = client->id();
+            state.client = client;
+            state.needsKeyframe = true;
+            registered = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&clientsMux);
+    return registered;
+}
+
+void unregisterClient(uint32_t id) {
+    portENTER_CRITICAL(&clientsMux);
+    for (ClientState &state : clients) {
+        if (state.id == id) {
+            state.id = 0;
+            state.client = NULL;
+        }
+    }
+    portEXIT_CRITICAL(&clientsMux);
+}
+
 void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len) {
   switch (type) {
     case WS_EVT_CONNECT:
       Serial.printf("WebSocket client #%u connected from %s\n", client->id(), client->remoteIP().toString().c_str());
+      if (!registerClient(client)) {
+        client->close();
+      }
       break;
     case WS_EVT_DISCONNECT:
+      // Client is freed after this event, so it waits for fan-out sending to it
       Serial.printf("WebSocket client #%u disconnected\n", client->id());
+      xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+      unregisterClient(client->id());
+      xSemaphoreGiveRecursive(clientsLock);
       break;
     case WS_EVT_DATA:
     case WS_EVT_PONG:
@@ -46,8 +393,8 @@ void onEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType
 
 void initWebSocket() {
     server.addHandler(&ws).addMiddleware([](AsyncWebServerRequest *request, ArMiddlewareNext next) {
-        if (ws.count() > 1) {
-            // if we have 2 clients or more, prevent the next one to connect
+        if (ws.count() >= MAX_WS_CLIENTS) {
+            // every frame is fanned out to all clients, so their number is limited to keep memory bounded
             request->send(503, "text/plain", "Server is busy");
         } else {
             next();
@@ -57,27 +404,368 @@ void initWebSocket() {
     server.addHandler(&ws);
 }
 
-void readCameraData() {
-    for (byte x = 0 ; x < 2 ; x++) {
-        uint16_t mlx90640Frame[834];
-        int status = MLX90640_GetFrameData(MLX90640_address, mlx90640Frame);
-        if (status < 0) {
-            Serial.print("GetFrame Error: ");
-            Serial.println(status);
+bool isValidFrameRate(int rate) {
+    return rate >= 1 && rate <= MAX_FRAME_RATE && (rate & (rate - 1)) == 0;
+}
+
+// Sets sensor refresh rate for given frame rate, I2C clock is raised for higher rates
+int applyFrameRate(uint8_t rate) {
+    uint8_t refreshRate = 0x02; // 2Hz subpages for 1 frame per second
+    for (uint8_t r = rate; r > 1; r >>= 1) {
+        refreshRate++;
+    }
+    Wire.setClock(rate > DEFAULT_FRAME_RATE ? I2C_CLOCK_HIGH_RATE : I2C_CLOCK);
+    int status = MLX90640_SetRefreshRate(MLX90640_address, refreshRate);
+    if (status == 0) {
+        frameRate = rate;
+    }
+    return status;
+}
+
+// Reads next subpage and merges its temperatures into frame, time spent is added to timings.
+// Returns false if the read failed, frame is left as it was then
+bool readCameraSubpage(CameraFrame *frame, StageTimings *timings, uint32_t *cycles) {
+    uint16_t mlx90640Frame[834];
+    int status = MLX90640_GetFrameDataScheduled(MLX90640_address, mlx90640Frame);
+    if (status < 0) {
+        Serial.print("GetFrame Error: ");
+        Serial.println(status);
+    }
+    AcquisitionReport report;
+    MLX90640_GetAcquisitionStats(&report.acquisition);
+    MLX90640_I2CGetStats(&report.i2c);
+    acquisitionReports.write(report);
+    timings->read += report.acquisition.lastReadTime;
+    if (status < 0) {
+        // Frame words weren't read, subpage number in them can't even index calibration tables
+        return false;
+    }
+
+    float Ta = MLX90640_GetTa(mlx90640Frame, &mlx90640);
+    float tr = Ta - TA_SHIFT; //Reflected temperature based on the sensor ambient temperature
+
+    uint32_t start = ESP.getCycleCount();
+    uint32_t startTime = micros();
+    frame->ta = Ta;
+    frame->subPage = mlx90640Frame[833];
+    frame->pattern = (mlx90640Frame[832] & 0x1000) ? FRAME_PATTERN_CHESS : FRAME_PATTERN_INTERLEAVED;
+#ifdef MLX90640_FIXED_POINT
+    // Calculated values are sent as they are, floats of subpage pixels are for statistics, filter and images
+    MLX90640_CalculateToFixed(mlx90640Frame, &mlx90640, &mlx90640Fixed, EMISSIVITY, tr, frame->centi);
+    MLX90640_CorrectBadPixelsFixed(&mlx90640BadPixels, frame->subPage, mlx90640Frame[832] & 0x1000, frame->centi);
+    for (int i = 0; i < DATA_SIZE; i++) {
+        if (isSubpagePixel(i, GRID_WIDTH, frame->pattern, frame->subPage)) {
+            // Invalid pixels become NaN like in float build, left out of statistics the same way
+            frame->temperatures[i] = frame->centi[i] == MLX90640_FIXED_INVALID ? NAN : frame->centi[i] * (1.0f / FRAME_DEFAULT_SCALE);
         }
-        float vdd = MLX90640_GetVdd(mlx90640Frame, &mlx90640);
-        float Ta = MLX90640_GetTa(mlx90640Frame, &mlx90640);
-        float tr = Ta - TA_SHIFT; //Reflected temperature based on the sensor ambient temperature
+    }
+#else
+    MLX90640_CalculateToPrepared(mlx90640Frame, &mlx90640, &mlx90640Prepared, EMISSIVITY, tr, frame->temperatures);
+    MLX90640_CorrectBadPixels(&mlx90640BadPixels, frame->subPage, mlx90640Frame[832] & 0x1000, frame->temperatures);
+#endif
+    *cycles += ESP.getCycleCount() - start;
+    timings->calculation += micros() - startTime;
+
+    startTime = micros();
+    applyTemporalFilter(&temporalFilter, frame->temperatures, frame->subPage, frame->pattern);
+#ifdef MLX90640_FIXED_POINT
+    if (temporalFilter.mode != FILTER_MODE_OFF) {
+        // Filtered values are sent instead
+        quantizeFrame(frame->temperatures, DATA_SIZE, FRAME_DEFAULT_SCALE, frame->centi);
+    }
+#endif
+    timings->filter += micros() - startTime;
+    frame->timestamp = millis();
+    return true;
+}
 
-        MLX90640_CalculateTo(mlx90640Frame, &mlx90640, EMISSIVITY, tr, frameData);
+// Computes statistics of frame about to be published
+void updateFrameStats(CameraFrame *frame, StageTimings *timings) {
+    static StatsWork statsWork; // zeroed, stays zeroed between frames
+    uint32_t startTime = micros();
+    computeFrameStats(&statsWork, frame->temperatures, DATA_SIZE, &frame->stats);
+    timings->stats += micros() - startTime;
+}
+
+// Applies filter settings changed since last frame, averages restart then
+void updateTemporalFilter() {
+    float alpha = filterAlpha > 0 ? filterAlpha : filterAlphaForRate(frameRate, DEFAULT_FRAME_RATE);
+    if (temporalFilter.mode != filterMode || temporalFilter.alpha != alpha || temporalFilter.threshold != filterThreshold) {
+        initTemporalFilter(&temporalFilter, filterMode, alpha, filterThreshold);
+    }
+}
+
+// Publishes working frame to consumers and wakes up loop to send it
+void publishFrame(CameraFrame *frame, bool partial) {
+    frame->partial = partial;
+    frame->frameCounter++;
+    if (firstFrameTime == 0) {
+        firstFrameTime = millis();
+    }
+    frames.write(*frame);
+    xTaskNotifyGive(loopTaskHandle);
+}
+
+// Frame rate acquisition task should run at
+uint8_t targetFrameRate() {
+    return requestedFrameRate < budgetFrameRate ? requestedFrameRate : budgetFrameRate;
+}
+
+// Falls back to lower frame rate when all stages of a frame don't fit into the frame period. Requested
+// rate is kept, fallback is undone step by step once frames fit with margin into budget of double rate
+void checkFrameBudget() {
+    static uint8_t overBudget = 0;
+    static uint8_t underBudget = 0;
+    uint32_t budget = 1000000 / frameRate;
+    uint32_t busy = stageTimings.read + stageTimings.calculation + stageTimings.filter + stageTimings.stats + stageTimings.record + stageTimings.capture + stageTimings.encode + stageTimings.send;
+
+    if (busy > budget || stageTimings.interval > budget + budget / 2) {
+        overBudget++;
+        underBudget = 0;
+    } else {
+        overBudget = 0;
+        if (frameRate < requestedFrameRate && busy < budget / 2 * 3 / 4) {
+            underBudget++;
+        } else {
+            underBudget = 0;
+        }
+    }
+    if (overBudget >= FRAME_BUDGET_LIMIT && frameRate > 1) {
+        Serial.printf("Frame budget of %u us exceeded (busy %u us, interval %u us), falling back to %u fps\n", budget, busy, stageTimings.interval, frameRate / 2);
+        budgetFrameRate = frameRate / 2;
+        overBudget = 0;
+    }
+    if (underBudget >= FRAME_RECOVERY_LIMIT) {
+        Serial.printf("Frames fit into budget of %u fps (busy %u us), raising frame rate\n", frameRate * 2, busy);
+        budgetFrameRate = frameRate * 2;
+        underBudget = 0;
+    }
+}
+
+FrameHeader getFrameHeader(const CameraFrame &frame) {
+    FrameHeader header = {};
+    header.version = FRAME_PROTOCOL_VERSION;
+    header.type = FRAME_TYPE_FULL;
+    header.width = GRID_WIDTH;
+    header.height = GRID_HEIGHT;
+    header.frameCounter = frame.frameCounter;
+    header.timestamp = frame.timestamp;
+    header.ta = frame.ta;
+    header.scale = FRAME_DEFAULT_SCALE;
+    header.minTemp = frame.stats.minTemp;
+    header.maxTemp = frame.stats.maxTemp;
+    header.minIndex = frame.stats.minIndex;
+    header.maxIndex = frame.stats.maxIndex;
+    header.mean = frame.stats.mean;
+    header.stddev = frame.stats.stddev;
+    for (int i = 0; i < FRAME_PERCENTILE_COUNT; i++) {
+        header.percentiles[i] = frame.stats.percentiles[i];
+    }
+    return header;
+}
+
+// Hands chunk being filled over to recordingTask, last closes the recording file afterwards
+void submitRecordingChunk(bool last) {
+    RecordingMessage message = {-1, last};
+    if (recordingWriter.chunk != NULL) {
+        int8_t chunk = (recordingWriter.chunk - recordingChunks) / RECORDING_CHUNK_SIZE;
+        if (recordingWriter.info.frameCount > 0) {
+            finishRecordingChunk(&recordingWriter);
+            message.chunk = chunk;
+        } else {
+            recordingWriter.chunk = NULL;
+            xQueueSend(recordingFree, &chunk, 0);
+        }
+    }
+    if (message.chunk >= 0 || last) {
+        xQueueSend(recordingFull, &message, 0);
     }
 }
 
-String getJsonData() {
+// Allocates chunk buffers of new recording and hands them to free queue. Previous recording
+// has to be finished first, its buffers are freed by recordingTask after the last chunk
+bool allocateRecordingChunks() {
+    if (recordingChunks != NULL) {
+        return false;
+    }
+    size_t size = RECORDING_CHUNKS * RECORDING_CHUNK_SIZE;
+    uint8_t *chunks = (uint8_t *)(psramFound() ? ps_malloc(size) : malloc(size));
+    if (chunks == NULL) {
+        recordingStats.error = "No memory for recording";
+        Serial.printf("Recording stopped: %s\n", recordingStats.error);
+        recordingRequested = false;
+        return false;
+    }
+    recordingChunks = chunks;
+    for (int8_t i = 0; i < RECORDING_CHUNKS; i++) {
+        xQueueSend(recordingFree, &i, 0);
+    }
+    return true;
+}
+
+// Appends complete frame to recording, full chunk is submitted and frame goes to the next one.
+// Frame is dropped when no chunk is free, i.e. flash can't keep up
+void recordFrame(const CameraFrame *frame, StageTimings *timings) {
+    bool requested = recordingRequested;
+    if (!requested && !recordingActive) {
+        return;
+    }
+    uint32_t startTime = micros();
+    if (!requested) {
+        submitRecordingChunk(true);
+        recordingActive = false;
+    } else {
+        if (!recordingActive) {
+            if (!allocateRecordingChunks()) {
+                // Previous recording is still being written, out of memory stops recording instead
+                if (recordingRequested) {
+                    recordingStats.dropped++;
+                }
+                timings->record += micros() - startTime;
+                return;
+            }
+            initRecordingWriter(&recordingWriter, sensorKey, EMISSIVITY);
+            recordingActive = true;
+        }
+        FrameHeader header = getFrameHeader(*frame);
+        bool appended = recordingWriter.chunk != NULL && appendRecordingFrame(&recordingWriter, &header, frame->temperatures);
+        if (!appended) {
+            submitRecordingChunk(false);
+            int8_t chunk;
+            if (xQueueReceive(recordingFree, &chunk, 0) == pdTRUE) {
+                beginRecordingChunk(&recordingWriter, recordingChunks + chunk * RECORDING_CHUNK_SIZE);
+                appended = appendRecordingFrame(&recordingWriter, &header, frame->temperatures);
+            }
+        }
+        if (appended) {
+            recordingStats.frames++;
+        } else {
+            recordingStats.dropped++;
+        }
+    }
+    timings->record += micros() - startTime;
+}
+
+// Stores complete frame into pre-trigger ring, applies requests of /capture first
+void captureCompleteFrame(const CameraFrame *frame, StageTimings *timings) {
+    uint32_t startTime = micros();
+    if (captureArmRequested && captureReaders == 0) {
+        armCapture(&captureRing, (uint32_t)capturePre * frameRate, (uint32_t)capturePost * frameRate);
+        captureArmRequested = false;
+    }
+    if (captureTriggerRequested) {
+        triggerCapture(&captureRing);
+        captureTriggerRequested = false;
+    }
+    captureRing.threshold = captureThreshold;
+    FrameHeader header = getFrameHeader(*frame);
+    if (captureFrame(&captureRing, &header, frame->temperatures)) {
+        Serial.printf("Captured %u frames around frame %u\n", captureRing.count, captureRing.triggerFrame);
+    }
+    timings->capture += micros() - startTime;
+}
+
+// Creates file of new recording, numbered after the highest existing one
+File createRecordingFile() {
+    uint32_t number = 0;
+    File directory = LittleFS.open(RECORDING_DIR);
+    for (File entry = directory.openNextFile(); entry; entry = directory.openNextFile()) {
+        number = max(number, (uint32_t)atoi(entry.name()));
+    }
+    snprintf(recordingStats.file, sizeof(recordingStats.file), RECORDING_DIR "/%05u.trec", number + 1);
+    return LittleFS.open(recordingStats.file, "w");
+}
+
+// Writes chunks submitted by acquisition task. Chunk is flushed right away, so recording
+// cut by power loss keeps every chunk written before
+void recordingTask(void *parameter) {
+    File file;
+    RecordingMessage message;
+    while (true) {
+        xQueueReceive(recordingFull, &message, portMAX_DELAY);
+        if (message.chunk >= 0) {
+            const uint8_t *chunk = recordingChunks + message.chunk * RECORDING_CHUNK_SIZE;
+            RecordingChunkInfo info;
+            if (parseRecordingHeader(chunk, &info) && info.sequence == 0) {
+                file.close();
+                file = createRecordingFile();
+            }
+            uint32_t startTime = micros();
+            bool written = file && file.write(chunk, RECORDING_CHUNK_SIZE) == RECORDING_CHUNK_SIZE;
+            file.flush();
+            uint32_t elapsed = micros() - startTime;
+            xQueueSend(recordingFree, &message.chunk, 0);
+
+            if (written) {
+                recordingStats.chunks++;
+                recordingStats.writeTime = elapsed;
+                recordingStats.maxWriteTime = max(recordingStats.maxWriteTime, elapsed);
+            } else if (recordingRequested) {
+                recordingStats.error = file ? "Filesystem full" : "Failed to create recording file";
+                Serial.printf("Recording stopped: %s\n", recordingStats.error);
+                recordingRequested = false;
+            }
+        }
+        if (message.last) {
+            file.close();
+            // Every chunk came back, acquisition task doesn't use them until it allocates new ones
+            xQueueReset(recordingFree);
+            free(recordingChunks);
+            recordingChunks = NULL;
+        }
+    }
+}
+
+// Reads sensor continuously and publishes every complete frame, or every subpage in subpage streaming mode
+void acquisitionTask(void *parameter) {
+    uint32_t lastFrame = micros();
+    while (true) {
+        uint8_t rate = targetFrameRate();
+        if (rate != frameRate) {
+            if (applyFrameRate(rate) != 0) {
+                Serial.println("Failed to set frame rate");
+                requestedFrameRate = frameRate;
+                budgetFrameRate = MAX_FRAME_RATE;
+            }
+        }
+
+        // Mode is latched per frame, so the first subpage delta always follows a complete frame
+        bool streamSubpages = subpageStreaming;
+        updateTemporalFilter();
+        StageTimings timings = {};
+        uint32_t cycles = 0;
+        for (byte x = 0 ; x < 2 ; ) {
+            if (!readCameraSubpage(&frameData, &timings, &cycles)) {
+                continue; // nothing to publish, next subpage is read in its place
+            }
+            if (streamSubpages || x == 1) {
+                updateFrameStats(&frameData, &timings);
+                publishFrame(&frameData, streamSubpages);
+            }
+            x++;
+        }
+        recordFrame(&frameData, &timings);
+        captureCompleteFrame(&frameData, &timings);
+        calculationCycles = cycles;
+        stageTimings.read = timings.read;
+        stageTimings.calculation = timings.calculation;
+        stageTimings.filter = timings.filter;
+        stageTimings.stats = timings.stats;
+        stageTimings.record = timings.record;
+        stageTimings.capture = timings.capture;
+
+        uint32_t now = micros();
+        stageTimings.interval = now - lastFrame;
+        lastFrame = now;
+        checkFrameBudget();
+    }
+}
+
+String getJsonData(const CameraFrame &frame) {
     // Prepare JSON response
     JsonDocument doc;
     JsonArray dataArray = doc["temperatures"].to<JsonArray>();
-    for (float temp : frameData) {
+    for (float temp : frame.temperatures) {
         dataArray.add(temp);
     }
     String output;
@@ -86,8 +774,440 @@ String getJsonData() {
     return output;
 }
 
-void sendDataToWsClients() {
-    ws.textAll(getJsonData());
+// Adds temperature and position of pixel in sensor frame (same order as /data, clients draw it mirrored)
+void addPixelJson(JsonObject object, const CameraFrame &frame, uint16_t index) {
+    object["temp"] = frame.temperatures[index];
+    object["x"] = index % GRID_WIDTH;
+    object["y"] = index / GRID_WIDTH;
+}
+
+String getStatsJson(const CameraFrame &frame) {
+    const FrameStats &stats = frame.stats;
+    JsonDocument doc;
+    doc["frameCounter"] = frame.frameCounter;
+    doc["timestamp"] = frame.timestamp;
+    doc["ta"] = frame.ta;
+    addPixelJson(doc["min"].to<JsonObject>(), frame, stats.minIndex);
+    addPixelJson(doc["max"].to<JsonObject>(), frame, stats.maxIndex);
+    doc["mean"] = stats.mean;
+    doc["stddev"] = stats.stddev;
+    JsonObject percentiles = doc["percentiles"].to<JsonObject>();
+    for (int i = 0; i < FRAME_PERCENTILE_COUNT; i++) {
+        char key[4];
+        snprintf(key, sizeof(key), "%u", FRAME_PERCENTILES[i]);
+        percentiles[key] = stats.percentiles[i];
+    }
+    JsonArray histogram = doc["histogram"].to<JsonArray>(); // equal bins from min to max temp
+    for (uint16_t count : stats.histogram) {
+        histogram.add(count);
+    }
+    String output;
+    serializeJson(doc, output);
+
+    return output;
+}
+
+// Encodes frame for clients in sync as subpage, delta or full frame and keeps sentFrame updated.
+// Subpage is only sent when subpage is set, delta frames only in compressed stream
+size_t getBinaryData(const CameraFrame &frame, bool subpage, FrameHeader *header, uint8_t *out, size_t outSize) {
+    *header = getFrameHeader(frame);
+    size_t len = 0;
+    if (subpage) {
+        len = encodeSubpage(header, frame.temperatures, frame.subPage, frame.pattern, out, outSize);
+#ifdef MLX90640_FIXED_POINT
+        const int16_t *scaled = frame.centi;
+#else
+        int16_t scaled[DATA_SIZE];
+        quantizeFrame(frame.temperatures, DATA_SIZE, FRAME_DEFAULT_SCALE, scaled);
+#endif
+        for (int i = 0; i < DATA_SIZE; i++) {
+            if (isSubpagePixel(i, GRID_WIDTH, frame.pattern, frame.subPage)) {
+                sentFrame[i] = scaled[i];
+            }
+        }
+        return len;
+    }
+    if (compression && framesSinceKeyframe < KEYFRAME_INTERVAL) {
+        // Delta is never allowed to grow over full frame size, full frame is sent then
+        len = encodeDeltaFrame(header, frame.temperatures, sentFrame, deadband, out, frameEncodedSize(DATA_SIZE));
+    }
+    if (len > 0) {
+        framesSinceKeyframe++;
+        return len;
+    }
+    header->type = FRAME_TYPE_FULL;
+#ifdef MLX90640_FIXED_POINT
+    memcpy(sentFrame, frame.centi, sizeof(sentFrame));
+    len = encodeQuantizedFrame(header, sentFrame, out, outSize);
+#else
+    len = encodeFrame(header, frame.temperatures, out, outSize);
+    quantizeFrame(frame.temperatures, DATA_SIZE, FRAME_DEFAULT_SCALE, sentFrame);
+#endif
+    framesSinceKeyframe = 0;
+    streamStats.keyframes++;
+    return len;
+}
+
+// Encodes sentFrame as full frame, brings client which missed stream messages in sync
+size_t getKeyframeData(const CameraFrame &frame, uint8_t *out, size_t outSize) {
+    FrameHeader header = getFrameHeader(frame);
+    return encodeQuantizedFrame(&header, sentFrame, out, outSize);
+}
+
+String getModeJson() {
+    JsonDocument doc;
+    doc["rate"] = frameRate;
+    doc["requestedRate"] = requestedFrameRate;
+    doc["budgetRate"] = budgetFrameRate;
+    doc["subpages"] = subpageStreaming;
+    doc["compression"] = compression;
+    doc["deadband"] = deadband;
+    doc["filter"] = filterMode == FILTER_MODE_ADAPTIVE ? "adaptive" : filterMode == FILTER_MODE_EMA ? "ema" : "off";
+    doc["alpha"] = temporalFilter.alpha;
+    doc["threshold"] = filterThreshold;
+    doc["compressionRatio"] = streamStats.encodedBytes ? (float)streamStats.rawBytes / streamStats.encodedBytes : 1.0f;
+    doc["i2cClock"] = frameRate > DEFAULT_FRAME_RATE ? I2C_CLOCK_HIGH_RATE : I2C_CLOCK;
+    JsonArray badPixels = doc["badPixels"].to<JsonArray>();
+    for (int i = 0; i < mlx90640BadPixels.count; i++) {
+        badPixels.add(mlx90640BadPixels.pixels[i].pixel);
+    }
+    JsonObject timings = doc["timings"].to<JsonObject>();
+    timings["budget"] = 1000000 / frameRate;
+    timings["interval"] = stageTimings.interval;
+    timings["read"] = stageTimings.read;
+    timings["calculation"] = stageTimings.calculation;
+    timings["filter"] = stageTimings.filter;
+    timings["stats"] = stageTimings.stats;
+    timings["record"] = stageTimings.record;
+    timings["capture"] = stageTimings.capture;
+    timings["encode"] = stageTimings.encode;
+    timings["send"] = stageTimings.send;
+    timings["render"] = imageRenderTime;
+    timings["png"] = pngEncodeTime;
+    timings["mjpeg"] = mjpegEncodeTime;
+    JsonObject startup = doc["startup"].to<JsonObject>();
+    startup["calibration"] = calibrationCached ? "cached" : "extracted";
+    startup["calibrationTime"] = calibrationTime;
+    startup["firstFrame"] = firstFrameTime;
+    JsonObject heap = doc["heap"].to<JsonObject>();
+    heap["free"] = ESP.getFreeHeap();
+    heap["minFree"] = ESP.getMinFreeHeap();
+    heap["maxAlloc"] = ESP.getMaxAllocHeap();
+    heap["poolMisses"] = framePool.misses;
+    String output;
+    serializeJson(doc, output);
+
+    return output;
+}
+
+String getRecordingJson() {
+    JsonDocument doc;
+    doc["recording"] = recordingRequested;
+    doc["file"] = recordingStats.file;
+    doc["frames"] = recordingStats.frames;
+    doc["dropped"] = recordingStats.dropped;
+    doc["chunks"] = recordingStats.chunks;
+    doc["bytesPerFrame"] = recordingStats.frames ? recordingStats.chunks * RECORDING_CHUNK_SIZE / recordingStats.frames : 0;
+    doc["writeTime"] = recordingStats.writeTime;
+    doc["maxWriteTime"] = recordingStats.maxWriteTime;
+    if (recordingStats.error) {
+        doc["error"] = recordingStats.error;
+    }
+    if (filesystemMounted) {
+        doc["total"] = LittleFS.totalBytes();
+        doc["used"] = LittleFS.usedBytes();
+        JsonArray files = doc["files"].to<JsonArray>();
+        File directory = LittleFS.open(RECORDING_DIR);
+        for (File entry = directory.openNextFile(); entry; entry = directory.openNextFile()) {
+            JsonObject file = files.add<JsonObject>();
+            file["name"] = entry.name();
+            file["size"] = entry.size();
+        }
+    }
+    String output;
+    serializeJson(doc, output);
+
+    return output;
+}
+
+String getCaptureJson() {
+    static const char *const states[] = {"off", "armed", "triggered", "frozen"};
+    JsonDocument doc;
+    doc["state"] = states[captureRing.state];
+    doc["capacity"] = captureRing.capacity;
+    doc["memory"] = capturePsram ? "psram" : "heap";
+    doc["pre"] = capturePre;
+    doc["post"] = capturePost;
+    doc["preFrames"] = captureRing.preFrames;
+    doc["postFrames"] = captureRing.postFrames;
+    doc["stored"] = captureRing.stored;
+    if (!isnan(captureThreshold)) {
+        doc["threshold"] = captureThreshold;
+    }
+    if (captureRing.state == CAPTURE_FROZEN) {
+        doc["triggerFrame"] = captureRing.triggerFrame;
+        doc["triggerIndex"] = captureRing.triggerIndex;
+        doc["frames"] = captureRing.count;
+        doc["size"] = captureSize(&captureRing);
+    }
+    String output;
+    serializeJson(doc, output);
+
+    return output;
+}
+
+// Recording file being downloaded, closed when response is done
+struct DownloadFile {
+    File file;
+};
+
+bool readDownloadFile(void *context, uint32_t offset, uint8_t *out, size_t size) {
+    File &file = ((DownloadFile *)context)->file;
+    return (file.position() == offset || file.seek(offset)) && file.read(out, size) == size;
+}
+
+bool readCaptureBytes(void *context, uint32_t offset, uint8_t *out, size_t size) {
+    return readCapture(&captureRing, offset, out, size) == size;
+}
+
+// Streams resource of given size honoring Range header, so downloads can be resumed and players can seek.
+// Bytes are read straight into TCP send buffer block by block, memory use doesn't depend on resource size.
+// Context is kept alive until response is done
+AsyncWebServerResponse *beginRangeResponse(AsyncWebServerRequest *request, size_t size, RecordingReadFunction read, std::shared_ptr<void> context) {
+    ByteRange range;
+    const AsyncWebHeader *header = request->getHeader("Range");
+    int result = parseByteRange(header ? header->value().c_str() : NULL, size, &range);
+    char contentRange[48];
+    formatContentRange(result, &range, size, contentRange, sizeof(contentRange));
+
+    AsyncWebServerResponse *response;
+    if (result == RANGE_UNSATISFIABLE) {
+        response = request->beginResponse(416, "text/plain", "Range not satisfiable");
+    } else {
+        response = request->beginResponse("application/octet-stream", range.length, [read, context, range](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return readRangeBlock(read, context.get(), &range, index, buffer, maxLen < DOWNLOAD_BLOCK_SIZE ? maxLen : DOWNLOAD_BLOCK_SIZE);
+        });
+        if (result == RANGE_PARTIAL) {
+            response->setCode(206);
+        }
+    }
+    if (result != RANGE_NONE) {
+        response->addHeader("Content-Range", contentRange);
+    }
+    response->addHeader("Accept-Ranges", "bytes");
+    return response;
+}
+
+// Parses scale and palette of rendered image into defaults given. Sends 400 and returns false if invalid
+bool getImageOptions(AsyncWebServerRequest *request, int *scale, int *palette) {
+    if (request->hasParam("scale")) {
+        *scale = request->getParam("scale")->value().toInt();
+        if (*scale < 1 || *scale > MAX_IMAGE_SCALE) {
+            request->send(400, "text/plain", "Scale must be 1 - 10");
+            return false;
+        }
+    }
+    if (request->hasParam("palette")) {
+        *palette = findPalette(request->getParam("palette")->value().c_str());
+        if (*palette < 0) {
+            request->send(400, "text/plain", "Supported palettes: rainbow, whitehot, nightvision, iron");
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parameter of state changing POST request, from form body or query string. NULL if not given
+const AsyncWebParameter *getStateParam(AsyncWebServerRequest *request, const char *name) {
+    if (request->hasParam(name, true)) {
+        return request->getParam(name, true);
+    }
+    return request->getParam(name);
+}
+
+// GET of endpoint changing state only reports it, so links, prefetching and crawlers can't change it.
+// Sends 405 and returns true if GET has parameters
+bool refuseStateChange(AsyncWebServerRequest *request) {
+    if (request->params() == 0) {
+        return false;
+    }
+    AsyncWebServerResponse *response = request->beginResponse(405, "text/plain", "Use POST to change state");
+    response->addHeader("Allow", "GET, POST");
+    request->send(response);
+    return true;
+}
+
+// Encodes frame for MJPEG consumers, once for all of them
+void encodeStreamFrame(const CameraFrame &frame) {
+    if (streamPool == NULL) {
+        // First consumer, buffers are freed by loop after the last one leaves
+        if (ESP.getFreeHeap() < STREAM_BUFFERS * STREAM_BUFFER_SIZE || ESP.getMaxAllocHeap() < STREAM_BUFFER_SIZE) {
+            mjpegStats.noMemory++;
+            return;
+        }
+        streamPool = new StreamPool();
+    }
+    if (streamPool->inUse() == STREAM_BUFFERS) {
+        mjpegStats.busy++;
+        return;
+    }
+    StreamPool::Buffer buffer = streamPool->acquire();
+    uint32_t start = micros();
+    if (jpegEncoder.quality != streamQuality) {
+        initJpegEncoder(&jpegEncoder, streamQuality);
+    }
+    initImageRender(&streamRender, frame.temperatures, GRID_WIDTH, GRID_HEIGHT, streamScale, IMAGE_FORMAT_INDEXED, streamPalette);
+    size_t size = encodeJpeg(&jpegEncoder, &streamRender, buffer->data(), buffer->size());
+    uint32_t elapsed = micros() - start;
+    mjpegEncodeTime = elapsed;
+    if (size == 0) {
+        mjpegStats.oversized++;
+        return;
+    }
+    buffer->resize(size);
+
+    // Buffer replaced here is still held by pool, so nothing is freed within critical section
+    portENTER_CRITICAL(&streamMux);
+    streamFrame = buffer;
+    streamSequence++;
+    portEXIT_CRITICAL(&streamMux);
+    mjpegStats.frames++;
+    mjpegStats.bytes += size;
+    mjpegStats.encodeTime += elapsed;
+}
+
+// Response filler of MJPEG consumer: part of the newest frame, then waits for next one
+size_t fillStreamPart(StreamConsumer *consumer, uint8_t *buffer, size_t maxLen) {
+    size_t partSize = consumer->frame ? consumer->headerLength + consumer->frame->size() + 2 : 0;
+    if (consumer->sent == partSize) {
+        bool fresh = false;
+        portENTER_CRITICAL(&streamMux);
+        if (streamFrame && streamSequence != consumer->sequence) {
+            consumer->frame = streamFrame;
+            consumer->sequence = streamSequence;
+            fresh = true;
+        }
+        portEXIT_CRITICAL(&streamMux);
+        if (!fresh) {
+            return RESPONSE_TRY_AGAIN;
+        }
+        consumer->headerLength = snprintf(consumer->header, sizeof(consumer->header),
+            "--" STREAM_BOUNDARY "\r\nContent-Type: image/jpeg\r\nContent-Length: %u\r\n\r\n", (unsigned)consumer->frame->size());
+        consumer->sent = 0;
+        partSize = consumer->headerLength + consumer->frame->size() + 2;
+    }
+
+    size_t frameEnd = consumer->headerLength + consumer->frame->size();
+    size_t written = 0;
+    while (written < maxLen && consumer->sent < partSize) {
+        const uint8_t *source;
+        size_t available;
+        if (consumer->sent < consumer->headerLength) {
+            source = (const uint8_t *)consumer->header + consumer->sent;
+            available = consumer->headerLength - consumer->sent;
+        } else if (consumer->sent < frameEnd) {
+            source = consumer->frame->data() + consumer->sent - consumer->headerLength;
+            available = frameEnd - consumer->sent;
+        } else {
+            source = (const uint8_t *)"\r\n" + consumer->sent - frameEnd;
+            available = partSize - consumer->sent;
+        }
+        size_t length = available < maxLen - written ? available : maxLen - written;
+        memcpy(buffer + written, source, length);
+        written += length;
+        consumer->sent += length;
+    }
+    return written;
+}
+
+String getClientsJson() {
+    ClientState states[MAX_WS_CLIENTS];
+    portENTER_CRITICAL(&clientsMux);
+    memcpy(states, clients, sizeof(states));
+    portEXIT_CRITICAL(&clientsMux);
+
+    JsonDocument doc;
+    doc["maxClients"] = MAX_WS_CLIENTS;
+    JsonArray array = doc["clients"].to<JsonArray>();
+    for (const ClientState &state : states) {
+        if (state.id == 0) {
+            continue;
+        }
+        JsonObject client = array.add<JsonObject>();
+        client["id"] = state.id;
+        client["fps"] = state.fps;
+        client["interval"] = state.interval;
+        client["ackLatency"] = state.ackLatency;
+        client["sent"] = state.sent;
+        client["dropped"] = state.dropped;
+        client["paced"] = state.paced;
+    }
+    String output;
+    serializeJson(doc, output);
+
+    return output;
+}
+
+// Effective frame rate of each client over last elapsed ms
+void updateClientRates(uint32_t elapsed) {
+    portENTER_CRITICAL(&clientsMux);
+    for (ClientState &state : clients) {
+        state.fps = state.windowSent * 1000.0f / elapsed;
+        state.windowSent = 0;
+    }
+    portEXIT_CRITICAL(&clientsMux);
+}
+
+AsyncWebSocketSharedBuffer makeFrameBuffer() {
+    return framePool.acquire();
+}
+
+// Fans frame out to all clients, it's encoded once for clients in sync and at most once more as keyframe
+// for clients that joined or skipped a frame (see client_fanout.h)
+void sendDataToWsClients(const CameraFrame &frame, bool subpage) {
+    uint32_t start = micros();
+    FrameHeader header;
+    AsyncWebSocketSharedBuffer stream = makeFrameBuffer();
+    size_t len = getBinaryData(frame, subpage, &header, stream->data(), stream->size());
+    stream->resize(len);
+    AsyncWebSocketSharedBuffer keyframe = header.type == FRAME_TYPE_FULL ? stream : nullptr;
+    uint32_t encoded = micros();
+    uint32_t keyframeTime = 0;
+    uint32_t now = millis();
+
+    xSemaphoreTakeRecursive(clientsLock, portMAX_DELAY);
+    ClientState states[MAX_WS_CLIENTS];
+    portENTER_CRITICAL(&clientsMux);
+    memcpy(states, clients, sizeof(states));
+    portEXIT_CRITICAL(&clientsMux);
+
+    FanOutStats fanOut = {};
+    fanOutFrame(states, MAX_WS_CLIENTS, stream, keyframe, now, [&]() {
+        uint32_t keyframeStart = micros();
+        AsyncWebSocketSharedBuffer buffer = makeFrameBuffer();
+        buffer->resize(getKeyframeData(frame, buffer->data(), buffer->size()));
+        keyframeTime += micros() - keyframeStart;
+        return buffer;
+    }, fanOut);
+    streamStats.dropped += fanOut.dropped;
+    streamStats.paced += fanOut.paced;
+
+    // Client could disconnect and other one take its slot meanwhile, only same client is updated
+    portENTER_CRITICAL(&clientsMux);
+    for (int i = 0; i < MAX_WS_CLIENTS; i++) {
+        if (clients[i].id == states[i].id) {
+            clients[i] = states[i];
+        }
+    }
+    portEXIT_CRITICAL(&clientsMux);
+    xSemaphoreGiveRecursive(clientsLock);
+
+    stageTimings.encode = encoded - start + keyframeTime;
+    streamStats.frames++;
+    streamStats.rawBytes += frameEncodedSize(DATA_SIZE);
+    streamStats.encodedBytes += len;
+    streamStats.encodeTime += stageTimings.encode;
+    stageTimings.send = micros() - encoded - keyframeTime;
 }
 
 boolean isConnected()
@@ -98,13 +1218,49 @@ boolean isConnected()
   return (true);
 }
 
+// Loads params extracted at previous boot if they belong to sensor with given key,
+// status is set to extraction result of that boot
+bool loadCachedCalibration(uint32_t key, paramsMLX90640 *params, int *status) {
+    if (!calibrationStore.begin(CALIBRATION_NAMESPACE, true)) {
+        return false; // nothing stored yet
+    }
+    CalibrationMeta meta;
+    bool loaded = calibrationStore.getBytes("meta", &meta, sizeof(meta)) == sizeof(meta) && meta.key == key
+        && calibrationStore.getBytes("params", params, sizeof(paramsMLX90640)) == sizeof(paramsMLX90640)
+        && isCalibrationValid(&meta, key, params);
+    calibrationStore.end();
+    if (loaded) {
+        *status = meta.status;
+    }
+    return loaded;
+}
+
+// Persists params for next boots. Old record is removed first, NVS partition doesn't fit two
+// of them, and meta is written last, so interrupted write leaves no valid record behind
+void storeCachedCalibration(uint32_t key, const paramsMLX90640 *params, int status) {
+    CalibrationMeta meta;
+    makeCalibrationMeta(key, params, status, &meta);
+    if (!calibrationStore.begin(CALIBRATION_NAMESPACE, false)) {
+        Serial.println("Failed to open calibration store");
+        return;
+    }
+    calibrationStore.remove("meta");
+    calibrationStore.remove("params");
+    if (calibrationStore.putBytes("params", params, sizeof(paramsMLX90640)) != sizeof(paramsMLX90640)
+        || calibrationStore.putBytes("meta", &meta, sizeof(meta)) != sizeof(meta)) {
+        Serial.println("Failed to store calibration");
+    }
+    calibrationStore.end();
+}
+
 void setup() {
     Serial.begin(115200);
 
     // Setup MLX90640 thermal camera sensor with deafault I2C pins
     Serial.println("Setting up MLX90640 thermal sensor...");
+    MLX90640_I2CInit(); // enlarges Wire buffer, so it must go before Wire.begin()
     Wire.begin();
-    Wire.setClock(400000);
+    Wire.setClock(I2C_CLOCK);
     if (isConnected() == false) {
         Serial.println("MLX90640 not detected at default I2C address. Please check wiring. Freezing.");
         while (1);
@@ -112,16 +1268,61 @@ void setup() {
 
     int status;
     uint16_t eeMLX90640[832];
-    status = MLX90640_DumpEE(MLX90640_address, eeMLX90640);
-    if (status != 0)
-        Serial.println("Failed to load system parameters");
+    uint32_t calibrationStart = micros();
+    uint16_t eeHeader[CALIBRATION_KEY_WORDS];
+    status = MLX90640_I2CRead(MLX90640_address, CALIBRATION_KEY_ADDRESS, CALIBRATION_KEY_WORDS, eeHeader);
+    sensorKey = calibrationKey(eeHeader);
+    calibrationCached = status == 0 && loadCachedCalibration(sensorKey, &mlx90640, &status);
+    if (!calibrationCached) {
+        status = MLX90640_DumpEE(MLX90640_address, eeMLX90640);
+        if (status != 0)
+            Serial.println("Failed to load system parameters");
 
-    status = MLX90640_ExtractParameters(eeMLX90640, &mlx90640);
+        int dumpStatus = status;
+        status = MLX90640_ExtractParameters(eeMLX90640, &mlx90640);
+        calibrationTime = micros() - calibrationStart;
+        if (dumpStatus == 0 && status != -7) {
+            storeCachedCalibration(sensorKey, &mlx90640, status);
+        }
+    } else {
+        calibrationTime = micros() - calibrationStart;
+    }
     if (status != 0)
         Serial.println("Parameter extraction failed");
+    Serial.printf("Calibration %s in %u us\n", calibrationCached ? "loaded from NVS" : "extracted from EEPROM", calibrationTime);
+    MLX90640_PrepareCalibration(&mlx90640, &mlx90640Prepared);
+    MLX90640_PrepareBadPixels(&mlx90640, &mlx90640BadPixels);
+    for (int i = 0; i < mlx90640BadPixels.count; i++) {
+        const badPixelMLX90640 &bad = mlx90640BadPixels.pixels[i];
+        Serial.printf("Correcting %s pixel %u (row %u, column %u)\n", i < mlx90640BadPixels.broken ? "broken" : "outlier", bad.pixel, bad.pixel / GRID_WIDTH, bad.pixel % GRID_WIDTH);
+    }
+    initPalettes();
+#ifdef MLX90640_FIXED_POINT
+    MLX90640_PrepareFixed(&mlx90640, &mlx90640Prepared, &mlx90640Fixed);
+#endif
+
+    applyFrameRate(DEFAULT_FRAME_RATE);
+
+    filesystemMounted = LittleFS.begin(true);
+    if (filesystemMounted) {
+        LittleFS.mkdir(RECORDING_DIR);
+    } else {
+        Serial.println("Failed to mount filesystem, recording is disabled");
+    }
+    clientsLock = xSemaphoreCreateRecursiveMutex();
+    recordingFree = xQueueCreate(RECORDING_CHUNKS, sizeof(int8_t)); // filled when recording starts
+    recordingFull = xQueueCreate(RECORDING_CHUNKS + 1, sizeof(RecordingMessage)); // chunks and stop without chunk
+    xTaskCreatePinnedToCore(recordingTask, "recording", RECORDING_TASK_STACK, NULL, RECORDING_TASK_PRIORITY, NULL, RECORDING_TASK_CORE);
+
+    capturePsram = psramFound();
+    size_t captureMemorySize = capturePsram ? CAPTURE_PSRAM_SIZE : CAPTURE_HEAP_FRAMES * CAPTURE_SLOT_SIZE;
+    uint8_t *captureMemory = (uint8_t *)(capturePsram ? ps_malloc(captureMemorySize) : malloc(captureMemorySize));
+    initCaptureRing(&captureRing, captureMemory, captureMemorySize);
+    captureArmRequested = captureRing.capacity > 0; // ring keeps last seconds from start
+    Serial.printf("Pre-trigger capture holds %u frames in %s\n", captureRing.capacity, capturePsram ? "PSRAM" : "heap");
 
-    MLX90640_SetRefreshRate(MLX90640_address, 0x04); // Set refresh rate to 4Hz
-    // Wire.setClock(1000000); // Increase I2C to 800kHz after EEPROM read, use for higher refresh rates only
+    loopTaskHandle = xTaskGetCurrentTaskHandle();
+    xTaskCreatePinnedToCore(acquisitionTask, "acquisition", ACQUISITION_TASK_STACK, NULL, ACQUISITION_TASK_PRIORITY, &acquisitionTaskHandle, ACQUISITION_TASK_CORE);
 
     // Setup ESP32 WiFi Access Point
     Serial.println("Setting up AP...");
@@ -135,7 +1336,290 @@ void setup() {
         request->send(200, "text/html", HTML_CONTENT);
     });
     server.on("/data", HTTP_GET, [](AsyncWebServerRequest *request){
-        request->send(200, "application/json", getJsonData());
+        if (frames.read(&httpFrame) == 0) {
+            request->send(503, "text/plain", "No frame available yet");
+            return;
+        }
+        request->send(200, "application/json", getJsonData(httpFrame));
+    });
+    server.on("/stats", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (frames.read(&httpFrame) == 0) {
+            request->send(503, "text/plain", "No frame available yet");
+            return;
+        }
+        request->send(200, "application/json", getStatsJson(httpFrame));
+    });
+    server.on("/mode", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!refuseStateChange(request)) {
+            request->send(200, "application/json", getModeJson());
+        }
+    });
+    server.on("/mode", HTTP_POST, [](AsyncWebServerRequest *request){
+        if (const AsyncWebParameter *rateParam = getStateParam(request, "rate")) {
+            int rate = rateParam->value().toInt();
+            if (!isValidFrameRate(rate)) {
+                request->send(400, "text/plain", "Supported frame rates: 1, 2, 4, 8, 16, 32");
+                return;
+            }
+            requestedFrameRate = rate;
+            budgetFrameRate = MAX_FRAME_RATE; // rate asked for explicitly gets a fresh try
+        }
+        if (const AsyncWebParameter *subpagesParam = getStateParam(request, "subpages")) {
+            subpageStreaming = subpagesParam->value().toInt() != 0;
+        }
+        if (const AsyncWebParameter *compressionParam = getStateParam(request, "compression")) {
+            compression = compressionParam->value().toInt() != 0;
+        }
+        if (const AsyncWebParameter *deadbandParam = getStateParam(request, "deadband")) {
+            int value = deadbandParam->value().toInt();
+            if (value < 0 || value > MAX_DEADBAND) {
+                request->send(400, "text/plain", "Deadband must be 0 - 100 centi-degrees");
+                return;
+            }
+            deadband = value;
+        }
+        if (const AsyncWebParameter *filterParam = getStateParam(request, "filter")) {
+            const String &value = filterParam->value();
+            if (value == "off") {
+                filterMode = FILTER_MODE_OFF;
+            } else if (value == "ema") {
+                filterMode = FILTER_MODE_EMA;
+            } else if (value == "adaptive") {
+                filterMode = FILTER_MODE_ADAPTIVE;
+            } else {
+                request->send(400, "text/plain", "Supported filters: off, ema, adaptive");
+                return;
+            }
+        }
+        if (const AsyncWebParameter *alphaParam = getStateParam(request, "alpha")) {
+            float value = alphaParam->value().toFloat();
+            if (value < 0 || value > 1) {
+                request->send(400, "text/plain", "Alpha must be 0 - 1, 0 adapts it to frame rate");
+                return;
+            }
+            filterAlpha = value;
+        }
+        if (const AsyncWebParameter *thresholdParam = getStateParam(request, "threshold")) {
+            float value = thresholdParam->value().toFloat();
+            if (value <= 0 || value > MAX_FILTER_THRESHOLD) {
+                request->send(400, "text/plain", "Threshold must be above 0 and up to 20 degC");
+                return;
+            }
+            filterThreshold = value;
+        }
+        request->send(200, "application/json", getModeJson());
+    });
+    server.on("/image", HTTP_GET, [](AsyncWebServerRequest *request){
+        int scale = DEFAULT_IMAGE_SCALE;
+        int format = IMAGE_FORMAT_INDEXED;
+        int palette = PALETTE_RAINBOW;
+        if (!getImageOptions(request, &scale, &palette)) {
+            return;
+        }
+        if (request->hasParam("format")) {
+            const String &value = request->getParam("format")->value();
+            if (value == "rgb565") {
+                format = IMAGE_FORMAT_RGB565;
+            } else if (value != "indexed") {
+                request->send(400, "text/plain", "Supported formats: indexed, rgb565");
+                return;
+            }
+        }
+        if (frames.read(&httpFrame) == 0) {
+            request->send(503, "text/plain", "No frame available yet");
+            return;
+        }
+
+        // Image is rendered chunk by chunk as TCP window allows, only source frame is kept per request
+        std::shared_ptr<ImageRender> render = std::make_shared<ImageRender>();
+        initImageRender(render.get(), httpFrame.temperatures, GRID_WIDTH, GRID_HEIGHT, scale, format, palette);
+        size_t size = imageSize(render.get());
+        AsyncWebServerResponse *response = request->beginResponse("application/octet-stream", size, [render, size, elapsed = (uint32_t)0](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+            uint32_t start = micros();
+            size_t len = renderImage(render.get(), index, buffer, maxLen);
+            elapsed += micros() - start;
+            if (index + len >= size) {
+                imageRenderTime = elapsed;
+            }
+            return len;
+        });
+        response->addHeader("X-Image-Width", String(imageWidth(render.get())));
+        response->addHeader("X-Image-Height", String(imageHeight(render.get())));
+        response->addHeader("X-Frame-Counter", String(httpFrame.frameCounter));
+        response->addHeader("X-Min-Temp", String(render->minTemp, 2));
+        response->addHeader("X-Max-Temp", String(render->maxTemp, 2));
+        request->send(response);
+    });
+    server.on("/snapshot.png", HTTP_GET, [](AsyncWebServerRequest *request){
+        int scale = DEFAULT_IMAGE_SCALE;
+        int palette = PALETTE_RAINBOW;
+        if (!getImageOptions(request, &scale, &palette)) {
+            return;
+        }
+        if (frames.read(&httpFrame) == 0) {
+            request->send(503, "text/plain", "No frame available yet");
+            return;
+        }
+
+        // Compressed size isn't known up front, PNG is sent chunked as it's encoded
+        std::shared_ptr<PngSnapshot> snapshot = std::make_shared<PngSnapshot>();
+        initImageRender(&snapshot->render, httpFrame.temperatures, GRID_WIDTH, GRID_HEIGHT, scale, IMAGE_FORMAT_INDEXED, palette);
+        initPngEncoder(&snapshot->encoder, &snapshot->render);
+        AsyncWebServerResponse *response = request->beginChunkedResponse("image/png", [snapshot, elapsed = (uint32_t)0](uint8_t *buffer, size_t maxLen, size_t index) mutable -> size_t {
+            uint32_t start = micros();
+            size_t len = encodePng(&snapshot->encoder, buffer, maxLen);
+            elapsed += micros() - start;
+            if (len == 0) {
+                pngEncodeTime = elapsed;
+            }
+            return len;
+        });
+        response->addHeader("Cache-Control", "no-store");
+        response->addHeader("X-Frame-Counter", String(httpFrame.frameCounter));
+        response->addHeader("X-Min-Temp", String(snapshot->render.minTemp, 2));
+        response->addHeader("X-Max-Temp", String(snapshot->render.maxTemp, 2));
+        request->send(response);
+    });
+    server.on("/stream.mjpg", HTTP_GET, [](AsyncWebServerRequest *request){
+        // Options apply to the stream of all consumers, it's encoded once
+        int scale = streamScale;
+        int palette = streamPalette;
+        if (!getImageOptions(request, &scale, &palette)) {
+            return;
+        }
+        if (request->hasParam("quality")) {
+            int quality = request->getParam("quality")->value().toInt();
+            if (quality < 1 || quality > 100) {
+                request->send(400, "text/plain", "Quality must be 1 - 100");
+                return;
+            }
+            streamQuality = quality;
+        }
+        if (streamConsumers >= MAX_STREAM_CONSUMERS) {
+            request->send(503, "text/plain", "Too many stream consumers");
+            return;
+        }
+        streamScale = scale;
+        streamPalette = palette;
+
+        std::shared_ptr<StreamConsumer> consumer = std::make_shared<StreamConsumer>();
+        AsyncWebServerResponse *response = request->beginChunkedResponse("multipart/x-mixed-replace; boundary=" STREAM_BOUNDARY, [consumer](uint8_t *buffer, size_t maxLen, size_t index) -> size_t {
+            return fillStreamPart(consumer.get(), buffer, maxLen);
+        });
+        response->addHeader("Cache-Control", "no-store");
+        request->send(response);
+    });
+    server.on("/recording", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (!refuseStateChange(request)) {
+            request->send(200, "application/json", getRecordingJson());
+        }
+    });
+    server.on("/recording", HTTP_POST, [](AsyncWebServerRequest *request){
+        if (const AsyncWebParameter *recordParam = getStateParam(request, "record")) {
+            bool record = recordParam->value().toInt() != 0;
+            if (record && !filesystemMounted) {
+                request->send(503, "text/plain", "Filesystem is not mounted");
+                return;
+            }
+            if (record && !recordingRequested) {
+                recordingStats = {};
+            }
+            recordingRequested = record;
+        }
+        if (const AsyncWebParameter *deleteParam = getStateParam(request, "delete")) {
+            const String &name = deleteParam->value();
+            String path = String(RECORDING_DIR "/") + name;
+            if (name.indexOf('/') >= 0 || !filesystemMounted || !LittleFS.exists(path)) {
+                request->send(404, "text/plain", "No such recording");
+                return;
+            }
+            if (recordingRequested && path == recordingStats.file) {
+                request->send(409, "text/plain", "Recording is in progress");
+                return;
+            }
+            LittleFS.remove(path);
+        }
+        request->send(200, "application/json", getRecordingJson());
+    });
+    server.on("/capture", HTTP_GET, [](AsyncWebServerRequest *request){
+        if (refuseStateChange(request)) {
+            return;
+        }
+        if (captureRing.capacity == 0) {
+            request->send(503, "text/plain", "No memory for capture");
+            return;
+        }
+        request->send(200, "application/json", getCaptureJson());
+    });
+    server.on("/capture", HTTP_POST, [](AsyncWebServerRequest *request){
+        if (captureRing.capacity == 0) {
+            request->send(503, "text/plain", "No memory for capture");
+            return;
+        }
+        if (const AsyncWebParameter *preParam = getStateParam(request, "pre")) {
+            int value = preParam->value().toInt();
+            if (value < 1 || value > 3600) {
+                request->send(400, "text/plain", "Pre-trigger time must be 1 - 3600 s");
+                return;
+            }
+            capturePre = value;
+        }
+        if (const AsyncWebParameter *postParam = getStateParam(request, "post")) {
+            int value = postParam->value().toInt();
+            if (value < 0 || value > 3600) {
+                request->send(400, "text/plain", "Post-trigger time must be 0 - 3600 s");
+                return;
+            }
+            capturePost = value;
+        }
+        if (const AsyncWebParameter *thresholdParam = getStateParam(request, "threshold")) {
+            const String &value = thresholdParam->value();
+            captureThreshold = value == "off" ? NAN : value.toFloat();
+        }
+        if (getStateParam(request, "arm")) {
+            if (captureReaders > 0) {
+                request->send(409, "text/plain", "Capture is being downloaded");
+                return;
+            }
+            captureArmRequested = true;
+        }
+        if (getStateParam(request, "trigger")) {
+            captureTriggerRequested = true;
+        }
+        request->send(200, "application/json", getCaptureJson());
+    });
+    server.on("/capture.bin", HTTP_GET, [](AsyncWebServerRequest *request){
+        // Reader is registered before state is checked, so acquisition task can't arm ring in between
+        std::shared_ptr<CaptureReader> reader = std::make_shared<CaptureReader>();
+        if (captureRing.state != CAPTURE_FROZEN || captureArmRequested) {
+            request->send(409, "text/plain", "No capture frozen");
+            return;
+        }
+        AsyncWebServerResponse *response = beginRangeResponse(request, captureSize(&captureRing), readCaptureBytes, reader);
+        response->addHeader("Content-Disposition", String("attachment; filename=\"capture-") + captureRing.triggerFrame + ".bin\"");
+        response->addHeader("X-Frame-Count", String(captureRing.count));
+        response->addHeader("X-Trigger-Index", String(captureRing.triggerIndex));
+        response->addHeader("X-Trigger-Frame", String(captureRing.triggerFrame));
+        response->addHeader("X-Calibration-Key", String(sensorKey, HEX));
+        response->addHeader("X-Emissivity", String(EMISSIVITY, 2));
+        request->send(response);
+    });
+    server.on("/rec/*", HTTP_GET, [](AsyncWebServerRequest *request){
+        // Recording download, file is read block by block as TCP window allows
+        String name = request->url().substring(strlen(RECORDING_DIR "/"));
+        std::shared_ptr<DownloadFile> download = std::make_shared<DownloadFile>();
+        if (name.length() == 0 || name.indexOf('/') >= 0 || !filesystemMounted || !LittleFS.exists(request->url())
+            || !(download->file = LittleFS.open(request->url(), "r")) || download->file.isDirectory()) {
+            request->send(404, "text/plain", "No such recording");
+            return;
+        }
+        // Recording in progress grows by whole chunks, its download ends with the last chunk written so far
+        AsyncWebServerResponse *response = beginRangeResponse(request, download->file.size(), readDownloadFile, download);
+        response->addHeader("Content-Disposition", String("attachment; filename=\"") + name + "\"");
+        request->send(response);
+    });
+    server.on("/clients", HTTP_GET, [](AsyncWebServerRequest *request){
+        request->send(200, "application/json", getClientsJson());
     });
     server.begin();
     Serial.println("HTTP Server started.");
@@ -148,25 +1632,64 @@ void setup() {
     Serial.println(WIFI_PASS);
 }
 
-static uint32_t lastWS = 0;
-static uint32_t deltaWS = 200;
 static uint32_t lastHeap = 0;
+static uint32_t lastSequence = 0;
+static i2cStatsMLX90640 lastI2CStats = {};
+static uint32_t lastSubPages = 0;
 
 void loop() {
-    readCameraData();
+    // Wait until acquisition task publishes new frame, then stream it right away
+    ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
     uint32_t now = millis();
     
-    if (now - lastWS >= deltaWS) {
+    if (frames.sequence() != lastSequence) {
+        uint32_t previousSequence = lastSequence;
+        lastSequence = frames.read(&wsFrame);
         if (ws.count() > 0){
-            Serial.println("Sending new frames to ws clients");
-            sendDataToWsClients();
-            lastWS = millis();
+            // Subpage delta is enough only if clients got the previous frame, otherwise resend full frame
+            sendDataToWsClients(wsFrame, wsFrame.partial && lastSequence == previousSequence + 1);
+        }
+        if (streamConsumers > 0 && now - lastStreamEncode >= STREAM_INTERVAL) {
+            lastStreamEncode = now;
+            encodeStreamFrame(wsFrame);
         }
     }
+    if (streamConsumers == 0 && streamPool != NULL) {
+        // New consumer shouldn't get stale frame first. Buffer still held by leaving consumer is freed with its last reference
+        portENTER_CRITICAL(&streamMux);
+        streamFrame = NULL;
+        portEXIT_CRITICAL(&streamMux);
+        delete streamPool;
+        streamPool = NULL;
+    }
 
     if (now - lastHeap >= 2000) {
+        AcquisitionReport report = {};
+        acquisitionReports.read(&report);
+        const acquisitionStatsMLX90640 &stats = report.acquisition;
         Serial.printf("Connected ws clients: %u \n", ws.count());
-        ws.cleanupClients(2);
+        Serial.printf("Heap: free %u, min free %u, largest block %u, frame buffers in use %u, pool misses %u\n", ESP.getFreeHeap(), ESP.getMinFreeHeap(), ESP.getMaxAllocHeap(), framePool.inUse(), framePool.misses);
+        Serial.printf("Status polls per subpage: last %u, max %u, avg %.2f\n", stats.lastFramePolls, stats.maxFramePolls, stats.frames ? (float)stats.statusPolls / stats.frames : 0.0f);
+        Serial.printf("Temperature calculation: %u cycles per frame\n", calculationCycles);
+        const i2cStatsMLX90640 &i2cStats = report.i2c;
+        uint32_t fullFrames = (stats.frames - lastSubPages) / 2;
+        Serial.printf("I2C: %.1f transactions per frame, %u bytes/s, %u byte reads, %u errors\n", fullFrames ? (float)(i2cStats.transactions - lastI2CStats.transactions) / fullFrames : 0.0f, (i2cStats.bytesRead - lastI2CStats.bytesRead) * 1000 / (now - lastHeap), i2cStats.readLength, i2cStats.errors);
+        lastI2CStats = i2cStats;
+        lastSubPages = stats.frames;
+        if (streamStats.frames > 0) {
+            Serial.printf("Stream: %u frames, %u keyframes, compression ratio %.2f, encode %u us per frame, %u dropped for full client queues, %u paced\n", streamStats.frames, streamStats.keyframes, streamStats.encodedBytes ? (float)streamStats.rawBytes / streamStats.encodedBytes : 1.0f, streamStats.encodeTime / streamStats.frames, streamStats.dropped, streamStats.paced);
+            streamStats = {};
+        }
+        Serial.printf("Frame rate %u fps, stages [us]: read %u, calculation %u, filter %u, stats %u, record %u, capture %u, encode %u, send %u, interval %u\n", frameRate, stageTimings.read, stageTimings.calculation, stageTimings.filter, stageTimings.stats, stageTimings.record, stageTimings.capture, stageTimings.encode, stageTimings.send, stageTimings.interval);
+        if (mjpegStats.frames > 0 || mjpegStats.busy > 0 || mjpegStats.oversized > 0 || mjpegStats.noMemory > 0) {
+            Serial.printf("MJPEG: %u consumers, %u frames, %u bytes per frame, encode %u us per frame, %u skipped while buffers were sent, %u too large, %u without memory\n", (unsigned)streamConsumers, mjpegStats.frames, mjpegStats.frames ? mjpegStats.bytes / mjpegStats.frames : 0, mjpegStats.frames ? mjpegStats.encodeTime / mjpegStats.frames : 0, mjpegStats.busy, mjpegStats.oversized, mjpegStats.noMemory);
+            mjpegStats = {};
+        }
+        if (recordingRequested) {
+            Serial.printf("Recording %s: %u frames, %u dropped, %u chunks, write %u us (max %u us)\n", recordingStats.file, recordingStats.frames, recordingStats.dropped, recordingStats.chunks, recordingStats.writeTime, recordingStats.maxWriteTime);
+        }
+        updateClientRates(now - lastHeap);
+        ws.cleanupClients(MAX_WS_CLIENTS);
         lastHeap = now;
     }
 }
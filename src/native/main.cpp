@@ -0,0 +1,497 @@
+// Host benchmark of acquisition path, runs Melexis API against recorded sensor dumps,
+// or against synthetic sensor when none are given.
+//
+// Usage: program [<eeprom.bin> <frames.bin> | synthetic] [frames] [frame rate] [read latency us]
+// Bus and sensor timing is simulated (virtual clock), temperature calculation is timed on host.
+// Not part of unit test builds (pio test -e native), tests under test/ have their own main.
+#ifndef PIO_UNIT_TESTING
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <new>
+#include <vector>
+#include <math.h>
+#include "MLX90640_API.h"
+#include "MLX90640_I2C_Driver.h"
+#include "MLX90640_Prepared.h"
+#include "MLX90640_BadPixels.h"
+#include "MLX90640_Fixed.h"
+#include "MLX90640_Simulator.h"
+#include "MLX90640_Counting.h"
+#include "frame_protocol.h"
+#include "camera_frame.h"
+#include "buffer_pool.h"
+#include "thermal_image.h"
+#include "temporal_filter.h"
+#include "frame_stats.h"
+#include "calibration_cache.h"
+#include "recording.h"
+#include "capture_ring.h"
+#include "byte_range.h"
+#include "image_encoder.h"
+
+#define MLX90640_ADDRESS 0x33
+#define TA_SHIFT 8
+#define EMISSIVITY 0.92f
+#define RENDER_CHUNK 1436 // device renders /image into TCP segments
+#define NOISE_WARMUP 16 // frames filter needs to settle before noise is measured
+#define ENCODE_QUEUE 2 // encoded frames held as if queued for websocket client, same as device MAX_CLIENT_QUEUE
+#define RECORDING_CHUNKS 2 // same as device, chunk is filled while the other one is written
+#define CAPTURE_FRAMES 64 // pre-trigger ring, triggered in the middle of run
+#define DOWNLOAD_BLOCK_SIZE 4096 // same as device, largest read per response fill
+#define DOWNLOAD_RANGES 200 // random ranges fetched from recording
+#define STREAM_QUALITY 75 // same as device default of /stream.mjpg
+#define IMAGE_REPEATS 20 // encodes of last frame per image size
+#define SYNTHETIC_SUBPAGES 112 // one pass of synthetic scene, blob crosses frame and comes back
+
+static paramsMLX90640 params;
+static preparedMLX90640 prepared;
+static paramsMLX90640 cachedParams; // as if loaded from NVS at warm boot
+static badPixelsMLX90640 badPixels;
+static fixedMLX90640 fixedCalibration;
+static float temperatures[DATA_SIZE];
+static int16_t temperaturesCenti[DATA_SIZE];
+typedef BufferPool<ENCODE_QUEUE + 1, FRAME_HEADER_SIZE + DATA_SIZE * 2> EncodePool;
+static EncodePool encodePool;
+static EncodePool::Buffer queued[ENCODE_QUEUE];
+static TemporalFilter filter;
+static StatsWork statsWork;
+static FrameStats frameStats;
+static float filtered[DATA_SIZE]; // fast calculation output passed through adaptive filter
+static double noiseSum[2][DATA_SIZE]; // per pixel sum and sum of squares over frames, [unfiltered, filtered]
+static double noiseSquares[2][DATA_SIZE];
+static ImageRender render;
+static uint8_t renderChunk[RENDER_CHUNK];
+static PngEncoder pngEncoder;
+static JpegEncoder jpegEncoder;
+static uint8_t jpegBuffer[65536];
+static RecordingWriter recordingWriter;
+static uint8_t recordingChunks[RECORDING_CHUNKS][RECORDING_CHUNK_SIZE];
+static float playback[DATA_SIZE];
+static CaptureRing captureRing;
+static uint8_t captureMemory[CAPTURE_FRAMES * CAPTURE_SLOT_SIZE];
+static uint32_t allocations = 0; // counted by operator new below, encode path must not allocate per frame
+
+void *operator new(size_t size) {
+    allocations++;
+    void *pointer = malloc(size);
+    if (pointer == NULL) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+// Accumulated host time of one benchmarked stage
+struct StageTime {
+    const char *name;
+    double total; // us
+};
+
+template <typename F>
+static void measure(StageTime *stage, F function) {
+    auto start = std::chrono::steady_clock::now();
+    function();
+    stage->total += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Header of frame described by frameStats, as device fills it
+static FrameHeader statsHeader(uint32_t frameCounter, uint32_t timestamp) {
+    FrameHeader header = {};
+    header.version = FRAME_PROTOCOL_VERSION;
+    header.width = GRID_WIDTH;
+    header.height = GRID_HEIGHT;
+    header.frameCounter = frameCounter;
+    header.timestamp = timestamp;
+    header.minTemp = frameStats.minTemp;
+    header.maxTemp = frameStats.maxTemp;
+    header.minIndex = frameStats.minIndex;
+    header.maxIndex = frameStats.maxIndex;
+    header.mean = frameStats.mean;
+    header.stddev = frameStats.stddev;
+    for (int i = 0; i < FRAME_PERCENTILE_COUNT; i++) {
+        header.percentiles[i] = frameStats.percentiles[i];
+    }
+    return header;
+}
+
+// Finishes chunk being filled and writes it, the way device recording task does
+static void writeRecordingChunk(FILE *file, StageTime *stage) {
+    uint8_t *chunk = recordingWriter.chunk;
+    finishRecordingChunk(&recordingWriter);
+    measure(stage, [&]() { fwrite(chunk, RECORDING_CHUNK_SIZE, 1, file); });
+}
+
+static bool readRecording(void *context, uint32_t offset, uint8_t *out, size_t size) {
+    FILE *file = (FILE *)context;
+    return fseek(file, offset, SEEK_SET) == 0 && fread(out, size, 1, file) == 1;
+}
+
+int main(int argc, char **argv) {
+    // Without dumps simulated sensor makes up its calibration and a scene, see MLX90640_SimulatorSynthetic()
+    bool synthetic = argc < 2 || strcmp(argv[1], "synthetic") == 0;
+    if (!synthetic && argc < 3) {
+        fprintf(stderr, "Usage: %s [<eeprom.bin> <frames.bin> | synthetic] [frames] [frame rate] [read latency us]\n", argv[0]);
+        return 1;
+    }
+    int arg = synthetic ? 2 : 3;
+    int frameCount = argc > arg ? atoi(argv[arg]) : 100;
+    int frameRate = argc > arg + 1 ? atoi(argv[arg + 1]) : 4;
+    uint32_t readLatency = argc > arg + 2 ? atoi(argv[arg + 2]) : 0;
+
+    simulatorMLX90640 simulator;
+    int status = synthetic ? MLX90640_SimulatorSynthetic(&simulator, SYNTHETIC_SUBPAGES) : MLX90640_SimulatorLoad(&simulator, argv[1], argv[2]);
+    if (status != 0) {
+        fprintf(stderr, "Failed to %s: %d\n", synthetic ? "generate sensor data" : "load dumps", status);
+        return 1;
+    }
+    simulator.i2cClock = frameRate > 4 ? 1000000 : 400000; // same as device, see applyFrameRate()
+    i2cTransportMLX90640 simulatorTransport;
+    MLX90640_SimulatorTransport(&simulator, &simulatorTransport);
+    countingMLX90640 counting;
+    MLX90640_CountingInit(&counting, &simulatorTransport, readLatency, 0);
+    i2cTransportMLX90640 countingTransport;
+    MLX90640_CountingTransport(&counting, &countingTransport);
+    MLX90640_SetTransport(&countingTransport);
+
+    // Cold boot dumps whole EEPROM and extracts params, warm boot reads only EEPROM header
+    // and validates params cached at previous boot (see src/calibration_cache.h)
+    uint32_t i2cClock = simulator.i2cClock;
+    simulator.i2cClock = 400000; // device reads EEPROM at I2C_CLOCK
+    uint16_t eeData[MLX90640_EEPROM_WORDS];
+    StageTime startup[] = {{"cold", 0}, {"warm", 0}};
+    MLX90640_CountingReset(&counting);
+    status = MLX90640_DumpEE(MLX90640_ADDRESS, eeData);
+    uint32_t coldBus = counting.busTime;
+    measure(&startup[0], [&]() { status |= MLX90640_ExtractParameters(eeData, &params); });
+    if (status != 0) {
+        fprintf(stderr, "Parameter extraction failed\n");
+    }
+    CalibrationMeta meta;
+    makeCalibrationMeta(calibrationKey(eeData), &params, status, &meta);
+    cachedParams = params;
+    uint16_t eeHeader[CALIBRATION_KEY_WORDS];
+    MLX90640_CountingReset(&counting);
+    MLX90640_I2CRead(MLX90640_ADDRESS, CALIBRATION_KEY_ADDRESS, CALIBRATION_KEY_WORDS, eeHeader);
+    uint32_t warmBus = counting.busTime;
+    bool cacheValid = false;
+    measure(&startup[1], [&]() { cacheValid = isCalibrationValid(&meta, calibrationKey(eeHeader), &cachedParams); });
+    simulator.i2cClock = i2cClock;
+    MLX90640_PrepareCalibration(&params, &prepared);
+    MLX90640_PrepareBadPixels(&params, &badPixels);
+    MLX90640_PrepareFixed(&params, &prepared, &fixedCalibration);
+    initPalettes();
+    initTemporalFilter(&filter, FILTER_MODE_ADAPTIVE, filterAlphaForRate(frameRate, 4), 2.0f);
+
+    uint8_t refreshRate = 0x02;
+    for (int r = frameRate; r > 1; r >>= 1) {
+        refreshRate++;
+    }
+    if (MLX90640_SetRefreshRate(MLX90640_ADDRESS, refreshRate) != 0) {
+        fprintf(stderr, "Failed to set frame rate\n");
+        return 1;
+    }
+
+    StageTime stages[] = {{"reference", 0}, {"prepared", 0}, {"fast", 0}, {"fixed", 0}, {"encode", 0}, {"render", 0}, {"filter", 0}, {"badpixels", 0}, {"stats", 0}, {"record", 0}, {"write", 0}, {"capture", 0}};
+    MLX90640_CountingReset(&counting);
+    uint32_t start = MLX90640_Micros();
+    int errors = 0;
+    uint32_t encodeAllocations = 0;
+
+    // Recording goes to temporary file, every frame is kept quantized to check it after playback
+    FILE *recording = tmpfile();
+    if (recording == NULL) {
+        fprintf(stderr, "Failed to create recording file\n");
+        return 1;
+    }
+    std::vector<int16_t> recorded((size_t)frameCount * DATA_SIZE);
+    initRecordingWriter(&recordingWriter, meta.key, EMISSIVITY);
+    int recordingBuffer = 0;
+    uint32_t recordAllocations = 0;
+    initCaptureRing(&captureRing, captureMemory, sizeof(captureMemory));
+    armCapture(&captureRing, CAPTURE_FRAMES * 3 / 4, CAPTURE_FRAMES / 4);
+
+    for (int frame = 0; frame < frameCount; frame++) {
+        for (int subPage = 0; subPage < 2; subPage++) {
+            uint16_t frameData[MLX90640_FRAME_WORDS];
+            if (MLX90640_GetFrameDataScheduled(MLX90640_ADDRESS, frameData) < 0) {
+                errors++;
+                continue;
+            }
+            float tr = MLX90640_GetTa(frameData, &params) - TA_SHIFT;
+            measure(&stages[0], [&]() { MLX90640_CalculateTo(frameData, &params, EMISSIVITY, tr, temperatures); });
+            measure(&stages[1], [&]() { MLX90640_CalculateToPrepared(frameData, &params, &prepared, EMISSIVITY, tr, temperatures); });
+            measure(&stages[2], [&]() { MLX90640_CalculateToFast(frameData, &params, &prepared, EMISSIVITY, tr, temperatures); });
+            measure(&stages[3], [&]() { MLX90640_CalculateToFixed(frameData, &params, &fixedCalibration, EMISSIVITY, tr, temperaturesCenti); });
+            measure(&stages[7], [&]() { MLX90640_CorrectBadPixels(&badPixels, frameData[833], frameData[832] & 0x1000, temperatures); });
+
+            uint8_t pattern = (frameData[832] & 0x1000) ? FRAME_PATTERN_CHESS : FRAME_PATTERN_INTERLEAVED;
+            for (int i = 0; i < DATA_SIZE; i++) {
+                if (isSubpagePixel(i, GRID_WIDTH, pattern, frameData[833])) {
+                    filtered[i] = temperatures[i];
+                }
+            }
+            measure(&stages[6], [&]() { applyTemporalFilter(&filter, filtered, frameData[833], pattern); });
+        }
+        if (frame >= NOISE_WARMUP) {
+            for (int i = 0; i < DATA_SIZE; i++) {
+                noiseSum[0][i] += temperatures[i];
+                noiseSquares[0][i] += (double)temperatures[i] * temperatures[i];
+                noiseSum[1][i] += filtered[i];
+                noiseSquares[1][i] += (double)filtered[i] * filtered[i];
+            }
+        }
+        measure(&stages[8], [&]() { computeFrameStats(&statsWork, temperatures, DATA_SIZE, &frameStats); });
+        uint32_t allocationsBefore = allocations;
+        measure(&stages[4], [&]() {
+            FrameHeader header = statsHeader(frame, 0);
+            EncodePool::Buffer buffer = encodePool.acquire();
+            buffer->resize(encodeFrame(&header, temperatures, buffer->data(), buffer->size()));
+            queued[frame % ENCODE_QUEUE] = buffer;
+        });
+        encodeAllocations += allocations - allocationsBefore;
+        allocationsBefore = allocations;
+        FrameHeader recordHeader = statsHeader(frame, MLX90640_Micros() / 1000);
+        bool appended = false;
+        measure(&stages[9], [&]() { appended = recordingWriter.chunk != NULL && appendRecordingFrame(&recordingWriter, &recordHeader, temperatures); });
+        if (!appended) {
+            if (recordingWriter.chunk != NULL) {
+                writeRecordingChunk(recording, &stages[10]);
+                recordingBuffer ^= 1;
+            }
+            measure(&stages[9], [&]() {
+                beginRecordingChunk(&recordingWriter, recordingChunks[recordingBuffer]);
+                appendRecordingFrame(&recordingWriter, &recordHeader, temperatures);
+            });
+        }
+        if (frame == frameCount / 2) {
+            triggerCapture(&captureRing);
+        }
+        measure(&stages[11], [&]() { captureFrame(&captureRing, &recordHeader, temperatures); });
+        recordAllocations += allocations - allocationsBefore;
+        quantizeFrame(temperatures, DATA_SIZE, FRAME_DEFAULT_SCALE, &recorded[(size_t)frame * DATA_SIZE]);
+        measure(&stages[5], [&]() {
+            initImageRender(&render, temperatures, GRID_WIDTH, GRID_HEIGHT, 10, IMAGE_FORMAT_RGB565, PALETTE_IRON);
+            size_t offset = 0;
+            size_t length;
+            while ((length = renderImage(&render, offset, renderChunk, sizeof(renderChunk))) > 0) {
+                offset += length;
+            }
+        });
+    }
+
+    uint32_t elapsed = MLX90640_Micros() - start;
+    acquisitionStatsMLX90640 stats;
+    MLX90640_GetAcquisitionStats(&stats);
+
+    if (recordingWriter.chunk != NULL) {
+        writeRecordingChunk(recording, &stages[10]);
+    }
+    fflush(recording);
+    uint32_t recordingSize = ftell(recording);
+    uint32_t chunkCount = recordingSize / RECORDING_CHUNK_SIZE;
+
+    // Playback decodes chunks in order, every frame has to match recorded one exactly
+    StageTime playbackTime = {"playback", 0};
+    std::vector<uint32_t> timestamps(frameCount);
+    int played = 0;
+    int mismatches = 0;
+    uint8_t *chunk = recordingChunks[0];
+    for (uint32_t n = 0; n < chunkCount; n++) {
+        RecordingChunkInfo info;
+        if (!readRecording(recording, n * RECORDING_CHUNK_SIZE, chunk, RECORDING_CHUNK_SIZE) || !readRecordingChunk(chunk, &info)) {
+            mismatches++;
+            continue;
+        }
+        for (uint16_t i = 0; i < info.frameCount; i++) {
+            const uint8_t *data;
+            size_t size;
+            FrameHeader header;
+            int decoded = -1;
+            measure(&playbackTime, [&]() {
+                if (recordingFrameRecord(chunk, &info, i, &data, &size)) {
+                    decoded = decodeFrame(data, size, &header, playback, DATA_SIZE);
+                }
+            });
+            if (decoded != DATA_SIZE || header.frameCounter >= (uint32_t)frameCount) {
+                mismatches++;
+                continue;
+            }
+            const int16_t *expected = &recorded[(size_t)header.frameCounter * DATA_SIZE];
+            for (int k = 0; k < DATA_SIZE; k++) {
+                if (lroundf(playback[k] * header.scale) != expected[k]) {
+                    mismatches++;
+                    break;
+                }
+            }
+            timestamps[header.frameCounter] = header.timestamp;
+            played++;
+        }
+    }
+
+    // Seeks to every second of recording, only chunk headers on the way and one chunk are read
+    StageTime seekTime = {"seek", 0};
+    int seeks = 0;
+    int seekErrors = 0;
+    for (uint32_t target = timestamps[0]; played > 0 && target <= timestamps[frameCount - 1]; target += 1000) {
+        FrameHeader header;
+        int decoded = -1;
+        measure(&seekTime, [&]() {
+            RecordingChunkInfo info;
+            int32_t n = findRecordingChunk(readRecording, recording, recordingSize, target);
+            if (n >= 0 && readRecording(recording, n * RECORDING_CHUNK_SIZE, chunk, RECORDING_CHUNK_SIZE) && readRecordingChunk(chunk, &info)) {
+                decoded = decodeRecordingFrames(chunk, &info, target, &header, playback, DATA_SIZE);
+            }
+        });
+        seeks++;
+        // Has to land on the last frame taken at or before target, with its pixels
+        uint32_t frame = header.frameCounter;
+        if (decoded < 0 || frame >= (uint32_t)frameCount || timestamps[frame] > target
+            || (frame + 1 < (uint32_t)frameCount && timestamps[frame + 1] <= target)
+            || lroundf(playback[DATA_SIZE / 2] * header.scale) != recorded[(size_t)frame * DATA_SIZE + DATA_SIZE / 2]) {
+            seekErrors++;
+        }
+    }
+
+    // Downloads of recording served as device /rec/ does: Range header parsed and range read in blocks
+    // of random TCP window sizes. Fixed cases, random ranges and an interrupted download resumed, header
+    // edge cases are in test/test_byte_range
+    StageTime downloadTime = {"download", 0};
+    std::vector<uint8_t> file(recordingSize);
+    std::vector<uint8_t> fetched;
+    size_t downloaded = 0;
+    int downloads = 0;
+    int downloadErrors = recordingSize > 0 && readRecording(recording, 0, file.data(), recordingSize) ? 0 : 1;
+    auto download = [&](const char *header, int expected, size_t start, size_t length, const char *contentRange) {
+        ByteRange range;
+        char value[48];
+        int result = parseByteRange(header, recordingSize, &range);
+        formatContentRange(result, &range, recordingSize, value, sizeof(value));
+        fetched.clear();
+        measure(&downloadTime, [&]() {
+            uint8_t block[DOWNLOAD_BLOCK_SIZE];
+            size_t index = 0;
+            for (size_t len; result != RANGE_UNSATISFIABLE && (len = readRangeBlock(readRecording, recording, &range, index, block, 1 + rand() % DOWNLOAD_BLOCK_SIZE)) > 0; index += len) {
+                fetched.insert(fetched.end(), block, block + len);
+            }
+        });
+        downloads++;
+        downloaded += fetched.size();
+        if (result != expected || (result != RANGE_UNSATISFIABLE && (range.start != start || range.length != length
+            || fetched.size() != length || memcmp(fetched.data(), file.data() + start, length) != 0))
+            || (contentRange && strcmp(value, contentRange) != 0)) {
+            fprintf(stderr, "download of \"%s\": result %d, range %u+%u, %u bytes, Content-Range \"%s\"\n", header ? header : "(none)",
+                result, (unsigned)range.start, (unsigned)range.length, (unsigned)fetched.size(), value);
+            downloadErrors++;
+        }
+    };
+    if (chunkCount > 1) {
+        char header[48];
+        char contentRange[48];
+        download(NULL, RANGE_NONE, 0, recordingSize, NULL);
+        download("bytes=0-99", RANGE_PARTIAL, 0, 100, NULL);
+        snprintf(header, sizeof(header), "bytes=%u-%u", RECORDING_CHUNK_SIZE - 4, RECORDING_CHUNK_SIZE + 5); // across chunks
+        snprintf(contentRange, sizeof(contentRange), "bytes %u-%u/%u", RECORDING_CHUNK_SIZE - 4, RECORDING_CHUNK_SIZE + 5, recordingSize);
+        download(header, RANGE_PARTIAL, RECORDING_CHUNK_SIZE - 4, 10, contentRange);
+        snprintf(contentRange, sizeof(contentRange), "bytes %u-%u/%u", recordingSize - 500, recordingSize - 1, recordingSize);
+        download("bytes=-500", RANGE_PARTIAL, recordingSize - 500, 500, contentRange);
+        for (int i = 0; i < DOWNLOAD_RANGES; i++) {
+            uint32_t first = rand() % recordingSize;
+            uint32_t last = first + rand() % (recordingSize - first);
+            snprintf(header, sizeof(header), "bytes=%u-%u", first, last);
+            download(header, RANGE_PARTIAL, first, last - first + 1, NULL);
+        }
+        // Connection dropped after a third of the file, client resumes from what it has
+        uint32_t received = recordingSize / 3;
+        snprintf(header, sizeof(header), "bytes=0-%u", received - 1);
+        download(header, RANGE_PARTIAL, 0, received, NULL);
+        std::vector<uint8_t> resumed(fetched);
+        snprintf(header, sizeof(header), "bytes=%u-", received);
+        download(header, RANGE_PARTIAL, received, recordingSize - received, NULL);
+        resumed.insert(resumed.end(), fetched.begin(), fetched.end());
+        if (resumed != file) {
+            downloadErrors++;
+        }
+    }
+    fclose(recording);
+
+    // /snapshot.png and /stream.mjpg encoding of last frame at native and upscaled sizes, PNG is pulled
+    // in TCP segment sized pieces as device sends it
+    static const uint8_t imageScales[] = {1, 2, 4, 10};
+    StageTime pngTimes[sizeof(imageScales)] = {};
+    StageTime jpegTimes[sizeof(imageScales)] = {};
+    size_t pngSizes[sizeof(imageScales)] = {};
+    size_t jpegSizes[sizeof(imageScales)] = {};
+    initJpegEncoder(&jpegEncoder, STREAM_QUALITY);
+    for (size_t s = 0; s < sizeof(imageScales); s++) {
+        for (int i = 0; i < IMAGE_REPEATS; i++) {
+            measure(&pngTimes[s], [&]() {
+                initImageRender(&render, temperatures, GRID_WIDTH, GRID_HEIGHT, imageScales[s], IMAGE_FORMAT_INDEXED, PALETTE_IRON);
+                initPngEncoder(&pngEncoder, &render);
+                pngSizes[s] = 0;
+                for (size_t length; (length = encodePng(&pngEncoder, renderChunk, sizeof(renderChunk))) > 0;) {
+                    pngSizes[s] += length;
+                }
+            });
+            measure(&jpegTimes[s], [&]() {
+                initImageRender(&render, temperatures, GRID_WIDTH, GRID_HEIGHT, imageScales[s], IMAGE_FORMAT_INDEXED, PALETTE_IRON);
+                jpegSizes[s] = encodeJpeg(&jpegEncoder, &render, jpegBuffer, sizeof(jpegBuffer));
+            });
+        }
+    }
+
+    printf("%d frames at %d fps, %d errors\n", frameCount, frameRate, errors);
+    printf("simulated time %.1f ms per frame, bus %.1f ms per frame, sleep %.1f ms per frame\n",
+        elapsed / 1000.0 / frameCount, counting.busTime / 1000.0 / frameCount, counting.sleepTime / 1000.0 / frameCount);
+    printf("bus: %.1f reads, %.1f writes, %.1f words per frame, %u errors, max %u status polls per subpage\n",
+        (double)counting.reads / frameCount, (double)counting.writes / frameCount, (double)counting.wordsRead / frameCount, counting.errors, stats.maxFramePolls);
+    printf("startup: cold %.1f ms (EEPROM dump %.1f ms, extraction %.0f us host), warm %.1f ms (header read %.1f ms, validation %.0f us host, cache %s), NVS read not included\n",
+        (coldBus + startup[0].total) / 1000.0, coldBus / 1000.0, startup[0].total, (warmBus + startup[1].total) / 1000.0, warmBus / 1000.0, startup[1].total, cacheValid ? "valid" : "INVALID");
+    printf("bad pixels: %u broken, %u outliers corrected", badPixels.broken, badPixels.count - badPixels.broken);
+    for (int i = 0; i < badPixels.count; i++) {
+        printf("%s%u %.2f degC", i ? ", " : ": ", badPixels.pixels[i].pixel, temperatures[badPixels.pixels[i].pixel]);
+    }
+    printf("\n");
+    printf("encode: %.2f heap allocations per frame, %u pool misses\n", (double)encodeAllocations / frameCount, encodePool.misses);
+    double recordSeconds = (stages[9].total + stages[10].total) / 1e6;
+    printf("recording: %u chunks, %.0f bytes per frame (raw frame %u), %.0f fps record and write (host), %.2f heap allocations per frame with capture\n",
+        chunkCount, (double)recordingSize / frameCount, (unsigned)frameEncodedSize(DATA_SIZE), recordSeconds > 0 ? frameCount / recordSeconds : 0.0, (double)recordAllocations / frameCount);
+    printf("capture: %s, %u frames around frame %u, ring of %u frames\n", captureRing.state == CAPTURE_FROZEN ? "frozen" : "not complete",
+        captureRing.count, captureRing.triggerFrame, captureRing.capacity);
+    printf("playback: %d of %d frames decoded, %d mismatches, %.1f us per frame, %d seeks to whole seconds %.1f us each, %d wrong\n",
+        played, frameCount, mismatches, played ? playbackTime.total / played : 0.0, seeks, seeks ? seekTime.total / seeks : 0.0, seekErrors);
+    printf("download: %d range requests, %.1f MB/s served (host), %d wrong\n",
+        downloads, downloadTime.total > 0 ? downloaded / downloadTime.total : 0.0, downloadErrors);
+    for (size_t s = 0; s < sizeof(imageScales); s++) {
+        printf("image %3ux%-3u png %6zu bytes %6.3f ms, jpeg q%d %5zu bytes %6.3f ms per frame (host)\n", GRID_WIDTH * imageScales[s], GRID_HEIGHT * imageScales[s],
+            pngSizes[s], pngTimes[s].total / IMAGE_REPEATS / 1000.0, STREAM_QUALITY, jpegSizes[s], jpegTimes[s].total / IMAGE_REPEATS / 1000.0);
+    }
+    if (frameCount > NOISE_WARMUP + 1) {
+        // Temporal noise (NETD of static scene): per pixel standard deviation over frames, averaged
+        double noise[2] = {0, 0};
+        int samples = frameCount - NOISE_WARMUP;
+        for (int k = 0; k < 2; k++) {
+            for (int i = 0; i < DATA_SIZE; i++) {
+                double mean = noiseSum[k][i] / samples;
+                noise[k] += sqrt(fmax(0.0, noiseSquares[k][i] / samples - mean * mean));
+            }
+        }
+        printf("noise: %.3f degC unfiltered, %.3f degC adaptive filter (alpha %.3f), %u restarts\n", noise[0] / DATA_SIZE, noise[1] / DATA_SIZE, filter.alpha, filter.resets);
+    }
+    for (const StageTime &stage : stages) {
+        printf("%-10s %8.1f us per frame (host)\n", stage.name, stage.total / frameCount);
+    }
+
+    MLX90640_SimulatorFree(&simulator);
+    return errors > 0 || mismatches > 0 || seekErrors > 0 || downloadErrors > 0;
+}
+
+#endif
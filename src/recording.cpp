@@ -0,0 +1,221 @@
+#include "recording.h"
+#include "calibration_cache.h"
+#include <math.h>
+#include <string.h>
+
+#define CRC_OFFSET 40
+
+static void putU16(uint8_t *out, uint16_t value) {
+    out[0] = value & 0xFF;
+    out[1] = value >> 8;
+}
+
+static void putU32(uint8_t *out, uint32_t value) {
+    out[0] = value & 0xFF;
+    out[1] = (value >> 8) & 0xFF;
+    out[2] = (value >> 16) & 0xFF;
+    out[3] = value >> 24;
+}
+
+static uint16_t getU16(const uint8_t *in) {
+    return in[0] | (in[1] << 8);
+}
+
+static uint32_t getU32(const uint8_t *in) {
+    return in[0] | (in[1] << 8) | ((uint32_t)in[2] << 16) | ((uint32_t)in[3] << 24);
+}
+
+// Index entry of frame, index grows from chunk end towards records
+static size_t indexOffset(uint16_t frame) {
+    return RECORDING_CHUNK_SIZE - 2 * ((size_t)frame + 1);
+}
+
+static uint32_t chunkCrc(const uint8_t *chunk) {
+    uint32_t crc = crc32Update(0, chunk, CRC_OFFSET);
+    return crc32Update(crc, chunk + CRC_OFFSET + 4, RECORDING_CHUNK_SIZE - CRC_OFFSET - 4);
+}
+
+void initRecordingWriter(RecordingWriter *writer, uint32_t calibrationKey, float emissivity) {
+    writer->calibrationKey = calibrationKey;
+    writer->emissivity = emissivity;
+    writer->chunk = NULL;
+    writer->sequence = 0;
+}
+
+void beginRecordingChunk(RecordingWriter *writer, uint8_t *chunk) {
+    memset(chunk, 0, RECORDING_CHUNK_SIZE);
+    writer->chunk = chunk;
+    writer->info = {};
+    writer->info.version = RECORDING_VERSION;
+    writer->info.emissivity = writer->emissivity;
+    writer->info.calibrationKey = writer->calibrationKey;
+    writer->info.sequence = writer->sequence;
+    writer->info.dataEnd = RECORDING_HEADER_SIZE;
+}
+
+bool appendRecordingFrame(RecordingWriter *writer, FrameHeader *header, const float *pixels) {
+    RecordingChunkInfo *info = &writer->info;
+    size_t pixelCount = header->width * header->height;
+    if (writer->chunk == NULL || pixelCount > DATA_SIZE) {
+        return false;
+    }
+    // Record has to leave room for its index entry
+    size_t end = indexOffset(info->frameCount);
+    if (end <= info->dataEnd) {
+        return false;
+    }
+    uint8_t *out = writer->chunk + info->dataEnd;
+    size_t size;
+    if (info->frameCount == 0) {
+        header->type = FRAME_TYPE_FULL;
+        size = encodeFrame(header, pixels, out, end - info->dataEnd);
+        if (size == 0) {
+            return false;
+        }
+        quantizeFrame(pixels, pixelCount, header->scale, writer->reference);
+        info->width = header->width;
+        info->height = header->height;
+        info->scale = header->scale;
+        info->firstFrame = header->frameCounter;
+        info->firstTimestamp = header->timestamp;
+        info->ta = header->ta;
+    } else {
+        if (header->width != info->width || header->height != info->height) {
+            return false;
+        }
+        header->scale = info->scale;
+        size = encodeDeltaFrame(header, pixels, writer->reference, 0, out, end - info->dataEnd);
+        if (size == 0) {
+            return false;
+        }
+    }
+    putU16(writer->chunk + indexOffset(info->frameCount), info->dataEnd);
+    info->dataEnd += size;
+    info->frameCount++;
+    info->lastTimestamp = header->timestamp;
+    return true;
+}
+
+void finishRecordingChunk(RecordingWriter *writer) {
+    const RecordingChunkInfo *info = &writer->info;
+    uint8_t *out = writer->chunk;
+    int16_t ta;
+    quantizeFrame(&info->ta, 1, info->scale, &ta);
+
+    memcpy(out, RECORDING_MAGIC, 4);
+    out[4] = info->version;
+    out[5] = info->width;
+    out[6] = info->height;
+    out[7] = 0;
+    putU16(out + 8, info->scale);
+    putU16(out + 10, (uint16_t)lroundf(info->emissivity * 10000.0f));
+    putU32(out + 12, info->calibrationKey);
+    putU32(out + 16, info->sequence);
+    putU32(out + 20, info->firstFrame);
+    putU32(out + 24, info->firstTimestamp);
+    putU32(out + 28, info->lastTimestamp);
+    putU16(out + 32, (uint16_t)ta);
+    putU16(out + 34, info->frameCount);
+    putU16(out + 36, info->dataEnd);
+    putU16(out + 38, 0);
+    putU32(out + CRC_OFFSET, chunkCrc(out));
+
+    writer->chunk = NULL;
+    writer->sequence++;
+}
+
+bool parseRecordingHeader(const uint8_t *data, RecordingChunkInfo *info) {
+    if (memcmp(data, RECORDING_MAGIC, 4) != 0 || data[4] != RECORDING_VERSION) {
+        return false;
+    }
+    info->version = data[4];
+    info->width = data[5];
+    info->height = data[6];
+    info->scale = getU16(data + 8);
+    if (info->scale == 0) {
+        return false;
+    }
+    info->emissivity = getU16(data + 10) / 10000.0f;
+    info->calibrationKey = getU32(data + 12);
+    info->sequence = getU32(data + 16);
+    info->firstFrame = getU32(data + 20);
+    info->firstTimestamp = getU32(data + 24);
+    info->lastTimestamp = getU32(data + 28);
+    info->ta = (float)(int16_t)getU16(data + 32) / info->scale;
+    info->frameCount = getU16(data + 34);
+    info->dataEnd = getU16(data + 36);
+    return true;
+}
+
+bool readRecordingChunk(const uint8_t *chunk, RecordingChunkInfo *info) {
+    if (!parseRecordingHeader(chunk, info) || getU32(chunk + CRC_OFFSET) != chunkCrc(chunk)) {
+        return false;
+    }
+    if (info->frameCount == 0 || info->dataEnd > indexOffset(info->frameCount - 1)) {
+        return false;
+    }
+    // Records follow each other in frame order
+    uint16_t previous = RECORDING_HEADER_SIZE;
+    for (uint16_t i = 0; i < info->frameCount; i++) {
+        uint16_t offset = getU16(chunk + indexOffset(i));
+        if ((i == 0 && offset != RECORDING_HEADER_SIZE) || (i > 0 && offset <= previous) || offset >= info->dataEnd) {
+            return false;
+        }
+        previous = offset;
+    }
+    return true;
+}
+
+bool recordingFrameRecord(const uint8_t *chunk, const RecordingChunkInfo *info, uint16_t frame, const uint8_t **data, size_t *size) {
+    if (frame >= info->frameCount) {
+        return false;
+    }
+    uint16_t offset = getU16(chunk + indexOffset(frame));
+    uint16_t end = frame + 1 < info->frameCount ? getU16(chunk + indexOffset(frame + 1)) : info->dataEnd;
+    *data = chunk + offset;
+    *size = end - offset;
+    return true;
+}
+
+int decodeRecordingFrames(const uint8_t *chunk, const RecordingChunkInfo *info, uint32_t timestamp, FrameHeader *header, float *pixels, size_t maxPixels) {
+    int decoded = -1;
+    for (uint16_t i = 0; i < info->frameCount; i++) {
+        const uint8_t *data;
+        size_t size;
+        FrameHeader next;
+        if (!recordingFrameRecord(chunk, info, i, &data, &size) || decodeFrame(data, size, &next, NULL, 0) < 0) {
+            return -1;
+        }
+        if (i > 0 && (int32_t)(next.timestamp - timestamp) > 0) {
+            break;
+        }
+        if (decodeFrame(data, size, header, pixels, maxPixels) < 0) {
+            return -1;
+        }
+        decoded = i;
+    }
+    return decoded;
+}
+
+int32_t findRecordingChunk(RecordingReadFunction read, void *context, uint32_t fileSize, uint32_t timestamp) {
+    uint32_t count = fileSize / RECORDING_CHUNK_SIZE;
+    uint8_t data[RECORDING_HEADER_SIZE];
+    RecordingChunkInfo info;
+    if (count == 0 || !read(context, 0, data, sizeof(data)) || !parseRecordingHeader(data, &info)) {
+        return -1;
+    }
+    // Chunk low starts at or before timestamp (or is the first one), chunks from high on start later
+    // or are unreadable, which can only be the tail of interrupted recording
+    uint32_t low = 0;
+    uint32_t high = count;
+    while (high - low > 1) {
+        uint32_t middle = low + (high - low) / 2;
+        if (read(context, middle * RECORDING_CHUNK_SIZE, data, sizeof(data)) && parseRecordingHeader(data, &info)
+            && info.sequence == middle && (int32_t)(info.firstTimestamp - timestamp) <= 0) {
+            low = middle;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
@@ -0,0 +1,112 @@
+#ifndef _RECORDING_H_
+#define _RECORDING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "frame_protocol.h"
+#include "camera_frame.h"
+
+// Radiometric recording file format. All fields are little-endian.
+//
+// File is a sequence of RECORDING_CHUNK_SIZE byte chunks, chunk n starts at n * RECORDING_CHUNK_SIZE,
+// so playback finds the chunk of any point in time by binary search over chunk headers
+// (findRecordingChunk()) without scanning the file. Every chunk decodes on its own:
+//
+//  offset  size  field
+//       0     4  magic "TREC"
+//       4     1  version (RECORDING_VERSION)
+//       5     1  width
+//       6     1  height
+//       7     1  reserved
+//       8     2  scale     (uint16, units per degree C of records)
+//      10     2  emissivity (uint16, 1/10000)
+//      12     4  calibration key (calibrationKey() of sensor EEPROM, see calibration_cache.h)
+//      16     4  chunk sequence number (n)
+//      20     4  frame counter of first frame
+//      24     4  timestamp of first frame (ms since boot)
+//      28     4  timestamp of last frame
+//      32     2  Ta of first frame (int16, scaled)
+//      34     2  frame count F
+//      36     2  data end (offset following last record)
+//      38     2  reserved
+//      40     4  CRC32 of whole chunk except this field
+//      44     -  records, encoded frames of frame_protocol.h: FRAME_TYPE_FULL for the first one,
+//                lossless FRAME_TYPE_DELTA against the previous one for the rest
+//     ...        zeros
+// size-2*F  2*F  index, record offsets (uint16), of frame F-1 first and frame 0 last
+//
+// Records keep per frame timestamp, Ta and statistics of the frame header.
+// Chunks are written whole, chunk cut short by power loss fails its CRC and ends the recording.
+
+#define RECORDING_MAGIC "TREC"
+#define RECORDING_VERSION 1
+#define RECORDING_CHUNK_SIZE 16384 // 4 flash blocks, ~18 frames of real scene
+#define RECORDING_HEADER_SIZE 44
+
+// Chunk header fields
+struct RecordingChunkInfo {
+    uint8_t version;
+    uint8_t width;
+    uint8_t height;
+    uint16_t scale;
+    float emissivity;
+    uint32_t calibrationKey;
+    uint32_t sequence;
+    uint32_t firstFrame;
+    uint32_t firstTimestamp;
+    uint32_t lastTimestamp;
+    float ta;
+    uint16_t frameCount;
+    uint16_t dataEnd;
+};
+
+// Encodes frames into chunks held by caller, so chunk buffers can be handed over to another task
+// for writing while next chunk is being filled
+struct RecordingWriter {
+    uint32_t calibrationKey;
+    float emissivity;
+    uint8_t *chunk; // chunk being filled, NULL between chunks
+    RecordingChunkInfo info; // of chunk being filled
+    uint32_t sequence; // of next chunk
+    int16_t reference[DATA_SIZE]; // previous frame quantized, reference of delta records
+};
+
+// Starts recording, chunk sequence restarts from 0
+void initRecordingWriter(RecordingWriter *writer, uint32_t calibrationKey, float emissivity);
+
+// Starts filling next chunk into buffer of RECORDING_CHUNK_SIZE bytes
+void beginRecordingChunk(RecordingWriter *writer, uint8_t *chunk);
+
+// Appends frame to chunk being filled, header statistics have to be filled (see encodeFrame()).
+// Returns false when frame doesn't fit, chunk has to be finished then and frame appended into next one
+bool appendRecordingFrame(RecordingWriter *writer, FrameHeader *header, const float *pixels);
+
+// Writes header, index and CRC of chunk being filled, its buffer is ready to be written to file then
+void finishRecordingChunk(RecordingWriter *writer);
+
+// Decodes chunk header without validating the rest of chunk, data has at least RECORDING_HEADER_SIZE bytes.
+// Returns false if it isn't recording chunk header
+bool parseRecordingHeader(const uint8_t *data, RecordingChunkInfo *info);
+
+// Decodes header of whole chunk and validates its CRC and index. Returns false for corrupted chunk
+bool readRecordingChunk(const uint8_t *chunk, RecordingChunkInfo *info);
+
+// Record of n-th frame of chunk validated by readRecordingChunk(), decodable with decodeFrame().
+// Records after the first one are deltas, so they are decoded in order from the first one.
+// Returns false when chunk has no such frame
+bool recordingFrameRecord(const uint8_t *chunk, const RecordingChunkInfo *info, uint16_t frame, const uint8_t **data, size_t *size);
+
+// Decodes frames of chunk validated by readRecordingChunk() up to the last one taken at or before
+// timestamp (ms since boot), the first one if all are later. Returns index of frame decoded into
+// header and pixels, or -1 if a record is malformed
+int decodeRecordingFrames(const uint8_t *chunk, const RecordingChunkInfo *info, uint32_t timestamp, FrameHeader *header, float *pixels, size_t maxPixels);
+
+// Reads size bytes at offset of recording file, returns false on failure
+typedef bool (*RecordingReadFunction)(void *context, uint32_t offset, uint8_t *out, size_t size);
+
+// Chunk holding frame taken at or before timestamp (ms since boot), the first chunk if timestamp
+// precedes the recording. Reads only headers of O(log n) chunks.
+// Returns chunk number, or -1 if file has no valid chunk
+int32_t findRecordingChunk(RecordingReadFunction read, void *context, uint32_t fileSize, uint32_t timestamp);
+
+#endif
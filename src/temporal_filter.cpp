@@ -0,0 +1,75 @@
+#include "temporal_filter.h"
+#include "frame_protocol.h"
+#include <math.h>
+
+void initTemporalFilter(TemporalFilter *filter, uint8_t mode, float alpha, float threshold) {
+    filter->mode = mode;
+    filter->alpha = alpha <= 0.0f || alpha > 1.0f ? 1.0f : alpha;
+    filter->threshold = threshold;
+    filter->primedSubpages = 0;
+    filter->pattern = FRAME_PATTERN_INTERLEAVED;
+    filter->resets = 0;
+}
+
+// Filters count pixels from start with given step
+static void filterRun(TemporalFilter *filter, float *pixels, int start, int step, int count, bool primed) {
+    float *average = filter->average;
+    float alpha = filter->alpha;
+    int end = start + step * count;
+
+    if (!primed) {
+        for (int i = start; i < end; i += step) {
+            average[i] = pixels[i];
+        }
+        return;
+    }
+    if (filter->mode == FILTER_MODE_ADAPTIVE) {
+        float threshold = filter->threshold;
+        for (int i = start; i < end; i += step) {
+            float difference = pixels[i] - average[i];
+            if (fabsf(difference) > threshold) {
+                average[i] = pixels[i];
+                filter->resets++;
+            } else {
+                average[i] += alpha * difference;
+                pixels[i] = average[i];
+            }
+        }
+        return;
+    }
+    for (int i = start; i < end; i += step) {
+        average[i] += alpha * (pixels[i] - average[i]);
+        pixels[i] = average[i];
+    }
+}
+
+void applyTemporalFilter(TemporalFilter *filter, float *pixels, uint8_t subPage, uint8_t pattern) {
+    if (filter->mode == FILTER_MODE_OFF) {
+        return;
+    }
+    if (pattern != filter->pattern) {
+        // Subpages cover other pixels now, averages of previous pattern are mixed up
+        filter->primedSubpages = 0;
+        filter->pattern = pattern;
+    }
+    subPage &= 1;
+    bool primed = filter->primedSubpages & (1 << subPage);
+
+    for (int row = 0; row < GRID_HEIGHT; row++) {
+        if (pattern == FRAME_PATTERN_INTERLEAVED) {
+            if ((row & 1) == subPage) {
+                filterRun(filter, pixels, row * GRID_WIDTH, 1, GRID_WIDTH, primed);
+            }
+        } else {
+            filterRun(filter, pixels, row * GRID_WIDTH + ((row & 1) ^ subPage), 2, GRID_WIDTH / 2, primed);
+        }
+    }
+    filter->primedSubpages |= 1 << subPage;
+}
+
+float filterAlphaForRate(float frameRate, float referenceRate) {
+    if (frameRate <= referenceRate) {
+        return 1.0f;
+    }
+    return 2.0f * referenceRate / (frameRate + referenceRate);
+}
@@ -0,0 +1,40 @@
+#ifndef _TEMPORAL_FILTER_H_
+#define _TEMPORAL_FILTER_H_
+
+#include <stdint.h>
+#include "camera_frame.h"
+
+// Per pixel temporal noise filter, applied to subpage pixels right after they are calculated.
+//
+// FILTER_MODE_EMA keeps exponential moving average of every pixel: s += alpha * (t - s).
+// Noise variance drops by alpha / (2 - alpha), so alpha = 2 * r / (f + r) at frame rate f gives
+// noise of unfiltered frames at rate r (see filterAlphaForRate()).
+// FILTER_MODE_ADAPTIVE does the same, except pixel whose new value differs from its average by more
+// than threshold restarts from the new value, so moving objects don't leave trails.
+//
+// Memory is fixed, one float per pixel. Pixels not measured by the subpage are left untouched.
+
+#define FILTER_MODE_OFF 0
+#define FILTER_MODE_EMA 1
+#define FILTER_MODE_ADAPTIVE 2
+
+struct TemporalFilter {
+    uint8_t mode; // FILTER_MODE_*
+    float alpha; // weight of new sample, 1 passes samples through
+    float threshold; // degC, change resetting pixel in adaptive mode
+    uint8_t primedSubpages; // bit per subpage whose pixels hold average already
+    uint8_t pattern; // FRAME_PATTERN_* of primed subpages
+    uint32_t resets; // pixels restarted by adaptive mode since init
+    float average[DATA_SIZE];
+};
+
+// Sets filter parameters and drops averages, so next subpages start from their samples
+void initTemporalFilter(TemporalFilter *filter, uint8_t mode, float alpha, float threshold);
+
+// Filters pixels of given subpage in place. Frame must be GRID_WIDTH x GRID_HEIGHT
+void applyTemporalFilter(TemporalFilter *filter, float *pixels, uint8_t subPage, uint8_t pattern);
+
+// EMA weight giving at frameRate the noise of unfiltered frames at referenceRate (1 when not slower)
+float filterAlphaForRate(float frameRate, float referenceRate);
+
+#endif
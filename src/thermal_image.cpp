@@ -0,0 +1,211 @@
+#include "thermal_image.h"
+#include <math.h>
+#include <string.h>
+
+static uint16_t paletteTables[PALETTE_COUNT][PALETTE_SIZE];
+static const char *const paletteNames[PALETTE_COUNT] = {"rainbow", "whitehot", "nightvision", "iron"};
+
+static float clampUnit(float value) {
+    return value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+}
+
+// CSS hsl() to RGB565, hue in degrees, saturation and lightness in percent
+static uint16_t hslToRgb565(float hue, float saturation, float lightness) {
+    float s = saturation / 100.0f;
+    float l = lightness / 100.0f;
+    float a = s * fminf(l, 1.0f - l);
+    uint8_t rgb[3];
+    const float n[3] = {0.0f, 8.0f, 4.0f};
+    for (int i = 0; i < 3; i++) {
+        float k = fmodf(n[i] + hue / 30.0f, 12.0f);
+        float channel = l - a * fmaxf(-1.0f, fminf(fminf(k - 3.0f, 9.0f - k), 1.0f));
+        rgb[i] = (uint8_t)lroundf(clampUnit(channel) * 255.0f);
+    }
+    return ((rgb[0] >> 3) << 11) | ((rgb[1] >> 2) << 5) | (rgb[2] >> 3);
+}
+
+// Ports of web client temperatureTo* functions, t is normalized temperature 0..1
+static uint16_t rainbowColor(float t) {
+    return hslToRgb565((1.0f - t) * 240.0f, 100.0f, 50.0f);
+}
+
+static uint16_t whitehotColor(float t) {
+    return hslToRgb565(0.0f, 0.0f, roundf(powf(t, 1.5f) * 100.0f));
+}
+
+static uint16_t nightvisionColor(float t) {
+    float lightness = fmaxf(5.0f, powf(t, 1.5f) * 60.0f);
+    if (t > 0.9f) {
+        lightness = fminf(100.0f, 60.0f + 50.0f * (t - 0.9f) * 10.0f);
+    }
+    return hslToRgb565(roundf(270.0f - 250.0f * t), 100.0f, roundf(lightness));
+}
+
+static uint16_t ironColor(float t) {
+    float hue;
+    float saturation = 100.0f;
+    float lightness = powf(t, 1.5f) * 65.0f;
+    if (t <= 0.5f) {
+        hue = 270.0f + 90.0f * t / 0.5f;
+    } else if (t < 0.9f) {
+        hue = 60.0f * (t - 0.5f) / 0.4f;
+    } else {
+        hue = 60.0f;
+    }
+    hue = fmodf(hue, 360.0f);
+    if (t >= 0.9f) {
+        float whiteHotProgress = (t - 0.9f) * 10.0f;
+        lightness = 65.0f + 35.0f * whiteHotProgress;
+        saturation = 100.0f - 100.0f * whiteHotProgress;
+    }
+    return hslToRgb565(roundf(hue), roundf(fmaxf(0.0f, saturation)), roundf(fminf(100.0f, lightness)));
+}
+
+void initPalettes() {
+    for (int i = 0; i < PALETTE_SIZE; i++) {
+        float t = i / (float)(PALETTE_SIZE - 1);
+        paletteTables[PALETTE_RAINBOW][i] = rainbowColor(t);
+        paletteTables[PALETTE_WHITEHOT][i] = whitehotColor(t);
+        paletteTables[PALETTE_NIGHTVISION][i] = nightvisionColor(t);
+        paletteTables[PALETTE_IRON][i] = ironColor(t);
+    }
+}
+
+const uint16_t *paletteTable(uint8_t palette) {
+    return palette < PALETTE_COUNT ? paletteTables[palette] : NULL;
+}
+
+int findPalette(const char *name) {
+    for (int i = 0; i < PALETTE_COUNT; i++) {
+        if (strcmp(name, paletteNames[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+bool initImageRender(ImageRender *render, const float *pixels, uint8_t width, uint8_t height, uint8_t scale, uint8_t format, uint8_t palette) {
+    if (width == 0 || width > GRID_WIDTH || height == 0 || height > GRID_HEIGHT || scale == 0 || scale > MAX_IMAGE_SCALE
+        || format > IMAGE_FORMAT_RGB565 || palette >= PALETTE_COUNT) {
+        return false;
+    }
+    render->width = width;
+    render->height = height;
+    render->scale = scale;
+    render->format = format;
+    render->palette = paletteTables[palette];
+    render->cachedRow = -1;
+
+    size_t count = (size_t)width * height;
+    float minTemp = pixels[0];
+    float maxTemp = pixels[0];
+    for (size_t i = 1; i < count; i++) {
+        minTemp = fminf(minTemp, pixels[i]);
+        maxTemp = fmaxf(maxTemp, pixels[i]);
+    }
+    render->minTemp = minTemp;
+    render->maxTemp = maxTemp;
+
+    // Interpolation is linear, so it can run on palette indexes instead of temperatures
+    float factor = maxTemp > minTemp ? (PALETTE_SIZE - 1) / (maxTemp - minTemp) : 0.0f;
+    for (size_t i = 0; i < count; i++) {
+        render->values[i] = (pixels[i] - minTemp) * factor;
+    }
+    for (int i = 0; i < scale; i++) {
+        render->weights[i] = i / (float)scale;
+    }
+    return true;
+}
+
+size_t imageWidth(const ImageRender *render) {
+    return (size_t)render->width * render->scale;
+}
+
+size_t imageHeight(const ImageRender *render) {
+    return (size_t)render->height * render->scale;
+}
+
+size_t imageSize(const ImageRender *render) {
+    return imageWidth(render) * imageHeight(render) * (render->format == IMAGE_FORMAT_RGB565 ? 2 : 1);
+}
+
+// Interpolates source rows around output row y
+static void prepareRow(ImageRender *render, int y) {
+    if (render->cachedRow == y) {
+        return;
+    }
+    int top = y / render->scale;
+    int bottom = top + 1 < render->height ? top + 1 : top;
+    float weight = render->weights[y % render->scale];
+    const float *topRow = render->values + top * render->width;
+    const float *bottomRow = render->values + bottom * render->width;
+    for (int x = 0; x < render->width; x++) {
+        render->row[x] = topRow[x] + (bottomRow[x] - topRow[x]) * weight;
+    }
+    render->cachedRow = y;
+}
+
+// Renders count whole pixels starting at pixel index
+static void renderPixels(ImageRender *render, size_t pixel, size_t count, uint8_t *out) {
+    size_t width = imageWidth(render);
+    size_t end = pixel + count;
+    while (pixel < end) {
+        size_t y = pixel / width;
+        size_t rowEnd = (y + 1) * width < end ? (y + 1) * width : end;
+        prepareRow(render, y);
+
+        // Output is mirrored, walk source columns right to left
+        size_t sourceX = width - 1 - pixel % width;
+        int column = sourceX / render->scale;
+        int step = sourceX % render->scale;
+        for (; pixel < rowEnd; pixel++) {
+            int next = column + 1 < render->width ? column + 1 : column;
+            float value = render->row[column] + (render->row[next] - render->row[column]) * render->weights[step];
+            int index = (int)(value + 0.5f);
+            index = index < 0 ? 0 : index >= PALETTE_SIZE ? PALETTE_SIZE - 1 : index;
+            if (render->format == IMAGE_FORMAT_RGB565) {
+                uint16_t color = render->palette[index];
+                out[0] = color & 0xFF;
+                out[1] = color >> 8;
+                out += 2;
+            } else {
+                *out++ = index;
+            }
+            if (--step < 0) {
+                step = render->scale - 1;
+                column--;
+            }
+        }
+    }
+}
+
+size_t renderImage(ImageRender *render, size_t offset, uint8_t *out, size_t outSize) {
+    size_t pixelSize = render->format == IMAGE_FORMAT_RGB565 ? 2 : 1;
+    size_t size = imageSize(render);
+    size_t written = 0;
+    if (offset >= size) {
+        return 0;
+    }
+    if (outSize > size - offset) {
+        outSize = size - offset;
+    }
+
+    while (written < outSize) {
+        size_t position = offset + written;
+        size_t pixel = position / pixelSize;
+        size_t pixelOffset = position % pixelSize;
+        size_t whole = (outSize - written) / pixelSize;
+        if (pixelOffset == 0 && whole > 0) {
+            renderPixels(render, pixel, whole, out + written);
+            written += whole * pixelSize;
+        } else {
+            // Pixel split across calls
+            uint8_t bytes[2];
+            renderPixels(render, pixel, 1, bytes);
+            size_t length = pixelSize - pixelOffset < outSize - written ? pixelSize - pixelOffset : outSize - written;
+            memcpy(out + written, bytes + pixelOffset, length);
+            written += length;
+        }
+    }
+    return written;
+}
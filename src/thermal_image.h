@@ -0,0 +1,66 @@
+#ifndef _THERMAL_IMAGE_H_
+#define _THERMAL_IMAGE_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include "camera_frame.h"
+
+// Frame rendered on device into image ready to blit. Frame is upscaled bilinearly by integer
+// scale (same sampling as web client interpolateTemperatures()), mirrored horizontally the way
+// web client draws it and mapped through palette lookup table from frame min (index 0) to max (255).
+//
+// Image is rendered on demand by byte ranges, so it never has to be held in memory whole:
+//
+//  IMAGE_FORMAT_INDEXED  1 byte per pixel, palette index
+//  IMAGE_FORMAT_RGB565   2 bytes per pixel, little-endian
+
+#define IMAGE_FORMAT_INDEXED 0
+#define IMAGE_FORMAT_RGB565 1
+
+#define PALETTE_RAINBOW 0
+#define PALETTE_WHITEHOT 1
+#define PALETTE_NIGHTVISION 2
+#define PALETTE_IRON 3
+#define PALETTE_COUNT 4
+#define PALETTE_SIZE 256
+
+#define MAX_IMAGE_SCALE 10
+
+struct ImageRender {
+    uint8_t width; // source frame
+    uint8_t height;
+    uint8_t scale;
+    uint8_t format; // IMAGE_FORMAT_*
+    const uint16_t *palette; // RGB565 lookup table
+    float minTemp;
+    float maxTemp;
+    float values[DATA_SIZE]; // source pixels normalized to palette index range
+    float weights[MAX_IMAGE_SCALE]; // interpolation weight of n-th output pixel within source cell
+    float row[GRID_WIDTH]; // source row interpolated vertically for output row cachedRow
+    int cachedRow;
+};
+
+// Builds palette lookup tables, has to be called once before rendering.
+// Colors match temperatureTo* palettes of web client sampled at index / 255
+void initPalettes();
+
+// RGB565 lookup table of palette, NULL for unknown palette
+const uint16_t *paletteTable(uint8_t palette);
+
+// Palette by web client name (rainbow, whitehot, nightvision, iron), -1 if unknown
+int findPalette(const char *name);
+
+// Prepares rendering of pixels (temperatures of width x height frame, at most GRID_WIDTH x GRID_HEIGHT).
+// Returns false on unsupported size, scale, format or palette
+bool initImageRender(ImageRender *render, const float *pixels, uint8_t width, uint8_t height, uint8_t scale, uint8_t format, uint8_t palette);
+
+// Output image dimensions and size in bytes
+size_t imageWidth(const ImageRender *render);
+size_t imageHeight(const ImageRender *render);
+size_t imageSize(const ImageRender *render);
+
+// Renders image bytes starting at offset into out. Offset doesn't have to be pixel aligned.
+// Returns number of bytes written, 0 once whole image was rendered
+size_t renderImage(ImageRender *render, size_t offset, uint8_t *out, size_t outSize);
+
+#endif
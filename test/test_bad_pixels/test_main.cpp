@@ -0,0 +1,172 @@
+// Broken and outlier pixels listed in EEPROM (lib/MLX90640/MLX90640_BadPixels.h): pixels are injected
+// into EEPROM of synthetic sensor (MLX90640_SimulatorSynthetic()) and their raw values spoiled, after
+// correction they hold the average of same subpage neighbours and are close to what a working pixel
+// would read, in both readout patterns and in float as well as fixed-point output.
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "MLX90640_API.h"
+#include "MLX90640_Simulator.h"
+#include "MLX90640_Prepared.h"
+#include "MLX90640_Fixed.h"
+#include "MLX90640_BadPixels.h"
+
+#define EMISSIVITY 1.0f // synthetic frames are made for emissivity 1
+#define SUBPAGES 8
+#define MAX_INTERPOLATION_ERROR 0.5f // degC, scene is smooth away from the warm blob
+#define MAX_FIXED_ERROR 0.05f
+
+// Away from rows crossed by warm blob of synthetic scene, none of them adjacent to another. API accepts
+// at most 4 bad pixels in total
+static const uint16_t brokenPixels[] = {100, 650};
+static const uint16_t outlierPixels[] = {37, 767};
+
+static simulatorMLX90640 simulator;
+static uint16_t eeData[MLX90640_EEPROM_WORDS];
+static uint16_t frameData[MLX90640_FRAME_WORDS];
+static uint16_t spoiled[MLX90640_FRAME_WORDS];
+static paramsMLX90640 params;
+static preparedMLX90640 prepared;
+static fixedMLX90640 fixed;
+static badPixelsMLX90640 plan;
+static float reference[768];
+static float result[768];
+static int16_t centi[768];
+
+static bool isInjected(int pixel) {
+    for (uint16_t broken : brokenPixels) {
+        if (broken == pixel) {
+            return true;
+        }
+    }
+    for (uint16_t outlier : outlierPixels) {
+        if (outlier == pixel) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Copy of subpage frame in given pattern (bit 12 of control register word), bad pixels read garbage
+static void loadFrame(int n, int pattern) {
+    memcpy(frameData, simulator.frames + n * MLX90640_FRAME_WORDS, sizeof(frameData));
+    frameData[832] = (frameData[832] & ~0x1000) | (pattern << 12);
+    memcpy(spoiled, frameData, sizeof(spoiled));
+    for (uint16_t broken : brokenPixels) {
+        spoiled[broken] = 0x7FFF;
+    }
+    for (uint16_t outlier : outlierPixels) {
+        spoiled[outlier] += 1500;
+    }
+}
+
+void setUp(void) {
+    TEST_ASSERT_EQUAL_INT(0, MLX90640_SimulatorSynthetic(&simulator, SUBPAGES));
+    memcpy(eeData, simulator.eeData, sizeof(eeData));
+    for (uint16_t broken : brokenPixels) {
+        eeData[64 + broken] = 0;
+    }
+    for (uint16_t outlier : outlierPixels) {
+        eeData[64 + outlier] |= 0x0001;
+    }
+    TEST_ASSERT_EQUAL_INT(0, MLX90640_ExtractParameters(eeData, &params));
+    MLX90640_PrepareBadPixels(&params, &plan);
+}
+
+void tearDown(void) {
+    MLX90640_SimulatorFree(&simulator);
+}
+
+void test_plan_lists_injected_pixels(void) {
+    TEST_ASSERT_EQUAL_UINT8(4, plan.count);
+    TEST_ASSERT_EQUAL_UINT8(2, plan.broken);
+    for (int i = 0; i < plan.count; i++) {
+        const badPixelMLX90640 &bad = plan.pixels[i];
+        TEST_ASSERT_EQUAL_UINT16(i < plan.broken ? brokenPixels[i] : outlierPixels[i - plan.broken], bad.pixel);
+        for (int pattern = 0; pattern < 2; pattern++) {
+            TEST_ASSERT_GREATER_THAN(0, bad.count[pattern]);
+            for (int n = 0; n < bad.count[pattern]; n++) {
+                // Neighbours are usable pixels measured in the same subpage
+                int neighbour = bad.neighbours[pattern][n];
+                TEST_ASSERT_FALSE(isInjected(neighbour));
+                TEST_ASSERT_EQUAL_UINT8(bad.subPage[pattern], pattern == 0 ? neighbour / 32 % 2 : (neighbour / 32 ^ neighbour) % 2);
+            }
+        }
+    }
+    // Corner pixel has one neighbour in each pattern: left one and the diagonal one
+    const badPixelMLX90640 &corner = plan.pixels[3];
+    TEST_ASSERT_EQUAL_UINT8(1, corner.count[0]);
+    TEST_ASSERT_EQUAL_UINT16(766, corner.neighbours[0][0]);
+    TEST_ASSERT_EQUAL_UINT8(1, corner.count[1]);
+    TEST_ASSERT_EQUAL_UINT16(734, corner.neighbours[1][0]);
+}
+
+void test_bad_pixels_are_interpolated(void) {
+    for (int pattern = 0; pattern < 2; pattern++) {
+        for (int n = 0; n < SUBPAGES; n++) {
+            loadFrame(n, pattern);
+            int subPage = frameData[833];
+            float ta = MLX90640_GetTa(frameData, &params);
+            MLX90640_CalculateTo(frameData, &params, EMISSIVITY, ta - 8, reference);
+            MLX90640_CalculateTo(spoiled, &params, EMISSIVITY, ta - 8, result);
+            float spoiledError = 0;
+            for (int i = 0; i < plan.count; i++) {
+                const badPixelMLX90640 &bad = plan.pixels[i];
+                if (bad.subPage[pattern] == subPage) {
+                    spoiledError = fmaxf(spoiledError, fabsf(result[bad.pixel] - reference[bad.pixel]));
+                }
+            }
+            TEST_ASSERT_GREATER_THAN_FLOAT(5.0f, spoiledError);
+
+            MLX90640_CorrectBadPixels(&plan, subPage, pattern, result);
+            for (int i = 0; i < plan.count; i++) {
+                const badPixelMLX90640 &bad = plan.pixels[i];
+                if (bad.subPage[pattern] != subPage) {
+                    continue;
+                }
+                float sum = 0;
+                for (int k = 0; k < bad.count[pattern]; k++) {
+                    sum += result[bad.neighbours[pattern][k]];
+                }
+                TEST_ASSERT_EQUAL_FLOAT(sum / bad.count[pattern], result[bad.pixel]);
+                TEST_ASSERT_FLOAT_WITHIN(MAX_INTERPOLATION_ERROR, reference[bad.pixel], result[bad.pixel]);
+            }
+            // Everything else is left as calculated
+            for (int i = 0; i < 768; i++) {
+                if (!isInjected(i)) {
+                    TEST_ASSERT_EQUAL_FLOAT(reference[i], result[i]);
+                }
+            }
+        }
+    }
+}
+
+void test_fixed_point_correction_matches_float(void) {
+    MLX90640_PrepareCalibration(&params, &prepared);
+    MLX90640_PrepareFixed(&params, &prepared, &fixed);
+    for (int pattern = 0; pattern < 2; pattern++) {
+        for (int n = 0; n < SUBPAGES; n++) {
+            loadFrame(n, pattern);
+            int subPage = frameData[833];
+            float tr = MLX90640_GetTa(frameData, &params) - 8;
+            MLX90640_CalculateTo(spoiled, &params, EMISSIVITY, tr, result);
+            MLX90640_CorrectBadPixels(&plan, subPage, pattern, result);
+            MLX90640_CalculateToFixed(spoiled, &params, &fixed, EMISSIVITY, tr, centi);
+            MLX90640_CorrectBadPixelsFixed(&plan, subPage, pattern, centi);
+            for (int i = 0; i < plan.count; i++) {
+                const badPixelMLX90640 &bad = plan.pixels[i];
+                if (bad.subPage[pattern] == subPage) {
+                    TEST_ASSERT_FLOAT_WITHIN(MAX_FIXED_ERROR, result[bad.pixel], centi[bad.pixel] / 100.0f);
+                }
+            }
+        }
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_plan_lists_injected_pixels);
+    RUN_TEST(test_bad_pixels_are_interpolated);
+    RUN_TEST(test_fixed_point_correction_matches_float);
+    return UNITY_END();
+}
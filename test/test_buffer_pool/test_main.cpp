@@ -0,0 +1,108 @@
+// Encode path through BufferPool (src/buffer_pool.h) doesn't touch the heap: frames are encoded into
+// pooled buffers while clients hold up to MAX_CLIENT_QUEUE of them, same as device fan-out, and every
+// allocation is counted by operator new replaced below. Exhausted pool still works, by allocating.
+#include <unity.h>
+#include <stdlib.h>
+#include <new>
+#include "buffer_pool.h"
+#include "frame_protocol.h"
+#include "camera_frame.h"
+
+#define CLIENTS 8
+#define CLIENT_QUEUE 2 // same as MAX_CLIENT_QUEUE of device
+#define FRAMES 1000
+#define FRAME_SIZE (FRAME_HEADER_SIZE + DATA_SIZE * 2)
+
+typedef BufferPool<CLIENTS * CLIENT_QUEUE + 2, FRAME_SIZE> FramePool;
+
+static uint32_t allocations = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    void *pointer = malloc(size);
+    if (pointer == NULL) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void operator delete(void *pointer) noexcept {
+    free(pointer);
+}
+
+void operator delete(void *pointer, size_t) noexcept {
+    free(pointer);
+}
+
+static float pixels[DATA_SIZE];
+static FramePool::Buffer queued[CLIENTS][CLIENT_QUEUE]; // messages held by clients until sent
+
+// Encodes frame into pooled buffer like sendDataToWsClients(). Paced clients take turns, so every
+// queued message holds different frame, the worst case pool is sized for
+static void sendFrame(FramePool &pool, uint32_t frame) {
+    FrameHeader header = {};
+    header.version = FRAME_PROTOCOL_VERSION;
+    header.width = GRID_WIDTH;
+    header.height = GRID_HEIGHT;
+    header.frameCounter = frame;
+    FramePool::Buffer buffer = pool.acquire();
+    buffer->resize(encodeFrame(&header, pixels, buffer->data(), buffer->size()));
+    queued[frame % CLIENTS][frame / CLIENTS % CLIENT_QUEUE] = buffer;
+}
+
+void setUp(void) {
+    for (int i = 0; i < DATA_SIZE; i++) {
+        pixels[i] = 20.0f + i * 0.01f;
+    }
+    for (int client = 0; client < CLIENTS; client++) {
+        for (int i = 0; i < CLIENT_QUEUE; i++) {
+            queued[client][i] = nullptr;
+        }
+    }
+}
+
+void tearDown(void) {}
+
+void test_counting_hook_sees_allocations(void) {
+    uint32_t before = allocations;
+    FramePool::Buffer buffer = std::make_shared<std::vector<uint8_t>>(FRAME_SIZE);
+    TEST_ASSERT_GREATER_THAN(before, allocations);
+}
+
+void test_encode_path_doesnt_allocate(void) {
+    FramePool pool;
+    uint32_t before = allocations;
+    for (uint32_t frame = 0; frame < FRAMES; frame++) {
+        sendFrame(pool, frame);
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, allocations - before);
+    TEST_ASSERT_EQUAL_UINT32(0, pool.misses);
+    TEST_ASSERT_EQUAL_UINT(CLIENTS * CLIENT_QUEUE, pool.inUse());
+}
+
+void test_exhausted_pool_allocates(void) {
+    BufferPool<2, FRAME_SIZE> pool;
+    BufferPool<2, FRAME_SIZE>::Buffer held[3];
+    uint32_t before = allocations;
+    for (int i = 0; i < 3; i++) {
+        held[i] = pool.acquire();
+        TEST_ASSERT_EQUAL_UINT(FRAME_SIZE, held[i]->size());
+    }
+    TEST_ASSERT_EQUAL_UINT32(1, pool.misses);
+    TEST_ASSERT_GREATER_THAN(before, allocations);
+
+    // Released buffer is reused without allocating
+    held[0] = nullptr;
+    before = allocations;
+    held[0] = pool.acquire();
+    TEST_ASSERT_EQUAL_UINT32(before, allocations);
+    TEST_ASSERT_EQUAL_UINT32(1, pool.misses);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_counting_hook_sees_allocations);
+    RUN_TEST(test_encode_path_doesnt_allocate);
+    RUN_TEST(test_exhausted_pool_allocates);
+    return UNITY_END();
+}
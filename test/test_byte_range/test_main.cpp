@@ -0,0 +1,162 @@
+// HTTP Range handling of downloads (src/byte_range.h): single ranges in all three forms, suffix ranges
+// longer than the resource, unsatisfiable starts, malformed and multi-range headers falling back to the
+// whole resource, numbers overflowing size_t, Content-Range values and block reads of a range.
+#include <unity.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "byte_range.h"
+
+#define SIZE 1000
+
+static ByteRange range;
+static char contentRange[48];
+static uint8_t resource[SIZE];
+
+static bool readResource(void *context, uint32_t offset, uint8_t *out, size_t size) {
+    (void)context;
+    if (offset + size > SIZE) {
+        return false;
+    }
+    memcpy(out, resource + offset, size);
+    return true;
+}
+
+static void assertRange(int expected, size_t start, size_t length, const char *header) {
+    TEST_ASSERT_EQUAL_INT_MESSAGE(expected, parseByteRange(header, SIZE, &range), header);
+    TEST_ASSERT_EQUAL_UINT_MESSAGE(start, range.start, header);
+    TEST_ASSERT_EQUAL_UINT_MESSAGE(length, range.length, header);
+}
+
+// Header is ignored and whole resource is sent
+static void assertIgnored(const char *header) {
+    assertRange(RANGE_NONE, 0, SIZE, header);
+}
+
+static void assertUnsatisfiable(const char *header) {
+    TEST_ASSERT_EQUAL_INT_MESSAGE(RANGE_UNSATISFIABLE, parseByteRange(header, SIZE, &range), header);
+    formatContentRange(RANGE_UNSATISFIABLE, &range, SIZE, contentRange, sizeof(contentRange));
+    TEST_ASSERT_EQUAL_STRING("bytes */1000", contentRange);
+}
+
+void setUp(void) {
+    for (int i = 0; i < SIZE; i++) {
+        resource[i] = (uint8_t)(i * 7);
+    }
+}
+
+void tearDown(void) {}
+
+void test_single_ranges(void) {
+    assertRange(RANGE_NONE, 0, SIZE, NULL);
+    assertRange(RANGE_PARTIAL, 0, 100, "bytes=0-99");
+    assertRange(RANGE_PARTIAL, 500, 1, "bytes=500-500");
+    assertRange(RANGE_PARTIAL, 999, 1, "bytes=999-999");
+    assertRange(RANGE_PARTIAL, 100, SIZE - 100, "bytes=100-");
+    assertRange(RANGE_PARTIAL, 100, SIZE - 100, " bytes= 100- ");
+    // Last byte past the end is cut to resource
+    assertRange(RANGE_PARTIAL, 900, 100, "bytes=900-5000");
+
+    parseByteRange("bytes=10-19", SIZE, &range);
+    formatContentRange(RANGE_PARTIAL, &range, SIZE, contentRange, sizeof(contentRange));
+    TEST_ASSERT_EQUAL_STRING("bytes 10-19/1000", contentRange);
+}
+
+void test_suffix_ranges(void) {
+    assertRange(RANGE_PARTIAL, SIZE - 500, 500, "bytes=-500");
+    assertRange(RANGE_PARTIAL, SIZE - 1, 1, "bytes=-1");
+    assertRange(RANGE_PARTIAL, 0, SIZE, "bytes=-1000");
+    // Suffix longer than resource is the whole resource, still as 206
+    assertRange(RANGE_PARTIAL, 0, SIZE, "bytes=-1001");
+    parseByteRange("bytes=-300", SIZE, &range);
+    formatContentRange(RANGE_PARTIAL, &range, SIZE, contentRange, sizeof(contentRange));
+    TEST_ASSERT_EQUAL_STRING("bytes 700-999/1000", contentRange);
+
+    // Empty suffix and any suffix of empty resource select nothing
+    assertUnsatisfiable("bytes=-0");
+    TEST_ASSERT_EQUAL_INT(RANGE_UNSATISFIABLE, parseByteRange("bytes=-10", 0, &range));
+}
+
+void test_first_past_the_end(void) {
+    assertUnsatisfiable("bytes=1000-");
+    assertUnsatisfiable("bytes=1000-1000");
+    assertUnsatisfiable("bytes=5000-6000");
+    TEST_ASSERT_EQUAL_INT(RANGE_UNSATISFIABLE, parseByteRange("bytes=0-", 0, &range));
+    // Range is left at whole resource when not partial
+    TEST_ASSERT_EQUAL_UINT(0, range.start);
+    TEST_ASSERT_EQUAL_UINT(0, range.length);
+}
+
+void test_last_before_first_is_ignored(void) {
+    assertIgnored("bytes=5-2");
+    assertIgnored("bytes=999-0");
+}
+
+void test_multiple_ranges_are_ignored(void) {
+    assertIgnored("bytes=0-1,4-5");
+    assertIgnored("bytes=0-1, 4-5");
+    assertIgnored("bytes=-5,0-1");
+    assertIgnored("bytes=0-,");
+}
+
+void test_malformed_headers_are_ignored(void) {
+    assertIgnored("");
+    assertIgnored("bytes=");
+    assertIgnored("bytes=-");
+    assertIgnored("bytes=x-1");
+    assertIgnored("bytes=1-x");
+    assertIgnored("bytes 0-1");
+    assertIgnored("items=0-1");
+    assertIgnored("Bytes=0-1");
+    assertIgnored("bytes=+1-2");
+}
+
+void test_overflowing_numbers(void) {
+    // Largest values still parse, limited to resource
+    assertRange(RANGE_PARTIAL, 0, SIZE, "bytes=0-4294967294");
+    assertRange(RANGE_PARTIAL, 0, SIZE, "bytes=-4294967294");
+    char header[64];
+    snprintf(header, sizeof(header), "bytes=0-%zu", (size_t)SIZE_MAX);
+    assertRange(RANGE_PARTIAL, 0, SIZE, header);
+    snprintf(header, sizeof(header), "bytes=%zu-", (size_t)SIZE_MAX);
+    assertUnsatisfiable(header);
+
+    // One past SIZE_MAX and longer don't wrap around into small numbers
+    assertIgnored("bytes=99999999999999999999-");
+    assertIgnored("bytes=0-99999999999999999999");
+    assertIgnored("bytes=-99999999999999999999");
+    assertIgnored("bytes=18446744073709551616-");
+    assertIgnored("bytes=-18446744073709551616");
+}
+
+void test_range_is_read_in_blocks(void) {
+    TEST_ASSERT_EQUAL_INT(RANGE_PARTIAL, parseByteRange("bytes=95-904", SIZE, &range));
+    uint8_t fetched[SIZE];
+    uint8_t block[64];
+    size_t index = 0;
+    for (size_t len; (len = readRangeBlock(readResource, NULL, &range, index, block, 1 + index % sizeof(block))) > 0; index += len) {
+        TEST_ASSERT_LESS_OR_EQUAL(1 + index % sizeof(block), len);
+        memcpy(fetched + index, block, len);
+    }
+    TEST_ASSERT_EQUAL_UINT(810, index);
+    TEST_ASSERT_EQUAL_MEMORY(resource + 95, fetched, 810);
+    TEST_ASSERT_EQUAL_UINT(0, readRangeBlock(readResource, NULL, &range, range.length, block, sizeof(block)));
+
+    // Failed read ends the response
+    range.start = SIZE - 10;
+    range.length = 20;
+    TEST_ASSERT_EQUAL_UINT(0, readRangeBlock(readResource, NULL, &range, 0, block, sizeof(block)));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_single_ranges);
+    RUN_TEST(test_suffix_ranges);
+    RUN_TEST(test_first_past_the_end);
+    RUN_TEST(test_last_before_first_is_ignored);
+    RUN_TEST(test_multiple_ranges_are_ignored);
+    RUN_TEST(test_malformed_headers_are_ignored);
+    RUN_TEST(test_overflowing_numbers);
+    RUN_TEST(test_range_is_read_in_blocks);
+    return UNITY_END();
+}
@@ -0,0 +1,71 @@
+// Calibration cache (src/calibration_cache.h) on parameters extracted from synthetic sensor EEPROM:
+// params stored with their meta record are accepted at next boot, while a blob changed on the way,
+// a blob of another sensor or of other firmware layout is rejected so parameters are extracted again.
+#include <unity.h>
+#include <string.h>
+#include "MLX90640_API.h"
+#include "MLX90640_Simulator.h"
+#include "calibration_cache.h"
+
+static simulatorMLX90640 simulator;
+static uint16_t eeData[MLX90640_EEPROM_WORDS];
+static paramsMLX90640 params;
+static paramsMLX90640 loaded; // as read back from storage
+static CalibrationMeta meta;
+
+void setUp(void) {
+    TEST_ASSERT_EQUAL_INT(0, MLX90640_SimulatorSynthetic(&simulator, 2));
+    memcpy(eeData, simulator.eeData, sizeof(eeData));
+    MLX90640_SimulatorFree(&simulator);
+    TEST_ASSERT_GREATER_OR_EQUAL(0, MLX90640_ExtractParameters(eeData, &params));
+    makeCalibrationMeta(calibrationKey(eeData), &params, 0, &meta);
+    memcpy(&loaded, &params, sizeof(loaded));
+}
+
+void tearDown(void) {}
+
+// Standard CRC-32 check value, and CRC continued over parts equals CRC of the whole
+void test_crc32(void) {
+    const char *check = "123456789";
+    TEST_ASSERT_EQUAL_UINT32(0xCBF43926, crc32Update(0, check, 9));
+    TEST_ASSERT_EQUAL_UINT32(0xCBF43926, crc32Update(crc32Update(0, check, 4), check + 4, 5));
+    TEST_ASSERT_EQUAL_UINT32(0, crc32Update(0, check, 0));
+}
+
+void test_stored_params_accepted(void) {
+    TEST_ASSERT_EQUAL_UINT32(CALIBRATION_CACHE_VERSION, meta.version);
+    TEST_ASSERT_EQUAL_UINT32(sizeof(paramsMLX90640), meta.size);
+    TEST_ASSERT_TRUE(isCalibrationValid(&meta, calibrationKey(eeData), &loaded));
+    // Key covers only EEPROM header, warm boot doesn't read the rest
+    eeData[CALIBRATION_KEY_WORDS] ^= 1;
+    TEST_ASSERT_TRUE(isCalibrationValid(&meta, calibrationKey(eeData), &loaded));
+}
+
+void test_corrupted_params_rejected(void) {
+    ((uint8_t *)&loaded)[sizeof(loaded) / 2] ^= 0x10;
+    TEST_ASSERT_FALSE(isCalibrationValid(&meta, calibrationKey(eeData), &loaded));
+}
+
+void test_other_sensor_rejected(void) {
+    eeData[7] ^= 1; // device ID word
+    TEST_ASSERT_FALSE(isCalibrationValid(&meta, calibrationKey(eeData), &loaded));
+}
+
+void test_stale_layout_rejected(void) {
+    uint32_t key = calibrationKey(eeData);
+    meta.version = CALIBRATION_CACHE_VERSION - 1;
+    TEST_ASSERT_FALSE(isCalibrationValid(&meta, key, &loaded));
+    meta.version = CALIBRATION_CACHE_VERSION;
+    meta.size = sizeof(paramsMLX90640) - 4;
+    TEST_ASSERT_FALSE(isCalibrationValid(&meta, key, &loaded));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_crc32);
+    RUN_TEST(test_stored_params_accepted);
+    RUN_TEST(test_corrupted_params_rejected);
+    RUN_TEST(test_other_sensor_rejected);
+    RUN_TEST(test_stale_layout_rejected);
+    return UNITY_END();
+}
@@ -0,0 +1,165 @@
+// Pre-trigger capture ring (src/capture_ring.h) with a small ring that wraps several times before
+// trigger: frozen capture holds the frames before and after the trigger, oldest first, and reads the
+// same in any block size. Threshold triggers only when crossed after arming, capture that isn't
+// frozen reads empty and window longer than the ring is shortened.
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "capture_ring.h"
+#include "frame_protocol.h"
+#include "camera_frame.h"
+
+#define CAPACITY 8
+#define PRE_FRAMES 5
+#define POST_FRAMES 2
+
+static CaptureRing ring;
+static uint8_t memory[CAPACITY * CAPTURE_SLOT_SIZE + 100]; // remainder too small for a slot
+static uint8_t captured[CAPACITY * CAPTURE_SLOT_SIZE];
+static float pixels[DATA_SIZE];
+static float decoded[DATA_SIZE];
+
+// Frame n has all pixels at 20 + n / 10 degC, maxTemp given separately for threshold
+static bool storeFrame(uint32_t n, float maxTemp) {
+    for (int i = 0; i < DATA_SIZE; i++) {
+        pixels[i] = 20.0f + n / 10.0f;
+    }
+    FrameHeader header = {};
+    header.version = FRAME_PROTOCOL_VERSION;
+    header.width = GRID_WIDTH;
+    header.height = GRID_HEIGHT;
+    header.frameCounter = n;
+    header.timestamp = n * 125;
+    header.minTemp = pixels[0];
+    header.maxTemp = maxTemp;
+    return captureFrame(&ring, &header, pixels);
+}
+
+// Reads frozen capture in blocks of given size, checks it holds count consecutive frames from first
+static void assertCapture(uint32_t first, uint16_t count, size_t blockSize) {
+    size_t size = captureSize(&ring);
+    TEST_ASSERT_EQUAL_size_t((size_t)count * CAPTURE_SLOT_SIZE, size);
+    size_t offset = 0;
+    size_t length;
+    while ((length = readCapture(&ring, offset, captured + offset, blockSize)) > 0) {
+        offset += length;
+    }
+    TEST_ASSERT_EQUAL_size_t(size, offset);
+    for (uint16_t i = 0; i < count; i++) {
+        FrameHeader header;
+        TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(captured + i * CAPTURE_SLOT_SIZE, CAPTURE_SLOT_SIZE, &header, decoded, DATA_SIZE));
+        TEST_ASSERT_EQUAL_UINT32(first + i, header.frameCounter);
+        TEST_ASSERT_FLOAT_WITHIN(0.01f, 20.0f + (first + i) / 10.0f, decoded[DATA_SIZE - 1]);
+    }
+}
+
+void setUp(void) {
+    initCaptureRing(&ring, memory, sizeof(memory));
+}
+
+void tearDown(void) {}
+
+void test_wrapped_ring_keeps_window_around_trigger(void) {
+    TEST_ASSERT_EQUAL_UINT16(CAPACITY, ring.capacity);
+    armCapture(&ring, PRE_FRAMES, POST_FRAMES);
+    uint32_t n = 0;
+    for (; n < 3 * CAPACITY + 3; n++) {
+        TEST_ASSERT_FALSE(storeFrame(n, 25.0f));
+    }
+    uint32_t triggerFrame = n;
+    triggerCapture(&ring);
+    TEST_ASSERT_FALSE(storeFrame(n++, 25.0f)); // trigger frame
+    TEST_ASSERT_FALSE(storeFrame(n++, 25.0f));
+    TEST_ASSERT_TRUE(storeFrame(n++, 25.0f));
+    TEST_ASSERT_EQUAL_UINT8(CAPTURE_FROZEN, ring.state);
+    TEST_ASSERT_EQUAL_UINT32(triggerFrame, ring.triggerFrame);
+    TEST_ASSERT_EQUAL_UINT16(PRE_FRAMES - 1, ring.triggerIndex);
+    assertCapture(triggerFrame - PRE_FRAMES + 1, PRE_FRAMES + POST_FRAMES, 1000);
+    assertCapture(triggerFrame - PRE_FRAMES + 1, PRE_FRAMES + POST_FRAMES, CAPTURE_SLOT_SIZE);
+    assertCapture(triggerFrame - PRE_FRAMES + 1, PRE_FRAMES + POST_FRAMES, sizeof(captured));
+
+    // Frozen capture isn't overwritten by following frames
+    TEST_ASSERT_FALSE(storeFrame(n++, 25.0f));
+    assertCapture(triggerFrame - PRE_FRAMES + 1, PRE_FRAMES + POST_FRAMES, 777);
+}
+
+// Trigger before ring holds all pre-trigger frames keeps those it has
+void test_early_trigger(void) {
+    armCapture(&ring, PRE_FRAMES, POST_FRAMES);
+    storeFrame(0, 25.0f);
+    triggerCapture(&ring);
+    storeFrame(1, 25.0f);
+    storeFrame(2, 25.0f);
+    TEST_ASSERT_TRUE(storeFrame(3, 25.0f));
+    TEST_ASSERT_EQUAL_UINT16(1, ring.triggerIndex);
+    assertCapture(0, 2 + POST_FRAMES, 1000);
+}
+
+// Scene already hot when armed doesn't trigger, threshold has to be crossed upwards
+void test_threshold_crossing_triggers(void) {
+    ring.threshold = 40.0f;
+    armCapture(&ring, PRE_FRAMES, POST_FRAMES);
+    uint32_t n = 0;
+    for (; n < 10; n++) {
+        storeFrame(n, 45.0f);
+    }
+    storeFrame(n++, 30.0f);
+    TEST_ASSERT_EQUAL_UINT8(CAPTURE_ARMED, ring.state);
+    uint32_t triggerFrame = n;
+    storeFrame(n++, 41.0f);
+    TEST_ASSERT_EQUAL_UINT8(CAPTURE_TRIGGERED, ring.state);
+    storeFrame(n++, 45.0f);
+    TEST_ASSERT_TRUE(storeFrame(n++, 45.0f));
+    TEST_ASSERT_EQUAL_UINT32(triggerFrame, ring.triggerFrame);
+    assertCapture(triggerFrame - PRE_FRAMES + 1, PRE_FRAMES + POST_FRAMES, 1000);
+}
+
+void test_capture_not_frozen_reads_empty(void) {
+    uint8_t out[16];
+    TEST_ASSERT_FALSE(storeFrame(0, 25.0f)); // not armed
+    TEST_ASSERT_EQUAL_size_t(0, captureSize(&ring));
+    armCapture(&ring, PRE_FRAMES, POST_FRAMES);
+    storeFrame(1, 25.0f);
+    TEST_ASSERT_EQUAL_size_t(0, captureSize(&ring));
+    TEST_ASSERT_EQUAL_size_t(0, readCapture(&ring, 0, out, sizeof(out)));
+
+    // Past the end of frozen capture
+    triggerCapture(&ring);
+    for (uint32_t n = 2; ring.state != CAPTURE_FROZEN; n++) {
+        storeFrame(n, 25.0f);
+    }
+    TEST_ASSERT_EQUAL_size_t(0, readCapture(&ring, captureSize(&ring), out, sizeof(out)));
+    TEST_ASSERT_EQUAL_size_t(1, readCapture(&ring, captureSize(&ring) - 1, out, sizeof(out)));
+}
+
+void test_window_shortened_to_capacity(void) {
+    armCapture(&ring, 30, 10);
+    TEST_ASSERT_EQUAL_UINT16(CAPACITY, ring.preFrames + ring.postFrames);
+    TEST_ASSERT_EQUAL_UINT16(2, ring.postFrames);
+    armCapture(&ring, 0, 20);
+    TEST_ASSERT_EQUAL_UINT16(1, ring.preFrames); // trigger frame is always kept
+
+    // Longest windows of /capture at 32 fps, beyond uint16 frame counts
+    armCapture(&ring, 2048 * 32, 10 * 32);
+    TEST_ASSERT_EQUAL_UINT16(CAPACITY, ring.preFrames + ring.postFrames);
+    TEST_ASSERT_EQUAL_UINT16(0, ring.postFrames);
+    armCapture(&ring, 3600 * 32, 3600 * 32);
+    TEST_ASSERT_EQUAL_UINT16(CAPACITY / 2, ring.preFrames);
+    TEST_ASSERT_EQUAL_UINT16(CAPACITY / 2, ring.postFrames);
+
+    // Without memory ring can't be armed
+    initCaptureRing(&ring, NULL, sizeof(memory));
+    armCapture(&ring, PRE_FRAMES, POST_FRAMES);
+    TEST_ASSERT_EQUAL_UINT8(CAPTURE_OFF, ring.state);
+    TEST_ASSERT_FALSE(storeFrame(0, 25.0f));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_wrapped_ring_keeps_window_around_trigger);
+    RUN_TEST(test_early_trigger);
+    RUN_TEST(test_threshold_crossing_triggers);
+    RUN_TEST(test_capture_not_frozen_reads_empty);
+    RUN_TEST(test_window_shortened_to_capacity);
+    return UNITY_END();
+}
@@ -0,0 +1,55 @@
+// Stub of ESPAsyncWebServer websocket classes used by src/client_fanout.h, so fan-out builds on host.
+// Clients queue messages like AsyncWebSocketClient does and the test drains the queues at its own
+// pace, as TCP acknowledgements would. Found before the library as the test directory is on include path.
+#ifndef _ESP_ASYNC_WEB_SERVER_STUB_H_
+#define _ESP_ASYNC_WEB_SERVER_STUB_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <list>
+#include <memory>
+#include <vector>
+
+#define WS_MAX_QUEUED_MESSAGES 32 // library refuses messages above this
+
+typedef std::shared_ptr<std::vector<uint8_t>> AsyncWebSocketSharedBuffer;
+
+enum AwsClientStatus { WS_DISCONNECTED, WS_CONNECTED, WS_DISCONNECTING };
+
+class AsyncWebSocketClient {
+public:
+    AsyncWebSocketClient(uint32_t id) : _id(id), _status(WS_CONNECTED) {}
+
+    uint32_t id() const { return _id; }
+    AwsClientStatus status() const { return _status; }
+    size_t queueLen() const { return queue.size(); }
+
+    bool binary(AsyncWebSocketSharedBuffer buffer) {
+        if (_status != WS_CONNECTED || queue.size() >= WS_MAX_QUEUED_MESSAGES) {
+            return false;
+        }
+        queue.push_back(buffer);
+        return true;
+    }
+
+    void close() { _status = WS_DISCONNECTED; }
+
+    std::deque<AsyncWebSocketSharedBuffer> queue; // messages not acknowledged yet, oldest first
+
+private:
+    uint32_t _id;
+    AwsClientStatus _status;
+};
+
+class AsyncWebSocket {
+public:
+    AsyncWebSocketClient *connect(uint32_t id) {
+        clients.emplace_back(id);
+        return &clients.back();
+    }
+
+    std::list<AsyncWebSocketClient> clients;
+};
+
+#endif
@@ -0,0 +1,233 @@
+// Websocket fan-out (src/client_fanout.h) under load: frames at 32 fps go to clients draining their
+// queues at different speeds, from fast LAN clients to one that stopped reading. Every client has to
+// get frames in order with unbroken delta chains, fast clients every frame and slow ones as many as
+// they can drain, while no client holds more than MAX_CLIENT_QUEUE frames. Runs on virtual ms clock,
+// AsyncWebSocket is a stub (ESPAsyncWebServer.h next to this file).
+#include <unity.h>
+#include <string.h>
+#include <vector>
+#include "client_fanout.h"
+
+#define FRAME_INTERVAL 31 // ms, 32 fps
+#define RUN_TIME 20000 // ms
+#define KEYFRAME_INTERVAL 32 // every 32nd stream message is full frame, like on device
+#define UNCHANGED_INTERVAL 50 // every 50th frame has nothing to send
+#define FRAME_FULL 0
+#define FRAME_DELTA 1
+#define MAX_CLIENTS 8
+
+// Client at the other end of websocket, acknowledges head of its queue drainTime ms after it started sending
+struct TestClient {
+    uint32_t id;
+    uint32_t drainTime; // ms per message, 0 never reads
+    uint32_t joinTime; // ms
+    uint32_t leaveTime; // ms, 0 stays till the end
+    AsyncWebSocketClient *socket;
+    uint32_t headSince; // ms, head of queue is being sent since
+    uint32_t received;
+    uint32_t lastSequence;
+    bool hasFrame; // has full frame to apply deltas to
+    uint32_t outOfOrder;
+    uint32_t brokenChains; // delta frames not following previous received frame
+    size_t maxQueued;
+};
+
+static AsyncWebSocket ws;
+static ClientState states[MAX_CLIENTS];
+static FanOutStats fanOutStats;
+static std::vector<TestClient> testClients;
+static uint32_t framesSent; // non-empty frames handed to fan-out
+static uint32_t keyframesMade;
+static uint32_t maxKeyframesPerFrame;
+
+static AsyncWebSocketSharedBuffer makeFrame(uint8_t type, uint32_t sequence) {
+    AsyncWebSocketSharedBuffer buffer = std::make_shared<std::vector<uint8_t>>(5);
+    (*buffer)[0] = type;
+    for (int i = 0; i < 4; i++) {
+        (*buffer)[1 + i] = (uint8_t)(sequence >> (i * 8));
+    }
+    return buffer;
+}
+
+static void receive(TestClient &client, const std::vector<uint8_t> &message) {
+    uint32_t sequence = message[1] | (message[2] << 8) | (message[3] << 16) | ((uint32_t)message[4] << 24);
+    if (client.received > 0 && sequence <= client.lastSequence) {
+        client.outOfOrder++;
+    }
+    if (message[0] == FRAME_DELTA && (!client.hasFrame || sequence != client.lastSequence + 1)) {
+        client.brokenChains++;
+    }
+    client.hasFrame = true;
+    client.lastSequence = sequence;
+    client.received++;
+}
+
+static void addClient(uint32_t drainTime, uint32_t joinTime, uint32_t leaveTime) {
+    TestClient client = {};
+    client.id = testClients.size() + 1;
+    client.drainTime = drainTime;
+    client.joinTime = joinTime;
+    client.leaveTime = leaveTime;
+    testClients.push_back(client);
+}
+
+// Same as registerClient() of device
+static void join(TestClient &client, uint32_t now) {
+    client.socket = ws.connect(client.id);
+    client.headSince = now;
+    for (ClientState &state : states) {
+        if (state.id == 0) {
+            state = {};
+            state.id = client.id;
+            state.client = client.socket;
+            state.needsKeyframe = true;
+            return;
+        }
+    }
+    TEST_FAIL_MESSAGE("no free client slot");
+}
+
+static void run(void) {
+    uint32_t frame = 0;
+    for (uint32_t now = 0; now < RUN_TIME; now++) {
+        for (TestClient &client : testClients) {
+            if (now == client.joinTime) {
+                join(client, now);
+            }
+            if (client.socket == NULL) {
+                continue;
+            }
+            if (client.leaveTime != 0 && now == client.leaveTime) {
+                client.socket->close();
+            }
+            std::deque<AsyncWebSocketSharedBuffer> &queue = client.socket->queue;
+            if (queue.empty() || client.drainTime == 0) {
+                client.headSince = now;
+            } else if (now - client.headSince >= client.drainTime) {
+                receive(client, *queue.front());
+                queue.pop_front();
+                client.headSince = now;
+            }
+        }
+
+        if (now % FRAME_INTERVAL != 0) {
+            continue;
+        }
+        AsyncWebSocketSharedBuffer stream = makeFrame(frame % KEYFRAME_INTERVAL == 0 ? FRAME_FULL : FRAME_DELTA, frame);
+        if (frame % UNCHANGED_INTERVAL == UNCHANGED_INTERVAL - 1) {
+            stream->clear();
+        } else {
+            framesSent++;
+        }
+        AsyncWebSocketSharedBuffer keyframe = !stream->empty() && (*stream)[0] == FRAME_FULL ? stream : nullptr;
+        uint32_t keyframes = 0;
+        fanOutFrame(states, MAX_CLIENTS, stream, keyframe, now, [&]() {
+            keyframes++;
+            return makeFrame(FRAME_FULL, frame);
+        }, fanOutStats);
+        keyframesMade += keyframes;
+        if (keyframes > maxKeyframesPerFrame) {
+            maxKeyframesPerFrame = keyframes;
+        }
+        for (TestClient &client : testClients) {
+            if (client.socket != NULL && client.socket->queueLen() > client.maxQueued) {
+                client.maxQueued = client.socket->queueLen();
+            }
+        }
+        frame++;
+    }
+}
+
+static float clientRate(const TestClient &client) {
+    uint32_t end = client.leaveTime != 0 ? client.leaveTime : RUN_TIME;
+    return client.received * 1000.0f / (end - client.joinTime);
+}
+
+static void assertIntact(const TestClient &client) {
+    TEST_ASSERT_EQUAL_UINT32(0, client.outOfOrder);
+    TEST_ASSERT_EQUAL_UINT32(0, client.brokenChains);
+    TEST_ASSERT_LESS_OR_EQUAL(MAX_CLIENT_QUEUE, client.maxQueued);
+}
+
+void setUp(void) {
+    ws.clients.clear();
+    memset(states, 0, sizeof(states));
+    fanOutStats = {};
+    testClients.clear();
+    framesSent = 0;
+    keyframesMade = 0;
+    maxKeyframesPerFrame = 0;
+}
+
+void tearDown(void) {}
+
+void test_fast_clients_get_every_frame(void) {
+    addClient(2, 0, 0);
+    addClient(5, 0, 0);
+    run();
+    for (const TestClient &client : testClients) {
+        assertIntact(client);
+        TEST_ASSERT_EQUAL_UINT32(framesSent, client.received + client.socket->queueLen());
+    }
+    TEST_ASSERT_EQUAL_UINT32(0, fanOutStats.dropped);
+    TEST_ASSERT_EQUAL_UINT32(0, fanOutStats.paced);
+}
+
+void test_clients_are_paced_by_drain_rate(void) {
+    const uint32_t drainTimes[] = {2, 20, 50, 125, 400};
+    for (uint32_t drainTime : drainTimes) {
+        addClient(drainTime, 0, 0);
+    }
+    run();
+    float frameRate = 1000.0f / FRAME_INTERVAL * (UNCHANGED_INTERVAL - 1) / UNCHANGED_INTERVAL;
+    for (const TestClient &client : testClients) {
+        assertIntact(client);
+        // Never more than client can drain and at least half of it, clients keeping up aren't slowed down
+        float drainRate = 1000.0f / client.drainTime;
+        float expected = drainRate < frameRate ? drainRate : frameRate;
+        float rate = clientRate(client);
+        TEST_ASSERT_LESS_OR_EQUAL_FLOAT(expected * 1.01f, rate);
+        TEST_ASSERT_GREATER_OR_EQUAL_FLOAT(expected * (drainRate < frameRate ? 0.5f : 0.98f), rate);
+    }
+    TEST_ASSERT_EQUAL_UINT32(framesSent, testClients[0].received + testClients[0].socket->queueLen());
+}
+
+void test_stalled_client_doesnt_hold_others(void) {
+    addClient(0, 0, 0);
+    addClient(2, 0, 0);
+    run();
+    const TestClient &stalled = testClients[0];
+    const TestClient &fast = testClients[1];
+    TEST_ASSERT_EQUAL_UINT32(0, stalled.received);
+    TEST_ASSERT_EQUAL_UINT(MAX_CLIENT_QUEUE, stalled.socket->queueLen());
+    // Frames queued before it stopped reading, then it's backed off to slowest pace
+    TEST_ASSERT_EQUAL_UINT32(MAX_CLIENT_QUEUE, states[0].sent);
+    TEST_ASSERT_EQUAL_UINT32(MAX_CLIENT_INTERVAL, states[0].interval);
+    assertIntact(fast);
+    TEST_ASSERT_EQUAL_UINT32(framesSent, fast.received + fast.socket->queueLen());
+}
+
+void test_joining_and_leaving_clients(void) {
+    addClient(2, 0, 0);
+    addClient(2, 5003, 0); // joins mid keyframe interval, starts with keyframe made for it
+    addClient(50, 7001, 12000);
+    addClient(2, 15000, 0);
+    run();
+    for (const TestClient &client : testClients) {
+        assertIntact(client);
+        TEST_ASSERT_GREATER_THAN_UINT32(0, client.received);
+    }
+    TEST_ASSERT_EQUAL_UINT32(states[2].sent, testClients[2].received + testClients[2].socket->queueLen());
+    // Keyframe is encoded once per frame however many clients need it
+    TEST_ASSERT_GREATER_THAN_UINT32(0, keyframesMade);
+    TEST_ASSERT_EQUAL_UINT32(1, maxKeyframesPerFrame);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_fast_clients_get_every_frame);
+    RUN_TEST(test_clients_are_paced_by_drain_rate);
+    RUN_TEST(test_stalled_client_doesnt_hold_others);
+    RUN_TEST(test_joining_and_leaving_clients);
+    return UNITY_END();
+}
@@ -0,0 +1,128 @@
+// Seqlock FrameBuffer (src/frame_buffer.h) under load: one writer thread publishes frames as fast
+// as it can while several readers copy them, every copy has to be one whole published frame.
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+#include "frame_buffer.h"
+#include "camera_frame.h"
+
+#define WRITES 200000
+#define READERS 4
+
+static FrameBuffer<CameraFrame> frameBuffer;
+
+// Frame whose every field is derived from its sequence number, so a torn copy is detectable
+static void fillFrame(CameraFrame *frame, uint32_t sequence) {
+    frame->frameCounter = sequence;
+    frame->timestamp = sequence * 3;
+    frame->ta = (float)sequence;
+    frame->subPage = sequence & 1;
+    frame->pattern = 1;
+    frame->partial = false;
+    frame->stats.minTemp = (float)sequence;
+    frame->stats.maxTemp = (float)sequence;
+    for (int i = 0; i < DATA_SIZE; i++) {
+        frame->temperatures[i] = (float)(sequence + i);
+    }
+}
+
+static bool isConsistent(const CameraFrame &frame, uint32_t sequence) {
+    if (frame.frameCounter != sequence || frame.timestamp != sequence * 3 || frame.ta != (float)sequence
+        || frame.subPage != (sequence & 1) || frame.stats.minTemp != (float)sequence || frame.stats.maxTemp != (float)sequence) {
+        return false;
+    }
+    for (int i = 0; i < DATA_SIZE; i++) {
+        if (frame.temperatures[i] != (float)(sequence + i)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_empty_buffer(void) {
+    FrameBuffer<CameraFrame> empty;
+    CameraFrame frame;
+    TEST_ASSERT_EQUAL_UINT32(0, empty.sequence());
+    TEST_ASSERT_EQUAL_UINT32(0, empty.read(&frame));
+}
+
+void test_single_thread_read_returns_latest(void) {
+    FrameBuffer<CameraFrame> buffer;
+    static CameraFrame frame;
+    for (uint32_t sequence = 1; sequence <= 5; sequence++) {
+        fillFrame(&frame, sequence);
+        buffer.write(frame);
+        TEST_ASSERT_EQUAL_UINT32(sequence, buffer.sequence());
+    }
+    static CameraFrame out;
+    TEST_ASSERT_EQUAL_UINT32(5, buffer.read(&out));
+    TEST_ASSERT_TRUE(isConsistent(out, 5));
+}
+
+void test_concurrent_reads_are_never_torn(void) {
+    std::atomic<bool> done(false);
+    std::atomic<uint32_t> torn(0);
+    std::atomic<uint32_t> backwards(0);
+    std::vector<uint32_t> reads(READERS);
+    std::vector<uint32_t> distinct(READERS);
+    std::vector<std::thread> readers;
+
+    for (int r = 0; r < READERS; r++) {
+        readers.emplace_back([&, r]() {
+            static thread_local CameraFrame frame;
+            uint32_t last = 0;
+            while (!done.load(std::memory_order_acquire)) {
+                uint32_t sequence = frameBuffer.read(&frame);
+                if (sequence == 0) {
+                    continue;
+                }
+                if (!isConsistent(frame, sequence)) {
+                    torn++;
+                }
+                if (sequence < last) {
+                    backwards++;
+                }
+                if (sequence != last) {
+                    distinct[r]++;
+                }
+                last = sequence;
+                reads[r]++;
+            }
+        });
+    }
+
+    static CameraFrame frame;
+    for (uint32_t sequence = 1; sequence <= WRITES; sequence++) {
+        fillFrame(&frame, sequence);
+        frameBuffer.write(frame);
+    }
+    done.store(true, std::memory_order_release);
+    for (std::thread &reader : readers) {
+        reader.join();
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, torn.load());
+    TEST_ASSERT_EQUAL_UINT32(0, backwards.load());
+    TEST_ASSERT_EQUAL_UINT32(WRITES, frameBuffer.sequence());
+    for (int r = 0; r < READERS; r++) {
+        // Readers have to make progress while writer is running, not only see the final frame
+        TEST_ASSERT_GREATER_THAN(1, distinct[r]);
+        TEST_ASSERT_GREATER_THAN(0, reads[r]);
+    }
+    static CameraFrame last;
+    TEST_ASSERT_EQUAL_UINT32(WRITES, frameBuffer.read(&last));
+    TEST_ASSERT_TRUE(isConsistent(last, WRITES));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_empty_buffer);
+    RUN_TEST(test_single_thread_read_returns_latest);
+    RUN_TEST(test_concurrent_reads_are_never_torn);
+    return UNITY_END();
+}
@@ -0,0 +1,416 @@
+// Round trips of websocket frame format (src/frame_protocol.h): full, subpage and delta frames,
+// merging of subpage pairs in both sensor patterns, int16 clamping and decoding of malformed buffers.
+#include <unity.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "frame_protocol.h"
+#include "camera_frame.h"
+#include "MLX90640_API.h"
+
+static float pixels[DATA_SIZE];
+static float decoded[DATA_SIZE];
+static uint8_t buffer[FRAME_HEADER_SIZE + DATA_SIZE * 4];
+
+static FrameHeader makeHeader(uint32_t frameCounter) {
+    FrameHeader header = {};
+    header.version = FRAME_PROTOCOL_VERSION;
+    header.width = GRID_WIDTH;
+    header.height = GRID_HEIGHT;
+    header.frameCounter = frameCounter;
+    header.timestamp = 123456789;
+    header.ta = 31.25f;
+    header.minTemp = -12.34f;
+    header.maxTemp = 87.65f;
+    header.minIndex = 17;
+    header.maxIndex = 700;
+    header.mean = 24.5f;
+    header.stddev = 3.21f;
+    for (int i = 0; i < FRAME_PERCENTILE_COUNT; i++) {
+        header.percentiles[i] = 10.0f + i * 5.5f;
+    }
+    return header;
+}
+
+// Smooth scene with a hot spot, every pixel different
+static void makeScene(float *out, float offset) {
+    for (int i = 0; i < DATA_SIZE; i++) {
+        int x = i % GRID_WIDTH;
+        int y = i / GRID_WIDTH;
+        out[i] = 20.0f + offset + x * 0.37f - y * 0.21f + (abs(x - 16) < 3 && abs(y - 12) < 3 ? 40.0f : 0.0f);
+    }
+}
+
+static void assertPixelsEqual(const float *expected, const float *actual, uint16_t scale) {
+    for (int i = 0; i < DATA_SIZE; i++) {
+        TEST_ASSERT_FLOAT_WITHIN(0.5f / scale + 1e-4f, expected[i], actual[i]);
+    }
+}
+
+void setUp(void) {
+    makeScene(pixels, 0);
+    memset(decoded, 0, sizeof(decoded));
+}
+
+void tearDown(void) {}
+
+void test_full_frame_round_trip(void) {
+    FrameHeader header = makeHeader(42);
+    size_t size = encodeFrame(&header, pixels, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_size_t(frameEncodedSize(DATA_SIZE), size);
+    TEST_ASSERT_EQUAL(FRAME_DEFAULT_SCALE, header.scale);
+
+    FrameHeader out;
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+    TEST_ASSERT_EQUAL_UINT8(FRAME_TYPE_FULL, out.type);
+    TEST_ASSERT_EQUAL_UINT8(GRID_WIDTH, out.width);
+    TEST_ASSERT_EQUAL_UINT8(GRID_HEIGHT, out.height);
+    TEST_ASSERT_EQUAL_UINT32(42, out.frameCounter);
+    TEST_ASSERT_EQUAL_UINT32(123456789, out.timestamp);
+    TEST_ASSERT_EQUAL_UINT16(17, out.minIndex);
+    TEST_ASSERT_EQUAL_UINT16(700, out.maxIndex);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 31.25f, out.ta);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, -12.34f, out.minTemp);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 87.65f, out.maxTemp);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 24.5f, out.mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.005f, 3.21f, out.stddev);
+    for (int i = 0; i < FRAME_PERCENTILE_COUNT; i++) {
+        TEST_ASSERT_FLOAT_WITHIN(0.005f, header.percentiles[i], out.percentiles[i]);
+    }
+    assertPixelsEqual(pixels, decoded, FRAME_DEFAULT_SCALE);
+
+    // Header only
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(buffer, size, &out, NULL, 0));
+}
+
+void test_quantized_frame_matches_float_encoding(void) {
+    int16_t values[DATA_SIZE];
+    quantizeFrame(pixels, DATA_SIZE, FRAME_DEFAULT_SCALE, values);
+    FrameHeader header = makeHeader(1);
+    uint8_t expected[FRAME_HEADER_SIZE + DATA_SIZE * 2];
+    TEST_ASSERT_EQUAL_size_t(sizeof(expected), encodeFrame(&header, pixels, expected, sizeof(expected)));
+    TEST_ASSERT_EQUAL_size_t(sizeof(expected), encodeQuantizedFrame(&header, values, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(expected, buffer, sizeof(expected));
+}
+
+void test_custom_scale(void) {
+    FrameHeader header = makeHeader(2);
+    header.scale = 10;
+    size_t size = encodeFrame(&header, pixels, buffer, sizeof(buffer));
+    FrameHeader out;
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+    TEST_ASSERT_EQUAL_UINT16(10, out.scale);
+    assertPixelsEqual(pixels, decoded, 10);
+}
+
+void test_values_are_clamped_to_int16(void) {
+    pixels[0] = 400.0f;
+    pixels[1] = -400.0f;
+    pixels[2] = 327.67f;
+    pixels[3] = -327.68f;
+    FrameHeader header = makeHeader(3);
+    header.maxTemp = 1000.0f;
+    header.minTemp = -1000.0f;
+    size_t size = encodeFrame(&header, pixels, buffer, sizeof(buffer));
+    FrameHeader out;
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+    TEST_ASSERT_EQUAL_FLOAT(327.67f, decoded[0]);
+    TEST_ASSERT_EQUAL_FLOAT(-327.68f, decoded[1]);
+    TEST_ASSERT_EQUAL_FLOAT(327.67f, decoded[2]);
+    TEST_ASSERT_EQUAL_FLOAT(-327.68f, decoded[3]);
+    TEST_ASSERT_EQUAL_FLOAT(327.67f, out.maxTemp);
+    TEST_ASSERT_EQUAL_FLOAT(-327.68f, out.minTemp);
+
+    int16_t values[5];
+    pixels[4] = NAN; // pixel without temperature, same as MLX90640_FIXED_INVALID
+    quantizeFrame(pixels, 5, FRAME_DEFAULT_SCALE, values);
+    TEST_ASSERT_EQUAL_INT16(32767, values[0]);
+    TEST_ASSERT_EQUAL_INT16(-32768, values[1]);
+    TEST_ASSERT_EQUAL_INT16(-32768, values[4]);
+}
+
+void test_subpage_round_trip(void) {
+    for (uint8_t pattern = FRAME_PATTERN_INTERLEAVED; pattern <= FRAME_PATTERN_CHESS; pattern++) {
+        for (uint8_t subPage = 0; subPage < 2; subPage++) {
+            FrameHeader header = makeHeader(4);
+            size_t size = encodeSubpage(&header, pixels, subPage, pattern, buffer, sizeof(buffer));
+            TEST_ASSERT_EQUAL_size_t(subpageEncodedSize(DATA_SIZE), size);
+            TEST_ASSERT_EQUAL_UINT8(FRAME_TYPE_SUBPAGE, header.type);
+
+            // Pixels of the other subpage keep what decoder had
+            for (int i = 0; i < DATA_SIZE; i++) {
+                decoded[i] = -1000.0f;
+            }
+            FrameHeader out;
+            TEST_ASSERT_EQUAL_INT(DATA_SIZE / 2, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+            TEST_ASSERT_EQUAL_UINT8(FRAME_TYPE_SUBPAGE, out.type);
+            TEST_ASSERT_EQUAL_UINT32(4, out.frameCounter);
+            for (int i = 0; i < DATA_SIZE; i++) {
+                if (isSubpagePixel(i, GRID_WIDTH, pattern, subPage)) {
+                    TEST_ASSERT_FLOAT_WITHIN(0.0051f, pixels[i], decoded[i]);
+                } else {
+                    TEST_ASSERT_EQUAL_FLOAT(-1000.0f, decoded[i]);
+                }
+            }
+        }
+    }
+}
+
+void test_subpage_rejects_bad_subpage(void) {
+    FrameHeader header = makeHeader(5);
+    TEST_ASSERT_EQUAL_size_t(0, encodeSubpage(&header, pixels, 2, FRAME_PATTERN_CHESS, buffer, sizeof(buffer)));
+    TEST_ASSERT_EQUAL_size_t(0, encodeSubpage(&header, pixels, 0, FRAME_PATTERN_CHESS, buffer, subpageEncodedSize(DATA_SIZE) - 1));
+}
+
+// Each pixel belongs to exactly one subpage, and it's the subpage Melexis To calculation writes it in
+void test_subpage_patterns_match_sensor(void) {
+    static paramsMLX90640 params; // zeroed, only which pixels get written matters
+    static uint16_t frameData[834];
+    for (uint8_t pattern = FRAME_PATTERN_INTERLEAVED; pattern <= FRAME_PATTERN_CHESS; pattern++) {
+        int counts[2] = {};
+        for (uint8_t subPage = 0; subPage < 2; subPage++) {
+            frameData[832] = pattern == FRAME_PATTERN_CHESS ? 0x1000 : 0;
+            frameData[833] = subPage;
+            for (int i = 0; i < DATA_SIZE; i++) {
+                decoded[i] = 12345.0f;
+            }
+            MLX90640_CalculateTo(frameData, &params, 0.95f, 25.0f, decoded);
+            for (int i = 0; i < DATA_SIZE; i++) {
+                bool written = !(decoded[i] == 12345.0f);
+                TEST_ASSERT_EQUAL(written, isSubpagePixel(i, GRID_WIDTH, pattern, subPage));
+                TEST_ASSERT_NOT_EQUAL(isSubpagePixel(i, GRID_WIDTH, pattern, subPage), isSubpagePixel(i, GRID_WIDTH, pattern, 1 - subPage));
+                counts[subPage] += written;
+            }
+        }
+        TEST_ASSERT_EQUAL_INT(DATA_SIZE / 2, counts[0]);
+        TEST_ASSERT_EQUAL_INT(DATA_SIZE / 2, counts[1]);
+    }
+}
+
+// Device merges every subpage of a moving scene into its working frame and sends it as subpage frame,
+// client merges it into its own frame. Once both halves arrived, client has exactly the frame a full
+// frame message would give
+void test_subpage_pairs_merge_into_full_frame(void) {
+    static float working[DATA_SIZE];
+    static float scene[DATA_SIZE];
+    static float full[DATA_SIZE];
+    for (uint8_t pattern = FRAME_PATTERN_INTERLEAVED; pattern <= FRAME_PATTERN_CHESS; pattern++) {
+        for (int i = 0; i < DATA_SIZE; i++) {
+            working[i] = 0;
+            decoded[i] = -1000.0f;
+        }
+        for (int n = 0; n < 16; n++) {
+            // Each half-frame is measured at its own time, hot spot moves between them
+            uint8_t subPage = n & 1;
+            makeScene(scene, n * 0.5f);
+            for (int i = 0; i < DATA_SIZE; i++) {
+                int x = i % GRID_WIDTH;
+                scene[i] += (x == n || x == n + 1) ? 30.0f : 0.0f;
+                if (isSubpagePixel(i, GRID_WIDTH, pattern, subPage)) {
+                    working[i] = scene[i];
+                }
+            }
+
+            FrameHeader header = makeHeader(100 + n);
+            size_t size = encodeSubpage(&header, working, subPage, pattern, buffer, sizeof(buffer));
+            TEST_ASSERT_EQUAL_size_t(subpageEncodedSize(DATA_SIZE), size);
+            FrameHeader out;
+            TEST_ASSERT_EQUAL_INT(DATA_SIZE / 2, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+            TEST_ASSERT_EQUAL_UINT8(subPage, buffer[FRAME_HEADER_SIZE]);
+            TEST_ASSERT_EQUAL_UINT8(pattern, buffer[FRAME_HEADER_SIZE + 1]);
+            if (n == 0) {
+                // Only first half received yet, other one untouched
+                for (int i = 0; i < DATA_SIZE; i++) {
+                    if (!isSubpagePixel(i, GRID_WIDTH, pattern, subPage)) {
+                        TEST_ASSERT_EQUAL_FLOAT(-1000.0f, decoded[i]);
+                    }
+                }
+                continue;
+            }
+
+            header = makeHeader(100 + n);
+            size = encodeFrame(&header, working, buffer, sizeof(buffer));
+            TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(buffer, size, &out, full, DATA_SIZE));
+            TEST_ASSERT_EQUAL_FLOAT_ARRAY(full, decoded, DATA_SIZE);
+        }
+    }
+}
+
+void test_delta_sequence_tracks_reference(void) {
+    int16_t reference[DATA_SIZE];
+    FrameHeader header = makeHeader(10);
+    size_t size = encodeFrame(&header, pixels, buffer, sizeof(buffer));
+    quantizeFrame(pixels, DATA_SIZE, header.scale, reference);
+    FrameHeader out;
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+
+    for (int frame = 1; frame <= 20; frame++) {
+        // Drifting scene with part of pixels unchanged and a few large jumps
+        for (int i = 0; i < DATA_SIZE; i++) {
+            if ((i + frame) % 3 == 0) {
+                pixels[i] += 0.01f * ((i * 7 + frame) % 11 - 5);
+            }
+        }
+        pixels[frame * 13] += 150.0f;
+        header = makeHeader(10 + frame);
+        size = encodeDeltaFrame(&header, pixels, reference, 0, buffer, sizeof(buffer));
+        TEST_ASSERT_GREATER_THAN(FRAME_HEADER_SIZE, size);
+        TEST_ASSERT_LESS_THAN(frameEncodedSize(DATA_SIZE), size);
+        TEST_ASSERT_EQUAL_UINT8(FRAME_TYPE_DELTA, header.type);
+
+        TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+        TEST_ASSERT_EQUAL_UINT8(FRAME_TYPE_DELTA, out.type);
+        TEST_ASSERT_EQUAL_UINT32(10 + frame, out.frameCounter);
+        // Lossless: decoder ends up with exactly the quantized frame, same as encoder reference
+        for (int i = 0; i < DATA_SIZE; i++) {
+            TEST_ASSERT_EQUAL_INT16(reference[i], (int16_t)lroundf(decoded[i] * out.scale));
+        }
+        assertPixelsEqual(pixels, decoded, out.scale);
+    }
+}
+
+void test_delta_of_unchanged_frame_is_one_run(void) {
+    int16_t reference[DATA_SIZE];
+    quantizeFrame(pixels, DATA_SIZE, FRAME_DEFAULT_SCALE, reference);
+    FrameHeader header = makeHeader(11);
+    size_t size = encodeDeltaFrame(&header, pixels, reference, 0, buffer, sizeof(buffer));
+    // Zero marker and varint of 767
+    TEST_ASSERT_EQUAL_size_t(FRAME_HEADER_SIZE + 3, size);
+    memcpy(decoded, pixels, sizeof(decoded));
+    FrameHeader out;
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+    TEST_ASSERT_EQUAL_MEMORY(pixels, decoded, sizeof(decoded));
+}
+
+void test_delta_deadband(void) {
+    int16_t reference[DATA_SIZE];
+    quantizeFrame(pixels, DATA_SIZE, FRAME_DEFAULT_SCALE, reference);
+    int16_t original[DATA_SIZE];
+    memcpy(original, reference, sizeof(original));
+    pixels[5] += 0.02f; // within deadband of 2
+    pixels[6] += 0.05f;
+    FrameHeader header = makeHeader(12);
+    size_t size = encodeDeltaFrame(&header, pixels, reference, 2, buffer, sizeof(buffer));
+    TEST_ASSERT_GREATER_THAN(0, size);
+    TEST_ASSERT_EQUAL_INT16(original[5], reference[5]);
+    TEST_ASSERT_EQUAL_INT16(original[6] + 5, reference[6]);
+
+    for (int i = 0; i < DATA_SIZE; i++) {
+        decoded[i] = (float)original[i] / FRAME_DEFAULT_SCALE;
+    }
+    FrameHeader out;
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+    for (int i = 0; i < DATA_SIZE; i++) {
+        TEST_ASSERT_EQUAL_INT16(reference[i], (int16_t)lroundf(decoded[i] * out.scale));
+    }
+}
+
+void test_delta_too_large_leaves_reference(void) {
+    int16_t reference[DATA_SIZE] = {};
+    int16_t original[DATA_SIZE] = {};
+    FrameHeader header = makeHeader(13);
+    TEST_ASSERT_EQUAL_size_t(0, encodeDeltaFrame(&header, pixels, reference, 0, buffer, FRAME_HEADER_SIZE + 100));
+    TEST_ASSERT_EQUAL_INT16_ARRAY(original, reference, DATA_SIZE);
+}
+
+void test_encode_rejects_small_buffer(void) {
+    FrameHeader header = makeHeader(14);
+    TEST_ASSERT_EQUAL_size_t(0, encodeFrame(&header, pixels, buffer, frameEncodedSize(DATA_SIZE) - 1));
+    header.width = 0;
+    TEST_ASSERT_EQUAL_size_t(0, encodeFrame(&header, pixels, buffer, sizeof(buffer)));
+}
+
+void test_malformed_buffers(void) {
+    FrameHeader header = makeHeader(20);
+    size_t size = encodeFrame(&header, pixels, buffer, sizeof(buffer));
+    FrameHeader out;
+
+    // Shorter than header, truncated pixels, no room for pixels
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, FRAME_HEADER_SIZE - 1, &out, decoded, DATA_SIZE));
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size - 1, &out, decoded, DATA_SIZE));
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size, &out, decoded, DATA_SIZE - 1));
+
+    // Other version, zero scale
+    buffer[0] = FRAME_PROTOCOL_VERSION + 1;
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+    buffer[0] = FRAME_PROTOCOL_VERSION;
+    buffer[18] = 0;
+    buffer[19] = 0;
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+
+    // Truncated subpage, subpage and pattern out of range
+    header = makeHeader(21);
+    size = encodeSubpage(&header, pixels, 1, FRAME_PATTERN_CHESS, buffer, sizeof(buffer));
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size - 1, &out, decoded, DATA_SIZE));
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size, &out, decoded, DATA_SIZE - 1));
+    buffer[FRAME_HEADER_SIZE] = 2;
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+    buffer[FRAME_HEADER_SIZE] = 1;
+    buffer[FRAME_HEADER_SIZE + 1] = FRAME_PATTERN_CHESS + 1;
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+}
+
+void test_malformed_delta(void) {
+    int16_t reference[DATA_SIZE] = {};
+    FrameHeader header = makeHeader(22);
+    size_t size = encodeDeltaFrame(&header, pixels, reference, 0, buffer, sizeof(buffer));
+    FrameHeader out;
+
+    // Token stream ends before last pixel, varint cut in the middle
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size - 2, &out, decoded, DATA_SIZE));
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, FRAME_HEADER_SIZE, &out, decoded, DATA_SIZE));
+    buffer[FRAME_HEADER_SIZE] = 0x80;
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, FRAME_HEADER_SIZE + 1, &out, decoded, DATA_SIZE));
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size, &out, decoded, DATA_SIZE - 1));
+
+    // Run of unchanged pixels past the end of frame: marker 0 and run 768 (varint 0x80 0x06)
+    uint8_t run[] = {0, 0x80, 0x06};
+    memcpy(buffer + FRAME_HEADER_SIZE, run, sizeof(run));
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, FRAME_HEADER_SIZE + sizeof(run), &out, decoded, DATA_SIZE));
+    run[1] = 0xFF; // 767, exactly the whole frame
+    run[2] = 0x05;
+    memcpy(buffer + FRAME_HEADER_SIZE, run, sizeof(run));
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(buffer, FRAME_HEADER_SIZE + sizeof(run), &out, decoded, DATA_SIZE));
+}
+
+// Current behaviour, pinned so that a change is deliberate: header only decode of delta frame
+// doesn't look at tokens and returns pixel count even when token stream is truncated
+void test_delta_header_only_is_not_validated(void) {
+    int16_t reference[DATA_SIZE] = {};
+    FrameHeader header = makeHeader(23);
+    encodeDeltaFrame(&header, pixels, reference, 0, buffer, sizeof(buffer));
+    FrameHeader out;
+    TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(buffer, FRAME_HEADER_SIZE, &out, NULL, 0));
+}
+
+// Frame type decoder doesn't know is rejected like web client does, not read as pixels
+void test_unknown_type_is_rejected(void) {
+    FrameHeader header = makeHeader(24);
+    size_t size = encodeFrame(&header, pixels, buffer, sizeof(buffer));
+    buffer[1] = FRAME_TYPE_DELTA + 1;
+    FrameHeader out;
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size, &out, decoded, DATA_SIZE));
+    TEST_ASSERT_EQUAL_INT(-1, decodeFrame(buffer, size, &out, NULL, 0));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_full_frame_round_trip);
+    RUN_TEST(test_quantized_frame_matches_float_encoding);
+    RUN_TEST(test_custom_scale);
+    RUN_TEST(test_values_are_clamped_to_int16);
+    RUN_TEST(test_subpage_round_trip);
+    RUN_TEST(test_subpage_rejects_bad_subpage);
+    RUN_TEST(test_subpage_patterns_match_sensor);
+    RUN_TEST(test_subpage_pairs_merge_into_full_frame);
+    RUN_TEST(test_delta_sequence_tracks_reference);
+    RUN_TEST(test_delta_of_unchanged_frame_is_one_run);
+    RUN_TEST(test_delta_deadband);
+    RUN_TEST(test_delta_too_large_leaves_reference);
+    RUN_TEST(test_encode_rejects_small_buffer);
+    RUN_TEST(test_malformed_buffers);
+    RUN_TEST(test_malformed_delta);
+    RUN_TEST(test_delta_header_only_is_not_validated);
+    RUN_TEST(test_unknown_type_is_rejected);
+    return UNITY_END();
+}
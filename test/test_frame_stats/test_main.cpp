@@ -0,0 +1,156 @@
+// Frame statistics (src/frame_stats.h) against straightforward calculation on sorted copy of frame:
+// min and max with their index, mean, standard deviation and percentiles within a fine bin.
+// NaN pixels the To kernels produce are left out, scratch histogram is left zeroed for next frame.
+#include <unity.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+#include "frame_stats.h"
+#include "frame_protocol.h"
+#include "camera_frame.h"
+
+#define FRAMES 50
+
+static StatsWork work;
+static FrameStats stats;
+static float pixels[DATA_SIZE];
+static float sorted[DATA_SIZE];
+static uint32_t randomState;
+
+// Deterministic uniform random number in [min, max)
+static float uniform(float min, float max) {
+    randomState = randomState * 1664525 + 1013904223;
+    return min + (max - min) * (randomState >> 8) / 16777216.0f;
+}
+
+// Room with a warm blob and noise, blob temperature and position change with n
+static void makeScene(int n) {
+    float blobX = uniform(4, 28);
+    float blobY = uniform(4, 20);
+    float blobTemp = uniform(30, 250);
+    for (int i = 0; i < DATA_SIZE; i++) {
+        float dx = i % GRID_WIDTH - blobX;
+        float dy = i / GRID_WIDTH - blobY;
+        pixels[i] = 18.0f + n * 0.1f + blobTemp * expf(-(dx * dx + dy * dy) / 12.0f) + uniform(-0.5f, 0.5f);
+    }
+}
+
+static int compareFloat(const void *a, const void *b) {
+    float x = *(const float *)a;
+    float y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+// Checks stats against finite pixels of frame sorted
+static void assertMatchesSorted(void) {
+    size_t valid = 0;
+    double sum = 0;
+    for (int i = 0; i < DATA_SIZE; i++) {
+        if (isfinite(pixels[i])) {
+            sorted[valid++] = pixels[i];
+            sum += pixels[i];
+        }
+    }
+    qsort(sorted, valid, sizeof(float), compareFloat);
+    double mean = sum / valid;
+    double squares = 0;
+    for (size_t i = 0; i < valid; i++) {
+        squares += (sorted[i] - mean) * (sorted[i] - mean);
+    }
+
+    TEST_ASSERT_EQUAL_FLOAT(sorted[0], stats.minTemp);
+    TEST_ASSERT_EQUAL_FLOAT(sorted[valid - 1], stats.maxTemp);
+    TEST_ASSERT_EQUAL_FLOAT(stats.minTemp, pixels[stats.minIndex]);
+    TEST_ASSERT_EQUAL_FLOAT(stats.maxTemp, pixels[stats.maxIndex]);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, mean, stats.mean);
+    TEST_ASSERT_FLOAT_WITHIN(0.001f, sqrt(squares / valid), stats.stddev);
+    // Estimate is interpolated within fine bin of pixel at the rank, so it's within a bin width of it
+    for (int p = 0; p < FRAME_PERCENTILE_COUNT; p++) {
+        size_t rank = (size_t)(FRAME_PERCENTILES[p] / 100.0f * (valid - 1));
+        TEST_ASSERT_FLOAT_WITHIN(STATS_BIN_WIDTH, sorted[rank], stats.percentiles[p]);
+    }
+    size_t histogramTotal = 0;
+    for (int bin = 0; bin < STATS_HISTOGRAM_BINS; bin++) {
+        histogramTotal += stats.histogram[bin];
+    }
+    TEST_ASSERT_EQUAL_size_t(valid, histogramTotal);
+    for (int bin = 0; bin < STATS_FINE_BINS; bin++) {
+        TEST_ASSERT_EQUAL_UINT16(0, work.bins[bin]);
+    }
+}
+
+void setUp(void) {
+    randomState = 1;
+}
+
+void tearDown(void) {}
+
+void test_matches_sorted_frame(void) {
+    for (int n = 0; n < FRAMES; n++) {
+        makeScene(n);
+        computeFrameStats(&work, pixels, DATA_SIZE, &stats);
+        assertMatchesSorted();
+    }
+}
+
+// Values outside of sensor range go to edge fine bins, exact min and max still bound percentiles there
+void test_values_outside_range(void) {
+    makeScene(0);
+    pixels[10] = -55.0f;
+    pixels[20] = 410.0f;
+    computeFrameStats(&work, pixels, DATA_SIZE, &stats);
+    TEST_ASSERT_EQUAL_UINT16(10, stats.minIndex);
+    TEST_ASSERT_EQUAL_UINT16(20, stats.maxIndex);
+    assertMatchesSorted();
+}
+
+void test_uniform_frame(void) {
+    for (int i = 0; i < DATA_SIZE; i++) {
+        pixels[i] = 21.5f;
+    }
+    computeFrameStats(&work, pixels, DATA_SIZE, &stats);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.stddev);
+    TEST_ASSERT_EQUAL_UINT16(DATA_SIZE, stats.histogram[0]);
+    assertMatchesSorted();
+}
+
+// NaN pixels, also first one of frame, don't reach min, max, mean or percentiles
+void test_nan_pixels_skipped(void) {
+    makeScene(0);
+    for (int i = 0; i < DATA_SIZE; i += 7) {
+        pixels[i] = NAN;
+    }
+    computeFrameStats(&work, pixels, DATA_SIZE, &stats);
+    TEST_ASSERT_FALSE(isnan(stats.minTemp) || isnan(stats.maxTemp) || isnan(stats.mean) || isnan(stats.stddev));
+    assertMatchesSorted();
+
+    // Coldest pixels in first fine bin with NaNs
+    for (int i = 1; i < DATA_SIZE; i += 7) {
+        pixels[i] = STATS_RANGE_MIN + 0.1f;
+    }
+    computeFrameStats(&work, pixels, DATA_SIZE, &stats);
+    assertMatchesSorted();
+}
+
+void test_all_nan_frame(void) {
+    for (int i = 0; i < DATA_SIZE; i++) {
+        pixels[i] = NAN;
+    }
+    computeFrameStats(&work, pixels, DATA_SIZE, &stats);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.minTemp);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.maxTemp);
+    TEST_ASSERT_EQUAL_FLOAT(0.0f, stats.mean);
+    for (int bin = 0; bin < STATS_FINE_BINS; bin++) {
+        TEST_ASSERT_EQUAL_UINT16(0, work.bins[bin]);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_matches_sorted_frame);
+    RUN_TEST(test_values_outside_range);
+    RUN_TEST(test_uniform_frame);
+    RUN_TEST(test_nan_pixels_skipped);
+    RUN_TEST(test_all_nan_frame);
+    return UNITY_END();
+}
@@ -0,0 +1,150 @@
+// Bus traffic of frame and EEPROM reads through transport interface (MLX90640_I2C_Driver.h): whole
+// frame comes in a single read per subpage, short reads of the bus are reported as errors. Bus is
+// simulated sensor wrapped by a transport that logs reads and can cut them short, like Wire does
+// when sensor stops sending, with counting transport on top as in native build.
+#include <unity.h>
+#include <string.h>
+#include "MLX90640_API.h"
+#include "MLX90640_I2C_Driver.h"
+#include "MLX90640_Simulator.h"
+#include "MLX90640_Counting.h"
+
+#define MLX90640_ADDRESS 0x33
+#define CONTROL_REGISTER 0x1901
+#define SUBPAGES 8
+
+struct BusLog {
+    const i2cTransportMLX90640 *inner;
+    uint32_t longReads; // reads of more than one word
+    unsigned int lastLongAddress;
+    unsigned int lastLongWords;
+    unsigned int shortReadAddress; // reads from this address fail, 0 for none
+};
+
+static uint16_t eeData[MLX90640_EEPROM_WORDS];
+static uint16_t recorded[2 * MLX90640_FRAME_WORDS];
+static uint16_t frameData[MLX90640_FRAME_WORDS];
+static simulatorMLX90640 simulator;
+static i2cTransportMLX90640 simulatorTransport;
+static BusLog busLog;
+static i2cTransportMLX90640 busTransport;
+static countingMLX90640 counting;
+static i2cTransportMLX90640 countingTransport;
+
+static int busRead(void *context, uint8_t slaveAddr, unsigned int startAddress, unsigned int nWordsRead, uint16_t *data) {
+    BusLog *log = (BusLog *)context;
+    if (nWordsRead > 1) {
+        log->longReads++;
+        log->lastLongAddress = startAddress;
+        log->lastLongWords = nWordsRead;
+    }
+    int error = log->inner->read(log->inner->context, slaveAddr, startAddress, nWordsRead, data);
+    if (startAddress == log->shortReadAddress) {
+        // Sensor sent less than requested, rest of buffer is whatever was there
+        return -1;
+    }
+    return error;
+}
+
+static int busWrite(void *context, uint8_t slaveAddr, unsigned int writeAddress, uint16_t data) {
+    BusLog *log = (BusLog *)context;
+    return log->inner->write(log->inner->context, slaveAddr, writeAddress, data);
+}
+
+static void busSleep(void *context, uint32_t us) {
+    BusLog *log = (BusLog *)context;
+    log->inner->sleep(log->inner->context, us);
+}
+
+static uint32_t busMicros(void *context) {
+    BusLog *log = (BusLog *)context;
+    return log->inner->micros(log->inner->context);
+}
+
+void setUp(void) {
+    eeData[12] = CONTROL_REGISTER;
+    for (int i = 0; i < MLX90640_EEPROM_WORDS; i++) {
+        if (i != 12) {
+            eeData[i] = (uint16_t)(i * 7 + 1);
+        }
+    }
+    for (int subPage = 0; subPage < 2; subPage++) {
+        uint16_t *record = &recorded[subPage * MLX90640_FRAME_WORDS];
+        for (int i = 0; i < 832; i++) {
+            record[i] = (uint16_t)(i * 5 + subPage * 2000);
+        }
+        record[833] = subPage;
+    }
+    MLX90640_SimulatorInit(&simulator, eeData, recorded, 2);
+    MLX90640_SimulatorTransport(&simulator, &simulatorTransport);
+    busLog = {};
+    busLog.inner = &simulatorTransport;
+    busTransport = {busRead, busWrite, busSleep, busMicros, &busLog};
+    MLX90640_CountingInit(&counting, &busTransport, 0, 0);
+    MLX90640_CountingTransport(&counting, &countingTransport);
+    MLX90640_SetTransport(&countingTransport);
+}
+
+void tearDown(void) {
+    MLX90640_SetTransport(NULL);
+}
+
+void test_eeprom_dump_is_one_read(void) {
+    uint16_t dump[MLX90640_EEPROM_WORDS];
+    TEST_ASSERT_EQUAL_INT(0, MLX90640_DumpEE(MLX90640_ADDRESS, dump));
+    TEST_ASSERT_EQUAL_UINT32(1, counting.reads);
+    TEST_ASSERT_EQUAL_UINT32(MLX90640_EEPROM_WORDS, counting.wordsRead);
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(eeData, dump, MLX90640_EEPROM_WORDS);
+}
+
+void test_frame_is_one_read_per_subpage(void) {
+    for (int n = 0; n < SUBPAGES; n++) {
+        uint32_t longReads = busLog.longReads;
+        MLX90640_CountingReset(&counting);
+        int subPage = MLX90640_GetFrameData(MLX90640_ADDRESS, frameData);
+        TEST_ASSERT_EQUAL_INT(n & 1, subPage);
+        TEST_ASSERT_EQUAL_UINT16_ARRAY(&recorded[subPage * MLX90640_FRAME_WORDS], frameData, 832);
+
+        // Everything else is a single word: status polls, control register, write check
+        TEST_ASSERT_EQUAL_UINT32(longReads + 1, busLog.longReads);
+        TEST_ASSERT_EQUAL_UINT(0x0400, busLog.lastLongAddress);
+        TEST_ASSERT_EQUAL_UINT(832, busLog.lastLongWords);
+        TEST_ASSERT_EQUAL_UINT32(counting.reads + 831, counting.wordsRead);
+        TEST_ASSERT_EQUAL_UINT32(0, counting.errors);
+    }
+}
+
+void test_short_frame_read_is_reported(void) {
+    acquisitionStatsMLX90640 before;
+    MLX90640_GetAcquisitionStats(&before);
+    busLog.shortReadAddress = 0x0400;
+    TEST_ASSERT_EQUAL_INT(-1, MLX90640_GetFrameData(MLX90640_ADDRESS, frameData));
+    TEST_ASSERT_EQUAL_UINT32(1, counting.errors);
+    TEST_ASSERT_EQUAL_UINT32(1, busLog.longReads);
+
+    // Not counted as acquired frame, and next read gets through once bus is fine again
+    acquisitionStatsMLX90640 after;
+    MLX90640_GetAcquisitionStats(&after);
+    TEST_ASSERT_EQUAL_UINT32(before.frames, after.frames);
+    busLog.shortReadAddress = 0;
+    TEST_ASSERT_GREATER_OR_EQUAL(0, MLX90640_GetFrameData(MLX90640_ADDRESS, frameData));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(&recorded[frameData[833] * MLX90640_FRAME_WORDS], frameData, 832);
+}
+
+void test_short_status_read_is_reported(void) {
+    busLog.shortReadAddress = 0x8000;
+    TEST_ASSERT_EQUAL_INT(-1, MLX90640_GetFrameData(MLX90640_ADDRESS, frameData));
+    TEST_ASSERT_EQUAL_INT(-1, MLX90640_GetFrameDataScheduled(MLX90640_ADDRESS, frameData));
+    // Write is checked by reading register back, failed read back fails the write
+    TEST_ASSERT_EQUAL_INT(-1, MLX90640_I2CWrite(MLX90640_ADDRESS, 0x8000, 0x0030));
+    TEST_ASSERT_EQUAL_UINT32(0, busLog.longReads);
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_eeprom_dump_is_one_read);
+    RUN_TEST(test_frame_is_one_read_per_subpage);
+    RUN_TEST(test_short_frame_read_is_reported);
+    RUN_TEST(test_short_status_read_is_reported);
+    return UNITY_END();
+}
@@ -0,0 +1,407 @@
+// PNG and JPEG encoders (src/image_encoder.h) checked by decoding their output in the test. PNG is
+// parsed chunk by chunk with CRCs, its fixed Huffman deflate stream is inflated and unfiltered back
+// into exactly the indexed render. JPEG segments are parsed and the entropy coded scan is decoded with
+// Huffman tables of its DHT: every block is there and DC of each block matches mean of its samples
+// within quantization. Renders that aren't indexed and too small output buffers are rejected.
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "image_encoder.h"
+#include "thermal_image.h"
+#include "calibration_cache.h"
+#include "camera_frame.h"
+
+#define MAX_PIXELS (IMAGE_MAX_WIDTH * GRID_HEIGHT * MAX_IMAGE_SCALE)
+#define PNG_PIECE 100 // bytes read from encoder at a time, as response fill does
+
+static ImageRender render;
+static PngEncoder pngEncoder;
+static JpegEncoder jpegEncoder;
+static float pixels[DATA_SIZE];
+static uint8_t indexed[MAX_PIXELS];
+static uint8_t encoded[MAX_PIXELS * 2];
+static uint8_t zlibData[MAX_PIXELS * 2];
+static uint8_t inflated[MAX_PIXELS + GRID_HEIGHT * MAX_IMAGE_SCALE]; // filter type byte per row
+static uint8_t unfiltered[MAX_PIXELS];
+
+static uint32_t getBE32(const uint8_t *data) {
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | (data[2] << 8) | data[3];
+}
+
+static uint16_t getBE16(const uint8_t *data) {
+    return (data[0] << 8) | data[1];
+}
+
+// Gradient with a hot spot and a sharp edge
+static void makeFrame(void) {
+    for (int i = 0; i < DATA_SIZE; i++) {
+        float dx = i % GRID_WIDTH - 10.5f;
+        float dy = i / GRID_WIDTH - 12.0f;
+        pixels[i] = 20.0f + 0.2f * (i / GRID_WIDTH) + 25.0f * expf(-(dx * dx + dy * dy) / 15.0f) + (i % GRID_WIDTH > 24 ? 8.0f : 0.0f);
+    }
+}
+
+static void prepareRender(uint8_t scale, uint8_t palette) {
+    TEST_ASSERT_TRUE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, scale, IMAGE_FORMAT_INDEXED, palette));
+    TEST_ASSERT_EQUAL_size_t(imageSize(&render), renderImage(&render, 0, indexed, sizeof(indexed)));
+}
+
+// PNG
+
+// Deflate bit reader, bits are taken least significant first
+struct BitReader {
+    const uint8_t *data;
+    size_t size;
+    size_t position; // in bits
+};
+
+static uint32_t readBits(BitReader *reader, int count) {
+    uint32_t value = 0;
+    for (int i = 0; i < count; i++, reader->position++) {
+        TEST_ASSERT_TRUE(reader->position / 8 < reader->size);
+        value |= ((reader->data[reader->position / 8] >> (reader->position % 8)) & 1) << i;
+    }
+    return value;
+}
+
+// Literal/length symbol of fixed Huffman code, code bits come most significant first
+static int readFixedSymbol(BitReader *reader) {
+    int code = 0;
+    for (int length = 1; length <= 9; length++) {
+        code = (code << 1) | readBits(reader, 1);
+        if (length == 7 && code < 24) {
+            return 256 + code;
+        }
+        if (length == 8 && code >= 0x30 && code < 0xC0) {
+            return code - 0x30;
+        }
+        if (length == 8 && code >= 0xC0 && code < 0xC8) {
+            return 280 + code - 0xC0;
+        }
+        if (length == 9 && code >= 0x190) {
+            return 144 + code - 0x190;
+        }
+    }
+    TEST_FAIL_MESSAGE("invalid fixed Huffman code");
+    return -1;
+}
+
+// Inflates zlib stream of a single fixed Huffman block, the only kind encoder writes
+static size_t inflateFixed(const uint8_t *data, size_t size, uint8_t *out, size_t outSize) {
+    static const uint16_t lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+    static const uint16_t distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+    TEST_ASSERT_EQUAL_UINT8(0x78, data[0]);
+    TEST_ASSERT_EQUAL_INT(0, ((data[0] << 8) | data[1]) % 31);
+    BitReader reader = {data + 2, size - 6, 0};
+    TEST_ASSERT_EQUAL_UINT32(1, readBits(&reader, 1)); // final block
+    TEST_ASSERT_EQUAL_UINT32(1, readBits(&reader, 2)); // fixed codes
+    size_t length = 0;
+    for (int symbol; (symbol = readFixedSymbol(&reader)) != 256;) {
+        if (symbol < 256) {
+            TEST_ASSERT_TRUE(length < outSize);
+            out[length++] = symbol;
+            continue;
+        }
+        int code = symbol - 257;
+        TEST_ASSERT_TRUE(code < 29);
+        int extra = code < 8 || code == 28 ? 0 : (code - 4) / 4;
+        size_t count = lengthBase[code] + readBits(&reader, extra);
+        code = 0;
+        for (int i = 0; i < 5; i++) {
+            code = (code << 1) | readBits(&reader, 1);
+        }
+        TEST_ASSERT_TRUE(code < 30);
+        extra = code < 4 ? 0 : code / 2 - 1;
+        size_t distance = distanceBase[code] + readBits(&reader, extra);
+        TEST_ASSERT_TRUE(distance <= length && length + count <= outSize);
+        for (size_t i = 0; i < count; i++, length++) {
+            out[length] = out[length - distance];
+        }
+    }
+    // Adler-32 of inflated data follows the block, byte aligned
+    uint32_t a = 1;
+    uint32_t b = 0;
+    for (size_t i = 0; i < length; i++) {
+        a = (a + out[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    TEST_ASSERT_EQUAL_UINT32((b << 16) | a, getBE32(data + size - 4));
+    TEST_ASSERT_TRUE((reader.position + 7) / 8 == size - 6);
+    return length;
+}
+
+// Encodes render as PNG read out in pieces, checks its chunks and returns image decoded from it
+static size_t encodeAndDecodePng(void) {
+    TEST_ASSERT_TRUE(initPngEncoder(&pngEncoder, &render));
+    size_t size = 0;
+    for (size_t length; (length = encodePng(&pngEncoder, encoded + size, PNG_PIECE)) > 0;) {
+        size += length;
+        TEST_ASSERT_TRUE(size + PNG_PIECE <= sizeof(encoded));
+    }
+    TEST_ASSERT_EQUAL_size_t(0, encodePng(&pngEncoder, encoded + size, PNG_PIECE));
+
+    static const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    TEST_ASSERT_EQUAL_MEMORY(signature, encoded, 8);
+    size_t width = 0;
+    size_t height = 0;
+    size_t zlibSize = 0;
+    bool ended = false;
+    for (size_t position = 8; position < size;) {
+        TEST_ASSERT_FALSE(ended);
+        uint32_t length = getBE32(encoded + position);
+        const uint8_t *type = encoded + position + 4;
+        const uint8_t *data = type + 4;
+        TEST_ASSERT_TRUE(position + 12 + length <= size);
+        TEST_ASSERT_EQUAL_UINT32(crc32Update(0, type, length + 4), getBE32(data + length));
+        if (memcmp(type, "IHDR", 4) == 0) {
+            TEST_ASSERT_EQUAL_UINT32(13, length);
+            width = getBE32(data);
+            height = getBE32(data + 4);
+            TEST_ASSERT_EQUAL_UINT8(8, data[8]); // bit depth
+            TEST_ASSERT_EQUAL_UINT8(3, data[9]); // indexed color
+        } else if (memcmp(type, "PLTE", 4) == 0) {
+            TEST_ASSERT_EQUAL_UINT32(3 * PALETTE_SIZE, length);
+            for (int i = 0; i < PALETTE_SIZE; i++) {
+                uint16_t color = render.palette[i];
+                TEST_ASSERT_EQUAL_UINT8((color >> 11) << 3, data[i * 3] & 0xF8);
+                TEST_ASSERT_EQUAL_UINT8(((color >> 5) & 0x3F) << 2, data[i * 3 + 1] & 0xFC);
+                TEST_ASSERT_EQUAL_UINT8((color & 0x1F) << 3, data[i * 3 + 2] & 0xF8);
+            }
+        } else if (memcmp(type, "IDAT", 4) == 0) {
+            memcpy(zlibData + zlibSize, data, length);
+            zlibSize += length;
+        } else {
+            TEST_ASSERT_EQUAL_MEMORY("IEND", type, 4);
+            ended = true;
+        }
+        position += 12 + length;
+    }
+    TEST_ASSERT_TRUE(ended);
+    TEST_ASSERT_EQUAL_size_t(imageWidth(&render), width);
+    TEST_ASSERT_EQUAL_size_t(imageHeight(&render), height);
+
+    // Every row is filter type followed by filtered bytes
+    TEST_ASSERT_EQUAL_size_t((width + 1) * height, inflateFixed(zlibData, zlibSize, inflated, sizeof(inflated)));
+    for (size_t y = 0; y < height; y++) {
+        const uint8_t *line = inflated + y * (width + 1);
+        uint8_t *row = unfiltered + y * width;
+        TEST_ASSERT_TRUE(line[0] <= 2); // none, sub or up
+        for (size_t x = 0; x < width; x++) {
+            uint8_t left = x > 0 ? row[x - 1] : 0;
+            uint8_t up = y > 0 ? row[x - width] : 0;
+            row[x] = line[x + 1] + (line[0] == 1 ? left : line[0] == 2 ? up : 0);
+        }
+    }
+    return width * height;
+}
+
+void test_png_decodes_to_render(void) {
+    const uint8_t scales[] = {1, 3, MAX_IMAGE_SCALE};
+    for (uint8_t scale : scales) {
+        prepareRender(scale, PALETTE_IRON);
+        size_t count = encodeAndDecodePng();
+        TEST_ASSERT_EQUAL_MEMORY(indexed, unfiltered, count);
+    }
+}
+
+// JPEG
+
+struct HuffmanTable {
+    uint8_t counts[16];
+    uint8_t symbols[256];
+};
+
+struct ScanReader {
+    const uint8_t *data;
+    size_t size;
+    size_t position;
+    uint32_t bits;
+    int bitCount;
+};
+
+static int readScanBit(ScanReader *reader) {
+    if (reader->bitCount == 0) {
+        TEST_ASSERT_TRUE(reader->position < reader->size);
+        reader->bits = reader->data[reader->position++];
+        if (reader->bits == 0xFF) {
+            // Stuffed zero, no restart or other markers within scan
+            TEST_ASSERT_EQUAL_UINT8(0, reader->data[reader->position++]);
+        }
+        reader->bitCount = 8;
+    }
+    return (reader->bits >> --reader->bitCount) & 1;
+}
+
+static int readHuffman(ScanReader *reader, const HuffmanTable *table) {
+    int code = 0;
+    int first = 0;
+    int index = 0;
+    for (int length = 0; length < 16; length++) {
+        code = (code << 1) | readScanBit(reader);
+        if (code - first < table->counts[length]) {
+            return table->symbols[index + code - first];
+        }
+        index += table->counts[length];
+        first = (first + table->counts[length]) << 1;
+    }
+    TEST_FAIL_MESSAGE("invalid Huffman code");
+    return -1;
+}
+
+static int readScanValue(ScanReader *reader, int category) {
+    int value = 0;
+    for (int i = 0; i < category; i++) {
+        value = (value << 1) | readScanBit(reader);
+    }
+    return category > 0 && value < (1 << (category - 1)) ? value - (1 << category) + 1 : value;
+}
+
+// Level shifted Y, Cb or Cr of palette index, JFIF conversion
+static float componentValue(int component, uint8_t index) {
+    uint16_t color = render.palette[index];
+    float r = ((color >> 11) << 3) | (color >> 13);
+    float g = (((color >> 5) & 0x3F) << 2) | ((color >> 9) & 0x03);
+    float b = ((color & 0x1F) << 3) | ((color >> 2) & 0x07);
+    return component == 0 ? 0.299f * r + 0.587f * g + 0.114f * b - 128.0f
+        : component == 1 ? -0.168736f * r - 0.331264f * g + 0.5f * b
+        : 0.5f * r - 0.418688f * g - 0.081312f * b;
+}
+
+// Mean of component over image area of size x size pixels, edge pixels repeat past image end
+static float areaMean(int component, size_t left, size_t top, size_t size) {
+    size_t width = imageWidth(&render);
+    size_t height = imageHeight(&render);
+    float sum = 0;
+    for (size_t y = top; y < top + size; y++) {
+        for (size_t x = left; x < left + size; x++) {
+            sum += componentValue(component, indexed[(y < height ? y : height - 1) * width + (x < width ? x : width - 1)]);
+        }
+    }
+    return sum / (size * size);
+}
+
+// Encodes render as JPEG, parses it and decodes DC of every block, checks it against block mean
+static size_t encodeAndCheckJpeg(uint8_t quality) {
+    initJpegEncoder(&jpegEncoder, quality);
+    size_t size = encodeJpeg(&jpegEncoder, &render, encoded, sizeof(encoded));
+    TEST_ASSERT_GREATER_THAN(0, size);
+    TEST_ASSERT_EQUAL_UINT8(0xFF, encoded[0]);
+    TEST_ASSERT_EQUAL_UINT8(0xD8, encoded[1]); // SOI
+    TEST_ASSERT_EQUAL_UINT8(0xFF, encoded[size - 2]);
+    TEST_ASSERT_EQUAL_UINT8(0xD9, encoded[size - 1]); // EOI
+
+    uint8_t quant[2][64] = {};
+    HuffmanTable tables[2][2] = {}; // [DC, AC][table]
+    int sampling = 0;
+    size_t position = 2;
+    while (encoded[position + 1] != 0xDA) {
+        TEST_ASSERT_EQUAL_UINT8(0xFF, encoded[position]);
+        uint8_t marker = encoded[position + 1];
+        uint16_t length = getBE16(encoded + position + 2);
+        const uint8_t *data = encoded + position + 4;
+        const uint8_t *end = encoded + position + 2 + length;
+        if (marker == 0xDB) {
+            for (; data < end; data += 65) {
+                memcpy(quant[data[0]], data + 1, 64);
+            }
+        } else if (marker == 0xC0) {
+            TEST_ASSERT_EQUAL_UINT16(imageHeight(&render), getBE16(data + 1));
+            TEST_ASSERT_EQUAL_UINT16(imageWidth(&render), getBE16(data + 3));
+            TEST_ASSERT_EQUAL_UINT8(3, data[5]);
+            sampling = data[7] >> 4;
+        } else if (marker == 0xC4) {
+            while (data < end) {
+                HuffmanTable *table = &tables[data[0] >> 4][data[0] & 1];
+                memcpy(table->counts, data + 1, 16);
+                int count = 0;
+                for (int i = 0; i < 16; i++) {
+                    count += table->counts[i];
+                }
+                memcpy(table->symbols, data + 17, count);
+                data += 17 + count;
+            }
+        }
+        position += 2 + length;
+    }
+    TEST_ASSERT_EQUAL_INT(render.scale > 1 ? 2 : 1, sampling); // 4:2:0 when upscaled
+    position += 2 + getBE16(encoded + position + 2);
+
+    ScanReader reader = {encoded, size - 2, position, 0, 0};
+    int mcuSize = 8 * sampling;
+    int dc[3] = {0, 0, 0};
+    for (size_t top = 0; top < imageHeight(&render); top += mcuSize) {
+        for (size_t left = 0; left < imageWidth(&render); left += mcuSize) {
+            for (int block = 0; block < sampling * sampling + 2; block++) {
+                int component = block < sampling * sampling ? 0 : block - sampling * sampling + 1;
+                int table = component > 0;
+                dc[component] += readScanValue(&reader, readHuffman(&reader, &tables[0][table]));
+                for (int k = 1; k < 64; k++) {
+                    int symbol = readHuffman(&reader, &tables[1][table]);
+                    if (symbol == 0x00) {
+                        break; // end of block
+                    }
+                    k += symbol >> 4;
+                    readScanValue(&reader, symbol & 0x0F);
+                }
+                // DC is 8 times block mean, quantized
+                float expected = component == 0
+                    ? areaMean(0, left + (block % sampling) * 8, top + (block / sampling) * 8, 8)
+                    : areaMean(component, left, top, mcuSize);
+                TEST_ASSERT_FLOAT_WITHIN(quant[table][0] / 16.0f + 0.01f, expected, dc[component] * quant[table][0] / 8.0f);
+            }
+        }
+    }
+    // Only padding bits are left of the scan
+    TEST_ASSERT_EQUAL_size_t(size - 2, reader.position);
+    return size;
+}
+
+void test_jpeg_blocks_match_render(void) {
+    const uint8_t scales[] = {1, 2, 3};
+    for (uint8_t scale : scales) {
+        prepareRender(scale, PALETTE_RAINBOW);
+        encodeAndCheckJpeg(75);
+    }
+}
+
+// Quality scales standard tables like libjpeg, 50 keeps them as they are
+void test_jpeg_quality(void) {
+    prepareRender(4, PALETTE_WHITEHOT);
+    size_t high = encodeAndCheckJpeg(95);
+    size_t low = encodeAndCheckJpeg(20);
+    TEST_ASSERT_GREATER_THAN(low, high);
+    initJpegEncoder(&jpegEncoder, 50);
+    TEST_ASSERT_EQUAL_UINT8(16, jpegEncoder.quantTables[0][0]);
+    TEST_ASSERT_EQUAL_UINT8(11, jpegEncoder.quantTables[0][1]);
+    TEST_ASSERT_EQUAL_UINT8(17, jpegEncoder.quantTables[1][0]);
+    initJpegEncoder(&jpegEncoder, 100);
+    TEST_ASSERT_EQUAL_UINT8(1, jpegEncoder.quantTables[0][63]);
+}
+
+void test_unsupported_input_rejected(void) {
+    prepareRender(2, PALETTE_RAINBOW);
+    initJpegEncoder(&jpegEncoder, 75);
+    size_t size = encodeJpeg(&jpegEncoder, &render, encoded, sizeof(encoded));
+    TEST_ASSERT_EQUAL_size_t(0, encodeJpeg(&jpegEncoder, &render, encoded, size - 1));
+    TEST_ASSERT_EQUAL_size_t(size, encodeJpeg(&jpegEncoder, &render, encoded, size));
+
+    TEST_ASSERT_TRUE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, 2, IMAGE_FORMAT_RGB565, PALETTE_RAINBOW));
+    TEST_ASSERT_FALSE(initPngEncoder(&pngEncoder, &render));
+    TEST_ASSERT_EQUAL_size_t(0, encodeJpeg(&jpegEncoder, &render, encoded, sizeof(encoded)));
+}
+
+void setUp(void) {
+    initPalettes();
+    makeFrame();
+}
+
+void tearDown(void) {}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_png_decodes_to_render);
+    RUN_TEST(test_jpeg_blocks_match_render);
+    RUN_TEST(test_jpeg_quality);
+    RUN_TEST(test_unsupported_input_rejected);
+    return UNITY_END();
+}
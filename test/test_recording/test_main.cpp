@@ -0,0 +1,178 @@
+// Recording format (src/recording.h) written into in-memory file: every frame plays back exactly as
+// quantized when recorded, chunk index gives records in order and seeking by timestamp finds the
+// frame taken at or before it through chunk headers only. Corrupted chunk fails its CRC, tail of
+// interrupted recording is never returned by seek.
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "recording.h"
+#include "frame_protocol.h"
+#include "camera_frame.h"
+
+#define FRAMES 80
+#define MAX_CHUNKS 16
+#define FRAME_INTERVAL 125 // ms, 8 fps
+#define START_TIME 5000
+#define CALIBRATION_KEY 0x12345678
+#define EMISSIVITY 0.95f
+
+static RecordingWriter writer;
+static uint8_t file[MAX_CHUNKS * RECORDING_CHUNK_SIZE];
+static uint32_t fileSize;
+static int16_t recorded[FRAMES][DATA_SIZE];
+static float pixels[DATA_SIZE];
+static uint32_t randomState;
+static uint32_t headerReads;
+
+// Deterministic uniform random number in [min, max)
+static float uniform(float min, float max) {
+    randomState = randomState * 1664525 + 1013904223;
+    return min + (max - min) * (randomState >> 8) / 16777216.0f;
+}
+
+static uint32_t frameTime(int frame) {
+    return START_TIME + frame * FRAME_INTERVAL;
+}
+
+// Noisy room with a warm spot moving across it
+static void makeFrame(int frame) {
+    for (int i = 0; i < DATA_SIZE; i++) {
+        float dx = i % GRID_WIDTH - frame % GRID_WIDTH;
+        float dy = i / GRID_WIDTH - GRID_HEIGHT / 2;
+        pixels[i] = 21.0f + 14.0f * expf(-(dx * dx + dy * dy) / 8.0f) + uniform(-0.3f, 0.3f);
+    }
+}
+
+static bool readFile(void *context, uint32_t offset, uint8_t *out, size_t size) {
+    headerReads += size == RECORDING_HEADER_SIZE;
+    if (offset + size > fileSize) {
+        return false;
+    }
+    memcpy(out, (const uint8_t *)context + offset, size);
+    return true;
+}
+
+// Records FRAMES frames into file the way recording task does, chunk after chunk
+static void record(void) {
+    randomState = 1;
+    fileSize = 0;
+    initRecordingWriter(&writer, CALIBRATION_KEY, EMISSIVITY);
+    for (int frame = 0; frame < FRAMES; frame++) {
+        makeFrame(frame);
+        quantizeFrame(pixels, DATA_SIZE, FRAME_DEFAULT_SCALE, recorded[frame]);
+        FrameHeader header = {};
+        header.version = FRAME_PROTOCOL_VERSION;
+        header.width = GRID_WIDTH;
+        header.height = GRID_HEIGHT;
+        header.frameCounter = frame;
+        header.timestamp = frameTime(frame);
+        header.ta = 30.0f;
+        if (writer.chunk == NULL || !appendRecordingFrame(&writer, &header, pixels)) {
+            if (writer.chunk != NULL) {
+                finishRecordingChunk(&writer);
+                fileSize += RECORDING_CHUNK_SIZE;
+            }
+            TEST_ASSERT_TRUE(fileSize < sizeof(file));
+            beginRecordingChunk(&writer, file + fileSize);
+            TEST_ASSERT_TRUE(appendRecordingFrame(&writer, &header, pixels));
+        }
+    }
+    finishRecordingChunk(&writer);
+    fileSize += RECORDING_CHUNK_SIZE;
+}
+
+void setUp(void) {
+    record();
+}
+
+void tearDown(void) {}
+
+void test_frames_play_back_as_recorded(void) {
+    uint32_t chunks = fileSize / RECORDING_CHUNK_SIZE;
+    TEST_ASSERT_GREATER_THAN(2, chunks);
+    float decoded[DATA_SIZE];
+    int frame = 0;
+    for (uint32_t n = 0; n < chunks; n++) {
+        const uint8_t *chunk = file + n * RECORDING_CHUNK_SIZE;
+        RecordingChunkInfo info;
+        TEST_ASSERT_TRUE(readRecordingChunk(chunk, &info));
+        TEST_ASSERT_EQUAL_UINT32(n, info.sequence);
+        TEST_ASSERT_EQUAL_UINT32(CALIBRATION_KEY, info.calibrationKey);
+        TEST_ASSERT_FLOAT_WITHIN(0.0001f, EMISSIVITY, info.emissivity);
+        TEST_ASSERT_EQUAL_UINT32(frame, info.firstFrame);
+        TEST_ASSERT_EQUAL_UINT32(frameTime(frame), info.firstTimestamp);
+        TEST_ASSERT_EQUAL_UINT32(frameTime(frame + info.frameCount - 1), info.lastTimestamp);
+        for (uint16_t i = 0; i < info.frameCount; i++, frame++) {
+            const uint8_t *data;
+            size_t size;
+            FrameHeader header;
+            TEST_ASSERT_TRUE(recordingFrameRecord(chunk, &info, i, &data, &size));
+            TEST_ASSERT_EQUAL(i == 0 ? FRAME_TYPE_FULL : FRAME_TYPE_DELTA, data[1]);
+            TEST_ASSERT_EQUAL_INT(DATA_SIZE, decodeFrame(data, size, &header, decoded, DATA_SIZE));
+            TEST_ASSERT_EQUAL_UINT32(frame, header.frameCounter);
+            TEST_ASSERT_EQUAL_UINT32(frameTime(frame), header.timestamp);
+            for (int k = 0; k < DATA_SIZE; k++) {
+                TEST_ASSERT_EQUAL_INT(recorded[frame][k], lroundf(decoded[k] * header.scale));
+            }
+        }
+        const uint8_t *data;
+        size_t size;
+        TEST_ASSERT_FALSE(recordingFrameRecord(chunk, &info, info.frameCount, &data, &size));
+    }
+    TEST_ASSERT_EQUAL_INT(FRAMES, frame);
+}
+
+// Every timestamp of recording, between frames and before it, finds frame taken at or before it
+void test_seek_by_timestamp(void) {
+    uint32_t chunks = fileSize / RECORDING_CHUNK_SIZE;
+    float decoded[DATA_SIZE];
+    for (uint32_t timestamp = START_TIME - 200; timestamp < frameTime(FRAMES) + 200; timestamp += 37) {
+        int expected = timestamp < START_TIME ? 0 : (timestamp - START_TIME) / FRAME_INTERVAL;
+        expected = expected < FRAMES ? expected : FRAMES - 1;
+        headerReads = 0;
+        int32_t n = findRecordingChunk(readFile, file, fileSize, timestamp);
+        TEST_ASSERT_GREATER_OR_EQUAL(0, n);
+        // Binary search, not a scan of all chunk headers
+        TEST_ASSERT_LESS_OR_EQUAL(2 + (int)log2(chunks), headerReads);
+        const uint8_t *chunk = file + n * RECORDING_CHUNK_SIZE;
+        RecordingChunkInfo info;
+        TEST_ASSERT_TRUE(readRecordingChunk(chunk, &info));
+        FrameHeader header;
+        int index = decodeRecordingFrames(chunk, &info, timestamp, &header, decoded, DATA_SIZE);
+        TEST_ASSERT_GREATER_OR_EQUAL(0, index);
+        TEST_ASSERT_EQUAL_UINT32(expected, header.frameCounter);
+        TEST_ASSERT_EQUAL_UINT32(expected, info.firstFrame + index);
+        TEST_ASSERT_EQUAL_INT(recorded[expected][DATA_SIZE / 2], lroundf(decoded[DATA_SIZE / 2] * header.scale));
+    }
+}
+
+void test_corrupted_chunk_rejected(void) {
+    RecordingChunkInfo info;
+    uint8_t *chunk = file + RECORDING_CHUNK_SIZE;
+    chunk[RECORDING_HEADER_SIZE + 100] ^= 0x01;
+    TEST_ASSERT_FALSE(readRecordingChunk(chunk, &info));
+    chunk[RECORDING_HEADER_SIZE + 100] ^= 0x01;
+    TEST_ASSERT_TRUE(readRecordingChunk(chunk, &info));
+    chunk[0] = 'X';
+    TEST_ASSERT_FALSE(parseRecordingHeader(chunk, &info));
+}
+
+// Last chunk cut short by power loss: seek past recording end stays on last complete chunk
+void test_interrupted_tail_not_found(void) {
+    uint32_t chunks = fileSize / RECORDING_CHUNK_SIZE;
+    uint8_t *last = file + (chunks - 1) * RECORDING_CHUNK_SIZE;
+    memset(last, 0xFF, RECORDING_CHUNK_SIZE);
+    TEST_ASSERT_EQUAL_INT(chunks - 2, findRecordingChunk(readFile, file, fileSize, frameTime(FRAMES) + 1000));
+    TEST_ASSERT_EQUAL_INT(-1, findRecordingChunk(readFile, file, 0, START_TIME));
+    memset(file, 0, RECORDING_HEADER_SIZE);
+    TEST_ASSERT_EQUAL_INT(-1, findRecordingChunk(readFile, file, fileSize, START_TIME));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_frames_play_back_as_recorded);
+    RUN_TEST(test_seek_by_timestamp);
+    RUN_TEST(test_corrupted_chunk_rejected);
+    RUN_TEST(test_interrupted_tail_not_found);
+    return UNITY_END();
+}
@@ -0,0 +1,127 @@
+// Scheduled frame acquisition (MLX90640_GetFrameDataScheduled) against simulated sensor on virtual
+// clock: status polls per subpage, sleep before subpage is due and timeout when sensor stops.
+#include <unity.h>
+#include <string.h>
+#include "MLX90640_API.h"
+#include "MLX90640_I2C_Driver.h"
+#include "MLX90640_Simulator.h"
+#include "MLX90640_Counting.h"
+
+#define MLX90640_ADDRESS 0x33
+#define CONTROL_REGISTER 0x1901 // chess mode, 18 bit ADC, 2 Hz
+#define REFRESH_RATE 0x04 // 8 Hz subpages, 4 frames per second
+#define SUBPAGE_PERIOD 125000 // us
+#define SUBPAGES 32
+// Wake up is 1/8 period early, backoff 1, 2, 4, 7, 7 ms reaches it in 5 polls. Plus status read
+// after frame data and a spare for sensor clock drift
+#define MAX_SCHEDULED_POLLS 7
+
+static uint16_t eeData[MLX90640_EEPROM_WORDS];
+static uint16_t recorded[2 * MLX90640_FRAME_WORDS];
+static simulatorMLX90640 simulator;
+static i2cTransportMLX90640 simulatorTransport;
+static countingMLX90640 counting;
+static i2cTransportMLX90640 countingTransport;
+static uint16_t frameData[MLX90640_FRAME_WORDS];
+
+// Starts simulated sensor serving given number of recorded subpages (0: sensor never has new data)
+static void startSensor(size_t subPages) {
+    MLX90640_SimulatorInit(&simulator, eeData, recorded, subPages);
+    MLX90640_SimulatorTransport(&simulator, &simulatorTransport);
+    MLX90640_CountingInit(&counting, &simulatorTransport, 0, 0);
+    MLX90640_CountingTransport(&counting, &countingTransport);
+    MLX90640_SetTransport(&countingTransport);
+    // Also restarts schedule of scheduled reads
+    TEST_ASSERT_EQUAL_INT(0, MLX90640_SetRefreshRate(MLX90640_ADDRESS, REFRESH_RATE));
+}
+
+void setUp(void) {
+    eeData[12] = CONTROL_REGISTER;
+    for (int subPage = 0; subPage < 2; subPage++) {
+        uint16_t *record = &recorded[subPage * MLX90640_FRAME_WORDS];
+        for (int i = 0; i < 832; i++) {
+            record[i] = (uint16_t)(i * 3 + subPage * 1000);
+        }
+        record[833] = subPage;
+    }
+}
+
+void tearDown(void) {
+    MLX90640_SetTransport(NULL);
+}
+
+void test_scheduled_reads_poll_few_times_per_subpage(void) {
+    startSensor(2);
+    acquisitionStatsMLX90640 before;
+    MLX90640_GetAcquisitionStats(&before);
+
+    // First read has no schedule yet and polls until subpage is ready
+    int subPage = MLX90640_GetFrameDataScheduled(MLX90640_ADDRESS, frameData);
+    TEST_ASSERT_EQUAL_INT(0, subPage);
+    MLX90640_CountingReset(&counting);
+    uint32_t start = MLX90640_Micros();
+    uint32_t polls = 0;
+    for (int n = 1; n <= SUBPAGES; n++) {
+        subPage = MLX90640_GetFrameDataScheduled(MLX90640_ADDRESS, frameData);
+        TEST_ASSERT_EQUAL_INT(n & 1, subPage);
+        TEST_ASSERT_EQUAL_UINT16_ARRAY(&recorded[subPage * MLX90640_FRAME_WORDS], frameData, 832);
+        TEST_ASSERT_EQUAL_UINT16((CONTROL_REGISTER & 0xFC7F) | (REFRESH_RATE << 7), frameData[832]);
+
+        acquisitionStatsMLX90640 stats;
+        MLX90640_GetAcquisitionStats(&stats);
+        TEST_ASSERT_LESS_OR_EQUAL(MAX_SCHEDULED_POLLS, stats.lastFramePolls);
+        TEST_ASSERT_EQUAL_UINT32(SUBPAGE_PERIOD, stats.subPagePeriod);
+        polls += stats.lastFramePolls;
+    }
+    acquisitionStatsMLX90640 stats;
+    MLX90640_GetAcquisitionStats(&stats);
+    TEST_ASSERT_EQUAL_UINT32(SUBPAGES + 1, stats.frames - before.frames);
+    TEST_ASSERT_EQUAL_UINT32(polls, counting.reads - SUBPAGES * 3); // besides polls: frame, control register, write check
+
+    // Reads keep pace with sensor and most of the time is slept, rest is mainly 1664 byte frame
+    // read at 400 kHz (38 ms)
+    uint32_t elapsed = MLX90640_Micros() - start;
+    TEST_ASSERT_LESS_OR_EQUAL(SUBPAGES * SUBPAGE_PERIOD + SUBPAGE_PERIOD / 8, elapsed);
+    TEST_ASSERT_GREATER_THAN(elapsed / 2, counting.sleepTime);
+}
+
+void test_unscheduled_reads_busy_poll(void) {
+    startSensor(2);
+    MLX90640_GetFrameData(MLX90640_ADDRESS, frameData);
+    acquisitionStatsMLX90640 stats;
+    MLX90640_GetFrameData(MLX90640_ADDRESS, frameData);
+    MLX90640_GetAcquisitionStats(&stats);
+    // Nothing is slept, status register is read back to back for the whole subpage period
+    TEST_ASSERT_GREATER_THAN(10 * MAX_SCHEDULED_POLLS, stats.lastFramePolls);
+}
+
+void test_timeout_when_sensor_stops(void) {
+    startSensor(0);
+    uint32_t start = MLX90640_Micros();
+    TEST_ASSERT_EQUAL_INT(-9, MLX90640_GetFrameDataScheduled(MLX90640_ADDRESS, frameData));
+    // Gives up after two periods of polling, no longer
+    uint32_t elapsed = MLX90640_Micros() - start;
+    TEST_ASSERT_GREATER_THAN(2 * SUBPAGE_PERIOD, elapsed);
+    TEST_ASSERT_LESS_THAN(2 * SUBPAGE_PERIOD + SUBPAGE_PERIOD / 16 + 1000, elapsed);
+    TEST_ASSERT_EQUAL_INT(-9, MLX90640_GetFrameDataScheduled(MLX90640_ADDRESS, frameData));
+
+    // Sensor coming back is picked up by next read, schedule starts over
+    simulator.frameCount = 2;
+    TEST_ASSERT_GREATER_OR_EQUAL(0, MLX90640_GetFrameDataScheduled(MLX90640_ADDRESS, frameData));
+    TEST_ASSERT_EQUAL_UINT16_ARRAY(&recorded[frameData[833] * MLX90640_FRAME_WORDS], frameData, 832);
+}
+
+void test_bus_error_is_returned(void) {
+    startSensor(2);
+    MLX90640_SetTransport(NULL);
+    TEST_ASSERT_EQUAL_INT(-1, MLX90640_GetFrameDataScheduled(MLX90640_ADDRESS, frameData));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_scheduled_reads_poll_few_times_per_subpage);
+    RUN_TEST(test_unscheduled_reads_busy_poll);
+    RUN_TEST(test_timeout_when_sensor_stops);
+    RUN_TEST(test_bus_error_is_returned);
+    return UNITY_END();
+}
@@ -0,0 +1,286 @@
+// Optimized To kernels against reference MLX90640_CalculateTo() of Melexis API, on synthetic
+// calibration and raw frames covering the whole object range of the sensor in both readout modes.
+#include <unity.h>
+#include <math.h>
+#include "MLX90640_API.h"
+#include "MLX90640_Prepared.h"
+#include "MLX90640_Fixed.h"
+#include "MLX90640_BadPixels.h"
+
+#define EMISSIVITY 0.92f
+#define TA_SHIFT 8
+#define SUBPAGES 400
+#define MAX_ERROR 0.01f // degC, documented in MLX90640_Prepared.h
+#define MAX_FIXED_ERROR 0.03f // degC over MIN_FIXED_TO..MAX_FIXED_TO, documented in MLX90640_Fixed.h
+#define MIN_FIXED_TO -40.0f
+#define MAX_FIXED_TO 300.0f
+#define RANGE_EDGE 2.0f // degC around ct[2] / ct[3] where reference jumps and fixed kernel may pick other range
+
+static paramsMLX90640 params;
+static preparedMLX90640 prepared;
+static fixedMLX90640 fixed;
+static int16_t centi[768];
+static uint16_t frameData[834];
+static float reference[768];
+static float result[768];
+static uint32_t randomState;
+
+// Deterministic uniform random number in [min, max)
+static float uniform(float min, float max) {
+    randomState = randomState * 1664525 + 1013904223;
+    return min + (max - min) * (randomState >> 8) / 16777216.0f;
+}
+
+// Calibration in ranges of real sensors, with different ksTo per temperature range
+static void makeParams(paramsMLX90640 *p) {
+    p->kVdd = -3200;
+    p->vdd25 = -12544;
+    p->KvPTAT = 0.002197f;
+    p->KtPTAT = 42.0f;
+    p->vPTAT25 = 12273;
+    p->alphaPTAT = 9;
+    p->gainEE = 5880;
+    p->tgc = 0.0625f;
+    p->cpKv = 0.375f;
+    p->cpKta = 0.004272f;
+    p->resolutionEE = 2;
+    p->calibrationModeEE = 128;
+    p->KsTa = -0.002f;
+    p->ksTo[0] = -0.0006f;
+    p->ksTo[1] = -0.0008f;
+    p->ksTo[2] = -0.0009f;
+    p->ksTo[3] = -0.0011f;
+    p->ct[0] = -40;
+    p->ct[1] = 0;
+    p->ct[2] = 160;
+    p->ct[3] = 320;
+    for (int i = 0; i < 768; i++) {
+        p->alpha[i] = uniform(0.8e-7f, 1.6e-7f);
+        p->offset[i] = (int16_t)uniform(-90, -60);
+        p->kta[i] = uniform(0.004f, 0.007f);
+        p->kv[i] = uniform(0.3f, 0.5f);
+    }
+    p->cpAlpha[0] = 4.07e-9f;
+    p->cpAlpha[1] = 3.98e-9f;
+    p->cpOffset[0] = -69;
+    p->cpOffset[1] = -65;
+    p->ilChessC[0] = 0.0625f;
+    p->ilChessC[1] = 2.0f;
+    p->ilChessC[2] = 0.6f;
+    for (int i = 0; i < 5; i++) {
+        p->brokenPixels[i] = 0xFFFF;
+        p->outlierPixels[i] = 0xFFFF;
+    }
+}
+
+// Raw subpage as read by MLX90640_GetFrameData(). Ta and Vdd jitter by a few LSB between subpages
+// like on sensor, now and then Ta jumps so that cached calibration terms are refreshed
+static void makeFrame(int n, bool chess) {
+    for (int i = 0; i < 768; i++) {
+        frameData[i] = (uint16_t)(int16_t)uniform(-800, 11000); // about -100 to 400 degC
+    }
+    frameData[768] = 0x4BF2; // Vbe
+    frameData[776] = (uint16_t)-54; // compensation pixel, subpage 0
+    frameData[778] = 6273; // gain
+    frameData[800] = 0x06AF + (int)uniform(0, 2) + (n / 50) * 40; // PTAT
+    frameData[808] = (uint16_t)-56; // compensation pixel, subpage 1
+    frameData[810] = (uint16_t)(-13115 + (int)uniform(0, 3)); // Vdd
+    frameData[832] = 0x0901 | (2 << 10) | (chess ? 0x1000 : 0);
+    frameData[833] = n & 1;
+}
+
+// Runs kernel and reference on the same subpages, returns largest difference
+template <typename F>
+static float compareKernel(F kernel) {
+    randomState = 1;
+    makeParams(&params);
+    MLX90640_PrepareCalibration(&params, &prepared);
+    float maxError = 0;
+    int compared = 0;
+    for (int n = 0; n < SUBPAGES; n++) {
+        makeFrame(n, n % 3 != 0);
+        for (int i = 0; i < 768; i++) {
+            reference[i] = NAN;
+            result[i] = NAN;
+        }
+        float tr = MLX90640_GetTa(frameData, &params) - TA_SHIFT;
+        MLX90640_CalculateTo(frameData, &params, EMISSIVITY, tr, reference);
+        kernel(tr);
+        for (int i = 0; i < 768; i++) {
+            // Kernel writes exactly the pixels of the subpage
+            TEST_ASSERT_EQUAL(isnan(reference[i]), isnan(result[i]));
+            if (!isnan(reference[i])) {
+                maxError = fmaxf(maxError, fabsf(reference[i] - result[i]));
+                compared++;
+            }
+        }
+    }
+    TEST_ASSERT_EQUAL_INT(SUBPAGES * 384, compared);
+    return maxError;
+}
+
+void setUp(void) {}
+
+void tearDown(void) {}
+
+void test_frames_cover_object_range(void) {
+    randomState = 1;
+    makeParams(&params);
+    float min = 1000;
+    float max = -1000;
+    for (int n = 0; n < 20; n++) {
+        makeFrame(n, true);
+        float tr = MLX90640_GetTa(frameData, &params) - TA_SHIFT;
+        MLX90640_CalculateTo(frameData, &params, EMISSIVITY, tr, reference);
+        for (int i = 0; i < 768; i++) {
+            if (((i / 32) ^ i) % 2 == (n & 1)) {
+                min = fminf(min, reference[i]);
+                max = fmaxf(max, reference[i]);
+            }
+        }
+    }
+    TEST_ASSERT_LESS_THAN_FLOAT(-40, min);
+    TEST_ASSERT_GREATER_THAN_FLOAT(300, max);
+}
+
+void test_prepared_matches_reference(void) {
+    float maxError = compareKernel([](float tr) {
+        MLX90640_CalculateToPrepared(frameData, &params, &prepared, EMISSIVITY, tr, result);
+    });
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(MAX_ERROR, maxError);
+}
+
+void test_fast_matches_reference(void) {
+    float maxError = compareKernel([](float tr) {
+        MLX90640_CalculateToFast(frameData, &params, &prepared, EMISSIVITY, tr, result);
+    });
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(MAX_ERROR, maxError);
+}
+
+// Fixed-point kernel over the whole object range, with pixels next to ksTo range boundaries
+// counted separately: only a few of them may be off by more than the bound
+void test_fixed_sweep_within_documented_bound(void) {
+    float maxError = 0;
+    int compared = 0;
+    int edgeMisses = 0;
+    float minTo = 1000;
+    float maxTo = -1000;
+    randomState = 1;
+    makeParams(&params);
+    MLX90640_PrepareCalibration(&params, &prepared);
+    MLX90640_PrepareFixed(&params, &prepared, &fixed);
+    for (int n = 0; n < SUBPAGES; n++) {
+        makeFrame(n, n % 3 != 0);
+        float tr = MLX90640_GetTa(frameData, &params) - TA_SHIFT;
+        MLX90640_CalculateTo(frameData, &params, EMISSIVITY, tr, reference);
+        MLX90640_CalculateToFixed(frameData, &params, &fixed, EMISSIVITY, tr, centi);
+        for (int i = 0; i < 768; i++) {
+            bool chess = n % 3 != 0;
+            int subPage = chess ? ((i / 32) ^ i) & 1 : (i / 32) & 1;
+            if (subPage != (n & 1) || reference[i] < MIN_FIXED_TO || reference[i] > MAX_FIXED_TO) {
+                continue;
+            }
+            float error = fabsf(reference[i] - centi[i] / 100.0f);
+            if (error > MAX_FIXED_ERROR && (fabsf(reference[i] - params.ct[2]) < RANGE_EDGE || fabsf(reference[i] - params.ct[3]) < RANGE_EDGE)) {
+                edgeMisses++;
+                continue;
+            }
+            maxError = fmaxf(maxError, error);
+            minTo = fminf(minTo, reference[i]);
+            maxTo = fmaxf(maxTo, reference[i]);
+            compared++;
+        }
+    }
+    TEST_ASSERT_LESS_THAN_FLOAT(MIN_FIXED_TO + 1, minTo);
+    TEST_ASSERT_GREATER_THAN_FLOAT(MAX_FIXED_TO - 1, maxTo);
+    TEST_ASSERT_LESS_OR_EQUAL_FLOAT(MAX_FIXED_ERROR, maxError);
+    // About 1 in 40000 pixels, allow a few times that
+    TEST_ASSERT_LESS_OR_EQUAL(compared / 10000, edgeMisses);
+}
+
+// Pixels far below sensor range have negative fourth power sum, reference gives NaN for them
+// and optimized kernels have to as well, not arbitrary value
+void test_negative_fourth_power_gives_nan(void) {
+    randomState = 1;
+    makeParams(&params);
+    MLX90640_PrepareCalibration(&params, &prepared);
+    for (int n = 0; n < 4; n++) {
+        makeFrame(n, n < 2);
+        for (int i = 0; i < 768; i += 3) {
+            frameData[i] = (uint16_t)-4000;
+        }
+        float tr = MLX90640_GetTa(frameData, &params) - TA_SHIFT;
+        for (int i = 0; i < 768; i++) {
+            reference[i] = 0;
+        }
+        MLX90640_CalculateTo(frameData, &params, EMISSIVITY, tr, reference);
+        int invalid = 0;
+        for (int kernel = 0; kernel < 2; kernel++) {
+            for (int i = 0; i < 768; i++) {
+                result[i] = 0;
+            }
+            if (kernel == 0) {
+                MLX90640_CalculateToPrepared(frameData, &params, &prepared, EMISSIVITY, tr, result);
+            } else {
+                MLX90640_CalculateToFast(frameData, &params, &prepared, EMISSIVITY, tr, result);
+            }
+            for (int i = 0; i < 768; i++) {
+                TEST_ASSERT_EQUAL(isnan(reference[i]), isnan(result[i]));
+                invalid += isnan(reference[i]);
+            }
+        }
+        TEST_ASSERT_GREATER_THAN(0, invalid);
+    }
+}
+
+// Same pixels are MLX90640_FIXED_INVALID in fixed-point output, not -273.15 degC, and bad pixel
+// correction passes that on like NaN
+void test_fixed_negative_fourth_power_is_invalid(void) {
+    randomState = 1;
+    makeParams(&params);
+    MLX90640_PrepareCalibration(&params, &prepared);
+    MLX90640_PrepareFixed(&params, &prepared, &fixed);
+    for (int n = 0; n < 4; n++) {
+        bool chess = n < 2;
+        makeFrame(n, chess);
+        for (int i = 0; i < 768; i += 3) {
+            frameData[i] = (uint16_t)-4000;
+        }
+        float tr = MLX90640_GetTa(frameData, &params) - TA_SHIFT;
+        MLX90640_CalculateTo(frameData, &params, EMISSIVITY, tr, reference);
+        MLX90640_CalculateToFixed(frameData, &params, &fixed, EMISSIVITY, tr, centi);
+        int invalid = 0;
+        int firstInvalid = -1;
+        for (int i = 0; i < 768; i++) {
+            int subPage = chess ? ((i / 32) ^ i) & 1 : (i / 32) & 1;
+            if (subPage == (n & 1)) {
+                TEST_ASSERT_EQUAL(isnan(reference[i]), centi[i] == MLX90640_FIXED_INVALID);
+                invalid += isnan(reference[i]);
+                firstInvalid = firstInvalid < 0 && isnan(reference[i]) ? i : firstInvalid;
+            }
+        }
+        TEST_ASSERT_GREATER_THAN(0, invalid);
+
+        // Pixel next to invalid one, corrected from it and a valid neighbour
+        badPixelsMLX90640 plan = {};
+        plan.count = 1;
+        plan.pixels[0].pixel = firstInvalid < 767 ? firstInvalid + 1 : firstInvalid - 1;
+        plan.pixels[0].subPage[chess] = n & 1;
+        plan.pixels[0].count[chess] = 2;
+        plan.pixels[0].neighbours[chess][0] = firstInvalid;
+        plan.pixels[0].neighbours[chess][1] = firstInvalid < 767 ? firstInvalid + 2 : firstInvalid - 2;
+        MLX90640_CorrectBadPixelsFixed(&plan, n & 1, chess, centi);
+        TEST_ASSERT_EQUAL_INT16(MLX90640_FIXED_INVALID, centi[plan.pixels[0].pixel]);
+    }
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_frames_cover_object_range);
+    RUN_TEST(test_prepared_matches_reference);
+    RUN_TEST(test_fast_matches_reference);
+    RUN_TEST(test_negative_fourth_power_gives_nan);
+    RUN_TEST(test_fixed_sweep_within_documented_bound);
+    RUN_TEST(test_fixed_negative_fourth_power_is_invalid);
+    return UNITY_END();
+}
@@ -0,0 +1,175 @@
+// Temporal noise filter (src/temporal_filter.h) on synthetic scenes: on a static scene noise drops as
+// documented for the EMA weight, while in adaptive mode an edge moving across the frame passes through
+// without trail. Only pixels of the filtered subpage are touched, pattern change restarts averages.
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "temporal_filter.h"
+#include "frame_protocol.h"
+#include "camera_frame.h"
+
+#define SUBPAGES 400
+#define WARMUP 40 // subpages until average settles
+#define NOISE 0.25f // degC, standard deviation of sensor noise at 32 fps
+#define ALPHA 0.2f
+#define THRESHOLD 2.0f // ~8x noise, as device default at 32 fps
+#define BACKGROUND 22.0f
+#define EDGE 34.0f
+
+static TemporalFilter filter;
+static float pixels[DATA_SIZE];
+static double sum[2][DATA_SIZE]; // [unfiltered, filtered]
+static double squares[2][DATA_SIZE];
+static uint32_t randomState;
+
+// Deterministic uniform random number in [min, max)
+static float uniform(float min, float max) {
+    randomState = randomState * 1664525 + 1013904223;
+    return min + (max - min) * (randomState >> 8) / 16777216.0f;
+}
+
+// Roughly normal noise of given standard deviation, sum of 4 uniforms
+static float noise(float deviation) {
+    float value = 0;
+    for (int i = 0; i < 4; i++) {
+        value += uniform(-1.0f, 1.0f);
+    }
+    return value * deviation * 0.8660254f;
+}
+
+// Static scene, gradient across the frame
+static float scene(int index) {
+    return 20.0f + (index % GRID_WIDTH) * 0.25f + (index / GRID_WIDTH) * 0.1f;
+}
+
+// Mean per pixel standard deviation of unfiltered and filtered subpages of static scene
+static void measureNoise(uint8_t mode, uint8_t pattern, float *unfiltered, float *filtered) {
+    int samples = 0;
+    initTemporalFilter(&filter, mode, ALPHA, THRESHOLD);
+    memset(sum, 0, sizeof(sum));
+    memset(squares, 0, sizeof(squares));
+    for (int n = 0; n < SUBPAGES; n++) {
+        uint8_t subPage = n & 1;
+        for (int i = 0; i < DATA_SIZE; i++) {
+            pixels[i] = scene(i) + noise(NOISE);
+        }
+        float raw[DATA_SIZE];
+        memcpy(raw, pixels, sizeof(raw));
+        applyTemporalFilter(&filter, pixels, subPage, pattern);
+        if (n < WARMUP) {
+            continue;
+        }
+        for (int i = 0; i < DATA_SIZE; i++) {
+            if (isSubpagePixel(i, GRID_WIDTH, pattern, subPage)) {
+                sum[0][i] += raw[i];
+                squares[0][i] += (double)raw[i] * raw[i];
+                sum[1][i] += pixels[i];
+                squares[1][i] += (double)pixels[i] * pixels[i];
+            }
+        }
+        samples += subPage; // every pixel is sampled once per subpage pair
+    }
+    double deviation[2] = {0, 0};
+    for (int k = 0; k < 2; k++) {
+        for (int i = 0; i < DATA_SIZE; i++) {
+            double mean = sum[k][i] / samples;
+            deviation[k] += sqrt(squares[k][i] / samples - mean * mean);
+        }
+    }
+    *unfiltered = deviation[0] / DATA_SIZE;
+    *filtered = deviation[1] / DATA_SIZE;
+}
+
+void setUp(void) {
+    randomState = 12345;
+}
+
+void tearDown(void) {}
+
+void test_static_scene_noise_is_lower(void) {
+    // Noise of EMA drops by sqrt(alpha / (2 - alpha)), 1/3 for alpha 0.2
+    float expected = sqrtf(ALPHA / (2.0f - ALPHA));
+    const uint8_t modes[] = {FILTER_MODE_EMA, FILTER_MODE_ADAPTIVE};
+    const uint8_t patterns[] = {FRAME_PATTERN_INTERLEAVED, FRAME_PATTERN_CHESS};
+    for (uint8_t mode : modes) {
+        for (uint8_t pattern : patterns) {
+            float unfiltered, filtered;
+            measureNoise(mode, pattern, &unfiltered, &filtered);
+            TEST_ASSERT_FLOAT_WITHIN(NOISE * 0.05f, NOISE, unfiltered);
+            TEST_ASSERT_FLOAT_WITHIN(expected * 0.15f, expected, filtered / unfiltered);
+        }
+    }
+    // Noise is far below threshold, adaptive mode never restarts pixels of static scene
+    TEST_ASSERT_EQUAL_UINT32(0, filter.resets);
+}
+
+void test_moving_edge_passes_through(void) {
+    const uint8_t modes[] = {FILTER_MODE_ADAPTIVE, FILTER_MODE_EMA};
+    float maxError[2] = {0, 0};
+    for (int m = 0; m < 2; m++) {
+        initTemporalFilter(&filter, modes[m], ALPHA, THRESHOLD);
+        for (int n = 0; n < 2 * GRID_WIDTH; n++) {
+            uint8_t subPage = n & 1;
+            int edge = n / 2; // columns left of edge are warm, one column per frame
+            for (int i = 0; i < DATA_SIZE; i++) {
+                pixels[i] = (i % GRID_WIDTH < edge ? EDGE : BACKGROUND) + noise(NOISE);
+            }
+            applyTemporalFilter(&filter, pixels, subPage, FRAME_PATTERN_CHESS);
+            // Pixel the edge just crossed has to show new temperature right away
+            for (int row = 0; row < GRID_HEIGHT; row++) {
+                int i = row * GRID_WIDTH + edge - 1;
+                if (edge > 0 && isSubpagePixel(i, GRID_WIDTH, FRAME_PATTERN_CHESS, subPage)) {
+                    maxError[m] = fmaxf(maxError[m], fabsf(pixels[i] - EDGE));
+                }
+            }
+        }
+    }
+    // Adaptive mode restarts at the edge and is off by noise only, EMA leaves a trail
+    TEST_ASSERT_LESS_THAN_FLOAT(NOISE * 4, maxError[0]);
+    TEST_ASSERT_GREATER_THAN_FLOAT(THRESHOLD, maxError[1]);
+}
+
+void test_only_subpage_pixels_are_filtered(void) {
+    const uint8_t patterns[] = {FRAME_PATTERN_INTERLEAVED, FRAME_PATTERN_CHESS};
+    for (uint8_t pattern : patterns) {
+        initTemporalFilter(&filter, FILTER_MODE_EMA, 0.5f, THRESHOLD);
+        for (int i = 0; i < DATA_SIZE; i++) {
+            pixels[i] = 10.0f;
+        }
+        applyTemporalFilter(&filter, pixels, 0, pattern);
+        for (int i = 0; i < DATA_SIZE; i++) {
+            pixels[i] = 20.0f;
+        }
+        applyTemporalFilter(&filter, pixels, 0, pattern);
+        for (int i = 0; i < DATA_SIZE; i++) {
+            TEST_ASSERT_EQUAL_FLOAT(isSubpagePixel(i, GRID_WIDTH, pattern, 0) ? 15.0f : 20.0f, pixels[i]);
+        }
+    }
+
+    // Pattern change drops averages, first subpage of new pattern passes through
+    for (int i = 0; i < DATA_SIZE; i++) {
+        pixels[i] = 30.0f;
+    }
+    applyTemporalFilter(&filter, pixels, 0, FRAME_PATTERN_INTERLEAVED);
+    for (int i = 0; i < DATA_SIZE; i++) {
+        TEST_ASSERT_EQUAL_FLOAT(30.0f, pixels[i]);
+    }
+}
+
+void test_alpha_for_rate(void) {
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, filterAlphaForRate(4, 4));
+    TEST_ASSERT_EQUAL_FLOAT(1.0f, filterAlphaForRate(2, 4));
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 8.0f / 36.0f, filterAlphaForRate(32, 4));
+    // Noise of filtered 32 fps is that of 4 fps: variance ratio alpha / (2 - alpha) = 4 / 32
+    float alpha = filterAlphaForRate(32, 4);
+    TEST_ASSERT_FLOAT_WITHIN(1e-6f, 4.0f / 32.0f, alpha / (2.0f - alpha));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_static_scene_noise_is_lower);
+    RUN_TEST(test_moving_edge_passes_through);
+    RUN_TEST(test_only_subpage_pixels_are_filtered);
+    RUN_TEST(test_alpha_for_rate);
+    return UNITY_END();
+}
@@ -0,0 +1,157 @@
+// Device side rendering (src/thermal_image.h) against straightforward bilinear interpolation of the
+// frame: output is mirrored, frame min and max map to the palette ends and RGB565 output is palette
+// lookup of indexed one. Image rendered in pieces of any size, also splitting pixels, equals the
+// image rendered at once. Unsupported sizes, formats and palettes are rejected.
+#include <unity.h>
+#include <math.h>
+#include <string.h>
+#include "thermal_image.h"
+#include "camera_frame.h"
+
+#define SCALE 4
+#define IMAGE_BYTES (GRID_WIDTH * SCALE * GRID_HEIGHT * SCALE * 2)
+
+static ImageRender render;
+static float pixels[DATA_SIZE];
+static uint8_t indexed[IMAGE_BYTES];
+static uint8_t image[IMAGE_BYTES];
+static uint8_t pieces[IMAGE_BYTES];
+
+// Gradient with a hot spot, every pixel different
+static void makeFrame(void) {
+    for (int i = 0; i < DATA_SIZE; i++) {
+        float dx = i % GRID_WIDTH - 20.5f;
+        float dy = i / GRID_WIDTH - 8.5f;
+        pixels[i] = 20.0f + 0.1f * i / GRID_WIDTH + 0.02f * (i % GRID_WIDTH) + 30.0f * expf(-(dx * dx + dy * dy) / 10.0f);
+    }
+}
+
+static size_t renderWhole(uint8_t *out) {
+    return renderImage(&render, 0, out, IMAGE_BYTES);
+}
+
+// Palette index of output pixel x, y interpolated in double from frame
+static double expectedIndex(int x, int y, int scale, float minTemp, float maxTemp) {
+    int sourceX = GRID_WIDTH * scale - 1 - x; // mirrored
+    int column = sourceX / scale;
+    int row = y / scale;
+    int nextColumn = column + 1 < GRID_WIDTH ? column + 1 : column;
+    int nextRow = row + 1 < GRID_HEIGHT ? row + 1 : row;
+    double wx = (double)(sourceX % scale) / scale;
+    double wy = (double)(y % scale) / scale;
+    double top = pixels[row * GRID_WIDTH + column] * (1 - wx) + pixels[row * GRID_WIDTH + nextColumn] * wx;
+    double bottom = pixels[nextRow * GRID_WIDTH + column] * (1 - wx) + pixels[nextRow * GRID_WIDTH + nextColumn] * wx;
+    double value = top * (1 - wy) + bottom * wy;
+    return (value - minTemp) / (maxTemp - minTemp) * (PALETTE_SIZE - 1);
+}
+
+void setUp(void) {
+    initPalettes();
+    makeFrame();
+}
+
+void tearDown(void) {}
+
+void test_native_scale_maps_frame_to_palette(void) {
+    TEST_ASSERT_TRUE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, 1, IMAGE_FORMAT_INDEXED, PALETTE_IRON));
+    TEST_ASSERT_EQUAL_size_t(DATA_SIZE, imageSize(&render));
+    TEST_ASSERT_EQUAL_size_t(DATA_SIZE, renderWhole(image));
+    int minIndex = 0;
+    int maxIndex = 0;
+    for (int i = 1; i < DATA_SIZE; i++) {
+        minIndex = pixels[i] < pixels[minIndex] ? i : minIndex;
+        maxIndex = pixels[i] > pixels[maxIndex] ? i : maxIndex;
+    }
+    TEST_ASSERT_EQUAL_FLOAT(pixels[minIndex], render.minTemp);
+    TEST_ASSERT_EQUAL_FLOAT(pixels[maxIndex], render.maxTemp);
+    // Frame pixel at column x is output at width - 1 - x
+    int row = minIndex / GRID_WIDTH;
+    TEST_ASSERT_EQUAL_UINT8(0, image[row * GRID_WIDTH + GRID_WIDTH - 1 - minIndex % GRID_WIDTH]);
+    row = maxIndex / GRID_WIDTH;
+    TEST_ASSERT_EQUAL_UINT8(PALETTE_SIZE - 1, image[row * GRID_WIDTH + GRID_WIDTH - 1 - maxIndex % GRID_WIDTH]);
+    for (int y = 0; y < GRID_HEIGHT; y++) {
+        for (int x = 0; x < GRID_WIDTH; x++) {
+            TEST_ASSERT_EQUAL_UINT8(lround(expectedIndex(x, y, 1, render.minTemp, render.maxTemp)), image[y * GRID_WIDTH + x]);
+        }
+    }
+}
+
+// Float interpolation on palette indexes may round the other way than double on temperatures
+void test_upscaled_matches_bilinear(void) {
+    TEST_ASSERT_TRUE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, SCALE, IMAGE_FORMAT_INDEXED, PALETTE_RAINBOW));
+    TEST_ASSERT_EQUAL_size_t(GRID_WIDTH * SCALE, imageWidth(&render));
+    TEST_ASSERT_EQUAL_size_t(GRID_HEIGHT * SCALE, imageHeight(&render));
+    size_t width = imageWidth(&render);
+    TEST_ASSERT_EQUAL_size_t(width * imageHeight(&render), renderWhole(image));
+    for (size_t y = 0; y < imageHeight(&render); y++) {
+        for (size_t x = 0; x < width; x++) {
+            TEST_ASSERT_FLOAT_WITHIN(0.51f, expectedIndex(x, y, SCALE, render.minTemp, render.maxTemp), image[y * width + x]);
+        }
+    }
+}
+
+void test_rgb565_is_palette_lookup(void) {
+    TEST_ASSERT_TRUE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, SCALE, IMAGE_FORMAT_INDEXED, PALETTE_WHITEHOT));
+    size_t count = renderWhole(indexed);
+    TEST_ASSERT_TRUE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, SCALE, IMAGE_FORMAT_RGB565, PALETTE_WHITEHOT));
+    TEST_ASSERT_EQUAL_size_t(count * 2, renderWhole(image));
+    const uint16_t *palette = paletteTable(PALETTE_WHITEHOT);
+    TEST_ASSERT_EQUAL_UINT16(0x0000, palette[0]);
+    TEST_ASSERT_EQUAL_UINT16(0xFFFF, palette[PALETTE_SIZE - 1]);
+    for (size_t i = 0; i < count; i++) {
+        TEST_ASSERT_EQUAL_UINT16(palette[indexed[i]], image[i * 2] | (image[i * 2 + 1] << 8));
+    }
+}
+
+// Odd piece sizes split RGB565 pixels and rows between calls, as TCP segments do
+void test_rendered_in_pieces(void) {
+    TEST_ASSERT_TRUE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, SCALE, IMAGE_FORMAT_RGB565, PALETTE_NIGHTVISION));
+    size_t size = renderWhole(image);
+    const size_t pieceSizes[] = {1, 7, 255, 1436};
+    for (size_t pieceSize : pieceSizes) {
+        memset(pieces, 0, sizeof(pieces));
+        size_t offset = 0;
+        size_t length;
+        while ((length = renderImage(&render, offset, pieces + offset, pieceSize)) > 0) {
+            offset += length;
+        }
+        TEST_ASSERT_EQUAL_size_t(size, offset);
+        TEST_ASSERT_EQUAL_MEMORY(image, pieces, size);
+    }
+    TEST_ASSERT_EQUAL_size_t(0, renderImage(&render, size, pieces, sizeof(pieces)));
+}
+
+// Uniform frame has no range to spread over palette, all pixels take its first color
+void test_uniform_frame(void) {
+    for (int i = 0; i < DATA_SIZE; i++) {
+        pixels[i] = 25.0f;
+    }
+    TEST_ASSERT_TRUE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, 2, IMAGE_FORMAT_INDEXED, PALETTE_RAINBOW));
+    size_t size = renderWhole(image);
+    for (size_t i = 0; i < size; i++) {
+        TEST_ASSERT_EQUAL_UINT8(0, image[i]);
+    }
+}
+
+void test_unsupported_render_rejected(void) {
+    TEST_ASSERT_FALSE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, 0, IMAGE_FORMAT_INDEXED, PALETTE_RAINBOW));
+    TEST_ASSERT_FALSE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, MAX_IMAGE_SCALE + 1, IMAGE_FORMAT_INDEXED, PALETTE_RAINBOW));
+    TEST_ASSERT_FALSE(initImageRender(&render, pixels, GRID_WIDTH + 1, GRID_HEIGHT, 1, IMAGE_FORMAT_INDEXED, PALETTE_RAINBOW));
+    TEST_ASSERT_FALSE(initImageRender(&render, pixels, GRID_WIDTH, 0, 1, IMAGE_FORMAT_INDEXED, PALETTE_RAINBOW));
+    TEST_ASSERT_FALSE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, 1, IMAGE_FORMAT_RGB565 + 1, PALETTE_RAINBOW));
+    TEST_ASSERT_FALSE(initImageRender(&render, pixels, GRID_WIDTH, GRID_HEIGHT, 1, IMAGE_FORMAT_INDEXED, PALETTE_COUNT));
+    TEST_ASSERT_TRUE(paletteTable(PALETTE_COUNT) == NULL);
+    TEST_ASSERT_EQUAL_INT(PALETTE_IRON, findPalette("iron"));
+    TEST_ASSERT_EQUAL_INT(-1, findPalette("sepia"));
+}
+
+int main(void) {
+    UNITY_BEGIN();
+    RUN_TEST(test_native_scale_maps_frame_to_palette);
+    RUN_TEST(test_upscaled_matches_bilinear);
+    RUN_TEST(test_rgb565_is_palette_lookup);
+    RUN_TEST(test_rendered_in_pieces);
+    RUN_TEST(test_uniform_frame);
+    RUN_TEST(test_unsupported_render_rejected);
+    return UNITY_END();
+}
@@ -2309,6 +2309,140 @@ const path = require('node:path');
     23.70544
   ]];
 
+// Frame statistics as device computes them (src/frame_stats.h), percentiles are exact here
+const framePercentiles = [5, 25, 50, 75, 95];
+function frameStats(temperatures) {
+  const sorted = [...temperatures].sort((a, b) => a - b);
+  const minTemp = sorted[0];
+  const maxTemp = sorted[sorted.length - 1];
+  const mean = temperatures.reduce((sum, value) => sum + value, 0) / temperatures.length;
+  const variance = temperatures.reduce((sum, value) => sum + (value - mean) * (value - mean), 0) / temperatures.length;
+  const percentile = (p) => {
+    const rank = p / 100 * (sorted.length - 1);
+    const lower = Math.floor(rank);
+    return sorted[lower] + (rank - lower) * (sorted[Math.min(lower + 1, sorted.length - 1)] - sorted[lower]);
+  };
+  const histogram = new Array(16).fill(0);
+  temperatures.forEach((value) => {
+    histogram[maxTemp > minTemp ? Math.min(15, Math.floor((value - minTemp) * 16 / (maxTemp - minTemp))) : 0]++;
+  });
+  return {
+    minTemp: minTemp,
+    maxTemp: maxTemp,
+    minIndex: temperatures.indexOf(minTemp),
+    maxIndex: temperatures.indexOf(maxTemp),
+    mean: mean,
+    stddev: Math.sqrt(variance),
+    percentiles: framePercentiles.map(percentile),
+    histogram: histogram
+  };
+}
+
+// Encodes frame in binary format, see src/frame_protocol.h
+let frameCounter = 0;
+function writeHeader(buffer, type, temperatures, scale) {
+  const quantize = (value) => Math.max(-32768, Math.min(32767, Math.round(value * scale)));
+  const stats = frameStats(temperatures);
+
+  buffer.writeUInt8(2, 0);
+  buffer.writeUInt8(type, 1);
+  buffer.writeUInt8(32, 2);
+  buffer.writeUInt8(24, 3);
+  buffer.writeUInt32LE(frameCounter++ >>> 0, 4);
+  buffer.writeUInt32LE(Math.round(process.uptime() * 1000) >>> 0, 8);
+  buffer.writeInt16LE(quantize(25), 12);
+  buffer.writeInt16LE(quantize(stats.minTemp), 14);
+  buffer.writeInt16LE(quantize(stats.maxTemp), 16);
+  buffer.writeUInt16LE(scale, 18);
+  buffer.writeUInt16LE(stats.minIndex, 20);
+  buffer.writeUInt16LE(stats.maxIndex, 22);
+  buffer.writeInt16LE(quantize(stats.mean), 24);
+  buffer.writeInt16LE(quantize(stats.stddev), 26);
+  stats.percentiles.forEach((value, i) => buffer.writeInt16LE(quantize(value), 28 + i * 2));
+}
+
+function encodeFrame(temperatures) {
+  const scale = 100;
+  const headerSize = 38;
+  const buffer = Buffer.alloc(headerSize + temperatures.length * 2);
+  const quantize = (value) => Math.max(-32768, Math.min(32767, Math.round(value * scale)));
+
+  writeHeader(buffer, 0, temperatures, scale);
+  temperatures.forEach((value, i) => buffer.writeInt16LE(quantize(value), headerSize + i * 2));
+
+  return buffer;
+}
+
+// Encodes one subpage of the frame in chess pattern, as the sensor reads it by default
+function encodeSubpage(temperatures, subPage) {
+  const scale = 100;
+  const headerSize = 40;
+  const buffer = Buffer.alloc(headerSize + temperatures.length);
+  const quantize = (value) => Math.max(-32768, Math.min(32767, Math.round(value * scale)));
+
+  writeHeader(buffer, 1, temperatures, scale);
+  buffer.writeUInt8(subPage, 38);
+  buffer.writeUInt8(1, 39);
+  let offset = headerSize;
+  temperatures.forEach((value, i) => {
+    if (((Math.floor(i / 32) ^ (i % 32)) & 1) === subPage) {
+      buffer.writeInt16LE(quantize(value), offset);
+      offset += 2;
+    }
+  });
+
+  return buffer;
+}
+
+// Encodes delta of the frame against reference (what client has), updates reference.
+// Returns null when delta would be bigger than full frame
+function encodeDeltaFrame(temperatures, reference, deadband) {
+  const scale = 100;
+  const headerSize = 38;
+  const buffer = Buffer.alloc(headerSize + temperatures.length * 2);
+  const quantize = (value) => Math.max(-32768, Math.min(32767, Math.round(value * scale)));
+  let offset = headerSize;
+  const putVarint = (value) => {
+    do {
+      if (offset >= buffer.length) {
+        return false;
+      }
+      const byte = value & 0x7F;
+      value >>>= 7;
+      buffer.writeUInt8(value ? byte | 0x80 : byte, offset++);
+    } while (value);
+    return true;
+  };
+
+  writeHeader(buffer, 2, temperatures, scale);
+  const values = temperatures.map(quantize);
+  let run = 0;
+  for (let i = 0; i <= values.length; i++) {
+    let delta = 0;
+    if (i < values.length) {
+      delta = values[i] - reference[i];
+      if (Math.abs(delta) <= deadband) {
+        run++;
+        continue;
+      }
+    }
+    if (run > 0 && !(putVarint(0) && putVarint(run - 1))) {
+      return null;
+    }
+    run = 0;
+    if (delta !== 0 && !putVarint(delta < 0 ? -delta * 2 - 1 : delta * 2)) {
+      return null;
+    }
+  }
+  values.forEach((value, i) => {
+    if (Math.abs(value - reference[i]) > deadband) {
+      reference[i] = value;
+    }
+  });
+
+  return buffer.subarray(0, offset);
+}
+
 fastify.register(require('@fastify/static'), {
   root: path.join(__dirname, 'src'),
   prefix: '/src/', 
@@ -2328,10 +2462,31 @@ fastify.register(async function (fastify) {
       }
     });
 
+    // Ticks at subpage rate, full frames are sent every second tick
+    let data = mockData[0];
+    let subPage = 0;
+    const reference = new Int16Array(768);
+    let framesSinceKeyframe = -1; // client just joined, start with keyframe
     setInterval(() => {
-      const data = mockData[(Math.random() * (mockData.length - 1)).toFixed(0)];
-      socket.send(JSON.stringify({"temperatures": data}));
-    }, 250);
+      if (subPage === 0) {
+        data = mockData[(Math.random() * (mockData.length - 1)).toFixed(0)];
+      }
+      if (subpageStreaming) {
+        socket.send(encodeSubpage(data, subPage));
+        framesSinceKeyframe = -1;
+      } else if (subPage === 1) {
+        const delta = compression && framesSinceKeyframe >= 0 && framesSinceKeyframe < 32 ? encodeDeltaFrame(data, reference, 5) : null;
+        if (delta) {
+          socket.send(delta);
+          framesSinceKeyframe++;
+        } else {
+          socket.send(encodeFrame(data));
+          data.forEach((value, i) => reference[i] = Math.max(-32768, Math.min(32767, Math.round(value * 100))));
+          framesSinceKeyframe = 0;
+        }
+      }
+      subPage ^= 1;
+    }, 125);
   })
 })
 
@@ -2339,12 +2494,238 @@ fastify.get('/', function (req, reply) {
   reply.sendFile('index.html', { cacheControl: false })
 });
 
+// Renderer benchmark, reports ms per frame of web client renderers on mock data
+fastify.get('/bench', function (req, reply) {
+  reply.sendFile('bench.html', { cacheControl: false })
+});
+
 fastify.get('/data', function (req, reply) {
   const data = mockData[(Math.random() * (mockData.length - 1)).toFixed(0)];
 
   reply.code(200).header('Content-Type', 'application/json; charset=utf-8').send({"temperatures": data});
 });
 
+fastify.get('/stats', function (req, reply) {
+  const data = mockData[(Math.random() * (mockData.length - 1)).toFixed(0)];
+  const stats = frameStats(data);
+  const pixel = (index) => ({"temp": data[index], "x": index % 32, "y": Math.floor(index / 32)});
+  const percentiles = {};
+  framePercentiles.forEach((p, i) => percentiles[p] = stats.percentiles[i]);
+
+  reply.code(200).send({"frameCounter": frameCounter, "timestamp": Math.round(process.uptime() * 1000), "ta": 25, "min": pixel(stats.minIndex), "max": pixel(stats.maxIndex),
+    "mean": stats.mean, "stddev": stats.stddev, "percentiles": percentiles, "histogram": stats.histogram});
+});
+
+// Indexed image as device renders it (src/thermal_image.cpp): bilinear upscale, mirrored, min..max mapped to 0..255.
+// RGB565 needs device palette tables, so mock serves indexed images only
+fastify.get('/image', function (req, reply) {
+  const scale = req.query.scale !== undefined ? parseInt(req.query.scale) : 10;
+  if (!(scale >= 1 && scale <= 10)) {
+    reply.code(400).send("Scale must be 1 - 10");
+    return;
+  }
+  if (req.query.format !== undefined && req.query.format !== 'indexed') {
+    reply.code(400).send("Mock supports indexed format only");
+    return;
+  }
+  const data = mockData[(Math.random() * (mockData.length - 1)).toFixed(0)];
+  const minTemp = Math.min(...data);
+  const maxTemp = Math.max(...data);
+  const factor = maxTemp > minTemp ? 255 / (maxTemp - minTemp) : 0;
+  const width = 32 * scale;
+  const height = 24 * scale;
+  const image = Buffer.alloc(width * height);
+  for (let y = 0; y < height; y++) {
+    const top = Math.floor(y / scale);
+    const bottom = Math.min(23, top + 1);
+    const dy = (y % scale) / scale;
+    for (let x = 0; x < width; x++) {
+      const left = Math.floor(x / scale);
+      const right = Math.min(31, left + 1);
+      const dx = (x % scale) / scale;
+      const upper = data[top * 32 + left] + (data[top * 32 + right] - data[top * 32 + left]) * dx;
+      const lower = data[bottom * 32 + left] + (data[bottom * 32 + right] - data[bottom * 32 + left]) * dx;
+      const value = (upper + (lower - upper) * dy - minTemp) * factor;
+      image[y * width + width - 1 - x] = Math.max(0, Math.min(255, Math.round(value)));
+    }
+  }
+
+  reply.code(200).header('Content-Type', 'application/octet-stream')
+    .header('X-Image-Width', width).header('X-Image-Height', height)
+    .header('X-Min-Temp', minTemp.toFixed(2)).header('X-Max-Temp', maxTemp.toFixed(2))
+    .send(image);
+});
+
+let frameRate = 4;
+let subpageStreaming = false;
+let compression = false;
+let filter = 'off';
+// State changes are POST only as on device, GET with parameters is refused
+function refuseStateChange(req, reply) {
+  if (Object.keys(req.query).length > 0) {
+    reply.code(405).header('Allow', 'GET, POST').send("Use POST to change state");
+    return true;
+  }
+  return false;
+}
+
+fastify.get('/mode', function (req, reply) {
+  if (!refuseStateChange(req, reply)) {
+    reply.code(200).send(getMode());
+  }
+});
+
+fastify.post('/mode', function (req, reply) {
+  const rate = parseInt(req.query.rate);
+  if (req.query.rate !== undefined) {
+    if (![1, 2, 4, 8, 16, 32].includes(rate)) {
+      reply.code(400).send("Supported frame rates: 1, 2, 4, 8, 16, 32");
+      return;
+    }
+    frameRate = rate;
+  }
+  if (req.query.subpages !== undefined) {
+    subpageStreaming = parseInt(req.query.subpages) !== 0;
+  }
+  if (req.query.compression !== undefined) {
+    compression = parseInt(req.query.compression) !== 0;
+  }
+  if (req.query.filter !== undefined) {
+    if (!['off', 'ema', 'adaptive'].includes(req.query.filter)) {
+      reply.code(400).send("Supported filters: off, ema, adaptive");
+      return;
+    }
+    filter = req.query.filter;
+  }
+
+  reply.code(200).send(getMode());
+});
+
+function getMode() {
+  return {"rate": frameRate, "requestedRate": frameRate, "budgetRate": 32, "subpages": subpageStreaming, "compression": compression, "deadband": 5, "filter": filter, "i2cClock": frameRate > 4 ? 1000000 : 400000, "timings": {}};
+}
+
+// Recording state only, mock doesn't store frames. Size grows by 16 kB chunk per ~18 frames as on device
+let recording = false;
+let recordingStart = 0;
+const recordings = [];
+fastify.get('/recording', function (req, reply) {
+  if (!refuseStateChange(req, reply)) {
+    reply.code(200).send(getRecording());
+  }
+});
+
+fastify.post('/recording', function (req, reply) {
+  if (req.query.record !== undefined) {
+    const record = parseInt(req.query.record) !== 0;
+    if (record && !recording) {
+      recordingStart = frameCounter;
+      recordings.push({"name": String(recordings.length + 1).padStart(5, '0') + ".trec", "size": 0});
+    }
+    recording = record;
+  }
+  if (req.query.delete !== undefined) {
+    const index = recordings.findIndex((file) => file.name === req.query.delete);
+    if (index < 0) {
+      reply.code(404).send("No such recording");
+      return;
+    }
+    recordings.splice(index, 1);
+  }
+  reply.code(200).send(getRecording());
+});
+
+function getRecording() {
+  const frames = recording ? frameCounter - recordingStart : 0;
+  if (recording) {
+    recordings[recordings.length - 1].size = Math.ceil(frames / 18) * 16384;
+  }
+  return {"recording": recording, "file": recordings.length ? "/rec/" + recordings[recordings.length - 1].name : "", "frames": frames, "dropped": 0,
+    "chunks": Math.ceil(frames / 18), "files": recordings};
+}
+
+// Capture state only, mock ring holds 1330 frames as with PSRAM and freezes right after trigger
+let capture = {"state": "armed", "pre": 10, "post": 5, "threshold": undefined, "triggerFrame": 0};
+fastify.get('/capture', function (req, reply) {
+  if (!refuseStateChange(req, reply)) {
+    reply.code(200).send(getCapture());
+  }
+});
+
+fastify.post('/capture', function (req, reply) {
+  if (req.query.pre !== undefined) {
+    const pre = parseInt(req.query.pre);
+    if (!(pre >= 1 && pre <= 3600)) {
+      reply.code(400).send("Pre-trigger time must be 1 - 3600 s");
+      return;
+    }
+    capture.pre = pre;
+  }
+  if (req.query.post !== undefined) {
+    const post = parseInt(req.query.post);
+    if (!(post >= 0 && post <= 3600)) {
+      reply.code(400).send("Post-trigger time must be 0 - 3600 s");
+      return;
+    }
+    capture.post = post;
+  }
+  if (req.query.threshold !== undefined) {
+    capture.threshold = req.query.threshold === "off" ? undefined : parseFloat(req.query.threshold);
+  }
+  if (req.query.arm !== undefined) {
+    capture.state = "armed";
+  }
+  if (req.query.trigger !== undefined && capture.state === "armed") {
+    capture.state = "frozen";
+    capture.triggerFrame = frameCounter;
+  }
+  reply.code(200).send(getCapture());
+});
+
+function getCapture() {
+  const result = {"state": capture.state, "capacity": 1330, "memory": "psram", "pre": capture.pre, "post": capture.post,
+    "preFrames": capture.pre * frameRate, "postFrames": capture.post * frameRate, "stored": 1330, "threshold": capture.threshold};
+  if (capture.state === "frozen") {
+    const frames = Math.min(1330, (capture.pre + capture.post) * frameRate);
+    result.triggerFrame = capture.triggerFrame;
+    result.triggerIndex = Math.min(frames, capture.pre * frameRate);
+    result.frames = frames;
+  }
+  return result;
+}
+
+// Recording download with single byte range as device serves it, content is byte offset & 0xff
+fastify.get('/rec/:name', function (req, reply) {
+  const file = recordings.find((file) => file.name === req.params.name);
+  if (!file) {
+    reply.code(404).send("No such recording");
+    return;
+  }
+  const size = file.size;
+  let start = 0;
+  let end = size - 1;
+  const range = /^\s*bytes=\s*(\d*)-(\d*)\s*$/.exec(req.headers.range || "");
+  if (range && (range[1] !== "" || range[2] !== "") && !(range[1] !== "" && range[2] !== "" && parseInt(range[2]) < parseInt(range[1]))) {
+    if (range[1] === "") {
+      start = Math.max(0, size - parseInt(range[2]));
+    } else {
+      start = parseInt(range[1]);
+      end = range[2] === "" ? size - 1 : Math.min(parseInt(range[2]), size - 1);
+    }
+    if (start >= size || (range[1] === "" && parseInt(range[2]) === 0)) {
+      reply.code(416).header("Content-Range", `bytes */${size}`).send("Range not satisfiable");
+      return;
+    }
+    reply.code(206).header("Content-Range", `bytes ${start}-${end}/${size}`);
+  }
+  const data = Buffer.alloc(end - start + 1);
+  for (let i = 0; i < data.length; i++) {
+    data[i] = (start + i) & 0xff;
+  }
+  reply.header("Accept-Ranges", "bytes").header("Content-Disposition", `attachment; filename="${file.name}"`)
+    .type("application/octet-stream").send(data);
+});
+
 // Run the server!
 fastify.listen({ port: 8000 }, (err, address) => {
   if (err) throw err